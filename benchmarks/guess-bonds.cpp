@@ -0,0 +1,82 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+// Time taken by `Frame::guess_bonds` for a box of water molecules, without
+// unit cell, with an orthorhombic unit cell and with a triclinic unit cell.
+//
+// Usage: benchmark-guess-bonds [natoms]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <chrono>
+#include <random>
+
+#include "chemfiles/Frame.hpp"
+#include "chemfiles/UnitCell.hpp"
+
+using namespace chemfiles;
+
+/// Create a frame containing `natoms / 3` water molecules at liquid density,
+/// with randomly oriented molecules on a grid
+static Frame water_box(size_t natoms) {
+    auto molecules = natoms / 3;
+    // the liquid water density is around 0.0334 molecules per cubic Angstrom
+    auto per_side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(molecules))));
+    auto spacing = std::cbrt(1.0 / 0.0334);
+
+    auto rng = std::mt19937_64(42);
+    auto uniform = std::uniform_real_distribution<double>(-1.0, 1.0);
+    auto random_direction = [&]() {
+        auto direction = Vector3D(uniform(rng), uniform(rng), uniform(rng));
+        return direction / direction.norm();
+    };
+
+    auto frame = Frame();
+    frame.reserve(3 * molecules);
+    for (size_t i = 0; i < molecules; i++) {
+        auto oxygen = spacing * Vector3D(
+            static_cast<double>(i % per_side),
+            static_cast<double>((i / per_side) % per_side),
+            static_cast<double>(i / (per_side * per_side))
+        );
+        frame.add_atom(Atom("O"), oxygen);
+        frame.add_atom(Atom("H"), oxygen + 0.96 * random_direction());
+        frame.add_atom(Atom("H"), oxygen + 0.96 * random_direction());
+    }
+
+    auto length = spacing * static_cast<double>(per_side);
+    frame.set_cell(UnitCell({length, length, length}));
+    return frame;
+}
+
+/// Time `frame.guess_bonds()` with the given unit `cell`
+static void run(Frame& frame, const UnitCell& cell, const char* name) {
+    frame.set_cell(cell);
+    auto start = std::chrono::steady_clock::now();
+    frame.guess_bonds();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf(
+        "%-14s %10.3f s %8.2f ns/atom (%zu bonds)\n",
+        name, elapsed, elapsed / static_cast<double>(frame.size()) * 1e9,
+        frame.topology().bonds().size()
+    );
+}
+
+int main(int argc, char* argv[]) {
+    size_t natoms = 500000;
+    if (argc > 1) {
+        natoms = static_cast<size_t>(std::strtoull(argv[1], nullptr, 10));
+    }
+
+    auto frame = water_box(natoms);
+    auto lengths = frame.cell().lengths();
+
+    run(frame, UnitCell(), "infinite");
+    run(frame, UnitCell(lengths), "orthorhombic");
+    run(frame, UnitCell(lengths, {80, 95, 70}), "triclinic");
+
+    return 0;
+}
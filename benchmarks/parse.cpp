@@ -0,0 +1,269 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+// Throughput of number parsing with `parse<double>`, `parse_fixed<double>`
+// and `parse<int64_t>`, compared to the standard library and to the previous
+// digit accumulation algorithm; and of splitting lines in whitespace separated
+// values with `split_whitespace` and `scan`.
+//
+// Usage: benchmark-parse [count]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+#include <string_view>
+
+#include "chemfiles/parse.hpp"
+#include "chemfiles/utils.hpp"
+#include "chemfiles/error_fmt.hpp"
+
+using namespace chemfiles;
+
+/// The previous implementation of `parse<double>`
+static double legacy_parse_double(std::string_view input) {
+    if (input.empty()) {
+        throw error("can not parse a double from an empty string");
+    }
+
+    auto it = input.begin();  // NOLINT(readability-qualified-auto)
+    auto end = input.end();   // NOLINT(readability-qualified-auto)
+
+    // skip whitespaces before number
+    while (it != end && is_ascii_whitespace(*it)) {
+        it++;
+    }
+
+    // Get sign, if any.
+    int sign = 1.0;
+    if (it != end && *it == '-') {
+        sign = -1.0;
+        it++;
+    } else if (it != end && *it == '+') {
+        it++;
+    }
+
+    auto digit_start = it;  // NOLINT(readability-qualified-auto)
+    // Get digits before decimal point or exponent, if any.
+    double value = 0.0;
+    while (it != end && is_ascii_digit(*it)) {
+        value = value * 10.0 + static_cast<double>(*it - '0');
+        it++;
+    }
+    bool got_digits = (digit_start != it);
+
+    // Get digits after decimal point, if any.
+    if (it != end && *it == '.') {
+        it++;
+        auto frac_start = it;  // NOLINT(readability-qualified-auto)
+        double pow10 = 10.0;
+        while (it != end && is_ascii_digit(*it)) {
+            value += static_cast<double>(*it - '0') / pow10;
+            pow10 *= 10.0;
+            it++;
+        }
+
+        got_digits = got_digits || (frac_start != it);
+    }
+
+    // Handle exponent, if any.
+    bool frac = false;
+    double scale = 1.0;
+    if (it != end && (*it == 'e' || *it == 'E')) {
+        it++;
+        auto exponent_start = it;  // NOLINT(readability-qualified-auto)
+
+        // Get sign of exponent, if any.
+        if (it != end && *it == '-') {
+            frac = true;
+            it++;
+        } else if (it != end && *it == '+') {
+            it++;
+        }
+
+        // Get digits of exponent, if any.
+        unsigned exponent = 0;
+        while (it != end && is_ascii_digit(*it)) {
+            auto digit = static_cast<unsigned>(*it - '0');
+            if (exponent <= ((std::numeric_limits<unsigned>::max() - digit) / 10)) {
+                exponent = exponent * 10 + digit;
+            } else {
+                throw error("float exponent in {} is out of range for unsigned integer", input);
+            }
+
+            it++;
+        }
+
+        if (it == exponent_start) {
+            throw error("missing exponent in '{}' to read a double", input);
+        } else if (exponent > 308) {
+            throw error("{} is out of range for double", input);
+        }
+
+        // Calculate scaling factor.
+        while (exponent >= 50) { scale *= 1e50; exponent -= 50; }
+        while (exponent >=  8) { scale *= 1e8;  exponent -=  8; }
+        while (exponent >   0) { scale *= 1e1;  exponent -=  1; }
+    }
+
+    // skip whitespaces after number if any
+    while (it != end && is_ascii_whitespace(*it)) {
+        it++;
+    }
+
+    if (it != end || !got_digits) {
+        throw error("can not parse '{}' as a double", input);
+    }
+
+    // Return signed and scaled floating point result.
+    return sign * (frac ? (value / scale) : (value * scale));
+}
+
+/// A set of numbers formatted the same way, and the exact value of these
+/// numbers
+struct Dataset {
+    std::string name;
+    std::vector<std::string> numbers;
+    std::vector<double> expected;
+    size_t bytes = 0;
+};
+
+static Dataset create_dataset(const char* name, const char* format, size_t count, const std::function<double()>& generator) {
+    auto dataset = Dataset();
+    dataset.name = name;
+    char buffer[64];
+    for (size_t i = 0; i < count; i++) {
+        std::snprintf(buffer, sizeof(buffer), format, generator());
+        dataset.numbers.emplace_back(buffer);
+        dataset.expected.push_back(std::strtod(buffer, nullptr));
+        dataset.bytes += dataset.numbers.back().size();
+    }
+    return dataset;
+}
+
+/// Run and time `function` on all the numbers in `dataset`. The function is
+/// called through `std::function` to prevent inlining, and give the same call
+/// overhead to all parsers.
+template <typename T>
+static void run(const Dataset& dataset, const char* parser, const std::function<T(const std::string&)>& function) {
+    // warm up, and check the results
+    size_t incorrect = 0;
+    for (size_t i = 0; i < dataset.numbers.size(); i++) {
+        auto value = static_cast<double>(function(dataset.numbers[i]));
+        if (value != dataset.expected[i]) {
+            incorrect++;
+        }
+    }
+
+    constexpr size_t REPEAT = 10;
+    T sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < REPEAT; repeat++) {
+        for (const auto& number: dataset.numbers) {
+            sum += function(number);
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto count = static_cast<double>(REPEAT * dataset.numbers.size());
+    auto bytes = static_cast<double>(REPEAT * dataset.bytes);
+    std::printf(
+        "%-14s %-22s %8.1f MB/s %8.2f ns/number %8zu incorrectly rounded (checksum %g)\n",
+        dataset.name.c_str(), parser, bytes / elapsed / 1e6, elapsed / count * 1e9,
+        incorrect, static_cast<double>(sum)
+    );
+}
+
+/// Run and time `function` splitting all the `lines` in values, returning
+/// the number of values found
+static void run_split(const std::vector<std::string>& lines, const char* name, const std::function<size_t(const std::string&)>& function) {
+    size_t bytes = 0;
+    for (const auto& line: lines) {
+        bytes += line.size();
+    }
+
+    constexpr size_t REPEAT = 10;
+    size_t values = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < REPEAT; repeat++) {
+        for (const auto& line: lines) {
+            values += function(line);
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf(
+        "%-14s %-22s %8.1f MB/s %8.2f ns/line (checksum %zu)\n",
+        "LAMMPS lines", name, static_cast<double>(REPEAT * bytes) / elapsed / 1e6,
+        elapsed / static_cast<double>(REPEAT * lines.size()) * 1e9, values
+    );
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = 1000000;
+    if (argc > 1) {
+        count = static_cast<size_t>(std::strtoull(argv[1], nullptr, 10));
+    }
+
+    auto rng = std::mt19937_64(42);
+    auto coordinates = std::uniform_real_distribution<double>(-999.0, 9999.0);
+    auto uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+    auto exponents = std::uniform_int_distribution<int>(-30, 30);
+    auto integers = std::uniform_int_distribution<int64_t>(-10000000, 10000000);
+
+    auto pdb = create_dataset("PDB (%8.3f)", "%8.3f", count, [&]() { return coordinates(rng); });
+    auto xyz = create_dataset("XYZ (%.6f)", "%.6f", count, [&]() { return coordinates(rng); });
+    auto scientific = create_dataset("LAMMPS (%.10e)", "%.10e", count, [&]() {
+        return uniform(rng) * std::pow(10.0, exponents(rng));
+    });
+    auto full = create_dataset("full (%.17g)", "%.17g", count, [&]() {
+        return uniform(rng) * std::pow(10.0, exponents(rng));
+    });
+    auto integer = create_dataset("integers", "%.0f", count, [&]() {
+        return static_cast<double>(integers(rng));
+    });
+
+    for (const auto* dataset: {&pdb, &xyz, &scientific, &full}) {
+        run<double>(*dataset, "legacy", legacy_parse_double);
+        run<double>(*dataset, "parse<double>", [](std::string_view input) { return parse<double>(input); });
+        run<double>(*dataset, "strtod", [](const std::string& input) { return std::strtod(input.c_str(), nullptr); });
+    }
+    run<double>(pdb, "parse_fixed<double>", [](std::string_view input) { return parse_fixed<double>(input); });
+
+    run<int64_t>(integer, "parse<int64_t>", [](std::string_view input) { return parse<int64_t>(input); });
+    run<int64_t>(integer, "strtoll", [](const std::string& input) { return std::strtoll(input.c_str(), nullptr, 10); });
+
+    auto lines = std::vector<std::string>();
+    char buffer[256];
+    for (size_t i = 0; i < count / 5; i++) {
+        std::snprintf(
+            buffer, sizeof(buffer), "%zu 1 %.10e %.10e %.10e %.10e %.10e %.10e", i + 1,
+            coordinates(rng), coordinates(rng), coordinates(rng),
+            uniform(rng), uniform(rng), uniform(rng)
+        );
+        lines.emplace_back(buffer);
+    }
+
+    run_split(lines, "split(' ')", [](const std::string& line) {
+        return split(line, ' ').size();
+    });
+    auto tokens = std::vector<std::string_view>();
+    run_split(lines, "split_whitespace", [&](const std::string& line) {
+        split_whitespace(line, tokens);
+        return tokens.size();
+    });
+    run_split(lines, "scan (with parse)", [](const std::string& line) {
+        size_t id = 0, type = 0;
+        double x = 0, y = 0, z = 0, vx = 0, vy = 0, vz = 0;
+        return scan(line, id, type, x, y, z, vx, vy, vz);
+    });
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+// Throughput of number formatting with `write_fixed` and `write_general`
+// compared to the equivalent fmt format strings, and of the XYZ, PDB and GRO
+// writers for a large frame.
+//
+// Usage: benchmark-write [natoms]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <fmt/format.h>
+
+#include "chemfiles/write_numbers.hpp"
+#include "chemfiles/Trajectory.hpp"
+#include "chemfiles/Frame.hpp"
+#include "chemfiles/Residue.hpp"
+
+using namespace chemfiles;
+
+/// Run and time `function` formatting all the `values` in a buffer
+static void run_format(const std::vector<double>& values, const char* name, const std::function<void(line_buffer&, double)>& function) {
+    constexpr size_t REPEAT = 10;
+    size_t bytes = 0;
+    auto buffer = line_buffer();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < REPEAT; repeat++) {
+        for (auto value: values) {
+            buffer.clear();
+            function(buffer, value);
+            bytes += buffer.size();
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf(
+        "%-24s %8.1f MB/s %8.2f ns/number\n",
+        name, static_cast<double>(bytes) / elapsed / 1e6,
+        elapsed / static_cast<double>(REPEAT * values.size()) * 1e9
+    );
+}
+
+/// Time writing `frame` to memory with the given `format`
+static void run_writer(const Frame& frame, const char* format) {
+    auto start = std::chrono::steady_clock::now();
+    auto trajectory = Trajectory::memory_writer(format);
+    trajectory.write(frame);
+    auto size = trajectory.memory_buffer()->size();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf(
+        "%-24s %8.1f MB/s %8.2f ns/atom\n",
+        format, static_cast<double>(size) / elapsed / 1e6,
+        elapsed / static_cast<double>(frame.size()) * 1e9
+    );
+}
+
+int main(int argc, char* argv[]) {
+    size_t natoms = 1000000;
+    if (argc > 1) {
+        natoms = static_cast<size_t>(std::strtoull(argv[1], nullptr, 10));
+    }
+
+    auto rng = std::mt19937_64(42);
+    auto coordinates = std::uniform_real_distribution<double>(-999.0, 9999.0);
+
+    auto values = std::vector<double>();
+    for (size_t i = 0; i < natoms; i++) {
+        values.push_back(coordinates(rng));
+    }
+
+    run_format(values, "fmt {:8.3f}", [](line_buffer& buffer, double value) {
+        fmt::format_to(fmt::appender(buffer), "{:8.3f}", value);
+    });
+    run_format(values, "write_fixed<3>", [](line_buffer& buffer, double value) {
+        write_fixed<3>(buffer, value, 8);
+    });
+    run_format(values, "fmt {:g}", [](line_buffer& buffer, double value) {
+        fmt::format_to(fmt::appender(buffer), "{:g}", value);
+    });
+    run_format(values, "write_general", [](line_buffer& buffer, double value) {
+        write_general(buffer, value);
+    });
+
+    auto frame = Frame();
+    frame.reserve(natoms);
+    for (size_t i = 0; i < natoms; i++) {
+        frame.add_atom(Atom("C"), {coordinates(rng) / 10, coordinates(rng) / 10, coordinates(rng) / 10});
+    }
+    for (size_t i = 0; i + 3 <= natoms; i += 3) {
+        // keep residue ids small enough for all formats
+        auto residue = Residue("ALA", static_cast<int64_t>((i / 3) % 9999 + 1));
+        residue.add_atom(i);
+        residue.add_atom(i + 1);
+        residue.add_atom(i + 2);
+        frame.add_residue(std::move(residue));
+    }
+
+    run_writer(frame, "XYZ");
+    run_writer(frame, "PDB");
+    run_writer(frame, "GRO");
+
+    return 0;
+}
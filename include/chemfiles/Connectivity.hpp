@@ -5,11 +5,13 @@
 #define CHEMFILES_CONNECTIVITY_HPP
 
 #include <array>
+#include <cstddef>
 #include <vector>
 #include <algorithm> // IWYU pragma: keep
 
 #include "chemfiles/sorted_set.hpp"
 #include "chemfiles/exports.h"
+#include "chemfiles/external/span.hpp"
 
 namespace chemfiles {
 
@@ -293,10 +295,14 @@ inline bool operator>=(const Improper& lhs, const Improper& rhs) {
     return lhs.data_ >= rhs.data_;
 }
 
-/// The connectivity struct store a cache of the bonds, angles and dihedrals
-/// in the system. The `recalculate` function should be called when bonds are
-/// added or removed. The `bonds` set is the main source of information, all the
-/// other data are cached from it.
+/// The connectivity struct store the bonds in the system, and a cache of the
+/// angles, dihedrals and impropers created by these bonds. The `bonds` set is
+/// the main source of information, all the other data are cached from it.
+///
+/// Angles, dihedrals and impropers are each computed independently the first
+/// time they are requested. Once computed, they are updated incrementally when
+/// a single bond is added or removed; adding many bonds at once with
+/// `add_bonds` clears the caches instead.
 class Connectivity final {
 public:
     Connectivity() = default;
@@ -319,36 +325,76 @@ public:
     /// Add a bond between the atoms `i` and `j`
     void add_bond(size_t i, size_t j, Bond::BondOrder bond_order = Bond::UNKNOWN);
 
+    /// Add all the `bonds` at once, with the corresponding `bond_orders`. If
+    /// `bond_orders` is empty, all bonds use `Bond::UNKNOWN`; else it must
+    /// have the same size as `bonds`.
+    ///
+    /// This sorts the new bonds and merges them with the existing ones in a
+    /// single pass. As with `add_bond`, bonds which already exist keep their
+    /// bond order, and for bonds given multiple times the first bond order is
+    /// used.
+    void add_bonds(span<const Bond> bonds, span<const Bond::BondOrder> bond_orders);
+
     /// Remove any bond between the atoms `i` and `j`
     void remove_bond(size_t i, size_t j);
 
-    /// Update the indexes of the bonds after atom removal
+    /// Update the indexes of the bonds after atoms removal. `new_indexes[i]`
+    /// is the new index of the atom `i`, or `SIZE_MAX` if this atom was
+    /// removed. The new indexes must be in the same order as the old ones.
     ///
-    /// This function shifts all indexes bigger than `index` in the
-    /// bonds/angles/dihedrals/impropers lists by -1.
-    void atom_removed(size_t index);
+    /// All the bonds/angles/dihedrals/impropers containing removed atoms are
+    /// removed, and the indexes of the other atoms are updated.
+    void atoms_removed(span<const size_t> new_indexes);
 
     /// Get the bond order of the bond between i and j
     Bond::BondOrder bond_order(size_t i, size_t j) const;
 private:
-    /// Recalculate the angles and the dihedrals from the bond list
-    void recalculate() const;
+    /// Build the adjacency list from the bonds, if it is not up to date
+    void update_adjacency() const;
+    /// Get the sorted list of atoms bonded to `atom`. The adjacency list must
+    /// be up to date.
+    span<const size_t> bonded_to(size_t atom) const;
+
+    /// Compute all the angles from the bonds
+    void compute_angles() const;
+    /// Compute all the dihedral angles from the bonds
+    void compute_dihedrals() const;
+    /// Compute all the improper dihedral angles from the bonds
+    void compute_impropers() const;
+
+    /// Update the adjacency list and the up to date caches after adding a
+    /// new bond between `i` and `j`
+    void bond_added(size_t i, size_t j);
+    /// Update the adjacency list and the up to date caches after removing
+    /// the bond between `i` and `j`
+    void bond_removed(size_t i, size_t j);
 
     /// Biggest index within the atoms we know about. Used to pre-allocate
-    /// memory when recomputing bonds.
+    /// memory when building the adjacency list.
     size_t biggest_atom_ = 0;
     /// Bonds in the system
     sorted_set<Bond> bonds_;
+    /// Store the bond orders
+    std::vector<Bond::BondOrder> bond_orders_;
+
+    /// Adjacency list in compressed sparse row format: the atoms bonded to
+    /// atom `i` are stored in `adjacency_` between `adjacency_offsets_[i]`
+    /// and `adjacency_offsets_[i + 1]`, sorted by index.
+    mutable std::vector<size_t> adjacency_offsets_;
+    mutable std::vector<size_t> adjacency_;
+    /// Is the adjacency list up to date?
+    mutable bool adjacency_uptodate_ = false;
+
     /// Angles in the system
     mutable sorted_set<Angle> angles_;
     /// Dihedral angles in the system
     mutable sorted_set<Dihedral> dihedrals_;
     /// Improper dihedral angles in the system
     mutable sorted_set<Improper> impropers_;
-    /// Is the cached content up to date ?
-    mutable bool uptodate_ = false;
-    /// Store the bond orders
-    std::vector<Bond::BondOrder> bond_orders_;
+    /// Are the cached angles, dihedrals and impropers up to date?
+    mutable bool angles_uptodate_ = false;
+    mutable bool dihedrals_uptodate_ = false;
+    mutable bool impropers_uptodate_ = false;
 };
 
 } // namespace chemfiles
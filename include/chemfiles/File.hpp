@@ -16,9 +16,26 @@
 #include <fmt/format.h>
 
 #include "chemfiles/exports.h"
+#include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
 
+/// Options for the compression of text files, set from the format string used
+/// to open a `Trajectory` (for example `"XYZ / XZ(level=9, extreme=true)"`).
+/// Default values let each compression method use its own defaults.
+struct CompressionOptions {
+    /// Compression level, or -1 to use the default level
+    int level = -1;
+    /// Use the slower "extreme" variant of the compression level (xz only)
+    bool extreme = false;
+    /// Size of the uncompressed data in each compressed block or frame, or 0
+    /// to use the default block size (xz and zstd only)
+    uint64_t block_size = 0;
+    /// Number of threads to use for compression and decompression, or 0 to
+    /// use all available threads
+    size_t threads = 0;
+};
+
 /// Abstract base class for file representation.
 class CHFL_EXPORT File {
 public:
@@ -42,6 +59,8 @@ public:
         BZIP2,
         /// lzma compression (.xz)
         LZMA,
+        /// zstd compression (.zst)
+        ZSTD,
     };
 
     virtual ~File() noexcept = default;
@@ -104,6 +123,30 @@ public:
     /// @throws FileError if it could not write all of the data to the file
     virtual void write(const char* data, size_t count) = 0;
 
+    /// Get a view of the whole content of the file, if this implementation
+    /// keeps it in contiguous memory (for example memory mapped files). The
+    /// view must stay valid as long as this `TextFileImpl` is alive.
+    ///
+    /// When this returns `nullopt` (the default), `TextFile` reads data in its
+    /// own buffer through `read`.
+    virtual optional<std::string_view> contiguous() const {
+        return nullopt;
+    }
+
+    /// Change the compression options for this file. This should be called
+    /// right after opening the file, before reading or writing any data. The
+    /// default implementation throws an error, since uncompressed files do
+    /// not have any compression option.
+    ///
+    /// @throws FileError if the options are not valid for this file
+    virtual void set_compression_options(const CompressionOptions& options);
+
+    /// Make sure all the data written so far is stored in the underlying
+    /// file or memory buffer, as a complete file. Compressed files may keep
+    /// some data in memory until the file is closed, or until this function
+    /// is called. The default implementation does nothing.
+    virtual void flush() {}
+
 protected:
     /// Get the string path used to open this file
     std::string_view path() const {
@@ -125,7 +168,18 @@ class MemoryBuffer;
 /// `string_view` inside this buffer, removing the need to allocate a new
 /// `std::string` for each line.
 ///
-/// Writing to the files is done without buffering or considering lines.
+/// When the `TextFileImpl` exposes the whole file in contiguous memory (see
+/// `TextFileImpl::contiguous`), this buffer is not used and the lines point
+/// directly inside the `TextFileImpl` memory instead. This is the case for
+/// in-memory data, and for uncompressed files opened for reading when
+/// chemfiles is configured with `CHFL_MMAP_TEXT_FILES=ON`. Such files are
+/// then a snapshot of the file content when opening it: data appended to the
+/// file later is not visible, and the file must not be truncated while it is
+/// opened.
+///
+/// Data written to the file is accumulated in a separate output buffer, and
+/// only sent to the `TextFileImpl` in large blocks, when calling `flush()`, or
+/// when the `TextFile` is destroyed.
 ///
 ///
 /// This class can read compressed data or in-memory data by using one of the
@@ -146,8 +200,11 @@ public:
     /// compressed file.
     TextFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, File::Compression compression);
 
+    ~TextFile() override;
     TextFile(TextFile&&) = default;
-    TextFile& operator=(TextFile&&) = default;
+    /// Move `other` into this file, after writing any data waiting in the
+    /// output buffer of this file.
+    TextFile& operator=(TextFile&& other);
     TextFile(const TextFile&) = delete;
     TextFile& operator=(const TextFile&) = delete;
 
@@ -170,12 +227,45 @@ public:
     /// Clear end-of-file flags on the file.
     void clear();
 
+    /// Get a view of the whole file content if it is available in contiguous
+    /// memory (memory mapped and in-memory files opened for reading), or
+    /// `nullopt` otherwise.
+    const optional<std::string_view>& contiguous() const {
+        return contiguous_;
+    }
+
+    /// Change the compression options used for this file, see
+    /// `TextFileImpl::set_compression_options`.
+    void set_compression_options(const CompressionOptions& options) {
+        file_->set_compression_options(options);
+    }
+
+    /// Make sure all the data written so far is stored in the underlying file
+    /// or memory buffer, see `TextFileImpl::flush`.
+    ///
+    /// Calling this function again without writing more data does nothing,
+    /// in particular compressed files do not start a new compressed stream.
+    ///
+    /// Errors while writing buffered data are reported by this function.
+    /// When the file is destroyed without calling `flush`, these errors are
+    /// only reported as warnings.
+    ///
+    /// @throws FileError if writing the data fails
+    void flush();
+
     /// Read a single line from the file. The returned `string_view` points into
     /// an internal buffer, and can be invalidated after another call to
     /// `readline`. If storing the line is necessary, transform it to an owned
     /// string using `string_view::to_string()`.
     std::string_view readline();
 
+    /// Skip the next `count` lines in the file, as if calling `readline()`
+    /// `count` times, without looking at the lines content. This returns the
+    /// number of lines skipped, which is smaller than `count` if the end of
+    /// file was reached before. Together with `tellpos()`, this can be used to
+    /// get the offset of any line in the file.
+    size_t skiplines(size_t count);
+
     /// Read the full file into an owned string. This is a convenience method
     /// for format that need the full file read before parsing can start.
     std::string readall();
@@ -189,10 +279,32 @@ public:
         this->vprint(format, fmt::make_format_args(args...));
     }
 
+    /// Write `data` to the file as-is, without any formatting.
+    void write(std::string_view data);
+
+    /// Get a pointer to at least `count` bytes of writable memory at the end
+    /// of the output buffer. This allows to format data directly inside the
+    /// output buffer, without going through `print`. The data is only added
+    /// to the file after a call to `commit_output`, and the pointer is
+    /// invalidated by any other call to a function of this `TextFile`.
+    char* reserve_output(size_t count);
+
+    /// Add the first `count` bytes written to the memory returned by the last
+    /// call to `reserve_output` to the file. `count` must not be larger than
+    /// the size requested in `reserve_output`.
+    void commit_output(size_t count);
+
 private:
     /// Fill the buffer, calling `refill` and setting all needed internal values
     void fill_buffer(size_t start);
 
+    /// Use the contiguous data from `file_` instead of the buffer if the
+    /// `TextFileImpl` provides it
+    void use_contiguous();
+
+    /// Implementation of `readline` when using `contiguous_` data
+    std::string_view readline_contiguous();
+
     /// Actually format and print data to the file
     void vprint(fmt::string_view format, fmt::format_args args);
 
@@ -200,8 +312,15 @@ private:
     /// underlying  `TextFileImpl`.
     bool buffer_initialized() const;
 
+    /// Send all the data in the output buffer to the `TextFileImpl`
+    void flush_output();
+
     /// Pointer to the actual file implementation
     std::unique_ptr<TextFileImpl> file_;
+    /// Whole content of the file, if `file_` provides it. When this is set,
+    /// `line_start_` and `end_` point inside this data and `buffer_` is
+    /// unused.
+    optional<std::string_view> contiguous_;
     /// Buffer storing characters read from the `TextFileImpl`. If
     /// `got_impl_eof_` is true, this contains the remaining characters from the
     /// file and is then padded with null characters ('\0').
@@ -219,6 +338,15 @@ private:
     bool got_impl_eof_ = false;
     /// Did we actually reached the end of file while reading a line?
     bool eof_ = false;
+    /// Buffer storing data waiting to be written to the `TextFileImpl`. This
+    /// is allocated on the first write in write or append mode, and only the
+    /// first `output_size_` bytes contain actual data.
+    std::vector<char> output_;
+    /// Number of bytes waiting to be written in `output_`
+    size_t output_size_ = 0;
+    /// Was some data sent to the `TextFileImpl` since the last call to
+    /// `flush()`?
+    bool unflushed_ = false;
 };
 
 } // namespace chemfiles
@@ -75,6 +75,17 @@ public:
     /// @param frame The frame to fill
     virtual void read_step(size_t step, Frame& frame);
 
+    /// Read `frames.size()` consecutive steps from the trajectory file,
+    /// starting at `start`. The default implementation calls `read_step` for
+    /// each step.
+    ///
+    /// @throw FormatError if the file does not follow the format
+    /// @throw FileError if their is an OS error while reading the file
+    ///
+    /// @param start The first step to read
+    /// @param frames The frames to fill
+    virtual void read_steps(size_t start, std::vector<Frame>& frames);
+
     /// Read the next step from the trajectory file.
     ///
     /// @throw FormatError if the file does not follow the format
@@ -96,6 +107,21 @@ public:
     ///
     /// @return The number of frames
     virtual size_t nsteps() = 0;
+
+    /// Set the options used to compress or decompress the associated file.
+    /// This is called right after creating the format, if compression
+    /// options were given in the format string. The default implementation
+    /// ignores the options.
+    ///
+    /// @throw FileError if the options are not valid for this file
+    ///
+    /// @param options The compression options
+    virtual void set_compression_options(const CompressionOptions& options);
+
+    /// Make sure all the data written so far is stored in the associated
+    /// file or memory buffer. This is called before giving access to the
+    /// buffer of memory writers. The default implementation does nothing.
+    virtual void flush();
 };
 
 /// The `TextFormat` class defines a common, simpler interface for text based
@@ -111,9 +137,12 @@ public:
     virtual ~TextFormat() override = default;
 
     void read_step(size_t step, Frame& frame) override;
+    void read_steps(size_t start, std::vector<Frame>& frames) override;
     void read(Frame& frame) override;
     void write(const Frame& frame) override;
     size_t nsteps() override;
+    void set_compression_options(const CompressionOptions& options) override;
+    void flush() override;
 
     /// Fast-forward the file for one step, returning a valid position if the
     /// file does contain one more step or `nullopt` if it does not.
@@ -122,6 +151,22 @@ public:
     virtual void read_next(Frame& frame);
     virtual void write_next(const Frame& frame);
 
+    /// Create a new instance of this format, reading from the given `memory`.
+    /// This is used to scan and read the file from multiple threads at once.
+    /// The default implementation returns `nullptr`, which disables parallel
+    /// scanning and reading for this format.
+    virtual std::unique_ptr<TextFormat> parallel_reader(std::shared_ptr<MemoryBuffer> memory) const;
+
+    /// Move the file to the start of the first step after the current
+    /// position, which can be anywhere inside another step. This returns the
+    /// position of the step, or `nullopt` if no step could be found.
+    ///
+    /// This is used to split the file in chunks that are scanned in parallel.
+    /// The steps found in each chunk are validated against the previous chunk,
+    /// so this function may occasionally return a position which is not the
+    /// start of a step. The default implementation returns `nullopt`.
+    virtual optional<uint64_t> find_next_step();
+
 protected:
     /// Text file used to read/write data
     TextFile file_;
@@ -130,6 +175,17 @@ private:
     /// Scan the whole file to get all the steps positions
     void scan_all();
 
+    /// Try to scan the whole file for steps in parallel, filling
+    /// `steps_positions_`. This returns `false` if parallel scanning is not
+    /// possible for this file/format, or if the scanning did not give
+    /// consistent results.
+    bool scan_all_parallel();
+
+    /// Try to read `frames.size()` steps starting at `start` in parallel.
+    /// This returns `false` if parallel reading is not possible for this
+    /// file/format.
+    bool read_steps_parallel(size_t start, std::vector<Frame>& frames);
+
     /// The next step to read
     size_t step_ = 0;
 
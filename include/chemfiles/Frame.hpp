@@ -22,6 +22,7 @@
 
 namespace chemfiles {
 class Atom;
+class Selection;
 
 /// A frame contains data from one simulation step The Frame class holds data
 /// from one step of a simulation: the current topology, the positions, and the
@@ -192,6 +193,47 @@ public:
     /// @example{frame/remove.cpp}
     void remove(size_t i);
 
+    /// Remove all the atoms at the given `indexes` in the system. The
+    /// `indexes` can be given in any order, and can contain duplicated values.
+    ///
+    /// The remaining atoms keep their relative order. Positions, velocities,
+    /// atoms, residues and bonds are all compacted in a single pass, which is
+    /// much faster than calling `remove` for each atom.
+    ///
+    /// @throws chemfiles::OutOfBounds if any index is bigger than the number
+    ///         of atoms in this frame
+    ///
+    /// @example{frame/remove-indexes.cpp}
+    void remove(span<const size_t> indexes);
+
+    /// Keep only the atoms matching the given `selection` in the system, and
+    /// remove all the others. This uses the same single pass compaction as
+    /// `remove`.
+    ///
+    /// @throws chemfiles::SelectionError if the selection does not match
+    ///         single atoms (i.e. `selection.size() != 1`)
+    ///
+    /// @example{frame/keep.cpp}
+    void keep(const Selection& selection);
+
+    /// Create a new frame containing only the atoms at the given `indexes`
+    /// in this frame. The atom at `indexes[i]` in this frame becomes the atom
+    /// at index `i` in the new frame.
+    ///
+    /// The new frame contains the positions and velocities of these atoms,
+    /// the bonds between them, and the residues containing at least one of
+    /// them (with the same name, id and properties). The unit cell, step and
+    /// properties of this frame are copied to the new frame. The new frame is
+    /// built in a single pass over this frame, and can be used with
+    /// `Selection::list` to extract a part of a system.
+    ///
+    /// @throws chemfiles::OutOfBounds if any index is bigger than the number
+    ///         of atoms in this frame
+    /// @throws chemfiles::Error if `indexes` contains the same index twice
+    ///
+    /// @example{frame/extract.cpp}
+    Frame extract(span<const size_t> indexes) const;
+
     /// Get the current simulation step.
     ///
     /// The step is set by the `Trajectory` when reading a frame.
@@ -252,6 +294,24 @@ public:
         topology_.add_bond(atom_i, atom_j, bond_order);
     }
 
+    /// Add multiple bonds in the system at once, with the corresponding
+    /// `bond_orders`. If `bond_orders` is empty, all the bonds are added with
+    /// an unknown bond order.
+    ///
+    /// This is equivalent to calling `add_bond` for all bonds, but much faster
+    /// when adding many bonds.
+    ///
+    /// @example{frame/add_bonds.cpp}
+    ///
+    /// @param bonds the bonds to add
+    /// @param bond_orders the bond order of each bond, or an empty span
+    /// @throws OutOfBounds if any atom in `bonds` is greater than `size()`
+    /// @throws Error if `bond_orders` is not empty and does not have the same
+    ///         size as `bonds`
+    void add_bonds(span<const Bond> bonds, span<const Bond::BondOrder> bond_orders = {}) {
+        topology_.add_bonds(bonds, bond_orders);
+    }
+
     /// Remove a bond in the system, between the atoms at index `atom_i` and
     /// `atom_j`.
     ///
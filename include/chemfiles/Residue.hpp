@@ -13,6 +13,7 @@
 
 #include "chemfiles/exports.h"
 #include "chemfiles/sorted_set.hpp"
+#include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
 #include "chemfiles/Property.hpp"
 
@@ -137,14 +138,11 @@ private:
     /// Additional properties of this residue
     property_map properties_;
 
-    /// Update the atomic indexes in this residue after an atom has been
-    /// removed from the containing topology.
-    ///
-    /// This function shifts all the indexes bigger than `i` by -1.
-    void atom_removed(size_t i);
-
-    /// remove the atom at index i from this residue
-    void remove(size_t i);
+    /// Update the atomic indexes in this residue after some atoms have been
+    /// removed from the containing topology. `new_indexes[i]` is the new
+    /// index of the atom `i`, or `SIZE_MAX` if this atom was removed. Removed
+    /// atoms are also removed from this residue.
+    void atoms_removed(span<const size_t> new_indexes);
 
     friend bool operator==(const Residue& lhs, const Residue& rhs);
 
@@ -15,6 +15,7 @@
 #include "chemfiles/Error.hpp"
 #include "chemfiles/exports.h"
 
+#include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
@@ -106,6 +107,20 @@ public:
     /// @throws OutOfBounds if `i` is greater than size()
     void remove(size_t i);
 
+    /// Delete all the atoms at the given `indexes` in this topology, as well
+    /// as all the bonds involving these atoms. The `indexes` can be given in
+    /// any order, and can contain duplicated values.
+    ///
+    /// The remaining atoms keep their relative order, and their indexes are
+    /// updated in the atoms, bonds and residues lists. Contrary to calling
+    /// `remove` for each atom, this runs in a single pass over the topology.
+    ///
+    /// @example{topology/remove-indexes.cpp}
+    ///
+    /// @param indexes the indexes of the atoms to remove
+    /// @throws OutOfBounds if any index is greater than size()
+    void remove(span<const size_t> indexes);
+
     /// Add a bond in the system, between the atoms at index `atom_i` and
     /// `atom_j`.
     ///
@@ -118,6 +133,23 @@ public:
     /// @throws Error if `atom_i == atom_j`, as this is an invalid bond
     void add_bond(size_t atom_i, size_t atom_j, Bond::BondOrder bond_order = Bond::UNKNOWN);
 
+    /// Add multiple bonds in the system at once, with the corresponding
+    /// `bond_orders`. If `bond_orders` is empty, all the bonds are added with
+    /// an unknown bond order.
+    ///
+    /// This is equivalent to calling `add_bond` for all bonds, but much faster
+    /// when adding many bonds: the new bonds are sorted and merged with the
+    /// existing ones only once.
+    ///
+    /// @example{topology/add_bonds.cpp}
+    ///
+    /// @param bonds the bonds to add
+    /// @param bond_orders the bond order of each bond, or an empty span
+    /// @throws OutOfBounds if any atom in `bonds` is greater than `size()`
+    /// @throws Error if `bond_orders` is not empty and does not have the same
+    ///         size as `bonds`
+    void add_bonds(span<const Bond> bonds, span<const Bond::BondOrder> bond_orders = {});
+
     /// Remove a bond in the system, between the atoms at index `atom_i` and
     /// `atom_j`.
     ///
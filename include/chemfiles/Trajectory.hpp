@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "chemfiles/exports.h"
 #include "chemfiles/Frame.hpp"
@@ -29,20 +30,32 @@ public:
     /// `"<format>/<compression>"`. `<format>` should be the format name (see
     /// the corresponding [documentation section][formats] for the names) or an
     /// empty string. `<compression>` should be `GZ` for gzip files, `BZ2` for
-    /// bzip2 files, or `XZ` for lzma/.xz files. If `<compression>` is present,
-    /// it will determine which compression method is used to read/write the
-    /// file.
+    /// bzip2 files, `XZ` for lzma/.xz files, or `ZST` for zstd files. If
+    /// `<compression>` is present, it will determine which compression method
+    /// is used to read/write the file.
     ///
     /// For example, `format = "XYZ"` will force usage of XYZ format regardless
     /// of the file extension; `format = "XYZ / GZ"` will additionally use gzip
     /// compression.
     ///
-    /// If the `format` is an empty string, the file extension will be used to
-    /// guess the format. If the file path ends with `.gz`, `.xz`, or `.bz2`;
-    /// the file will be treated as a compressed file and the next extension is
-    /// used to guess the format. For example `Trajectory("file.xyz.gz")` will
-    /// open the file for reading using the XYZ format and the gzip compression
-    /// method.
+    /// Compression options can be given in parenthesis after the compression
+    /// method, as a comma-separated list of `name=value` pairs:
+    /// `format = "XYZ / XZ(level=9, extreme=true, threads=4)"`. The available
+    /// options are `level` (from 0 to 9, 1 to 9 for bzip2, or 1 to 22 for
+    /// zstd), `extreme` (`true` or `false`, xz only), `block_size` (size in
+    /// bytes of the uncompressed data in each block or frame, xz and zstd
+    /// only) and `threads` (number of threads used to compress or decompress
+    /// the file, 0 meaning all available threads).
+    ///
+    /// If the `format` is an empty string, the format is guessed with
+    /// `guess_format`. In `r` and `a` modes, the first bytes of existing files
+    /// are used to detect compressed files and binary formats with a magic
+    /// number, even if the extension is missing or wrong. Otherwise, the file
+    /// extension is used to guess the format. If the file path ends with
+    /// `.gz`, `.xz`, `.bz2` or `.zst`; the file will be treated as a compressed
+    /// file and the next extension is used to guess the format. For example
+    /// `Trajectory("file.xyz.gz")` will open the file for reading using the XYZ
+    /// format and the gzip compression method.
     ///
     /// @example{trajectory/trajectory.cpp}
     ///
@@ -76,7 +89,8 @@ public:
     /// @param size The size of the memory buffer.
     /// @param format Specific format to use.
     ///
-    /// @throws FileError If the compression given in `format` is not supported
+    /// @throws FileError If the compression given in `format` is not
+    ///                   supported, or if the compression options are invalid
     /// @throws FormatError if the data in the buffer is not valid for the used
     ///                     format, or the format does not support reading from
     ///                     a memory buffer
@@ -85,8 +99,8 @@ public:
     /// Write to a memory buffer as though it were a formatted file
     ///
     /// The `format` parameter should be follow the same rules as in the main
-    /// `Trajectory` constructor, except that compression specification are not
-    /// supported.
+    /// `Trajectory` constructor. If a compression method is given, the data
+    /// is compressed while it is written to the memory buffer.
     ///
     /// To retreive the memory written to by the returned `Trajectory` object,
     /// make a call to the `memory_buffer` function.
@@ -95,7 +109,8 @@ public:
     ///
     /// @param format Specific format to use.
     ///
-    /// @throws FileError If any compression is given in `format`
+    /// @throws FileError If the compression given in `format` is not
+    ///                   supported, or if the compression options are invalid
     /// @throws FormatError if the format does not support writing to a memory buffer
     static Trajectory memory_writer(const std::string& format);
 
@@ -141,6 +156,26 @@ public:
     ///                     the format does not support reading.
     Frame read_step(size_t step);
 
+    /// Read `count` consecutive frames from the trajectory, starting at step
+    /// `start`. This gives the same result as calling `read_step` for each
+    /// step, but text formats can read the frames using multiple threads.
+    ///
+    /// The trajectory must have been opened in read mode, and the
+    /// underlying format must support reading.
+    ///
+    /// This function throws a `FileError` if `start + count` is bigger than
+    /// the number of steps in the trajectory.
+    ///
+    /// @param start first step to read from the trajectory
+    /// @param count number of steps to read
+    ///
+    /// @throws FileError for all errors concerning the physical file: can not
+    ///                   open it, can not read/write it, *etc.*
+    /// @throws FormatError if the file is not valid for the used format, or if
+    ///                     the format does not support reading.
+    /// @throws OutOfBounds if `start + count` does not fit in a `size_t`
+    std::vector<Frame> read_steps(size_t start, size_t count);
+
     /// Write a single frame to the trajectory.
     ///
     /// The trajectory must have been opened in write or append mode, and the
@@ -224,6 +259,13 @@ public:
     ///
     /// Calling any function on a closed trajectory will throw a `FileError`.
     ///
+    /// Written data is buffered in memory, and errors while writing it to the
+    /// drive are reported here. If the trajectory is destroyed without
+    /// calling `close`, these errors are only reported as warnings.
+    ///
+    /// @throws FileError if writing the buffered data fails. The trajectory
+    ///         is closed in all cases.
+    ///
     /// @example{trajectory/close.cpp}
     void close();
 
@@ -240,6 +282,11 @@ public:
     /// If the trajectory was not created for writing to memory, this will
     /// return `nullopt`.
     ///
+    /// For compressed memory writers, this finishes the compression of all
+    /// the data written so far, such that the buffer always contains a
+    /// complete compressed file. Calling this function again without writing
+    /// new frames returns the same data.
+    ///
     /// @example{trajectory/memory_buffer.cpp}
     optional<span<const char>> memory_buffer() const;
 
@@ -34,6 +34,11 @@ CHFL_EXPORT CHFL_TRAJECTORY* chfl_trajectory_open(const char* path, char mode);
 /// extension, or when there is not standard extension for this format. If
 /// `format` is an empty string, the format will be guessed from the extension.
 ///
+/// The `format` can also specify a compression method and compression
+/// options, for example `"XYZ / XZ(level=9, threads=4)"`. See the
+/// documentation of the C++ `Trajectory` constructor for the list of
+/// available options.
+///
 /// The caller of this function should free the allocated memory using
 /// `chfl_trajectory_close`.
 ///
@@ -62,8 +67,9 @@ CHFL_EXPORT CHFL_TRAJECTORY* chfl_trajectory_memory_reader(
 
 /// Write to a memory buffer as though it were a formatted file
 ///
-/// The `format` parameter is required. To retreive the memory written to by
-/// the `CHFL_TRAJECTORY`, use the function `chfl_trajectory_memory_buffer`.
+/// The `format` parameter is required and may contain a compression method.
+/// To retreive the memory written to by the `CHFL_TRAJECTORY`, use the
+/// function `chfl_trajectory_memory_buffer`.
 ///
 /// The caller of this function should free the allocated memory using
 /// `chfl_trajectory_close`.
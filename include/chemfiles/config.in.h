@@ -22,6 +22,9 @@
 // Should we include GEMMI code?
 #cmakedefine CHFL_DISABLE_GEMMI
 
+// Should we read uncompressed text files through a memory mapping?
+#cmakedefine CHFL_MMAP_TEXT_FILES
+
 // clang-format on
 
 #endif
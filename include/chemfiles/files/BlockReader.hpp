@@ -0,0 +1,122 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_BLOCK_READER_HPP
+#define CHEMFILES_BLOCK_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "chemfiles/parallel.hpp"
+
+namespace chemfiles {
+
+/// Sequential reader for compressed files made of independently compressed
+/// blocks (bzip2 blocks, xz blocks, BGZF members, ...).
+///
+/// Blocks following the one currently being read are decompressed ahead of
+/// time by background threads, and the decompressed data is then given back
+/// in order by `read`.
+class BlockReader final {
+public:
+    /// Function used to decompress a single block: `decompress(i, output)`
+    /// should replace the content of `output` with the decompressed data of
+    /// the block `i`. This function is called concurrently from multiple
+    /// threads, and must synchronize any access to shared state (such as the
+    /// underlying file).
+    using Decompress = std::function<void(size_t, std::vector<char>&)>;
+
+    /// Create a reader for `count` blocks, decompressed with `decompress`.
+    ///
+    /// `sizes` contains the size of the uncompressed data in each block if it
+    /// is known in advance, or should be empty otherwise. In the latter case,
+    /// sizes are discovered when decompressing the blocks, and seeking needs
+    /// to decompress all the blocks before the target position the first
+    /// time.
+    ///
+    /// At most `threads` threads are used for decompression, including the
+    /// thread calling `read`. With a single thread, all blocks are
+    /// decompressed on demand in the calling thread.
+    BlockReader(size_t count, std::vector<uint64_t> sizes, Decompress decompress, size_t threads = parallel_threads());
+    ~BlockReader();
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+    BlockReader(BlockReader&&) = delete;
+    BlockReader& operator=(BlockReader&&) = delete;
+
+    /// Read up to `count` bytes in `data`, returning the number of bytes
+    /// read. This is only smaller than `count` at the end of the data.
+    size_t read(char* data, size_t count);
+
+    /// Move the reading position to `position` in the uncompressed data.
+    /// Seeking past the end puts the reader at the end of the data.
+    void seek(uint64_t position);
+
+    /// Get the current reading position in the uncompressed data
+    uint64_t tell() const;
+
+private:
+    /// Data of a block being decompressed by background threads
+    struct Pending {
+        bool done = false;
+        std::vector<char> data;
+        std::exception_ptr error;
+    };
+
+    /// Make the block `i` the current block, getting its data from the
+    /// background threads or decompressing it directly
+    void load_block(size_t i);
+    /// Function executed by the background threads
+    void worker();
+    /// Get the next block that should be decompressed by a background
+    /// thread, or `count_` if there is nothing to do. `mutex_` must be locked.
+    size_t next_pending() const;
+
+    /// Number of blocks
+    size_t count_;
+    /// Offsets of the blocks in the uncompressed data, for the first
+    /// `known_ + 1` blocks (the last one being the end of the last known
+    /// block).
+    std::vector<uint64_t> offsets_;
+    /// Number of blocks with a known size
+    size_t known_ = 0;
+    Decompress decompress_;
+
+    /// Index of the current block, or `count_` if no block was loaded yet
+    size_t current_;
+    /// Uncompressed data of the current block
+    std::vector<char> data_;
+    /// Reading position in `data_`
+    size_t position_ = 0;
+
+    /// Maximal number of threads to use
+    size_t threads_;
+    /// Number of blocks to decompress ahead of the current one
+    size_t window_;
+    /// Background threads, started on the first read
+    std::vector<std::thread> pool_;
+    /// Mutex protecting `pending_`, `first_` and `stop_`
+    std::mutex mutex_;
+    /// Signaled when a block is done, or when the background threads have
+    /// more work to do
+    std::condition_variable condition_;
+    /// Blocks being decompressed, or already decompressed, by the background
+    /// threads
+    std::map<size_t, Pending> pending_;
+    /// First block which should be decompressed in advance
+    size_t first_ = 0;
+    /// Should the background threads stop?
+    bool stop_ = false;
+};
+
+} // namespace chemfiles
+
+#endif
@@ -0,0 +1,118 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_BLOCK_WRITER_HPP
+#define CHEMFILES_BLOCK_WRITER_HPP
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "chemfiles/parallel.hpp"
+
+namespace chemfiles {
+
+/// Writer for compressed files made of independently compressed blocks
+/// (BGZF members, xz blocks, bzip2 streams, ...).
+///
+/// The data is split in blocks of fixed size, which are compressed by
+/// background threads. The compressed blocks are then written in order, from
+/// the thread calling `write` and `finish`.
+class BlockWriter final {
+public:
+    /// Function used to compress a single block: `compress(i, input, output)`
+    /// should replace the content of `output` with the compressed version of
+    /// `input`, the uncompressed data in block `i`. This function is called
+    /// concurrently from multiple threads, and must synchronize any access to
+    /// shared state.
+    using Compress = std::function<void(size_t, const std::vector<char>&, std::vector<char>&)>;
+    /// Function used to write a compressed block to the file:
+    /// `write(i, output)` is called with the output of `compress` for all the
+    /// blocks, in order.
+    using Write = std::function<void(size_t, const std::vector<char>&)>;
+
+    /// Create a new writer for blocks of `block_size` bytes of uncompressed
+    /// data, using at most `threads` threads (including the thread calling
+    /// `write`). With a single thread, all blocks are compressed in the
+    /// calling thread.
+    BlockWriter(size_t block_size, Compress compress, Write write, size_t threads = parallel_threads());
+    ~BlockWriter();
+
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+    BlockWriter(BlockWriter&&) = delete;
+    BlockWriter& operator=(BlockWriter&&) = delete;
+
+    /// Add `count` bytes from `data` to the uncompressed data
+    ///
+    /// If compressing or writing a block fails, the corresponding error is
+    /// thrown from this function or from `finish`, and again from all later
+    /// calls to `write` and `finish`.
+    void write(const char* data, size_t count);
+
+    /// Compress the remaining data in a last, smaller block, and wait for
+    /// all the blocks to be written. This must be called before destroying
+    /// the writer, otherwise the remaining data is lost.
+    void finish();
+
+private:
+    /// A block waiting to be compressed or written
+    struct Job {
+        bool done = false;
+        std::vector<char> input;
+        std::vector<char> output;
+        std::exception_ptr error;
+    };
+
+    /// Send the data in `buffer_` to the background threads for compression
+    void submit();
+    /// Write compressed blocks until there are at most `pending` blocks
+    /// waiting to be compressed or written
+    void write_until(size_t pending);
+    /// Function executed by the background threads
+    void worker();
+    /// Throw the error which made this writer fail, if any
+    void check_failure() const;
+
+    /// Size of the uncompressed data in each block
+    size_t block_size_;
+    Compress compress_;
+    Write write_;
+    /// Uncompressed data for the next block
+    std::vector<char> buffer_;
+
+    /// Maximal number of threads to use
+    size_t threads_;
+    /// Maximal number of blocks waiting to be compressed or written
+    size_t window_;
+    /// Background threads, started when submitting the first block
+    std::vector<std::thread> pool_;
+    /// Mutex protecting `jobs_`, `next_job_`, `submitted_` and `stop_`
+    std::mutex mutex_;
+    /// Signaled when a block is compressed, or when there are more blocks to
+    /// compress
+    std::condition_variable condition_;
+    /// Blocks which have been submitted, but not written yet
+    std::map<size_t, Job> jobs_;
+    /// Index of the next block to compress
+    size_t next_job_ = 0;
+    /// Number of submitted blocks
+    size_t submitted_ = 0;
+    /// Number of written blocks
+    size_t written_ = 0;
+    /// Should the background threads stop?
+    bool stop_ = false;
+    /// Error which made this writer fail. Once set, all blocks after the
+    /// failed one are lost and this error is thrown again by `write` and
+    /// `finish`.
+    std::exception_ptr failure_;
+};
+
+} // namespace chemfiles
+
+#endif
@@ -4,24 +4,70 @@
 #ifndef CHEMFILES_BZ2_FILES_HPP
 #define CHEMFILES_BZ2_FILES_HPP
 
-#include <cstdio>
 #include <cstdint>
+#include <mutex>
+#include <memory>
 #include <string>
 #include <vector>
-#include <functional>
 
 #include "chemfiles/File.hpp"
-#include "chemfiles/files/MemoryBuffer.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+#include "chemfiles/files/BlockWriter.hpp"
+#include "chemfiles/files/RawFile.hpp"
 
 #include <bzlib.h>
 
 namespace chemfiles {
 
-/// An implementation of TextFile for bzip2 files
+/// A single block in a bzip2 file. Blocks are independent, and can be
+/// decompressed separately.
+struct Bz2Block {
+    /// Offset in bits of the start of the block (the block magic number) in
+    /// the compressed file
+    uint64_t start;
+    /// Offset in bits of the end of this block in the compressed file
+    uint64_t end;
+};
+
+/// Find all the blocks in the bzip2 data in `file`, looking for the 48-bit
+/// block magic numbers. These can also appear by chance inside compressed
+/// data, so the CRC of the blocks in each stream is checked against the CRC
+/// of the stream. If they do not match, the blocks are found by decompressing
+/// them instead.
+std::vector<Bz2Block> find_bz2_blocks(RawFile& file);
+
+/// Decompress a single bzip2 block, stored in `data` (starting `shift` bits
+/// after the start of `data`), into `output`. `block` gives the size in bits
+/// of the block, and `data` must contain all of the block.
+void decompress_bz2_block(const char* data, unsigned shift, const Bz2Block& block, std::vector<char>& output);
+
+/// An implementation of TextFile for bzip2 files.
+///
+/// When reading, the file is first scanned for the start of all compressed
+/// blocks. Each block is then decompressed independently, which means that
+/// seeking only needs to decompress the block containing the new position,
+/// and that the blocks after the current one can be decompressed in parallel
+/// by a `BlockReader`.
+///
+/// When writing, the data is split in chunks of `level * 100000` bytes
+/// (matching the block size used by bzip2 for this compression level),
+/// compressed in parallel to separate bzip2 streams. Like files produced by
+/// `pbzip2`, the result can be read by any bzip2 tool.
+///
+/// The compression level (between 1 and 9, defaulting to
+/// `Bz2File::DEFAULT_LEVEL`) and the number of threads can be set with
+/// `set_compression_options`.
 class Bz2File final: public TextFileImpl {
 public:
+    /// Default compression level when writing
+    static constexpr int DEFAULT_LEVEL = 6;
+
     /// Open a text file with name `filename` and mode `mode`.
     Bz2File(const std::string& path, File::Mode mode);
+    /// Read compressed data from `memory` in read mode, or write compressed
+    /// data to `memory` in write mode.
+    Bz2File(std::shared_ptr<MemoryBuffer> memory, File::Mode mode);
     ~Bz2File() override;
 
     size_t read(char* data, size_t count) override;
@@ -29,25 +75,50 @@ public:
 
     void clear() noexcept override;
     void seek(uint64_t position) override;
+    void set_compression_options(const CompressionOptions& options) override;
+    void flush() override;
+
+    /// Get the blocks in this file
+    const std::vector<Bz2Block>& blocks() const {
+        return blocks_;
+    }
 
 private:
-    void compress_and_write(int action);
+    /// Open either the file at `path` (if `memory` is `nullptr`) or the
+    /// `memory` buffer
+    Bz2File(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode);
+
+    /// Create `writer_`, using the current compression level and number of
+    /// threads
+    void create_writer();
+    /// Create `reader_`, using the current number of threads
+    void create_reader();
+    /// Write compressed data to the file
+    void write_output(const char* data, size_t count);
 
-    FILE* file_ = nullptr;
+    /// Decompress the block at index `i` into `output`. This function is
+    /// called concurrently by `reader_`.
+    void decompress_block(size_t i, std::vector<char>& output);
+
+    std::unique_ptr<RawFile> file_;
     /// Store the mode used to open this file
     File::Mode mode_;
-    /// Store the right function to close the stream
-    std::function<int(bz_stream*)> stream_end_;
-    /// bzip2 stream used both for reading and writing.
-    bz_stream stream_;
-    /// compressed data buffer, straight out from the file when reading, to be
-    /// written to the file when writing.
-    std::vector<char> buffer_;
+    /// maximal number of threads used for compression and decompression
+    size_t threads_ = parallel_threads();
+    /// [for reading] all the blocks in the file
+    std::vector<Bz2Block> blocks_;
+    /// [for reading] mutex protecting accesses to `file_` while reading
+    std::mutex file_mutex_;
+    /// [for reading] reader giving back the decompressed blocks in order
+    std::unique_ptr<BlockReader> reader_;
+    /// [for writing] writer compressing streams in parallel
+    std::unique_ptr<BlockWriter> writer_;
+    /// [for writing] compression level
+    int level_ = DEFAULT_LEVEL;
+    /// [for writing] did we write any stream to the file?
+    bool stream_written_ = false;
 };
 
-/// Inflates BZIP2 data from the `src` buffer
-MemoryBuffer decompress_bz2(const char* src, size_t size);
-
 }
 
 #endif
@@ -7,19 +7,72 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <mutex>
+#include <vector>
+#include <memory>
 
 #include "chemfiles/File.hpp"
-#include "chemfiles/files/MemoryBuffer.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+#include "chemfiles/files/BlockWriter.hpp"
+#include "chemfiles/files/RawFile.hpp"
 
-typedef struct gzFile_s *gzFile;
+struct z_stream_s;
 
 namespace chemfiles {
 
-/// An implementation of TextFile for gzip files
+/// An access point in a gzip file, i.e. a position in the compressed data
+/// where decompression can be restarted. This is the same strategy as zlib's
+/// `examples/zran.c`: deflate blocks can reference data up to 32 KiB before
+/// them, so we store this data with the access point.
+struct GzAccessPoint {
+    /// Offset of this point in the uncompressed data
+    uint64_t output;
+    /// Offset in the compressed file of the first full byte of this point
+    uint64_t input;
+    /// Number of bits (1-7) of the byte at `input - 1` belonging to this
+    /// point, or 0 if the point starts on a byte boundary
+    int bits;
+    /// Up to 32 KiB of uncompressed data before this point
+    std::vector<unsigned char> window;
+};
+
+/// An implementation of TextFile for gzip files.
+///
+/// When reading, the file is decompressed with zlib's inflate, and access
+/// points are recorded every `GzFile::ACCESS_POINT_SPAN` bytes of uncompressed
+/// data. Seeking then restarts the decompression from the closest access point
+/// instead of the start of the file.
+///
+/// BGZF files (as produced by `bgzip`) are made of many small gzip members,
+/// each containing the size of its compressed data. For these files, the
+/// members are located when opening the file, and decompressed in parallel
+/// using a `BlockReader`.
+///
+/// When writing, the data is compressed in parallel to BGZF members, which
+/// can be read by any gzip tool.
+///
+/// The compression level (between 0 and 9, defaulting to
+/// `GzFile::DEFAULT_LEVEL`) and the number of threads used for compression
+/// and decompression can be set with `set_compression_options`.
 class GzFile final: public TextFileImpl {
 public:
+    /// Distance in the uncompressed data between two access points
+    static constexpr uint64_t ACCESS_POINT_SPAN = 1024 * 1024;
+    /// Size of the uncompressed data in a group of consecutive BGZF members,
+    /// decompressed together
+    static constexpr uint64_t BGZF_GROUP_SIZE = 1024 * 1024;
+    /// Maximal size of the uncompressed data in each BGZF member when
+    /// writing, such that the compressed member fits in 64 KiB
+    static constexpr size_t BGZF_MEMBER_SIZE = 0xff00;
+    /// Default compression level when writing
+    static constexpr int DEFAULT_LEVEL = 7;
+
     /// Open a text file with name `filename` and mode `mode`.
     GzFile(const std::string& path, File::Mode mode);
+    /// Read compressed data from `memory` in read mode, or write compressed
+    /// data to `memory` in write mode.
+    GzFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode);
     ~GzFile() override;
 
     size_t read(char* data, size_t count) override;
@@ -27,17 +80,94 @@ public:
 
     void clear() noexcept override;
     void seek(uint64_t position) override;
+    void set_compression_options(const CompressionOptions& options) override;
+    void flush() override;
+
+    /// Get the access points created so far while reading this file
+    const std::vector<GzAccessPoint>& access_points() const {
+        return index_;
+    }
+
+    /// A group of consecutive members in a BGZF file
+    struct Block {
+        /// Offset of the first member in the compressed file
+        uint64_t start;
+        /// Offset of the end of the last member in the compressed file
+        uint64_t end;
+        /// Size of the uncompressed data in all the members
+        uint64_t uncompressed_size;
+    };
 
 private:
-    /// Check if any error happened while reading/writing the file. Returns the
-    /// corresponding error message or `nullptr` if no error occurred.
-    const char* check_error() const;
+    /// Create a `GzFile` reading or writing to `file`. In read mode, data
+    /// without gzip header is read as is if `allow_transparent` is `true`
+    /// (like `gzread` does for files), and is an error otherwise.
+    GzFile(std::unique_ptr<RawFile> file, const std::string& path, File::Mode mode, bool allow_transparent);
 
-    gzFile file_ = nullptr;
-};
+    /// Create `writer_`, using the current compression level and number of
+    /// threads
+    void create_writer();
+    /// Create `reader_` for the BGZF members in `blocks_`, using the current
+    /// number of threads
+    void create_reader();
+    /// Decompress the group of members at index `i` in `blocks_` into
+    /// `output`. This function is called concurrently by `reader_`.
+    void decompress_block(size_t i, std::vector<char>& output);
+    /// Write compressed data to the file
+    void write_output(const char* data, size_t count);
+
+    /// Decompress up to `count` bytes in `data`, recording new access points
+    /// as needed. This returns the number of decompressed bytes, which is
+    /// only smaller than `count` at the end of the file.
+    size_t inflate_data(unsigned char* data, size_t count);
+    /// Make sure `stream_` contains at least `count` bytes of input data,
+    /// reading from the file if needed. Returns `false` if the end of the file
+    /// was reached before getting enough data.
+    bool fill_input(size_t count);
+    /// Start a new gzip member after the end of the previous one
+    void next_member();
+    /// Restart decompression from the beginning of the file
+    void restart();
+    /// Restart decompression from the given access `point`
+    void restart(const GzAccessPoint& point);
+
+    /// compression level used when writing
+    int level_ = DEFAULT_LEVEL;
+    /// maximal number of threads used for compression and decompression
+    size_t threads_ = parallel_threads();
 
-/// Inflates GZipped data from the `src` buffer
-MemoryBuffer decompress_gz(const char* src, size_t size);
+    /// compressed file used in write and append mode
+    std::unique_ptr<RawFile> output_;
+    /// writer compressing BGZF members in parallel
+    std::unique_ptr<BlockWriter> writer_;
+
+    /// compressed file used in read mode
+    std::unique_ptr<RawFile> input_;
+    /// inflate stream used in read mode
+    std::unique_ptr<z_stream_s> stream_;
+    /// compressed data buffer, straight out from the file
+    std::vector<unsigned char> buffer_;
+    /// offset in the compressed file of the end of the data in `buffer_`
+    uint64_t input_position_ = 0;
+    /// offset in the uncompressed data of the next byte returned by `read`
+    uint64_t output_position_ = 0;
+    /// Are we decompressing raw deflate data (after restarting from an access
+    /// point), or gzip data with headers and trailers?
+    bool raw_ = false;
+    /// Did we reach the end of the compressed data?
+    bool end_of_data_ = false;
+    /// The file is not gzip-compressed, read it directly, like `gzread`
+    bool transparent_ = false;
+    /// Access points in this file, sorted by increasing `output` offset
+    std::vector<GzAccessPoint> index_;
+    /// Groups of BGZF members in this file, used for parallel decompression
+    std::vector<Block> blocks_;
+    /// mutex protecting accesses to `input_` from `reader_`
+    std::mutex input_mutex_;
+    /// reader decompressing BGZF members in parallel, or `nullptr` if the
+    /// file is decompressed with `stream_`
+    std::unique_ptr<BlockReader> reader_;
+};
 
 } // namespace chemfiles
 
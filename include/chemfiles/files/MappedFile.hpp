@@ -0,0 +1,73 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_MAPPED_FILES_HPP
+#define CHEMFILES_MAPPED_FILES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "chemfiles/config.h"
+#include "chemfiles/File.hpp"
+#include "chemfiles/external/optional.hpp"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#if (CHEMFILES_SIZEOF_VOID_P == 8)
+    // mapping whole text files is only done in 64-bit posix, where the
+    // address space is large enough for any file
+    #define CHEMFILES_TEXT_FILE_USE_MMAP 1
+#else
+    #define CHEMFILES_TEXT_FILE_USE_MMAP 0
+#endif
+#else
+    #define CHEMFILES_TEXT_FILE_USE_MMAP 0
+#endif
+
+namespace chemfiles {
+
+/// Read-only TextFileImpl for plain, uncompressed files, mapping the whole
+/// file in memory with `mmap`. The mapped content is exposed through
+/// `contiguous()`, allowing `TextFile` to return lines pointing directly
+/// inside the mapping instead of copying the data to its own buffer.
+///
+/// This class is only available if `CHEMFILES_TEXT_FILE_USE_MMAP` is 1.
+/// `TextFile` only uses it when chemfiles is configured with
+/// `CHFL_MMAP_TEXT_FILES=ON`, and uses `PlainFile` otherwise.
+///
+/// The mapping is private: data appended to the file after opening it is not
+/// visible, and truncating the file while it is mapped can crash the process
+/// with `SIGBUS` when accessing the removed pages.
+class MappedFile final: public TextFileImpl {
+public:
+    /// Map the file at `path` in memory for reading.
+    ///
+    /// @throws FileError if the file can not be opened, is not a regular file
+    ///                   or can not be mapped in memory
+    MappedFile(const std::string& path);
+    ~MappedFile() override;
+
+    size_t read(char* data, size_t count) override;
+    void write(const char* data, size_t count) override;
+
+    void clear() noexcept override {}
+    void seek(uint64_t position) override;
+
+    optional<std::string_view> contiguous() const override {
+        return std::string_view(data_, size_);
+    }
+
+private:
+    /// Start of the mapping, or a pointer to an empty static string for empty
+    /// files (which can not be mapped)
+    const char* data_ = nullptr;
+    /// Size of the file, and of the mapping
+    size_t size_ = 0;
+    /// Current position used by `read`
+    size_t position_ = 0;
+};
+
+} // namespace chemfiles
+
+#endif
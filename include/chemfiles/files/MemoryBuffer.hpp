@@ -6,14 +6,7 @@
 
 #include <cstddef>
 
-#include "chemfiles/File.hpp"
-
 namespace chemfiles {
-class MemoryBuffer;
-
-MemoryBuffer decompress_xz(const char*, size_t);
-MemoryBuffer decompress_gz(const char*, size_t);
-MemoryBuffer decompress_bz2(const char*, size_t);
 
 /// A class for handling memory passed directly instead of through a file
 /// handle. Unlike a `std::vector`, it does not assume ownership of the data
@@ -55,10 +48,6 @@ public:
 
     void write(const char* data, size_t size);
 
-    /// Try to decompress the content of this buffer with the given
-    /// `compression` format
-    void decompress(File::Compression compression);
-
 private:
     /// Do we own the memory managed by this class?
     bool is_owned() const {
@@ -68,20 +57,6 @@ private:
     /// Reserve additional space for `extra` elements
     void reserve_extra(size_t extra);
 
-    /// Set the length of the buffer to the given value
-    void set_size(size_t len);
-
-    /// Get a non-const pointer to the data. This is not an overload of `data`
-    /// because otherwise this **private** overload would take precedence over
-    /// the public one for non-const `MemoryBuffer`.
-    char* data_mut() {
-        return ptr_;
-    }
-
-    friend MemoryBuffer chemfiles::decompress_xz(const char*, size_t);
-    friend MemoryBuffer chemfiles::decompress_gz(const char*, size_t);
-    friend MemoryBuffer chemfiles::decompress_bz2(const char*, size_t);
-
     /// Start of the memory buffer
     char* ptr_;
     /// Size of the current allocation when writing / 0 when reading
@@ -8,8 +8,10 @@
 #include <cstddef>
 #include <memory>
 #include <utility>
+#include <string_view>
 
 #include "chemfiles/File.hpp"
+#include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
 class MemoryBuffer;
@@ -29,6 +31,8 @@ public:
     void clear() noexcept override {}
     void seek(uint64_t position) override;
 
+    optional<std::string_view> contiguous() const override;
+
 private:
     /// Current reading location
     size_t current_location_ = 0;
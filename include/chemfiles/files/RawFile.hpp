@@ -0,0 +1,71 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_RAW_FILES_HPP
+#define CHEMFILES_RAW_FILES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "chemfiles/File.hpp"
+
+namespace chemfiles {
+class MemoryBuffer;
+
+/// Unbuffered access to the raw bytes of a compressed file, stored either on
+/// disk or in a `MemoryBuffer`. This is used by the compressed files
+/// (`GzFile`, `XzFile`, `Bz2File` and `ZstdFile`) to share the same code path when
+/// reading/writing actual files and memory buffers.
+class RawFile final {
+public:
+    /// Open the file at `path` with the given `mode`
+    RawFile(const std::string& path, File::Mode mode);
+    /// Use `memory` as the file content. In read mode, the data in `memory`
+    /// is used without copies; in write mode, data is added at the end of
+    /// `memory`. Append mode is not supported.
+    RawFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode);
+    ~RawFile();
+
+    RawFile(const RawFile&) = delete;
+    RawFile& operator=(const RawFile&) = delete;
+    RawFile(RawFile&&) = delete;
+    RawFile& operator=(RawFile&&) = delete;
+
+    /// Read up to `count` bytes in `data`, returning the number of bytes
+    /// read. This is only smaller than `count` at the end of the file.
+    size_t read(void* data, size_t count);
+
+    /// Write `count` bytes from `data` at the end of the file
+    void write(const void* data, size_t count);
+
+    /// Move the reading position to `position`
+    void seek(uint64_t position);
+
+    /// Get the total size of the file
+    uint64_t size();
+
+    /// Did the last call to `read` reach the end of the file?
+    bool eof() const {
+        return eof_;
+    }
+
+    /// Clear the end of file and error flags
+    void clear() noexcept;
+
+private:
+    /// The file on disk, or `nullptr` when using `memory_`
+    std::FILE* file_ = nullptr;
+    /// The memory buffer, or `nullptr` when using `file_`
+    std::shared_ptr<MemoryBuffer> memory_;
+    /// Reading position in `memory_`
+    uint64_t position_ = 0;
+    /// Did the last call to `read` reach the end of the file?
+    bool eof_ = false;
+};
+
+} // namespace chemfiles
+
+#endif
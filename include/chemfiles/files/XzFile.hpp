@@ -5,22 +5,49 @@
 #define CHEMFILES_XZ_FILES_HPP
 
 #include <cstdint>
-#include <cstdio>
+#include <mutex>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <lzma.h>
 
 #include "chemfiles/File.hpp"
-#include "chemfiles/files/MemoryBuffer.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+#include "chemfiles/files/BlockWriter.hpp"
+#include "chemfiles/files/RawFile.hpp"
 
 namespace chemfiles {
 
-/// An implementation of TextFile for lzma/xz files
+/// An implementation of TextFile for lzma/xz files.
+///
+/// When reading, the index at the end of xz files is used to find the block
+/// containing a given position, and seeking only needs to decompress the
+/// beginning of this block. If the file contains multiple blocks, these are
+/// decompressed in parallel using a `BlockReader`. When writing, the data is
+/// split in blocks of `block_size` uncompressed bytes, which are compressed in
+/// parallel and keep seeking cheap when reading the file back.
+///
+/// The compression preset (between 0 and 9, defaulting to
+/// `XzFile::DEFAULT_PRESET`, possibly with the extreme flag), the block size
+/// and the number of threads can be set with `set_compression_options`.
 class XzFile final: public TextFileImpl {
 public:
-    /// Open a text file with name `filename` and mode `mode`.
-    XzFile(const std::string& path, File::Mode mode);
+    /// Default size of the uncompressed data in each block when writing
+    static constexpr uint64_t DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
+    /// Maximal size of the uncompressed data in each block to use parallel
+    /// decompression, which keeps multiple blocks in memory at once
+    static constexpr uint64_t MAX_PARALLEL_BLOCK_SIZE = 64 * 1024 * 1024;
+    /// Default compression preset when writing
+    static constexpr int DEFAULT_PRESET = 6;
+
+    /// Open a text file with name `filename` and mode `mode`. When writing,
+    /// a new block is started every `block_size` bytes of uncompressed data.
+    XzFile(const std::string& path, File::Mode mode, uint64_t block_size = DEFAULT_BLOCK_SIZE);
+    /// Read compressed data from `memory` in read mode, or write compressed
+    /// data to `memory` in write mode.
+    XzFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, uint64_t block_size = DEFAULT_BLOCK_SIZE);
     ~XzFile() override;
 
     size_t read(char* data, size_t count) override;
@@ -28,26 +55,99 @@ public:
 
     void clear() noexcept override;
     void seek(uint64_t position) override;
+    void set_compression_options(const CompressionOptions& options) override;
+    /// Finish the current xz stream, writing its index and footer. Writing
+    /// more data after this starts a new stream in the same file.
+    void flush() override;
 
 private:
-    /// Compress data from stream_.next_in, and write the data to the file.
-    /// If action==LZMA_FINISH, continue writing until everything has been
-    /// processed.
-    void compress_and_write(lzma_action action);
+    /// Open either the file at `path` (if `memory` is `nullptr`) or the
+    /// `memory` buffer
+    XzFile(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode, uint64_t block_size);
+
+    /// Position and size of a block in the file
+    struct Block {
+        /// Offset of the block header in the compressed file
+        uint64_t compressed_offset;
+        /// Size of the block (header, compressed data, padding and check) in
+        /// the compressed file
+        uint64_t total_size;
+        /// Size of the block without padding
+        uint64_t unpadded_size;
+        /// Size of the uncompressed data in the block
+        uint64_t uncompressed_size;
+        /// Type of integrity check used in this block
+        lzma_check check;
+    };
+
+    /// Create `writer_`, using the current preset, block size and number of
+    /// threads
+    void create_writer();
+    /// Create `reader_` if the file contains multiple blocks which can be
+    /// decompressed in parallel with the current number of threads
+    void create_reader();
+    /// Write the block compressed by `writer_` to the file, and add it to
+    /// the index
+    void write_block(const std::vector<char>& block);
+    /// Start a new stream, writing its header and creating `index_`
+    void write_header();
+    /// Write the index and stream footer at the end of the current stream,
+    /// and release `index_`
+    void write_footer();
+
+    /// Decompress up to `count` bytes in `data`, using the block decoder and
+    /// the file index. Returns the number of decompressed bytes.
+    size_t read_blocks(uint8_t* data, size_t count);
+    /// Start decoding the block currently pointed to by `iter_`
+    void start_block();
+    /// Decompress the block at index `i` in `blocks_` into `output`. This
+    /// function is called concurrently by `reader_`.
+    void decompress_block(size_t i, std::vector<char>& output);
 
-    FILE* file_ = nullptr;
+    std::unique_ptr<RawFile> file_;
     /// Store opening file mode
     File::Mode mode_;
-    /// lzma stream used both for reading and writing. Reading is done using
-    /// lzma_stream_decoder, and writing using lzma_easy_encoder.
+    /// maximal number of threads used for compression and decompression
+    size_t threads_ = parallel_threads();
+    /// lzma stream used for reading. Reading is done using
+    /// lzma_block_decoder if the file index is available, and
+    /// lzma_stream_decoder otherwise.
     lzma_stream stream_ = LZMA_STREAM_INIT;
-    /// compressed data buffer, straight out from the file when reading, to be
-    /// written to the file when writing.
+    /// compressed data buffer, straight out from the file when reading
     std::vector<uint8_t> buffer_;
-};
 
-/// Inflates LZMA/XZ data from the `src` buffer
-MemoryBuffer decompress_xz(const char* src, size_t size);
+    /// index of all the streams and blocks in the file, or `nullptr` if it
+    /// could not be read. When writing, this contains the blocks written so
+    /// far in the current stream, and is `nullptr` if no stream is started.
+    lzma_index* index_ = nullptr;
+    /// [for reading] iterator pointing to the current block in `index_`
+    lzma_index_iter iter_;
+    /// [for reading] options of the current block, used by the block decoder
+    lzma_block block_;
+    /// [for reading] did we reach the end of the current block?
+    bool block_done_ = false;
+    /// [for reading] did we reach the end of the last block?
+    bool end_of_data_ = false;
+    /// [for reading] offset in the uncompressed data of the next byte
+    /// returned by `read`
+    uint64_t position_ = 0;
+    /// [for reading] list of all non-empty blocks in the file, used for
+    /// parallel decompression
+    std::vector<Block> blocks_;
+    /// [for reading] mutex protecting accesses to `file_` from `reader_`
+    std::mutex file_mutex_;
+    /// [for reading] reader decompressing the blocks in parallel, or
+    /// `nullptr` if the blocks are decompressed one after the other with
+    /// `stream_`
+    std::unique_ptr<BlockReader> reader_;
+
+    /// [for writing] maximal size of the uncompressed data in each block
+    uint64_t block_size_;
+    /// [for writing] compression preset, including `LZMA_PRESET_EXTREME`
+    uint32_t preset_ = DEFAULT_PRESET;
+    /// [for writing] writer compressing blocks in parallel
+    std::unique_ptr<BlockWriter> writer_;
+};
 
 }
 
@@ -0,0 +1,166 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_ZSTD_FILES_HPP
+#define CHEMFILES_ZSTD_FILES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+#include "chemfiles/files/BlockWriter.hpp"
+#include "chemfiles/files/RawFile.hpp"
+
+struct ZSTD_DCtx_s;
+
+namespace chemfiles {
+
+/// A single frame in a zstd file, as described by a seek table
+struct ZstdFrame {
+    /// Offset of the frame in the compressed file
+    uint64_t start;
+    /// Size of the frame in the compressed file
+    uint64_t compressed_size;
+    /// Size of the uncompressed data in the frame
+    uint64_t size;
+};
+
+/// Read the seek table at the end of the zstd data in `file`, following
+/// zstd's seekable format (`contrib/seekable_format` in the zstd sources).
+/// This returns an empty vector if the file does not end with a valid seek
+/// table.
+std::vector<ZstdFrame> read_zstd_seek_table(RawFile& file);
+
+/// An implementation of TextFile for zstd files.
+///
+/// When writing, the data is split in independent frames of `block_size`
+/// uncompressed bytes, which are compressed in parallel. A seek table
+/// following zstd's seekable format is written at the end of the file, in a
+/// skippable frame ignored by the standard zstd tools.
+///
+/// When reading, files containing a seek table have their frames
+/// decompressed in parallel using a `BlockReader`, and seeking only needs to
+/// decompress the frame containing the new position. Other files are
+/// decompressed sequentially, recording the start of each frame to restart
+/// the decompression from there when seeking backward.
+///
+/// The compression level (between 1 and 22, defaulting to
+/// `ZstdFile::DEFAULT_LEVEL`), the frame size and the number of threads can
+/// be set with `set_compression_options`.
+class ZstdFile final: public TextFileImpl {
+public:
+    /// Default size of the uncompressed data in each frame when writing
+    static constexpr uint64_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+    /// Maximal size of the uncompressed data in each frame when writing, the
+    /// seek table storing sizes as 32-bit integers
+    static constexpr uint64_t MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
+    /// Maximal size of the uncompressed data in each frame to use parallel
+    /// decompression, which keeps multiple frames in memory at once
+    static constexpr uint64_t MAX_PARALLEL_BLOCK_SIZE = 64 * 1024 * 1024;
+    /// Default compression level when writing
+    static constexpr int DEFAULT_LEVEL = 3;
+
+    /// Open a text file with name `filename` and mode `mode`.
+    ZstdFile(const std::string& path, File::Mode mode);
+    /// Read compressed data from `memory` in read mode, or write compressed
+    /// data to `memory` in write mode.
+    ZstdFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode);
+    ~ZstdFile() override;
+
+    size_t read(char* data, size_t count) override;
+    void write(const char* data, size_t count) override;
+
+    void clear() noexcept override;
+    void seek(uint64_t position) override;
+    void set_compression_options(const CompressionOptions& options) override;
+    /// Compress all the data written so far and write the seek table. Writing
+    /// more data after this adds new frames to the same file.
+    void flush() override;
+
+    /// Get the frames found in the seek table of this file
+    const std::vector<ZstdFrame>& frames() const {
+        return frames_;
+    }
+
+private:
+    /// Open either the file at `path` (if `memory` is `nullptr`) or the
+    /// `memory` buffer
+    ZstdFile(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode);
+
+    /// Create `writer_`, using the current compression level, frame size and
+    /// number of threads
+    void create_writer();
+    /// Create `reader_` if the file contains a seek table with frames small
+    /// enough to be decompressed in parallel
+    void create_reader();
+    /// Write a compressed frame to the file, and add it to the seek table
+    void write_frame(const std::vector<char>& frame);
+    /// Write the seek table for all the frames written so far
+    void write_seek_table();
+
+    /// Decompress the frame at index `i` in `frames_` into `output`. This
+    /// function is called concurrently by `reader_`.
+    void decompress_frame(size_t i, std::vector<char>& output);
+    /// Decompress up to `count` bytes in `data` with `stream_`, recording the
+    /// start of new frames. This returns the number of decompressed bytes,
+    /// which is only smaller than `count` at the end of the file.
+    size_t decompress_stream(char* data, size_t count);
+    /// Restart decompression with `stream_` from the start of the frame at
+    /// `input` in the compressed file and `output` in the uncompressed data
+    void restart_stream(uint64_t input, uint64_t output);
+
+    std::unique_ptr<RawFile> file_;
+    /// Store the mode used to open this file
+    File::Mode mode_;
+    /// maximal number of threads used for compression and decompression
+    size_t threads_ = parallel_threads();
+
+    /// [for reading] frames from the seek table, without empty frames
+    std::vector<ZstdFrame> frames_;
+    /// [for reading] mutex protecting accesses to `file_` from `reader_`
+    std::mutex file_mutex_;
+    /// [for reading] reader decompressing frames in parallel, or `nullptr` if
+    /// the file is decompressed with `stream_`
+    std::unique_ptr<BlockReader> reader_;
+    /// [for reading] streaming decompression context
+    std::unique_ptr<ZSTD_DCtx_s, size_t (*)(ZSTD_DCtx_s*)> stream_;
+    /// [for reading] compressed data buffer for `stream_`
+    std::vector<char> buffer_;
+    /// [for reading] position of the next unused byte in `buffer_`
+    size_t buffer_position_ = 0;
+    /// [for reading] size of the data in `buffer_`
+    size_t buffer_size_ = 0;
+    /// [for reading] offset in the compressed file of the end of `buffer_`
+    uint64_t input_position_ = 0;
+    /// [for reading] offset in the uncompressed data of the next byte
+    /// returned by `decompress_stream`
+    uint64_t output_position_ = 0;
+    /// [for reading] is `stream_` at the boundary between two frames?
+    bool frame_done_ = true;
+    /// [for reading] start of the frames seen so far by `stream_`, as pairs
+    /// of offsets in the compressed and uncompressed data
+    std::vector<std::pair<uint64_t, uint64_t>> restart_points_;
+
+    /// [for writing] writer compressing frames in parallel
+    std::unique_ptr<BlockWriter> writer_;
+    /// [for writing] compression level
+    int level_ = DEFAULT_LEVEL;
+    /// [for writing] size of the uncompressed data in each frame
+    uint64_t block_size_ = DEFAULT_BLOCK_SIZE;
+    /// [for writing] compressed and uncompressed size of all the frames
+    /// written so far, used to create the seek table
+    std::vector<std::pair<uint32_t, uint32_t>> seek_table_;
+    /// [for writing] were new frames written since the last seek table?
+    bool seek_table_outdated_ = false;
+};
+
+}
+
+#endif
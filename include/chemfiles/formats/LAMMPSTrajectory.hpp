@@ -36,6 +36,8 @@ class LAMMPSTrajectoryFormat final : public TextFormat {
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
     optional<uint64_t> forward() override;
+    std::unique_ptr<TextFormat> parallel_reader(std::shared_ptr<MemoryBuffer> memory) const override;
+    optional<uint64_t> find_next_step() override;
 
   private:
     std::array<double, 3> read_cell(Frame& frame);
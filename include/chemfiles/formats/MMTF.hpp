@@ -17,6 +17,7 @@
 #include "chemfiles/Format.hpp"
 
 #include "chemfiles/UnitCell.hpp"
+#include "chemfiles/Connectivity.hpp"
 #include "chemfiles/external/span.hpp"
 
 namespace chemfiles {
@@ -59,8 +60,8 @@ private:
     /// Read a group from the MMTF structure, adding atoms and a residue to frame
     void read_group(Frame& frame, size_t group_type, Residue& residue, span<Vector3D> positions);
 
-    /// Add inter residue bonds to the structure.
-    void add_inter_residue_bonds(Frame& frame);
+    /// Add inter residue bonds to the list of bonds of the current frame.
+    void add_inter_residue_bonds();
 
     /// Apply symmetry operations to the frame
     void apply_symmetry(Frame& frame);
@@ -98,6 +99,11 @@ private:
     /// Number of atoms before the current model.
     size_t atomSkip_ = 0;
 
+    /// Bonds read in the current model, and the corresponding bond orders.
+    /// They are added to the frame all at once at the end of `read_model`.
+    std::vector<Bond> bonds_;
+    std::vector<Bond::BondOrder> bond_orders_;
+
     // Since MMTF uses model->chain->residue->atom as storage model, and
     // chemfiles do not enforce that residues contains contiguous atoms, the
     // atoms can be re-ordered when adding them to a MMTF structure. This vector
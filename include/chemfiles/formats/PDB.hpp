@@ -7,17 +7,19 @@
 #include <cstddef>
 #include <cstdint>
 
-#include <map>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <unordered_map>
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/Format.hpp"
 
 #include "chemfiles/Residue.hpp"
+#include "chemfiles/Connectivity.hpp"
 #include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
@@ -40,6 +42,16 @@ struct FullResidueId {
 bool operator==(const FullResidueId& lhs, const FullResidueId& rhs);
 bool operator<(const FullResidueId& lhs, const FullResidueId& rhs);
 
+} // namespace chemfiles
+
+namespace std {
+    template<> struct hash<chemfiles::FullResidueId> {
+        size_t operator()(const chemfiles::FullResidueId& id) const;
+    };
+}
+
+namespace chemfiles {
+
 /// PDB file format reader and writer.
 ///
 /// For multi-frame trajectories, we support both the convention from VMD to
@@ -58,6 +70,8 @@ public:
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
     optional<uint64_t> forward() override;
+    std::unique_ptr<TextFormat> parallel_reader(std::shared_ptr<MemoryBuffer> memory) const override;
+    optional<uint64_t> find_next_step() override;
 
     // Connect residues based on a predefined table
     static void link_standard_residue_bonds(Frame& frame);
@@ -80,13 +94,22 @@ private:
     // Runs when a chain is terminated to update residue information
     void chain_ended(Frame& frame);
 
-    /// Residue information in the current step
-    std::map<FullResidueId, Residue> residues_;
+    /// Residues in the current chain, in the order they were first found in
+    /// the file
+    std::vector<std::pair<FullResidueId, Residue>> residues_;
+    /// Index of each residue in `residues_`
+    std::unordered_map<FullResidueId, size_t> residues_indexes_;
+    /// Are the residues in `residues_` sorted by `FullResidueId`? This is the
+    /// case for most files, where residues are written in order.
+    bool residues_sorted_ = true;
     /// Number of models written/read to the file.
     size_t models_ = 0;
     /// List of all atom offsets. This maybe pushed in read_ATOM or if a TER
     /// record is found. It is reset every time a frame is read.
     std::vector<size_t> atom_offsets_;
+    /// Bonds from the CONECT records of the current frame. They are added to
+    /// the frame all at once after reading all the records.
+    std::vector<Bond> conect_bonds_;
     /// Did we wrote a frame to the file? This is used to check whether we need
     /// to write a final `END` record in the destructor
     bool written_ = false;
@@ -94,11 +117,15 @@ private:
     /// starting residue of the secondary structure, and values are pairs
     /// containing the ending residue and a string which is a written
     /// description of the secondary structure
-    std::map<FullResidueId, std::pair<FullResidueId, std::string>> secinfo_;
+    std::unordered_map<FullResidueId, std::pair<FullResidueId, std::string>> secinfo_;
     /// This will be nullopt when no secondary structure information should be
     /// read. Else It is set to the final residue of a secondary structure and
     /// the text description which should be set.
     optional<std::pair<FullResidueId, std::string>> current_secinfo_;
+    /// Was this reader created by `parallel_reader`? Such readers start with
+    /// the secondary structure information of the reader which created them,
+    /// and fail if they find new secondary structure records.
+    bool parallel_ = false;
 };
 
 template<> const FormatMetadata& format_metadata<PDBFormat>();
@@ -34,11 +34,16 @@ std::vector<std::reference_wrapper<const FormatMetadata>> CHFL_EXPORT formats_li
 
 /// Get the format that chemfiles would use to read a file at the given path.
 ///
-/// Most of the time, the format is only guessed from the filename extension,
-/// without reading the file to guess the format. When two or more format can
-/// share the same extension (for example CIF and mmCIF), chemfiles tries to
-/// read the file to distinguish between them. If reading fails, the default
-/// format for this extension is returned.
+/// In read and append mode, the first bytes of existing files are used to
+/// detect compressed files (gzip, bzip2, xz and zstd) and binary formats with
+/// a magic number (XTC, TRR, TPR, DCD, Amber NetCDF, TNG and MMTF), even if
+/// the file extension is missing or wrong. The result is cached for each
+/// path, until the file is modified.
+///
+/// Otherwise, the format is guessed from the filename extension. When two or
+/// more format can share the same extension (for example CIF and mmCIF),
+/// chemfiles tries to read the file to distinguish between them. If reading
+/// fails, the default format for this extension is returned.
 ///
 /// Opening the file using the returned format string might still fail. For
 /// example, it will fail if the file is not actually formatted according to the
@@ -56,7 +61,15 @@ std::vector<std::reference_wrapper<const FormatMetadata>> CHFL_EXPORT formats_li
 /// @throw FormatError if no format matching this filename is found.
 ///
 /// @example{guess_format.cpp}
-std::string CHFL_EXPORT guess_format(std::string path, char mode = 'r');
+std::string CHFL_EXPORT guess_format(std::string path, char mode);
+
+/// Get the format that chemfiles would use to read a file at the given path.
+/// This is the same as `guess_format(path, 'r')`.
+///
+/// @param path path of the file we are trying to read
+/// @return guessed format of the file
+/// @throw FormatError if no format matching this filename is found.
+std::string CHFL_EXPORT guess_format(std::string path);
 
 } // namespace chemfiles
 
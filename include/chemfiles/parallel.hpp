@@ -0,0 +1,97 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_PARALLEL_HPP
+#define CHEMFILES_PARALLEL_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <system_error>
+
+namespace chemfiles {
+
+/// Get the number of threads to use for parallel operations, i.e. the number
+/// of hardware threads available on this machine (at least 1).
+inline size_t parallel_threads() {
+    auto threads = static_cast<size_t>(std::thread::hardware_concurrency());
+    return std::max(threads, size_t(1));
+}
+
+/// Call `function(i)` for all `i` in `[0, count)`, using at most `threads`
+/// threads (including the calling thread). Work items are distributed
+/// dynamically between threads, in increasing order of `i`.
+///
+/// If any call to `function` throws an exception, the remaining work items are
+/// not started, and the first exception is re-thrown in the calling thread
+/// once all threads finished.
+template <class Function>
+void parallel_for(size_t count, size_t threads, Function&& function) {
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+
+    auto next = std::atomic<size_t>(0);
+    auto failed = std::atomic<bool>(false);
+    auto exception = std::exception_ptr();
+    auto exception_mutex = std::mutex();
+
+    auto worker = [&]() {
+        while (!failed) {
+            auto i = next++;
+            if (i >= count) {
+                return;
+            }
+
+            try {
+                function(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(exception_mutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    auto pool = std::vector<std::thread>();
+    pool.reserve(threads - 1);
+    for (size_t i = 0; i < threads - 1; i++) {
+        try {
+            pool.emplace_back(worker);
+        } catch (const std::system_error&) {
+            // could not create more threads, continue with the ones we have
+            break;
+        }
+    }
+    worker();
+
+    for (auto& thread: pool) {
+        thread.join();
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+/// Call `function(i)` for all `i` in `[0, count)`, using all available
+/// threads.
+template <class Function>
+void parallel_for(size_t count, Function&& function) {
+    parallel_for(count, parallel_threads(), std::forward<Function>(function));
+}
+
+} // namespace chemfiles
+
+#endif
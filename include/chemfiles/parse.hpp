@@ -8,6 +8,8 @@
 #include <cstdint>
 #include <string>
 #include <limits>
+#include <vector>
+#include <algorithm>
 #include <string_view>
 #include <type_traits>
 
@@ -61,53 +63,100 @@ namespace detail {
         return detail::convert_integer<T>(value);
     }
 
-    /// Iterator over whitespace separated values in a string
+    /// Get a mask with the bit `i` set if `input[i]` is an ASCII whitespace,
+    /// for the first 64 bytes of `input`. If `size` is smaller than 64, the
+    /// bytes after `size` are considered to be whitespace. This uses SIMD
+    /// instructions when they are available.
+    uint64_t whitespace_mask(const char* input, size_t size);
+
+    /// Count the trailing zero bits in a non-zero `value`
+    inline int trailing_zeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(value);
+#else
+        int count = 0;
+        for (int shift = 32; shift > 0; shift /= 2) {
+            if ((value << (64 - shift)) == 0) {
+                count += shift;
+                value >>= shift;
+            }
+        }
+        return count;
+#endif
+    }
+
+    /// Iterator over whitespace separated values in a string. The input is
+    /// classified 64 bytes at a time with `whitespace_mask`, and the token
+    /// boundaries are found by looking at the bits of the mask.
     class tokens_iterator {
     public:
-        explicit tokens_iterator(std::string_view input):
-            input_(input), initial_start_(input_.data()) {}
+        explicit tokens_iterator(std::string_view input): input_(input) {
+            mask_ = whitespace_mask(input_.data(), std::min(input_.size(), BLOCK_SIZE));
+        }
 
         /// Get the number of characters read from input
         size_t read_count() const {
-            return static_cast<size_t>(input_.data() - initial_start_);
+            return position_;
         }
 
         /// Get the next non-whitespace value. If all values have been read,
-        /// this returns an empty string.
+        /// this throws an error.
         std::string_view next() {
-            auto start = input_.begin();  // NOLINT(readability-qualified-auto)
-            auto end = input_.end();  // NOLINT(readability-qualified-auto)
-
-            // skip whitespace
-            while (start != end && is_ascii_whitespace(*start)) {
-                start++;
-            }
-            input_.remove_prefix(static_cast<size_t>(start - input_.begin()));
-
-            // Find next whitespace
-            auto stop = start;  // NOLINT(readability-qualified-auto)
-            while (stop != end && !is_ascii_whitespace(*stop)) {
-                stop++;
-            }
-            auto size = static_cast<size_t>(stop - start);
-
-            if (size == 0) {
+            auto start = find(/* whitespace */ false);
+            if (start == input_.size()) {
                 throw error(
                     "expected {} values, found {}",
                     count_ + 1, count_
                 );
             }
+            position_ = start;
 
-            auto result = input_.substr(0, size);
-            input_.remove_prefix(size);
+            auto stop = find(/* whitespace */ true);
+            position_ = stop;
             count_++;
 
-            return result;
+            return input_.substr(start, stop - start);
         }
 
     private:
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        /// Find the first character at or after `position_` which is
+        /// whitespace (if `whitespace` is true) or not whitespace (if
+        /// `whitespace` is false). This returns the size of the input if no
+        /// such character exists.
+        size_t find(bool whitespace) {
+            while (true) {
+                auto offset = position_ - block_start_;
+                if (offset < BLOCK_SIZE) {
+                    auto mask = whitespace ? mask_ : ~mask_;
+                    mask &= ~uint64_t(0) << offset;
+                    if (mask != 0) {
+                        auto found = block_start_ + static_cast<size_t>(trailing_zeros(mask));
+                        return std::min(found, input_.size());
+                    }
+                }
+
+                if (block_start_ + BLOCK_SIZE >= input_.size()) {
+                    return input_.size();
+                }
+
+                // continue with the next block
+                block_start_ += BLOCK_SIZE;
+                position_ = block_start_;
+                auto size = std::min(input_.size() - block_start_, BLOCK_SIZE);
+                mask_ = whitespace_mask(input_.data() + block_start_, size);
+            }
+        }
+
         std::string_view input_;
-        const char* initial_start_;
+        /// Position of the next character to read in `input_`
+        size_t position_ = 0;
+        /// Start of the current block in `input_`
+        size_t block_start_ = 0;
+        /// Whitespace mask for the current block
+        uint64_t mask_ = 0;
+        /// Number of values read so far
         size_t count_ = 0;
     };
 
@@ -154,6 +203,18 @@ template<> inline std::string parse(std::string_view input) {
 ///                         after the value
 template<> double parse(std::string_view input);
 
+/// Read a value of type T from a fixed-width column in the `input`. This is
+/// only implemented for double.
+template<typename T> T parse_fixed(std::string_view input);
+
+/// Read double value from a fixed-width column in the `input`, such as the
+/// coordinates in PDB or GRO files. Numbers written in fixed-point notation
+/// (`%8.3f` and similar) and padded with spaces use a specialized fast path,
+/// all other inputs are parsed with `parse<double>`.
+///
+/// @throw chemfiles::Error in the same cases as `parse<double>`
+template<> double parse_fixed(std::string_view input);
+
 /// Read a signed 64-bit integer from the `input`. This only support plain
 /// numbers (no hex or octal notation), with ASCII digits (the system locale is
 /// ignored). Numbers should follow the `(+|-)?\d+` pattern.
@@ -183,6 +244,13 @@ inline size_t scan(std::string_view input, Args& ...args) {
     return iterator.read_count();
 }
 
+/// Split the `input` in values separated by ASCII whitespace, and store them
+/// in `tokens`, replacing any previous content. This finds all the token
+/// boundaries in a single pass over the input, classifying 64 bytes at a time
+/// with SIMD instructions when they are available. Re-using the same `tokens`
+/// vector for multiple lines avoids memory allocations.
+void split_whitespace(std::string_view input, std::vector<std::string_view>& tokens);
+
 /// Encodes an integer using the [hybrid36] encoding scheme. Returns a string
 /// of `*` characters if the integer is out of range.
 ///
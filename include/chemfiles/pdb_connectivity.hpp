@@ -94,6 +94,12 @@ public:
         }
     }
 
+    /// Get the connectivity tables for all the known residues, indexed by
+    /// residue name
+    static const PDBConnectMap& all() {
+        return PDB_CONNECTIVITY_MAP_;
+    }
+
 private:
     static const PDBConnectMap PDB_CONNECTIVITY_MAP_;
 };
@@ -0,0 +1,25 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_POWERS_OF_FIVE_HPP
+#define CHEMFILES_POWERS_OF_FIVE_HPP
+
+#include <cstdint>
+
+namespace chemfiles {
+
+/// Smallest power of ten in `POWERS_OF_FIVE_128`
+constexpr int64_t SMALLEST_POWER_OF_TEN = -342;
+/// Largest power of ten in `POWERS_OF_FIVE_128`
+constexpr int64_t LARGEST_POWER_OF_TEN = 308;
+
+/// 128-bit approximations of 5^q for q between `SMALLEST_POWER_OF_TEN` and
+/// `LARGEST_POWER_OF_TEN`, stored as pairs of (high, low) 64-bit words. The
+/// value for 5^q starts at index `2 * (q - SMALLEST_POWER_OF_TEN)`.
+///
+/// This table is generated by `scripts/generate/powers_of_five.py`.
+extern const uint64_t POWERS_OF_FIVE_128[2 * (LARGEST_POWER_OF_TEN - SMALLEST_POWER_OF_TEN + 1)];
+
+}
+
+#endif
@@ -136,6 +136,17 @@ inline void to_ascii_uppercase(std::string& input) {
     );
 }
 
+/// Find the end of the `count`-th line in the `[begin, end)` range, i.e. the
+/// position just after the `count`-th `'\n'` character.
+///
+/// On return, `count` is decremented by the number of newline characters
+/// found. If the range contains less than `count` newline characters, this
+/// function returns `nullptr` (and `count` is not zero on return).
+///
+/// This is used to skip lines in text files without looking at their content,
+/// and is vectorized when possible.
+const char* skip_lines(const char* begin, const char* end, size_t& count);
+
 /// Get the name of the computer used
 std::string hostname();
 /// Get the user name
@@ -5,6 +5,8 @@
 #define CHEMFILES_WARNINGS_H
 
 #include <string>
+#include <vector>
+#include <utility>
 #include <iterator>
 #include <fmt/format.h>
 
@@ -13,6 +15,34 @@ namespace chemfiles {
 /// Send a warning with the given message
 void send_warning(const std::string& message) noexcept;
 
+/// While an instance of this class is alive, warnings sent from the thread
+/// which created it are stored in the instance instead of being sent to the
+/// warning callback. This allows to control the order of warnings coming
+/// from multiple threads, or to discard them.
+class WarningCollector final {
+public:
+    WarningCollector();
+    ~WarningCollector();
+
+    WarningCollector(const WarningCollector&) = delete;
+    WarningCollector& operator=(const WarningCollector&) = delete;
+    WarningCollector(WarningCollector&&) = delete;
+    WarningCollector& operator=(WarningCollector&&) = delete;
+
+    /// Get the warnings collected so far, and clear them from this collector
+    std::vector<std::string> take() {
+        return std::exchange(messages_, {});
+    }
+
+private:
+    /// Warnings collected so far
+    std::vector<std::string> messages_;
+    /// Collector active in this thread before this one was created
+    WarningCollector* previous_;
+
+    friend void send_warning(const std::string& message) noexcept;
+};
+
 /// Create a message for the given `context` formatting the `message` with the
 /// `arguments`, and send a warning with this message.
 ///
@@ -0,0 +1,257 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_WRITE_NUMBERS_HPP
+#define CHEMFILES_WRITE_NUMBERS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/parallel.hpp"
+
+namespace chemfiles {
+
+/// Buffer used to build lines before writing them to a file. This can store
+/// most lines without allocating memory.
+using line_buffer = fmt::memory_buffer;
+
+namespace detail {
+    /// All the pairs of decimal digits, from "00" to "99"
+    inline constexpr char DIGIT_PAIRS[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    /// Exact powers of ten, from 10^0 to 10^15
+    inline constexpr uint64_t POWERS_OF_TEN[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+        1000000000, 10000000000, 100000000000, 1000000000000, 10000000000000,
+        100000000000000, 1000000000000000,
+    };
+
+    /// Get the number of decimal digits in `value`
+    inline size_t count_digits(uint64_t value) {
+        size_t count = 1;
+        while (value >= 10000) {
+            value /= 10000;
+            count += 4;
+        }
+        if (value >= 1000) {
+            return count + 3;
+        } else if (value >= 100) {
+            return count + 2;
+        } else if (value >= 10) {
+            return count + 1;
+        }
+        return count;
+    }
+
+    /// Write exactly `count` digits of `value` in `output`, padding with
+    /// zeros on the left if needed. `count` must be large enough to contain
+    /// all the digits of `value`.
+    inline void write_digits(char* output, uint64_t value, size_t count) {
+        while (count >= 2) {
+            auto pair = static_cast<size_t>(value % 100) * 2;
+            value /= 100;
+            count -= 2;
+            output[count] = DIGIT_PAIRS[pair];
+            output[count + 1] = DIGIT_PAIRS[pair + 1];
+        }
+        if (count == 1) {
+            output[0] = static_cast<char>('0' + value % 10);
+        }
+    }
+
+    /// Round `value`, which must be positive and smaller than 2^53, to the
+    /// nearest integer in `rounded`. `value` is assumed to come from a single
+    /// correctly rounded operation on exact inputs, and this returns `false`
+    /// if the value is too close to an halfway point to know in which
+    /// direction the exact result should be rounded.
+    inline bool round_scaled(double value, uint64_t& rounded) {
+        rounded = static_cast<uint64_t>(value);
+        // this is exact, since value < 2^53
+        auto fraction = value - static_cast<double>(rounded);
+        // the error on value is at most half an ulp, which is smaller than
+        // value * 2^-53. Use a slightly larger margin to stay safe.
+        auto margin = value * 2.3e-16;
+        if (std::abs(fraction - 0.5) <= margin) {
+            return false;
+        }
+        if (fraction > 0.5) {
+            rounded += 1;
+        }
+        return true;
+    }
+
+    /// Format `value` with fmt, with `precision` digits after the decimal
+    /// point in a field of at least `width` characters
+    void write_fixed_fallback(line_buffer& output, double value, size_t width, size_t precision);
+}
+
+/// Append `value` to `output`, with `Precision` digits after the decimal point
+/// and padded with spaces on the left to a field of at least `width`
+/// characters. This gives the same output as fmt's `"{:<width>.<Precision>f}"`
+/// format specification, without going through the format string at runtime.
+template <size_t Precision>
+inline void write_fixed(line_buffer& output, double value, size_t width) {
+    static_assert(Precision <= 9, "write_fixed only supports up to 9 digits of precision");
+    constexpr auto scale = detail::POWERS_OF_TEN[Precision];
+    constexpr auto limit = static_cast<double>(detail::POWERS_OF_TEN[15]);
+
+    auto negative = std::signbit(value);
+    auto scaled = std::abs(value) * static_cast<double>(scale);
+    uint64_t rounded = 0;
+    // this condition is also false for NaN
+    if (!(scaled < limit) || !detail::round_scaled(scaled, rounded)) {
+        detail::write_fixed_fallback(output, value, width, Precision);
+        return;
+    }
+
+    auto integer = rounded / scale;
+    auto fraction = rounded % scale;
+    auto integer_digits = detail::count_digits(integer);
+    auto size = static_cast<size_t>(negative) + integer_digits + (Precision == 0 ? 0 : Precision + 1);
+    auto padding = width > size ? width - size : 0;
+
+    auto start = output.size();
+    output.resize(start + padding + size);
+    auto* data = output.data() + start;
+    std::memset(data, ' ', padding);
+    data += padding;
+    if (negative) {
+        *data++ = '-';
+    }
+    detail::write_digits(data, integer, integer_digits);
+    if (Precision != 0) {
+        data += integer_digits;
+        *data++ = '.';
+        detail::write_digits(data, fraction, Precision);
+    }
+}
+
+/// Append `value` to `output` using the shortest representation with six
+/// significant digits. This gives the same output as fmt's `"{:g}"` format
+/// specification, without going through the format string at runtime.
+void write_general(line_buffer& output, double value);
+
+/// Append `value` to `output`, padded with spaces on the left to a field of
+/// at least `width` characters. This gives the same output as fmt's
+/// `"{:>width}"` format specification.
+inline void write_integer(line_buffer& output, int64_t value, size_t width) {
+    auto negative = value < 0;
+    // compute the absolute value with unsigned integers to support INT64_MIN
+    auto absolute = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    auto digits = detail::count_digits(absolute);
+    auto size = static_cast<size_t>(negative) + digits;
+    auto padding = width > size ? width - size : 0;
+
+    auto start = output.size();
+    output.resize(start + padding + size);
+    auto* data = output.data() + start;
+    std::memset(data, ' ', padding);
+    data += padding;
+    if (negative) {
+        *data++ = '-';
+    }
+    detail::write_digits(data, absolute, digits);
+}
+
+/// Append `value` to `output`, padded with spaces on the left to a field of
+/// at least `width` characters. This gives the same output as fmt's
+/// `"{:>width}"` format specification.
+inline void write_right(line_buffer& output, std::string_view value, size_t width) {
+    if (width > value.size()) {
+        auto start = output.size();
+        output.resize(start + width - value.size());
+        std::memset(output.data() + start, ' ', width - value.size());
+    }
+    output.append(value.data(), value.data() + value.size());
+}
+
+/// Append `value` to `output`, padded with spaces on the right to a field of
+/// at least `width` characters. This gives the same output as fmt's
+/// `"{:<width}"` format specification.
+inline void write_left(line_buffer& output, std::string_view value, size_t width) {
+    output.append(value.data(), value.data() + value.size());
+    if (width > value.size()) {
+        auto start = output.size();
+        output.resize(start + width - value.size());
+        std::memset(output.data() + start, ' ', width - value.size());
+    }
+}
+
+/// Append `value` to `output` without any padding
+inline void write_string(line_buffer& output, std::string_view value) {
+    output.append(value.data(), value.data() + value.size());
+}
+
+/// Number of records formatted together in a single buffer by `write_records`
+constexpr size_t WRITE_RECORDS_CHUNK_SIZE = 16384;
+
+/// Write `count` records to `file`, in order. The text of the record `i` is
+/// created by calling `format(buffer, i)`, which should append it to `buffer`.
+///
+/// The records are split in chunks of `WRITE_RECORDS_CHUNK_SIZE`, and the
+/// chunks are formatted in separate buffers using at most `threads` threads.
+/// The buffers are then written to the file in the same order as the records.
+/// `format` can be called from multiple threads at once, and should not modify
+/// any shared state: stateful parts of the records (such as numbering) should
+/// be computed before calling this function.
+///
+/// Since records are formatted in an unspecified order, `format` should not
+/// emit warnings, and values should be validated before calling this
+/// function. If `format` throws an exception anyway, the records before the
+/// chunk containing the error may have been written to the file, and the
+/// exception is re-thrown in the calling thread.
+template <class Function>
+void write_records(TextFile& file, size_t count, size_t threads, Function&& format) {
+    auto n_chunks = (count + WRITE_RECORDS_CHUNK_SIZE - 1) / WRITE_RECORDS_CHUNK_SIZE;
+    threads = std::max(std::min(threads, n_chunks), size_t(1));
+
+    // format a few chunks per thread at once, to balance the load between
+    // threads while keeping the memory used by the buffers bounded
+    auto buffers = std::vector<line_buffer>(2 * threads);
+    for (size_t first = 0; first < n_chunks; first += buffers.size()) {
+        auto n_buffers = std::min(buffers.size(), n_chunks - first);
+        parallel_for(n_buffers, threads, [&](size_t i) {
+            auto& buffer = buffers[i];
+            buffer.clear();
+
+            auto start = (first + i) * WRITE_RECORDS_CHUNK_SIZE;
+            auto stop = std::min(start + WRITE_RECORDS_CHUNK_SIZE, count);
+            for (size_t record = start; record < stop; record++) {
+                format(buffer, record);
+            }
+        });
+
+        for (size_t i = 0; i < n_buffers; i++) {
+            file.write({buffers[i].data(), buffers[i].size()});
+        }
+    }
+}
+
+/// Write `count` records to `file` with `format`, using all available threads
+template <class Function>
+void write_records(TextFile& file, size_t count, Function&& format) {
+    write_records(file, count, parallel_threads(), std::forward<Function>(format));
+}
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+# -* coding: utf-8 -*
+
+"""
+This script generates the table of 128-bit approximations of powers of five
+used by the Eisel-Lemire algorithm to parse floating point numbers in
+`src/parse.cpp`.
+
+For each power of ten 10^q with q between SMALLEST_POWER and LARGEST_POWER,
+the table contains the 128 most significant bits of 5^q, rounded up for
+negative q. See "Number Parsing at a Gigabyte per Second" by Daniel Lemire
+(https://arxiv.org/abs/2101.11408) for the details.
+"""
+
+import sys
+
+SMALLEST_POWER = -342
+LARGEST_POWER = 308
+
+HEADER = """// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+// !!!! AUTO-GENERATED FILE !!!! Do not edit. See powers_of_five.py for the code.
+
+#include "chemfiles/powers_of_five.hpp"
+using namespace chemfiles;
+
+const uint64_t chemfiles::POWERS_OF_FIVE_128[2 * (LARGEST_POWER_OF_TEN - SMALLEST_POWER_OF_TEN + 1)] = {
+"""
+
+
+def powers_of_five():
+    for q in range(SMALLEST_POWER, 0):
+        power5 = 5 ** -q
+        z = 0
+        while (1 << z) < power5:
+            z += 1
+
+        if q >= -27:
+            b = z + 127
+            c = 2 ** b // power5 + 1
+        else:
+            b = 2 * z + 2 * 64
+            c = 2 ** b // power5 + 1
+            # truncate to 128 bits
+            while c >= (1 << 128):
+                c //= 2
+        yield c
+
+    for q in range(0, LARGEST_POWER + 1):
+        power5 = 5 ** q
+        # move the most significant bit in position
+        while power5 < (1 << 127):
+            power5 *= 2
+        # truncate to 128 bits
+        while power5 >= (1 << 128):
+            power5 //= 2
+        yield power5
+
+
+def write_table(path):
+    mask = (1 << 64) - 1
+    with open(path, "w") as fd:
+        fd.write(HEADER)
+        for value in powers_of_five():
+            fd.write("    0x{:016x}, 0x{:016x},\n".format(value >> 64, value & mask))
+        fd.write("};\n")
+
+
+def usage():
+    print(sys.argv[0] + " powers_of_five.cpp")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        usage()
+        sys.exit(0)
+
+    write_table(sys.argv[1])
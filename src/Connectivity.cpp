@@ -4,7 +4,9 @@
 #include <cassert>
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
+#include <numeric>
 #include <iterator>
 #include <algorithm>
 
@@ -100,62 +102,260 @@ size_t Improper::operator[](size_t i) const {
     return data_[i];
 }
 
-void Connectivity::recalculate() const {
-    angles_.clear();
-    dihedrals_.clear();
-    impropers_.clear();
-
-    // Generate the list of which atom is bonded to which one
-    auto bonded_to = std::vector<std::vector<size_t>>(biggest_atom_ + 1);
-    for (auto const& bond: bonds_) {
-        assert(bond[0] < bonded_to.size());
-        assert(bond[1] < bonded_to.size());
-        bonded_to[bond[0]].push_back(bond[1]);
-        bonded_to[bond[1]].push_back(bond[0]);
-    }
-
-    // Generate the list of angles
-    for (auto const& bond: bonds_) {
-        auto i = bond[0];
-        auto j = bond[1];
-        for (auto k: bonded_to[i]) {
-            if (k != j) {
-                angles_.insert(Angle(k, i, j));
+/// Add the `values` to the sorted `set`, skipping values already in the set
+template <class T>
+static void merge_into(sorted_set<T>& set, std::vector<T> values) {
+    if (values.empty()) {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+
+    auto& data = set.as_mutable_vec();
+    auto middle = static_cast<std::ptrdiff_t>(data.size());
+    data.insert(data.end(), values.begin(), values.end());
+    std::inplace_merge(data.begin(), data.begin() + middle, data.end());
+    data.erase(std::unique(data.begin(), data.end()), data.end());
+}
+
+/// Check if the atoms `a` and `b` are the same pair as `i` and `j`, in any
+/// order
+static bool same_pair(size_t a, size_t b, size_t i, size_t j) {
+    return (a == i && b == j) || (a == j && b == i);
+}
+
+void Connectivity::update_adjacency() const {
+    if (adjacency_uptodate_) {
+        return;
+    }
+
+    // count the number of bonds for each atom, and use the cumulative sum
+    // as offsets in the adjacency list
+    auto natoms = bonds_.empty() ? 0 : biggest_atom_ + 1;
+    adjacency_offsets_.assign(natoms + 1, 0);
+    for (const auto& bond: bonds_) {
+        adjacency_offsets_[bond[0] + 1] += 1;
+        adjacency_offsets_[bond[1] + 1] += 1;
+    }
+    std::partial_sum(adjacency_offsets_.begin(), adjacency_offsets_.end(), adjacency_offsets_.begin());
+
+    // since the bonds are sorted, all the atoms bonded to `i` with a smaller
+    // index come first in increasing order, followed by the atoms with a
+    // bigger index in increasing order. This gives sorted lists of neighbors.
+    adjacency_.resize(2 * bonds_.size());
+    auto positions = std::vector<size_t>(adjacency_offsets_.begin(), adjacency_offsets_.end() - 1);
+    for (const auto& bond: bonds_) {
+        adjacency_[positions[bond[0]]++] = bond[1];
+        adjacency_[positions[bond[1]]++] = bond[0];
+    }
+
+    adjacency_uptodate_ = true;
+}
+
+span<const size_t> Connectivity::bonded_to(size_t atom) const {
+    assert(adjacency_uptodate_);
+    if (atom + 1 >= adjacency_offsets_.size()) {
+        return {};
+    }
+    auto start = adjacency_offsets_[atom];
+    auto stop = adjacency_offsets_[atom + 1];
+    return {adjacency_.data() + start, adjacency_.data() + stop};
+}
+
+void Connectivity::compute_angles() const {
+    update_adjacency();
+
+    auto angles = std::vector<Angle>();
+    for (size_t j = 0; j + 1 < adjacency_offsets_.size(); j++) {
+        auto bonded = bonded_to(j);
+        for (size_t a = 0; a < bonded.size(); a++) {
+            for (size_t b = a + 1; b < bonded.size(); b++) {
+                angles.emplace_back(bonded[a], j, bonded[b]);
+            }
+        }
+    }
+    std::sort(angles.begin(), angles.end());
+
+    angles_.as_mutable_vec() = std::move(angles);
+    angles_uptodate_ = true;
+}
+
+void Connectivity::compute_dihedrals() const {
+    update_adjacency();
+
+    // each dihedral angle is created exactly once, from its central bond
+    auto dihedrals = std::vector<Dihedral>();
+    for (const auto& bond: bonds_) {
+        auto j = bond[0];
+        auto k = bond[1];
+        for (auto i: bonded_to(j)) {
+            if (i == k) {
+                continue;
+            }
+            for (auto m: bonded_to(k)) {
+                if (m != j && m != i) {
+                    dihedrals.emplace_back(i, j, k, m);
+                }
+            }
+        }
+    }
+    std::sort(dihedrals.begin(), dihedrals.end());
+
+    dihedrals_.as_mutable_vec() = std::move(dihedrals);
+    dihedrals_uptodate_ = true;
+}
+
+void Connectivity::compute_impropers() const {
+    update_adjacency();
+
+    auto impropers = std::vector<Improper>();
+    for (size_t j = 0; j + 1 < adjacency_offsets_.size(); j++) {
+        auto bonded = bonded_to(j);
+        for (size_t a = 0; a < bonded.size(); a++) {
+            for (size_t b = a + 1; b < bonded.size(); b++) {
+                for (size_t c = b + 1; c < bonded.size(); c++) {
+                    impropers.emplace_back(bonded[a], j, bonded[b], bonded[c]);
+                }
+            }
+        }
+    }
+    std::sort(impropers.begin(), impropers.end());
+
+    impropers_.as_mutable_vec() = std::move(impropers);
+    impropers_uptodate_ = true;
+}
+
+void Connectivity::bond_added(size_t i, size_t j) {
+    if (adjacency_uptodate_) {
+        // insert the new bond in the adjacency list
+        auto natoms = biggest_atom_ + 1;
+        if (adjacency_offsets_.size() < natoms + 1) {
+            adjacency_offsets_.resize(natoms + 1, adjacency_offsets_.back());
+        }
+
+        for (auto atom: {i, j}) {
+            auto other = atom == i ? j : i;
+            auto begin = adjacency_.begin() + static_cast<std::ptrdiff_t>(adjacency_offsets_[atom]);
+            auto end = adjacency_.begin() + static_cast<std::ptrdiff_t>(adjacency_offsets_[atom + 1]);
+            adjacency_.insert(std::lower_bound(begin, end, other), other);
+            for (size_t k = atom + 1; k < adjacency_offsets_.size(); k++) {
+                adjacency_offsets_[k] += 1;
             }
         }
+    }
 
-        for (auto k: bonded_to[j]) {
+    if (!angles_uptodate_ && !dihedrals_uptodate_ && !impropers_uptodate_) {
+        return;
+    }
+    update_adjacency();
+
+    if (angles_uptodate_) {
+        auto angles = std::vector<Angle>();
+        for (auto k: bonded_to(i)) {
+            if (k != j) {
+                angles.emplace_back(k, i, j);
+            }
+        }
+        for (auto k: bonded_to(j)) {
             if (k != i) {
-                angles_.insert(Angle(i, j, k));
+                angles.emplace_back(i, j, k);
             }
         }
+        merge_into(angles_, std::move(angles));
     }
 
-    // Generate the list of dihedrals
-    for (auto const& angle: angles_) {
-        auto i = angle[0];
-        auto j = angle[1];
-        auto k = angle[2];
-        for (auto m: bonded_to[i]) {
-            if (m != j && m != k) {
-                dihedrals_.insert(Dihedral(m, i, j, k));
+    if (dihedrals_uptodate_) {
+        auto dihedrals = std::vector<Dihedral>();
+        for (auto a: bonded_to(i)) {
+            if (a == j) {
+                continue;
+            }
+            // the new bond is the central bond
+            for (auto b: bonded_to(j)) {
+                if (b != i && b != a) {
+                    dihedrals.emplace_back(a, i, j, b);
+                }
+            }
+            // the new bond is a terminal bond, on the side of `i`
+            for (auto b: bonded_to(a)) {
+                if (b != i && b != j) {
+                    dihedrals.emplace_back(j, i, a, b);
+                }
+            }
+        }
+        // the new bond is a terminal bond, on the side of `j`
+        for (auto a: bonded_to(j)) {
+            if (a == i) {
+                continue;
+            }
+            for (auto b: bonded_to(a)) {
+                if (b != j && b != i) {
+                    dihedrals.emplace_back(i, j, a, b);
+                }
             }
         }
+        merge_into(dihedrals_, std::move(dihedrals));
+    }
 
-        for (auto m: bonded_to[k]) {
-            if (m != i && m != j) {
-                dihedrals_.insert(Dihedral(i, j, k, m));
+    if (impropers_uptodate_) {
+        auto impropers = std::vector<Improper>();
+        for (auto center: {i, j}) {
+            auto other = center == i ? j : i;
+            auto bonded = bonded_to(center);
+            for (size_t a = 0; a < bonded.size(); a++) {
+                for (size_t b = a + 1; b < bonded.size(); b++) {
+                    if (bonded[a] != other && bonded[b] != other) {
+                        impropers.emplace_back(other, center, bonded[a], bonded[b]);
+                    }
+                }
             }
         }
+        merge_into(impropers_, std::move(impropers));
+    }
+}
 
-        for (auto m: bonded_to[j]) {
-            if (m != i && m != k) {
-                impropers_.insert(Improper(i, j, k, m));
+void Connectivity::bond_removed(size_t i, size_t j) {
+    if (adjacency_uptodate_) {
+        for (auto atom: {i, j}) {
+            auto other = atom == i ? j : i;
+            auto begin = adjacency_.begin() + static_cast<std::ptrdiff_t>(adjacency_offsets_[atom]);
+            auto end = adjacency_.begin() + static_cast<std::ptrdiff_t>(adjacency_offsets_[atom + 1]);
+            auto it = std::lower_bound(begin, end, other);
+            assert(it != end && *it == other);
+            adjacency_.erase(it);
+            for (size_t k = atom + 1; k < adjacency_offsets_.size(); k++) {
+                adjacency_offsets_[k] -= 1;
             }
         }
     }
 
-    uptodate_ = true;
+    // removing values from a sorted vector keeps it sorted
+    if (angles_uptodate_) {
+        auto& angles = angles_.as_mutable_vec();
+        angles.erase(std::remove_if(angles.begin(), angles.end(), [i, j](const Angle& angle) {
+            return same_pair(angle[0], angle[1], i, j) || same_pair(angle[1], angle[2], i, j);
+        }), angles.end());
+    }
+
+    if (dihedrals_uptodate_) {
+        auto& dihedrals = dihedrals_.as_mutable_vec();
+        dihedrals.erase(std::remove_if(dihedrals.begin(), dihedrals.end(), [i, j](const Dihedral& dihedral) {
+            return same_pair(dihedral[0], dihedral[1], i, j) ||
+                   same_pair(dihedral[1], dihedral[2], i, j) ||
+                   same_pair(dihedral[2], dihedral[3], i, j);
+        }), dihedrals.end());
+    }
+
+    if (impropers_uptodate_) {
+        auto& impropers = impropers_.as_mutable_vec();
+        impropers.erase(std::remove_if(impropers.begin(), impropers.end(), [i, j](const Improper& improper) {
+            auto center = improper[1];
+            if (center != i && center != j) {
+                return false;
+            }
+            auto other = center == i ? j : i;
+            return improper[0] == other || improper[2] == other || improper[3] == other;
+        }), impropers.end());
+    }
 }
 
 const sorted_set<Bond>& Connectivity::bonds() const {
@@ -167,28 +367,27 @@ const std::vector<Bond::BondOrder>& Connectivity::bond_orders() const {
 }
 
 const sorted_set<Angle>& Connectivity::angles() const {
-    if (!uptodate_) {
-        recalculate();
+    if (!angles_uptodate_) {
+        compute_angles();
     }
     return angles_;
 }
 
 const sorted_set<Dihedral>& Connectivity::dihedrals() const {
-    if (!uptodate_) {
-        recalculate();
+    if (!dihedrals_uptodate_) {
+        compute_dihedrals();
     }
     return dihedrals_;
 }
 
 const sorted_set<Improper>& Connectivity::impropers() const {
-    if (!uptodate_) {
-        recalculate();
+    if (!impropers_uptodate_) {
+        compute_impropers();
     }
     return impropers_;
 }
 
 void Connectivity::add_bond(size_t i, size_t j, Bond::BondOrder bond_order) {
-    uptodate_ = false;
     auto result = bonds_.emplace(i, j);
     if (i > biggest_atom_) {biggest_atom_ = i;}
     if (j > biggest_atom_) {biggest_atom_ = j;}
@@ -196,51 +395,152 @@ void Connectivity::add_bond(size_t i, size_t j, Bond::BondOrder bond_order) {
     if (result.second) {
         auto diff = std::distance(bonds_.cbegin(), result.first);
         bond_orders_.insert(bond_orders_.begin() + diff, bond_order);
+        bond_added(i, j);
+    }
+}
+
+void Connectivity::add_bonds(span<const Bond> bonds, span<const Bond::BondOrder> bond_orders) {
+    assert(bond_orders.empty() || bond_orders.size() == bonds.size());
+    if (bonds.empty()) {
+        return;
+    }
+    // updating the caches one bond at a time would be slower than computing
+    // them again when needed
+    adjacency_uptodate_ = false;
+    angles_uptodate_ = false;
+    dihedrals_uptodate_ = false;
+    impropers_uptodate_ = false;
+
+    // sort the new bonds, keeping bonds given multiple times in the same
+    // order as the input to use the first bond order
+    auto order = std::vector<size_t>(bonds.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (!std::is_sorted(bonds.begin(), bonds.end())) {
+        std::stable_sort(order.begin(), order.end(), [&bonds](size_t lhs, size_t rhs) {
+            return bonds[lhs] < bonds[rhs];
+        });
+    }
+
+    // merge the new bonds with the existing ones
+    const auto& old_bonds = bonds_.as_vec();
+    auto merged_bonds = std::vector<Bond>();
+    auto merged_orders = std::vector<Bond::BondOrder>();
+    merged_bonds.reserve(old_bonds.size() + bonds.size());
+    merged_orders.reserve(old_bonds.size() + bonds.size());
+
+    size_t old = 0;
+    size_t added = 0;
+    while (old < old_bonds.size() || added < order.size()) {
+        // existing bonds come first to keep their bond order
+        auto use_old = added == order.size() || (
+            old < old_bonds.size() && !(bonds[order[added]] < old_bonds[old])
+        );
+
+        const Bond* bond = nullptr;
+        auto bond_order = Bond::UNKNOWN;
+        if (use_old) {
+            bond = &old_bonds[old];
+            bond_order = bond_orders_[old];
+            old++;
+        } else {
+            bond = &bonds[order[added]];
+            biggest_atom_ = std::max(biggest_atom_, (*bond)[1]);
+            if (!bond_orders.empty()) {
+                bond_order = bond_orders[order[added]];
+            }
+            added++;
+        }
+
+        if (!merged_bonds.empty() && merged_bonds.back() == *bond) {
+            continue;
+        }
+        merged_bonds.push_back(*bond);
+        merged_orders.push_back(bond_order);
     }
+
+    bonds_.as_mutable_vec() = std::move(merged_bonds);
+    bond_orders_ = std::move(merged_orders);
 }
 
 void Connectivity::remove_bond(size_t i, size_t j) {
     auto pos = bonds_.find(Bond(i, j));
     if (pos != bonds_.end()) {
-        uptodate_ = false;
         auto result = bonds_.erase(pos);
 
         auto diff = std::distance(bonds_.cbegin(), result);
         bond_orders_.erase(bond_orders_.begin() + diff);
         assert(bond_orders_.size() == bonds_.size());
+        bond_removed(i, j);
     }
 }
 
-void Connectivity::atom_removed(size_t index) {
-    auto to_remove = std::vector<Bond>();
-    auto to_add = std::vector<Bond>();
-    auto bo_add = std::vector<Bond::BondOrder>();
-
-    const auto& bonds = bonds_.as_vec();
-    for (size_t idx = 0; idx < bonds_.size(); idx++) {
-        const auto& bond = bonds[idx];
-
-        if (bond[0] == index || bond[1] == index) {
-            throw error("can not shift atomic indexes that still have a bond");
+void Connectivity::atoms_removed(span<const size_t> new_indexes) {
+    auto removed = [&new_indexes](size_t i) {
+        return new_indexes[i] == SIZE_MAX;
+    };
+
+    // The new indexes keep the relative order of all atoms, so the bonds,
+    // angles, etc. stay sorted when removing some of them and updating the
+    // indexes of the others.
+    auto& bonds = bonds_.as_mutable_vec();
+    size_t count = 0;
+    biggest_atom_ = 0;
+    for (size_t i = 0; i < bonds.size(); i++) {
+        auto bond = bonds[i];
+        if (removed(bond[0]) || removed(bond[1])) {
+            continue;
         }
-        if (bond[0] > index || bond[1] > index) {
-            to_remove.push_back(bond);
-
-            auto i = bond[0] > index ? bond[0] - 1 : bond[0];
-            auto j = bond[1] > index ? bond[1] - 1 : bond[1];
-            to_add.emplace_back(i, j);
-            bo_add.push_back(bond_orders_[idx]);
+        bonds[count] = Bond(new_indexes[bond[0]], new_indexes[bond[1]]);
+        bond_orders_[count] = bond_orders_[i];
+        biggest_atom_ = std::max(biggest_atom_, bonds[count][1]);
+        count++;
+    }
+    bonds.erase(bonds.begin() + static_cast<std::ptrdiff_t>(count), bonds.end());
+    bond_orders_.resize(count);
+
+    if (angles_uptodate_) {
+        auto& angles = angles_.as_mutable_vec();
+        count = 0;
+        for (auto angle: angles) {
+            if (removed(angle[0]) || removed(angle[1]) || removed(angle[2])) {
+                continue;
+            }
+            angles[count++] = Angle(new_indexes[angle[0]], new_indexes[angle[1]], new_indexes[angle[2]]);
         }
+        angles.erase(angles.begin() + static_cast<std::ptrdiff_t>(count), angles.end());
     }
 
-    for (auto bond: to_remove) {
-        this->remove_bond(bond[0], bond[1]);
+    if (dihedrals_uptodate_) {
+        auto& dihedrals = dihedrals_.as_mutable_vec();
+        count = 0;
+        for (auto dihedral: dihedrals) {
+            if (removed(dihedral[0]) || removed(dihedral[1]) || removed(dihedral[2]) || removed(dihedral[3])) {
+                continue;
+            }
+            dihedrals[count++] = Dihedral(
+                new_indexes[dihedral[0]], new_indexes[dihedral[1]],
+                new_indexes[dihedral[2]], new_indexes[dihedral[3]]
+            );
+        }
+        dihedrals.erase(dihedrals.begin() + static_cast<std::ptrdiff_t>(count), dihedrals.end());
     }
 
-    for (size_t idx = 0; idx < to_add.size(); idx++) {
-        const auto& bond = to_add[idx];
-        this->add_bond(bond[0], bond[1], bo_add[idx]);
+    if (impropers_uptodate_) {
+        auto& impropers = impropers_.as_mutable_vec();
+        count = 0;
+        for (auto improper: impropers) {
+            if (removed(improper[0]) || removed(improper[1]) || removed(improper[2]) || removed(improper[3])) {
+                continue;
+            }
+            impropers[count++] = Improper(
+                new_indexes[improper[0]], new_indexes[improper[1]],
+                new_indexes[improper[2]], new_indexes[improper[3]]
+            );
+        }
+        impropers.erase(impropers.begin() + static_cast<std::ptrdiff_t>(count), impropers.end());
     }
+
+    adjacency_uptodate_ = false;
 }
 
 Bond::BondOrder Connectivity::bond_order(size_t i, size_t j) const {
@@ -8,7 +8,8 @@
 #include <string>
 #include <utility>
 #include <vector>
-#include <iterator>
+#include <exception>
+#include <algorithm>
 #include <string_view>
 
 #include <fmt/core.h>
@@ -18,15 +19,33 @@
 #include "chemfiles/files/GzFile.hpp"
 #include "chemfiles/files/XzFile.hpp"
 #include "chemfiles/files/Bz2File.hpp"
+#include "chemfiles/files/ZstdFile.hpp"
 #include "chemfiles/files/PlainFile.hpp"
+#include "chemfiles/files/MappedFile.hpp"
 #include "chemfiles/files/MemoryFile.hpp"
 #include "chemfiles/files/MemoryBuffer.hpp"
 
+#include "chemfiles/utils.hpp"
+#include "chemfiles/warnings.hpp"
 #include "chemfiles/error_fmt.hpp"
 #include "chemfiles/unreachable.hpp"
 
 using namespace chemfiles;
 
+#if defined(__GNUC__) && !defined(__clang__)
+#define IGNORING_SUGGEST_ATTRIBUTE_NORETURN
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=noreturn"
+#endif
+
+void TextFileImpl::set_compression_options(const CompressionOptions& /*options*/) {
+    throw file_error("compression options can only be used with compressed files");
+}
+
+#if defined(IGNORING_SUGGEST_ATTRIBUTE_NORETURN)
+#pragma GCC diagnostic pop
+#endif
+
 TextFile::TextFile(std::string path, File::Mode mode, File::Compression compression):
     File(std::move(path), mode, compression),
     file_(nullptr),
@@ -36,7 +55,23 @@ TextFile::TextFile(std::string path, File::Mode mode, File::Compression compress
 {
     switch (compression) {
     case File::DEFAULT:
+#if CHEMFILES_TEXT_FILE_USE_MMAP && defined(CHFL_MMAP_TEXT_FILES)
+        if (this->mode() == File::READ) {
+            try {
+                file_ = std::make_unique<MappedFile>(this->path());
+            } catch (const FileError&) {
+                // this can happen for files which are not regular files (pipes,
+                // devices, ...) or if the file does not exist: fallback to
+                // PlainFile, which will also give the right error message.
+                file_ = nullptr;
+            }
+        }
+        if (file_ == nullptr) {
+            file_ = std::make_unique<PlainFile>(this->path(), this->mode());
+        }
+#else
         file_ = std::make_unique<PlainFile>(this->path(), this->mode());
+#endif
         break;
     case File::GZIP:
         file_ = std::make_unique<GzFile>(this->path(), this->mode());
@@ -47,9 +82,14 @@ TextFile::TextFile(std::string path, File::Mode mode, File::Compression compress
     case File::LZMA:
         file_ = std::make_unique<XzFile>(this->path(), this->mode());
         break;
+    case File::ZSTD:
+        file_ = std::make_unique<ZstdFile>(this->path(), this->mode());
+        break;
     default:
         unreachable();
     }
+
+    this->use_contiguous();
 }
 
 TextFile::TextFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, File::Compression compression):
@@ -63,27 +103,100 @@ TextFile::TextFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, File::
         throw file_error("cannot append (mode 'a') to a memory file");
     }
 
-    if (compression != File::DEFAULT) {
-        if (mode != File::READ) {
-            throw file_error("writing to a compressed memory file is not supported");
+    switch (compression) {
+    case File::DEFAULT:
+        file_ = std::make_unique<MemoryFile>(std::move(memory), mode);
+        break;
+    case File::GZIP:
+        file_ = std::make_unique<GzFile>(std::move(memory), mode);
+        break;
+    case File::BZIP2:
+        file_ = std::make_unique<Bz2File>(std::move(memory), mode);
+        break;
+    case File::LZMA:
+        file_ = std::make_unique<XzFile>(std::move(memory), mode);
+        break;
+    case File::ZSTD:
+        file_ = std::make_unique<ZstdFile>(std::move(memory), mode);
+        break;
+    default:
+        unreachable();
+    }
+
+    this->use_contiguous();
+}
+
+/// Size of the output buffer, data is sent to the `TextFileImpl` in blocks of
+/// this size
+static constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+TextFile::~TextFile() {
+    if (file_ != nullptr) {
+        try {
+            flush_output();
+        } catch (const std::exception& e) {
+            warning("text file writer", "failed to write data when closing the file: {}", e.what());
         }
+    }
+}
 
-        memory->decompress(compression);
+TextFile& TextFile::operator=(TextFile&& other) {
+    if (this == &other) {
+        return *this;
     }
 
-    file_ = std::make_unique<MemoryFile>(std::move(memory), mode);
+    if (file_ != nullptr) {
+        flush_output();
+    }
+
+    File::operator=(std::move(other));
+    file_ = std::move(other.file_);
+    contiguous_ = other.contiguous_;
+    buffer_ = std::move(other.buffer_);
+    line_start_ = other.line_start_;
+    end_ = other.end_;
+    position_ = other.position_;
+    got_impl_eof_ = other.got_impl_eof_;
+    eof_ = other.eof_;
+    output_ = std::move(other.output_);
+    output_size_ = other.output_size_;
+    other.output_size_ = 0;
+    unflushed_ = other.unflushed_;
+
+    return *this;
+}
+
+void TextFile::use_contiguous() {
+    contiguous_ = file_->contiguous();
+    if (contiguous_) {
+        // the internal buffer is not needed anymore
+        buffer_ = std::vector<char>(1, '\0');
+        line_start_ = contiguous_->data();
+        end_ = contiguous_->data() + contiguous_->size();
+    }
 }
 
 uint64_t TextFile::tellpos() const {
+    if (contiguous_) {
+        return static_cast<uint64_t>(line_start_ - contiguous_->data());
+    }
+
     assert(line_start_ >= buffer_.data());
     auto delta = buffer_initialized() ? static_cast<uint64_t>(line_start_ - buffer_.data()) : 0;
-    return position_ + delta;
+    return position_ + delta + output_size_;
 }
 
 void TextFile::seekpos(uint64_t position) {
+    flush_output();
     got_impl_eof_ = false;
     eof_ = false;
 
+    if (contiguous_) {
+        auto offset = std::min(position, static_cast<uint64_t>(contiguous_->size()));
+        line_start_ = contiguous_->data() + offset;
+        return;
+    }
+
     if (buffer_initialized()) {
         // use signed int64_t since the requested position can be smaller than
         // position_
@@ -122,6 +235,7 @@ bool TextFile::buffer_initialized() const {
 }
 
 void TextFile::fill_buffer(size_t start) {
+    flush_output();
     auto count = buffer_.size() - start;
     if (buffer_initialized()) {
         position_ += count;
@@ -137,6 +251,10 @@ void TextFile::fill_buffer(size_t start) {
 }
 
 std::string_view TextFile::readline() {
+    if (contiguous_) {
+        return readline_contiguous();
+    }
+
     // Initialize buffer if needed
     if (!buffer_initialized()) {
         fill_buffer(0);
@@ -201,18 +319,156 @@ std::string_view TextFile::readline() {
     return line;
 }
 
+std::string_view TextFile::readline_contiguous() {
+    if (eof_) {
+        return "";
+    }
+
+    auto remainder = static_cast<size_t>(end_ - line_start_);
+    const auto* newline = static_cast<const char*>(std::memchr(line_start_, '\n', remainder));
+    if (newline == nullptr) {
+        // this is the last line, which is not terminated by a newline
+        // character, or the end of the file.
+        eof_ = true;
+        auto line = std::string_view(line_start_, remainder);
+        line_start_ = end_;
+        return line;
+    }
+
+    auto length = static_cast<size_t>(newline - line_start_);
+    auto line = std::string_view(line_start_, length);
+    line_start_ = newline + 1;
+
+    // Check if we have a windows style line ending (\r\n)
+    if (length != 0 && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    return line;
+}
+
+size_t TextFile::skiplines(size_t count) {
+    if (!contiguous_ && !buffer_initialized()) {
+        fill_buffer(0);
+    }
+
+    size_t skipped = 0;
+    while (skipped < count && !eof_) {
+        auto remaining = count - skipped;
+        const auto* found = skip_lines(line_start_, end_, remaining);
+        skipped = count - remaining;
+        if (found != nullptr) {
+            line_start_ = found;
+            break;
+        }
+
+        if (contiguous_ || got_impl_eof_) {
+            // there are not enough newline characters in the remaining data,
+            // skip the last line and go to the end of file, like `readline`
+            // would do.
+            if (contiguous_) {
+                line_start_ = end_;
+            } else {
+                // the buffer is padded with zeros after the end of the file
+                line_start_ += std::strlen(line_start_);
+            }
+            eof_ = true;
+            skipped += 1;
+            break;
+        }
+
+        // there are no more newline characters in the buffer, all of it can
+        // be discarded.
+        fill_buffer(0);
+    }
+
+    return skipped;
+}
+
 void TextFile::vprint(fmt::string_view format, fmt::format_args args) {
-    std::string buffer;
-    buffer.reserve(128);
-    fmt::vformat_to(std::back_inserter(buffer), format, args);
-    if (buffer.size() == 0) {
+    auto available = output_.size() - output_size_;
+    auto result = fmt::vformat_to_n(output_.data() + output_size_, available, format, args);
+    if (result.size > available) {
+        // the formatted data did not fit in the remaining space, make some
+        // room and format it again
+        auto size = result.size;
+        auto* output = reserve_output(size);
+        result = fmt::vformat_to_n(output, size, format, args);
+        assert(result.size == size);
+    }
+    commit_output(result.size);
+}
+
+void TextFile::commit_output(size_t count) {
+    assert(output_size_ + count <= output_.size());
+    output_size_ += count;
+    if (this->mode() == File::READ) {
+        // let the `TextFileImpl` give the error right away
+        flush_output();
+    }
+}
+
+void TextFile::write(std::string_view data) {
+    if (data.empty()) {
+        return;
+    } else if (data.size() >= OUTPUT_BUFFER_SIZE) {
+        // large blocks are written directly, without copying them in the
+        // output buffer first
+        flush_output();
+        unflushed_ = true;
+        file_->write(data.data(), data.size());
+        position_ += data.size();
+        return;
+    }
+    auto* output = reserve_output(data.size());
+    std::memcpy(output, data.data(), data.size());
+    commit_output(data.size());
+}
+
+char* TextFile::reserve_output(size_t count) {
+    if (output_.size() - output_size_ < count) {
+        flush_output();
+        if (this->mode() == File::READ) {
+            // the data will be sent to the `TextFileImpl` (and rejected)
+            // right away, there is no need for a large buffer
+            output_.resize(count);
+        } else {
+            output_.resize(std::max({output_.size(), count, OUTPUT_BUFFER_SIZE}));
+        }
+    }
+    return output_.data() + output_size_;
+}
+
+void TextFile::flush_output() {
+    if (output_size_ == 0) {
         return;
     }
-    file_->write(buffer.data(), buffer.size());
-    position_ += buffer.size();
+    // reset the size first, to not write the same data again if this throws
+    auto size = output_size_;
+    output_size_ = 0;
+    unflushed_ = true;
+    file_->write(output_.data(), size);
+    position_ += size;
+}
+
+void TextFile::flush() {
+    flush_output();
+    if (unflushed_) {
+        // compressed files finish the current stream when flushing, only do
+        // this if some data was written since the last flush
+        file_->flush();
+        unflushed_ = false;
+    }
 }
 
 std::string TextFile::readall() {
+    flush_output();
+    if (contiguous_) {
+        auto content = std::string(line_start_, end_);
+        line_start_ = end_;
+        return content;
+    }
+
     std::string buffer;
     buffer.resize(2048, '\0');
     size_t start = 0;
@@ -2,21 +2,24 @@
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 #include <utility>
 #include <typeinfo>
+#include <algorithm>
 
 #include "chemfiles/File.hpp"
+#include "chemfiles/Error.hpp"
+#include "chemfiles/Frame.hpp"
 #include "chemfiles/Format.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/warnings.hpp"
 #include "chemfiles/error_fmt.hpp"
 #include "chemfiles/external/optional.hpp"
 
-namespace chemfiles {
-    class Frame;
-    class MemoryBuffer;
-}
+#include "chemfiles/files/MemoryBuffer.hpp"
 
 using namespace chemfiles;
 
@@ -33,6 +36,12 @@ void Format::read_step(size_t /*unused*/, Frame& /*unused*/) {
     );
 }
 
+void Format::read_steps(size_t start, std::vector<Frame>& frames) {
+    for (size_t i = 0; i < frames.size(); i++) {
+        this->read_step(start + i, frames[i]);
+    }
+}
+
 void Format::read(Frame& /*unused*/) {
     throw format_error(
         "'read' is not implemented for this format ({})",
@@ -65,17 +74,155 @@ void TextFormat::write_next(const Frame& /*unused*/) {
 #pragma GCC diagnostic pop
 #endif
 
+void Format::set_compression_options(const CompressionOptions& /*unused*/) {}
+
+void Format::flush() {}
+
+void TextFormat::set_compression_options(const CompressionOptions& options) {
+    file_.set_compression_options(options);
+}
+
+void TextFormat::flush() {
+    file_.flush();
+}
+
 TextFormat::TextFormat(std::string path, File::Mode mode, File::Compression compression) :
     file_(std::move(path), mode, compression) {}
 
 TextFormat::TextFormat(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, File::Compression compression) :
     file_(std::move(memory), mode, compression) {}
 
+std::unique_ptr<TextFormat> TextFormat::parallel_reader(std::shared_ptr<MemoryBuffer> /*unused*/) const {
+    return nullptr;
+}
+
+optional<uint64_t> TextFormat::find_next_step() {
+    return nullopt;
+}
+
+/// Minimal size of the chunks used for parallel scanning. Smaller files are
+/// scanned with a single thread.
+static constexpr size_t PARALLEL_SCAN_CHUNK_SIZE = 1024 * 1024;
+
+bool TextFormat::scan_all_parallel() {
+    const auto& data = file_.contiguous();
+    if (!data || file_.mode() != File::READ || file_.tellpos() != 0) {
+        return false;
+    }
+
+    // use a few chunks per thread to balance the load between threads
+    auto n_chunks = std::min(4 * parallel_threads(), data->size() / PARALLEL_SCAN_CHUNK_SIZE);
+    if (n_chunks < 2) {
+        return false;
+    }
+    auto chunk_size = data->size() / n_chunks;
+
+    // the readers share the same (non-owned) memory, which is kept alive
+    // by `file_` for the duration of this function
+    auto memory = std::make_shared<MemoryBuffer>(data->data(), data->size());
+    auto readers = std::vector<std::unique_ptr<TextFormat>>(n_chunks);
+    readers[0] = this->parallel_reader(memory);
+    if (!readers[0]) {
+        return false;
+    }
+
+    // find the first step after the start of each chunk
+    auto starts = std::vector<optional<uint64_t>>(n_chunks, nullopt);
+    starts[0] = 0;
+    try {
+        parallel_for(n_chunks - 1, [&](size_t i) {
+            auto chunk = i + 1;
+            auto& reader = readers[chunk];
+            reader = this->parallel_reader(memory);
+            // start on the previous character, to find steps starting exactly
+            // at the beginning of this chunk
+            reader->file_.seekpos(chunk * chunk_size - 1);
+            reader->file_.skiplines(1);
+            if (!reader->file_.eof()) {
+                starts[chunk] = reader->find_next_step();
+            }
+        });
+    } catch (const Error&) {
+        return false;
+    }
+
+    // only keep chunks with distinct steps starts
+    auto chunks = std::vector<std::pair<std::unique_ptr<TextFormat>, uint64_t>>();
+    for (size_t i = 0; i < n_chunks; i++) {
+        if (!starts[i]) {
+            continue;
+        }
+        if (!chunks.empty() && chunks.back().second >= *starts[i]) {
+            continue;
+        }
+        chunks.emplace_back(std::move(readers[i]), *starts[i]);
+    }
+
+    // scan each chunk up to the start of the next one
+    auto positions = std::vector<std::vector<uint64_t>>(chunks.size());
+    auto valid = std::vector<char>(chunks.size(), 0);
+    parallel_for(chunks.size(), [&](size_t i) {
+        auto& reader = chunks[i].first;
+        auto is_last = (i == chunks.size() - 1);
+        auto stop = is_last ? data->size() : chunks[i + 1].second;
+        try {
+            reader->file_.seekpos(chunks[i].second);
+            auto next = optional<uint64_t>(nullopt);
+            auto finished = false;
+            while (!reader->file_.eof() && reader->file_.tellpos() < stop) {
+                auto position = reader->forward();
+                if (!position) {
+                    finished = true;
+                    break;
+                }
+                if (*position >= stop) {
+                    next = position;
+                    break;
+                }
+                positions[i].push_back(position.value());
+            }
+
+            if (is_last) {
+                valid[i] = true;
+            } else {
+                // the next chunk must start exactly where this one ended,
+                // otherwise the next chunk start was not a real step
+                auto end = next ? *next : reader->file_.tellpos();
+                valid[i] = !finished && end == stop;
+            }
+        } catch (const Error&) {
+            // invalid start position or invalid file. In the latter case,
+            // serial scanning will report the error with the right context
+            valid[i] = false;
+        }
+    });
+
+    for (auto is_valid: valid) {
+        if (!is_valid) {
+            return false;
+        }
+    }
+
+    for (auto& chunk_positions: positions) {
+        steps_positions_.insert(steps_positions_.end(), chunk_positions.begin(), chunk_positions.end());
+    }
+
+    eof_found_ = true;
+    if (!steps_positions_.empty()) {
+        file_.seekpos(steps_positions_[0]);
+    }
+    return true;
+}
+
 void TextFormat::scan_all() {
     if (eof_found_) {
         return;
     }
 
+    if (scan_all_parallel()) {
+        return;
+    }
+
     optional<TextFile> tmp_read_file = nullopt;
     if (file_.mode() == File::Mode::APPEND && file_.compression() == File::Compression::GZIP) {
         tmp_read_file = TextFile(file_.path(), File::Mode::READ, file_.compression());
@@ -135,6 +282,106 @@ void TextFormat::read_step(size_t step, Frame& frame) {
     read_next(frame);
 }
 
+void TextFormat::read_steps(size_t start, std::vector<Frame>& frames) {
+    if (!read_steps_parallel(start, frames)) {
+        Format::read_steps(start, frames);
+    }
+}
+
+bool TextFormat::read_steps_parallel(size_t start, std::vector<Frame>& frames) {
+    const auto& data = file_.contiguous();
+    if (!data || file_.mode() != File::READ || frames.size() < 2) {
+        return false;
+    }
+
+    if (start + frames.size() > steps_positions_.size()) {
+        scan_all();
+        if (start + frames.size() > steps_positions_.size()) {
+            // let `read_step` report the error
+            return false;
+        }
+    }
+
+    auto memory = std::make_shared<MemoryBuffer>(data->data(), data->size());
+    if (!this->parallel_reader(memory)) {
+        return false;
+    }
+
+    auto initial_steps = std::vector<size_t>();
+    initial_steps.reserve(frames.size());
+    for (const auto& frame: frames) {
+        initial_steps.push_back(frame.step());
+    }
+
+    // warnings are collected while reading, and only sent if all the steps
+    // are read successfully, in the same order as serial reading. Otherwise,
+    // the serial reading below sends them again.
+    auto first_warnings = std::vector<std::string>();
+    size_t first = 0;
+    if (start == 0) {
+        // the first step can contain header records applying to all the
+        // following steps (such as secondary structure in PDB files). Read
+        // it serially with this reader before creating the parallel readers,
+        // so they start from the corresponding state.
+        auto collector = WarningCollector();
+        file_.seekpos(steps_positions_[0]);
+        read_next(frames[0]);
+        first_warnings = collector.take();
+        first = 1;
+    }
+
+    // read contiguous groups of steps, each group using a single reader.
+    // Using more groups than threads helps balancing frames of different
+    // sizes between threads.
+    auto count = frames.size() - first;
+    auto n_groups = std::min(count, 4 * parallel_threads());
+    auto readers = std::vector<std::unique_ptr<TextFormat>>(n_groups);
+
+    // did reading fail in each group?
+    auto failures = std::vector<char>(n_groups, 0);
+    auto warnings = std::vector<std::vector<std::string>>(n_groups);
+    parallel_for(n_groups, [&](size_t group) {
+        auto collector = WarningCollector();
+        auto& reader = readers[group];
+        reader = this->parallel_reader(memory);
+
+        auto begin = first + group * count / n_groups;
+        auto end = first + (group + 1) * count / n_groups;
+        for (auto i = begin; i < end; i++) {
+            try {
+                reader->file_.seekpos(steps_positions_[start + i]);
+                reader->read_next(frames[i]);
+            } catch (const Error&) {
+                failures[group] = 1;
+                break;
+            }
+        }
+        warnings[group] = collector.take();
+    });
+
+    if (std::any_of(failures.begin(), failures.end(), [](char failed) { return failed; })) {
+        // reset the frames and read them again serially, to get the same
+        // error (with the right context) as serial reading
+        for (size_t i = 0; i < frames.size(); i++) {
+            frames[i] = Frame();
+            frames[i].set_step(initial_steps[i]);
+        }
+        return false;
+    }
+
+    for (const auto& message: first_warnings) {
+        send_warning(message);
+    }
+    for (const auto& group: warnings) {
+        for (const auto& message: group) {
+            send_warning(message);
+        }
+    }
+
+    step_ = start + frames.size() - 1;
+    return true;
+}
+
 void TextFormat::read(Frame& frame) {
     file_.seekpos(steps_positions_[step_]);
     ++step_;
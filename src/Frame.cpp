@@ -3,22 +3,29 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
 #include <iterator>
+#include <array>
 #include <algorithm>
 #include <unordered_map>
 
 #include "chemfiles/types.hpp"
 #include "chemfiles/error_fmt.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
 
 #include "chemfiles/Atom.hpp"
+#include "chemfiles/Residue.hpp"
+#include "chemfiles/Property.hpp"
 #include "chemfiles/Topology.hpp"
 #include "chemfiles/UnitCell.hpp"
 #include "chemfiles/Connectivity.hpp"
+#include "chemfiles/Selection.hpp"
 
 #include "chemfiles/Frame.hpp"
 
@@ -27,6 +34,14 @@ using namespace chemfiles;
 // get radius compatible with VMD bond guessing algorithm
 static optional<double> guess_bonds_radius(const Atom& atom);
 
+// find all pairs of atoms `i < j` at a distance `d` (using periodic boundary
+// conditions) such that `0.03 < d < 0.6 * (radii[i] + radii[j])` and
+// `d < cutoff`
+static std::vector<Bond> find_bonded_pairs(
+    const UnitCell& cell, const std::vector<Vector3D>& positions,
+    const std::vector<double>& radii, double cutoff
+);
+
 Frame::Frame(UnitCell cell): cell_(std::move(cell)) {} // NOLINT: std::move for trivially copyable type
 
 size_t Frame::size() const {
@@ -62,63 +77,51 @@ void Frame::add_velocities() {
 void Frame::guess_bonds() {
     topology_.clear_bonds();
     // This bond guessing algorithm comes from VMD
+    auto radii = std::vector<double>();
+    radii.reserve(size());
+    // the radius only depends on the atomic type, so we only look it up once
+    // for each type
+    auto radii_cache = std::unordered_map<std::string, optional<double>>();
     auto cutoff = 0.833;
     for (size_t i = 0; i < size(); i++) {
-        auto rad = guess_bonds_radius(topology_[i]).value_or(0);
-        cutoff = std::max(cutoff, rad);
-    }
-    cutoff = 1.2 * cutoff;
+        const auto& atom = topology_[i];
+        auto it = radii_cache.find(atom.type());
+        if (it == radii_cache.end()) {
+            it = radii_cache.emplace(atom.type(), guess_bonds_radius(atom)).first;
+        }
 
-    for (size_t i = 0; i < size(); i++) {
-        auto i_radius = guess_bonds_radius(topology_[i]);
-        if (!i_radius) {
+        if (!it->second) {
             throw error(
-                "missing Van der Waals radius for '{}'", topology_[i].type()
+                "missing Van der Waals radius for '{}'", atom.type()
             );
         }
-        for (size_t j = i + 1; j < size(); j++) {
-            auto j_radius = guess_bonds_radius(topology_[j]);
-            if (!j_radius) {
-                throw error(
-                    "missing Van der Waals radius for '{}'", topology_[j].type()
-                );
-            }
-            auto d = distance(i, j);
-            auto radii = i_radius.value() + j_radius.value();
-            if (0.03 < d && d < 0.6 * radii && d < cutoff) {
-                topology_.add_bond(i, j);
-            }
-        }
+        radii.push_back(it->second.value());
+        cutoff = std::max(cutoff, it->second.value());
     }
+    cutoff = 1.2 * cutoff;
+
+    auto guessed = find_bonded_pairs(cell_, positions_, radii, cutoff);
 
-    auto bonds = topology().bonds();
-    auto to_remove = std::vector<Bond>();
     // We need to remove bonds between hydrogen atoms which are bonded more than
     // once
-    for (auto& bond : bonds) {
+    auto bonds_count = std::vector<size_t>(size(), 0);
+    for (const auto& bond: guessed) {
+        bonds_count[bond[0]] += 1;
+        bonds_count[bond[1]] += 1;
+    }
+
+    auto is_hydrogen = [&](size_t i) {
+        return topology_[i].type() == "H";
+    };
+    auto removed = std::remove_if(guessed.begin(), guessed.end(), [&](const Bond& bond) {
         auto i = bond[0];
         auto j = bond[1];
-        if (topology_[i].type() != "H") {
-            continue;
-        }
-        if (topology_[j].type() != "H") {
-            continue;
-        }
-
-        auto nbonds = std::count_if(
-            std::begin(bonds), std::end(bonds), [=](const Bond& b) {
-                return b[0] == i || b[0] == j || b[1] == i || b[1] == j;
-            });
-        assert(nbonds >= 1);
-
-        if (nbonds != 1) {
-            to_remove.push_back(bond);
-        }
-    }
+        // the bond itself is counted twice
+        return is_hydrogen(i) && is_hydrogen(j) && bonds_count[i] + bonds_count[j] != 2;
+    });
+    guessed.erase(removed, guessed.end());
 
-    for (auto& bond : to_remove) {
-        topology_.remove_bond(bond[0], bond[1]);
-    }
+    topology_.add_bonds(guessed);
 }
 
 void Frame::set_topology(Topology topology) {
@@ -148,14 +151,125 @@ void Frame::remove(size_t i) {
             size(), i
         );
     }
-    topology_.remove(i);
-    positions_.erase(positions_.begin() + static_cast<std::ptrdiff_t>(i));
+    this->remove(span<const size_t>(i));
+}
+
+void Frame::remove(span<const size_t> indexes) {
+    auto removed = std::vector<bool>(size(), false);
+    for (auto i: indexes) {
+        if (i >= size()) {
+            throw out_of_bounds(
+                "out of bounds atomic index in `Frame::remove`: we have {} atoms, "
+                "but the index is {}",
+                size(), i
+            );
+        }
+        removed[i] = true;
+    }
+
+    topology_.remove(indexes);
+
+    auto compact = [&removed](std::vector<Vector3D>& values) {
+        size_t count = 0;
+        for (size_t i = 0; i < values.size(); i++) {
+            if (!removed[i]) {
+                values[count++] = values[i];
+            }
+        }
+        values.resize(count);
+    };
+    compact(positions_);
     if (velocities_) {
-        velocities_->erase(velocities_->begin() + static_cast<std::ptrdiff_t>(i));
+        compact(*velocities_);
     }
     assert(size() == topology_.size());
 }
 
+void Frame::keep(const Selection& selection) {
+    auto kept = std::vector<bool>(size(), false);
+    for (auto i: selection.list(*this)) {
+        kept[i] = true;
+    }
+
+    auto removed = std::vector<size_t>();
+    for (size_t i = 0; i < size(); i++) {
+        if (!kept[i]) {
+            removed.push_back(i);
+        }
+    }
+    this->remove(removed);
+}
+
+Frame Frame::extract(span<const size_t> indexes) const {
+    // new index of all atoms, or SIZE_MAX for atoms not in the new frame
+    auto new_indexes = std::vector<size_t>(size(), SIZE_MAX);
+    for (size_t i = 0; i < indexes.size(); i++) {
+        auto index = indexes[i];
+        if (index >= size()) {
+            throw out_of_bounds(
+                "out of bounds atomic index in `Frame::extract`: we have {} atoms, "
+                "but the index is {}",
+                size(), index
+            );
+        }
+        if (new_indexes[index] != SIZE_MAX) {
+            throw error("atomic index {} is present multiple times in `Frame::extract`", index);
+        }
+        new_indexes[index] = i;
+    }
+
+    auto frame = Frame(cell_);
+    frame.step_ = step_;
+    frame.properties_ = properties_;
+
+    frame.positions_.reserve(indexes.size());
+    frame.topology_.reserve(indexes.size());
+    for (auto index: indexes) {
+        frame.positions_.push_back(positions_[index]);
+        frame.topology_.add_atom(topology_[index]);
+    }
+
+    if (velocities_) {
+        frame.velocities_ = std::vector<Vector3D>();
+        frame.velocities_->reserve(indexes.size());
+        for (auto index: indexes) {
+            frame.velocities_->push_back((*velocities_)[index]);
+        }
+    }
+
+    const auto& bonds = topology_.bonds();
+    const auto& bond_orders = topology_.bond_orders();
+    auto new_bonds = std::vector<Bond>();
+    auto new_bond_orders = std::vector<Bond::BondOrder>();
+    for (size_t i = 0; i < bonds.size(); i++) {
+        auto first = new_indexes[bonds[i][0]];
+        auto second = new_indexes[bonds[i][1]];
+        if (first != SIZE_MAX && second != SIZE_MAX) {
+            new_bonds.emplace_back(first, second);
+            new_bond_orders.push_back(bond_orders[i]);
+        }
+    }
+    frame.topology_.add_bonds(new_bonds, new_bond_orders);
+
+    for (const auto& residue: topology_.residues()) {
+        auto new_residue = residue.id() ? Residue(residue.name(), *residue.id()) : Residue(residue.name());
+        for (auto atom: residue) {
+            if (atom < new_indexes.size() && new_indexes[atom] != SIZE_MAX) {
+                new_residue.add_atom(new_indexes[atom]);
+            }
+        }
+
+        if (new_residue.size() != 0) {
+            for (const auto& property: residue.properties()) {
+                new_residue.set(property.first, property.second);
+            }
+            frame.topology_.add_residue(std::move(new_residue));
+        }
+    }
+
+    return frame;
+}
+
 double Frame::distance(size_t i, size_t j) const {
     if (i >= size() || j >= size()) {
         throw out_of_bounds(
@@ -246,3 +360,248 @@ optional<double> guess_bonds_radius(const Atom& atom) {
         return atom.vdw_radius();
     }
 }
+
+namespace {
+/// Spatial grid used to find the pairs of atoms closer than a given cutoff.
+/// The atoms are sorted in cells which are wider than the cutoff in all
+/// directions, so two atoms closer than the cutoff are always in the same cell
+/// or in neighboring cells. For periodic unit cells, the grid is built in
+/// fractional coordinates, and neighboring cells wrap around the grid.
+class CellList {
+public:
+    CellList(const UnitCell& cell, const std::vector<Vector3D>& positions, double cutoff);
+
+    /// Get the number of cells in this grid
+    size_t size() const {
+        return offsets_.size() - 1;
+    }
+
+    /// Get the indexes of the atoms in the given `cell`
+    span<const size_t> atoms(size_t cell) const {
+        return {atoms_.data() + offsets_[cell], atoms_.data() + offsets_[cell + 1]};
+    }
+
+    /// Set `neighbors` to the list of unique cells neighboring the given
+    /// `cell`, including the `cell` itself
+    void neighbors(size_t cell, std::vector<size_t>& neighbors) const;
+
+private:
+    /// Number of cells along each direction
+    std::array<size_t, 3> n_cells_ = {{1, 1, 1}};
+    /// Does the grid wrap around in all directions?
+    bool periodic_ = false;
+    /// The atoms in the cell `c` are `atoms_[offsets_[c]]` to
+    /// `atoms_[offsets_[c + 1] - 1]`
+    std::vector<size_t> offsets_;
+    std::vector<size_t> atoms_;
+};
+}
+
+CellList::CellList(const UnitCell& cell, const std::vector<Vector3D>& positions, double cutoff) {
+    // fractional coordinates of the atoms in the grid, in [0, 1]
+    auto fractional = std::vector<Vector3D>(positions.size());
+    // width of the grid along each direction, i.e. the distance between
+    // opposite faces of the grid
+    auto widths = Vector3D();
+
+    if (cell.shape() == UnitCell::INFINITE) {
+        // use the bounding box of the atoms
+        auto min = Vector3D(HUGE_VAL, HUGE_VAL, HUGE_VAL);
+        auto max = Vector3D(-HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+        for (const auto& position: positions) {
+            if (!std::isfinite(position[0]) || !std::isfinite(position[1]) || !std::isfinite(position[2])) {
+                continue;
+            }
+            for (size_t k = 0; k < 3; k++) {
+                min[k] = std::min(min[k], position[k]);
+                max[k] = std::max(max[k], position[k]);
+            }
+        }
+
+        for (size_t k = 0; k < 3; k++) {
+            widths[k] = max[k] > min[k] ? max[k] - min[k] : 0.0;
+        }
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (size_t k = 0; k < 3; k++) {
+                fractional[i][k] = widths[k] > 0 ? (positions[i][k] - min[k]) / widths[k] : 0.0;
+            }
+        }
+    } else if (!private_details::is_roughly_zero(cell.volume())) {
+        periodic_ = true;
+        auto matrix = cell.matrix();
+        auto a = Vector3D(matrix[0][0], matrix[1][0], matrix[2][0]);
+        auto b = Vector3D(matrix[0][1], matrix[1][1], matrix[2][1]);
+        auto c = Vector3D(matrix[0][2], matrix[1][2], matrix[2][2]);
+        auto volume = cell.volume();
+        widths = Vector3D(
+            volume / cross(b, c).norm(),
+            volume / cross(c, a).norm(),
+            volume / cross(a, b).norm()
+        );
+
+        auto inverse = matrix.invert();
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto position = inverse * positions[i];
+            for (size_t k = 0; k < 3; k++) {
+                fractional[i][k] = position[k] - std::floor(position[k]);
+            }
+        }
+    } else {
+        // degenerated periodic cell, put all atoms in a single cell
+        periodic_ = true;
+    }
+
+    // use cells slightly larger than the cutoff to be safe against rounding
+    // errors in the fractional coordinates
+    auto cell_size = 1.0001 * cutoff;
+    for (size_t k = 0; k < 3; k++) {
+        auto count = widths[k] / cell_size;
+        if (count >= 2) {
+            n_cells_[k] = static_cast<size_t>(std::min(count, 1e6));
+        }
+    }
+
+    // for sparse systems, limit the number of (mostly empty) cells by making
+    // them larger
+    auto max_cells = 2 * positions.size() + 1;
+    while (n_cells_[0] * n_cells_[1] * n_cells_[2] > max_cells) {
+        auto largest = std::max_element(n_cells_.begin(), n_cells_.end());
+        *largest /= 2;
+    }
+
+    // sort the atoms in the cells, using a counting sort
+    auto n_cells = n_cells_[0] * n_cells_[1] * n_cells_[2];
+    auto atom_cells = std::vector<size_t>(positions.size(), SIZE_MAX);
+    offsets_.resize(n_cells + 1, 0);
+    for (size_t i = 0; i < positions.size(); i++) {
+        const auto& position = positions[i];
+        const auto& f = fractional[i];
+        // atoms at non-finite positions can not be bonded to anything
+        if (!std::isfinite(position[0]) || !std::isfinite(position[1]) || !std::isfinite(position[2]) ||
+            !std::isfinite(f[0]) || !std::isfinite(f[1]) || !std::isfinite(f[2])) {
+            continue;
+        }
+
+        auto x = std::min(static_cast<size_t>(f[0] * static_cast<double>(n_cells_[0])), n_cells_[0] - 1);
+        auto y = std::min(static_cast<size_t>(f[1] * static_cast<double>(n_cells_[1])), n_cells_[1] - 1);
+        auto z = std::min(static_cast<size_t>(f[2] * static_cast<double>(n_cells_[2])), n_cells_[2] - 1);
+        atom_cells[i] = (x * n_cells_[1] + y) * n_cells_[2] + z;
+        offsets_[atom_cells[i] + 1] += 1;
+    }
+
+    for (size_t cell_id = 0; cell_id < n_cells; cell_id++) {
+        offsets_[cell_id + 1] += offsets_[cell_id];
+    }
+
+    atoms_.resize(offsets_[n_cells]);
+    auto next = std::vector<size_t>(offsets_.begin(), offsets_.end() - 1);
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (atom_cells[i] != SIZE_MAX) {
+            atoms_[next[atom_cells[i]]++] = i;
+        }
+    }
+}
+
+void CellList::neighbors(size_t cell, std::vector<size_t>& neighbors) const {
+    neighbors.clear();
+    auto index = std::array<size_t, 3>{{
+        cell / (n_cells_[1] * n_cells_[2]),
+        (cell / n_cells_[2]) % n_cells_[1],
+        cell % n_cells_[2],
+    }};
+
+    // get the index of the neighbor of `index` at `delta` along the direction
+    // `k`, or `SIZE_MAX` if there is no such neighbor
+    auto shift = [&](size_t k, int delta) {
+        auto n = n_cells_[k];
+        if (delta < 0 && index[k] == 0) {
+            return periodic_ ? n - 1 : SIZE_MAX;
+        } else if (delta > 0 && index[k] == n - 1) {
+            return periodic_ ? 0 : SIZE_MAX;
+        } else {
+            return static_cast<size_t>(static_cast<int64_t>(index[k]) + delta);
+        }
+    };
+
+    for (int dx = -1; dx <= 1; dx++) {
+        auto x = shift(0, dx);
+        if (x == SIZE_MAX) {
+            continue;
+        }
+        for (int dy = -1; dy <= 1; dy++) {
+            auto y = shift(1, dy);
+            if (y == SIZE_MAX) {
+                continue;
+            }
+            for (int dz = -1; dz <= 1; dz++) {
+                auto z = shift(2, dz);
+                if (z == SIZE_MAX) {
+                    continue;
+                }
+                neighbors.push_back((x * n_cells_[1] + y) * n_cells_[2] + z);
+            }
+        }
+    }
+
+    // with less than 3 cells in one direction, the same neighbor can be
+    // found multiple times
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+/// Number of cells of the `CellList` handled together when guessing bonds in
+/// parallel
+static constexpr size_t GUESS_BONDS_CELLS_PER_TASK = 256;
+
+std::vector<Bond> find_bonded_pairs(
+    const UnitCell& cell, const std::vector<Vector3D>& positions,
+    const std::vector<double>& radii, double cutoff
+) {
+    auto cells = CellList(cell, positions, cutoff);
+
+    auto n_tasks = (cells.size() + GUESS_BONDS_CELLS_PER_TASK - 1) / GUESS_BONDS_CELLS_PER_TASK;
+    auto tasks_bonds = std::vector<std::vector<Bond>>(n_tasks);
+    parallel_for(n_tasks, [&](size_t task) {
+        auto& bonds = tasks_bonds[task];
+        auto neighbors = std::vector<size_t>();
+
+        auto start = task * GUESS_BONDS_CELLS_PER_TASK;
+        auto stop = std::min(start + GUESS_BONDS_CELLS_PER_TASK, cells.size());
+        for (auto current = start; current < stop; current++) {
+            auto atoms = cells.atoms(current);
+            if (atoms.empty()) {
+                continue;
+            }
+
+            cells.neighbors(current, neighbors);
+            for (auto i: atoms) {
+                for (auto other: neighbors) {
+                    for (auto j: cells.atoms(other)) {
+                        // only check each pair once
+                        if (j <= i) {
+                            continue;
+                        }
+
+                        auto d = cell.wrap(positions[i] - positions[j]).norm();
+                        auto sum = radii[i] + radii[j];
+                        if (0.03 < d && d < 0.6 * sum && d < cutoff) {
+                            bonds.emplace_back(i, j);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    auto bonds = std::vector<Bond>();
+    size_t count = 0;
+    for (const auto& task_bonds: tasks_bonds) {
+        count += task_bonds.size();
+    }
+    bonds.reserve(count);
+    for (const auto& task_bonds: tasks_bonds) {
+        bonds.insert(bonds.end(), task_bonds.begin(), task_bonds.end());
+    }
+    return bonds;
+}
@@ -5,9 +5,10 @@
 #include <cstdint>
 #include <string>
 #include <utility>
+#include <algorithm>
 
 #include "chemfiles/Residue.hpp"
-#include "chemfiles/error_fmt.hpp"
+#include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
 
 using namespace chemfiles;
@@ -24,19 +25,25 @@ bool Residue::contains(size_t i) const {
     return atoms_.find(i) != atoms_.end();
 }
 
-void Residue::remove(size_t i) {
-    auto iter = atoms_.find(i);
-    if (iter == atoms_.end()) {
-        // we should only remove an atom if we know it exists in the residue
-        throw error("invalid call to Residue::remove, this is a bug");
+void Residue::atoms_removed(span<const size_t> new_indexes) {
+    // new indexes are in the same order as the old ones, so the atoms stay
+    // sorted
+    auto& atoms = atoms_.as_mutable_vec();
+
+    // atoms outside of the topology are shifted by the number of removed
+    // atoms, which is only computed if there are such atoms
+    size_t removed = 0;
+    if (!atoms.empty() && atoms.back() >= new_indexes.size()) {
+        removed = static_cast<size_t>(std::count(new_indexes.begin(), new_indexes.end(), SIZE_MAX));
     }
-    atoms_.erase(iter);
-}
 
-void Residue::atom_removed(size_t i) {
-    for (auto& atom: atoms_.as_mutable_vec()) {
-        if (atom > i) {
-            atom -= 1;
+    size_t count = 0;
+    for (auto atom: atoms) {
+        if (atom >= new_indexes.size()) {
+            atoms[count++] = atom - removed;
+        } else if (new_indexes[atom] != SIZE_MAX) {
+            atoms[count++] = new_indexes[atom];
         }
     }
+    atoms.resize(count);
 }
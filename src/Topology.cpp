@@ -2,6 +2,7 @@
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
 #include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <vector>
 #include <unordered_map>
@@ -12,6 +13,7 @@
 #include "chemfiles/Residue.hpp"
 #include "chemfiles/Topology.hpp"
 #include "chemfiles/sorted_set.hpp"
+#include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
 
 using namespace chemfiles;
@@ -48,6 +50,27 @@ void Topology::add_bond(size_t atom_i, size_t atom_j, Bond::BondOrder bond_order
     connect_.add_bond(atom_i, atom_j, bond_order);
 }
 
+void Topology::add_bonds(span<const Bond> bonds, span<const Bond::BondOrder> bond_orders) {
+    if (!bond_orders.empty() && bond_orders.size() != bonds.size()) {
+        throw error(
+            "invalid size for bond orders in `Topology::add_bonds`: "
+            "we have {} bonds, but got {} bond orders",
+            bonds.size(), bond_orders.size()
+        );
+    }
+
+    for (const auto& bond: bonds) {
+        if (bond[1] >= size()) {
+            throw out_of_bounds(
+                "out of bounds atomic index in `Topology::add_bonds`: "
+                "we have {} atoms, but the bond indexes are {} and {}",
+                size(), bond[0], bond[1]
+            );
+        }
+    }
+    connect_.add_bonds(bonds, bond_orders);
+}
+
 void Topology::remove_bond(size_t atom_i, size_t atom_j) {
     if (atom_i >= size() || atom_j >= size()) {
         throw out_of_bounds(
@@ -75,30 +98,51 @@ void Topology::remove(size_t i) {
     if (i >= size()) {
         throw out_of_bounds(
             "out of bounds atomic index in `Topology::remove`: we have {} atoms, "
-            "but the indexe is {}",
+            "but the index is {}",
             size(), i
         );
     }
-    atoms_.erase(atoms_.begin() + static_cast<std::ptrdiff_t>(i));
+    this->remove(span<const size_t>(i));
+}
 
-    // Remove all bonds with the removed atom
-    auto bonds = connect_.bonds();
-    for (const auto& bond : bonds) {
-        if (bond[0] == i || bond[1] == i) {
-            connect_.remove_bond(bond[0], bond[1]);
+void Topology::remove(span<const size_t> indexes) {
+    // new index of all atoms, or SIZE_MAX for removed atoms
+    auto new_indexes = std::vector<size_t>(size(), 0);
+    for (auto i: indexes) {
+        if (i >= size()) {
+            throw out_of_bounds(
+                "out of bounds atomic index in `Topology::remove`: we have {} atoms, "
+                "but the index is {}",
+                size(), i
+            );
         }
-    }
-    // remove the atom from the corresponding residue
-    auto it = residue_mapping_.find(i);
-    if (it != residue_mapping_.end()) {
-        residues_[it->second].remove(i);
+        new_indexes[i] = SIZE_MAX;
     }
 
-    // shift all bonds indexes
-    connect_.atom_removed(i);
-    // shift all residue atoms
-    for (auto& res : residues_) {
-        res.atom_removed(i);
+    size_t count = 0;
+    for (size_t i = 0; i < atoms_.size(); i++) {
+        if (new_indexes[i] == SIZE_MAX) {
+            continue;
+        }
+        new_indexes[i] = count;
+        if (count != i) {
+            atoms_[count] = std::move(atoms_[i]);
+        }
+        count++;
+    }
+    atoms_.erase(atoms_.begin() + static_cast<std::ptrdiff_t>(count), atoms_.end());
+
+    // remove all bonds with the removed atoms and shift the others
+    connect_.atoms_removed(new_indexes);
+
+    // remove the atoms from the residues and shift the others
+    residue_mapping_.clear();
+    for (size_t res_index = 0; res_index < residues_.size(); res_index++) {
+        auto& residue = residues_[res_index];
+        residue.atoms_removed(new_indexes);
+        for (auto i: residue) {
+            residue_mapping_.emplace(i, res_index);
+        }
     }
 }
 
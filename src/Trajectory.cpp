@@ -3,11 +3,13 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 
 #include <functional>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "chemfiles/Trajectory.hpp"
 
@@ -21,6 +23,7 @@
 
 #include "chemfiles/misc.hpp"
 #include "chemfiles/utils.hpp"
+#include "chemfiles/parse.hpp"
 #include "chemfiles/error_fmt.hpp"
 #include "chemfiles/external/span.hpp"
 #include "chemfiles/external/optional.hpp"
@@ -30,28 +33,97 @@ using namespace chemfiles;
 #define SENTINEL_VALUE (static_cast<size_t>(-1))
 
 struct file_open_info {
-    static file_open_info parse(const std::string& path, std::string format);
+    static file_open_info parse(const std::string& path, std::string format, char mode = 'r');
     std::string format;
     File::Compression compression = File::DEFAULT;
+    /// Compression options, only used if `has_options` is true
+    CompressionOptions options;
+    bool has_options = false;
 };
 
-file_open_info file_open_info::parse(const std::string& path, std::string format) {
+/// Parse the value of a single compression option, from a string such as
+/// `level=9` in `"XYZ / XZ(level=9, threads=4)"`
+static void parse_compression_option(std::string_view option, CompressionOptions& options) {
+    auto equal = option.find('=');
+    if (equal == std::string_view::npos) {
+        throw file_error("invalid compression option '{}': expected 'name=value'", option);
+    }
+
+    auto name = trim(option.substr(0, equal));
+    auto value = trim(option.substr(equal + 1));
+    if (name != "level" && name != "extreme" && name != "block_size" && name != "threads") {
+        throw file_error(
+            "unknown compression option '{}', expected one of 'level', "
+            "'extreme', 'block_size' or 'threads'", name
+        );
+    }
+
+    try {
+        if (name == "level") {
+            auto level = parse<int64_t>(value);
+            if (level < 0 || level > 22) {
+                throw file_error("expected a value between 0 and 22");
+            }
+            options.level = static_cast<int>(level);
+        } else if (name == "extreme") {
+            if (value == "true") {
+                options.extreme = true;
+            } else if (value == "false") {
+                options.extreme = false;
+            } else {
+                throw file_error("expected 'true' or 'false'");
+            }
+        } else if (name == "block_size") {
+            options.block_size = parse<uint64_t>(value);
+            if (options.block_size == 0) {
+                throw file_error("the block size can not be 0");
+            }
+        } else {
+            options.threads = parse<size_t>(value);
+        }
+    } catch (const Error& e) {
+        throw file_error("invalid value '{}' for compression option '{}': {}", value, name, e.what());
+    }
+}
+
+file_open_info file_open_info::parse(const std::string& path, std::string format, char mode) {
     file_open_info info;
 
     if (format.empty()) {
-        format = guess_format(path);
+        format = guess_format(path, mode);
     }
 
     auto slash = format.find('/');
     if (slash != std::string::npos) {
         auto tmp = format.substr(slash + 1);
         auto compression = trim(tmp);
+
+        auto open = compression.find('(');
+        if (open != std::string_view::npos) {
+            if (compression.back() != ')') {
+                throw file_error(
+                    "invalid compression options in '{}': missing closing parenthesis",
+                    compression
+                );
+            }
+            auto options = compression.substr(open + 1, compression.size() - open - 2);
+            for (auto option: split(options, ',')) {
+                if (!trim(option).empty()) {
+                    parse_compression_option(option, info.options);
+                }
+            }
+            info.has_options = true;
+            compression = trim(compression.substr(0, open));
+        }
+
         if (compression == "GZ") {
             info.compression = File::GZIP;
         } else if (compression == "BZ2") {
             info.compression = File::BZIP2;
         } else if (compression == "XZ") {
             info.compression = File::LZMA;
+        } else if (compression == "ZST") {
+            info.compression = File::ZSTD;
         } else {
             throw file_error("unknown compression method '{}'", compression);
         }
@@ -82,10 +154,13 @@ static File::Mode char_to_file_mode(char mode) {
 Trajectory::Trajectory(std::string path, char mode, const std::string& format)
     : path_(std::move(path)), mode_(mode), format_(nullptr) {
 
-    auto info = file_open_info::parse(path_, format);
+    auto info = file_open_info::parse(path_, format, mode);
     auto format_creator = FormatFactory::get().by_name(info.format).creator;
 
     format_ = format_creator(path_, char_to_file_mode(mode), info.compression);
+    if (info.has_options) {
+        format_->set_compression_options(info.options);
+    }
 
     if (mode == 'r' || mode == 'a') {
         nsteps_ = format_->nsteps();
@@ -103,6 +178,9 @@ Trajectory Trajectory::memory_reader(const char* data, size_t size, const std::s
     auto buffer = std::make_shared<MemoryBuffer>(data, size);
     // if in-memory I/O is not supported, this call will throw
     auto format_impl = memory_creator(buffer, File::READ, info.compression);
+    if (info.has_options) {
+        format_impl->set_compression_options(info.options);
+    }
 
     return Trajectory('r', std::move(format_impl), std::move(buffer));
 }
@@ -118,6 +196,9 @@ Trajectory Trajectory::memory_writer(const std::string& format) {
     auto buffer = std::make_shared<MemoryBuffer>(8192);
     // if in-memory I/O is not supported, this call will throw
     auto format_impl = memory_creator(buffer, File::WRITE, info.compression);
+    if (info.has_options) {
+        format_impl->set_compression_options(info.options);
+    }
 
     return Trajectory('w', std::move(format_impl), std::move(buffer));
 }
@@ -211,6 +292,37 @@ Frame Trajectory::read_step(const size_t step) {
     return frame;
 }
 
+std::vector<Frame> Trajectory::read_steps(size_t start, size_t count) {
+    check_opened();
+    if (count == 0) {
+        return {};
+    }
+    if (count > SIZE_MAX - start) {
+        throw out_of_bounds(
+            "can not read {} steps starting at step {}: the last step is too big",
+            count, start
+        );
+    }
+    pre_read(start + count - 1);
+
+    auto frames = std::vector<Frame>(count);
+    for (auto& frame: frames) {
+        frame.set_step(SENTINEL_VALUE);
+    }
+    step_ = start + count - 1;
+    format_->read_steps(start, frames);
+
+    for (size_t i = 0; i < count; i++) {
+        // Don't override the step set by a format
+        if (frames[i].step() == SENTINEL_VALUE) {
+            frames[i].set_step(start + i);
+        }
+        post_read(frames[i]);
+    }
+
+    return frames;
+}
+
 void Trajectory::write(const Frame& frame) {
     check_opened();
     if (mode_ != File::WRITE && mode_ != File::APPEND) {
@@ -262,8 +374,12 @@ bool Trajectory::done() const {
 
 void Trajectory::close() {
     check_opened();
-    // delete the format and set the pointer to nullptr
-    format_.reset();
+    // take the format out of the trajectory first, so the trajectory is
+    // closed even if writing the remaining data fails below
+    auto format = std::move(format_);
+    // write any buffered data now, reporting errors to the caller instead of
+    // emitting warnings from the destructors
+    format->flush();
 }
 
 optional<span<const char>> Trajectory::memory_buffer() const {
@@ -271,5 +387,10 @@ optional<span<const char>> Trajectory::memory_buffer() const {
         return nullopt;
     }
 
+    if (format_) {
+        // compressed files keep some data in memory until they are flushed
+        format_->flush();
+    }
+
     return span<const char>(buffer_->data(), buffer_->data() + buffer_->size());
 }
@@ -0,0 +1,231 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <system_error>
+
+#include "chemfiles/error_fmt.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+
+using namespace chemfiles;
+
+BlockReader::BlockReader(size_t count, std::vector<uint64_t> sizes, Decompress decompress, size_t threads):
+    count_(count), offsets_({0}), decompress_(std::move(decompress)), current_(count),
+    threads_(std::max(threads, size_t(1))), window_(2 * threads_)
+{
+    if (!sizes.empty()) {
+        if (sizes.size() != count) {
+            throw file_error(
+                "internal error: expected {} block sizes, got {}", count, sizes.size()
+            );
+        }
+        offsets_.reserve(count + 1);
+        for (auto size: sizes) {
+            offsets_.push_back(offsets_.back() + size);
+        }
+        known_ = count;
+    }
+}
+
+BlockReader::~BlockReader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread: pool_) {
+        thread.join();
+    }
+}
+
+size_t BlockReader::next_pending() const {
+    auto end = std::min(count_, first_ + window_);
+    for (auto i = first_; i < end; i++) {
+        if (pending_.find(i) == pending_.end()) {
+            return i;
+        }
+    }
+    return count_;
+}
+
+void BlockReader::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        condition_.wait(lock, [this]() {
+            return stop_ || next_pending() != count_;
+        });
+        if (stop_) {
+            return;
+        }
+
+        auto i = next_pending();
+        // mark this block as being decompressed
+        pending_[i];
+        lock.unlock();
+
+        auto result = Pending();
+        try {
+            decompress_(i, result.data);
+        } catch (...) {
+            result.error = std::current_exception();
+        }
+        result.done = true;
+
+        lock.lock();
+        // the block might have been removed from `pending_` if the reader
+        // moved somewhere else in the meantime
+        auto it = pending_.find(i);
+        if (it != pending_.end() && !it->second.done) {
+            it->second = std::move(result);
+            condition_.notify_all();
+        }
+    }
+}
+
+void BlockReader::load_block(size_t i) {
+    assert(i < count_);
+    if (threads_ <= 1) {
+        decompress_(i, data_);
+    } else {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (pool_.empty()) {
+            for (size_t thread = 0; thread < threads_ - 1; thread++) {
+                try {
+                    pool_.emplace_back([this]() { this->worker(); });
+                } catch (const std::system_error&) {
+                    // could not create more threads, continue with the ones we have
+                    break;
+                }
+            }
+        }
+
+        // forget about blocks outside of the new read-ahead window
+        auto it = pending_.begin();
+        while (it != pending_.end()) {
+            if (it->first < i || it->first > i + window_) {
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        first_ = i;
+        if (pending_.find(i) == pending_.end()) {
+            // nobody started working on this block, decompress it ourself
+            // while the background threads work on the next ones
+            pending_[i];
+            lock.unlock();
+            condition_.notify_all();
+
+            auto result = Pending();
+            try {
+                decompress_(i, result.data);
+            } catch (...) {
+                result.error = std::current_exception();
+            }
+            result.done = true;
+
+            lock.lock();
+            auto& pending = pending_[i];
+            if (!pending.done) {
+                pending = std::move(result);
+            }
+        } else {
+            condition_.wait(lock, [this, i]() {
+                return pending_[i].done;
+            });
+        }
+
+        auto pending = std::move(pending_[i]);
+        pending_.erase(i);
+        first_ = i + 1;
+        lock.unlock();
+        condition_.notify_all();
+
+        if (pending.error) {
+            std::rethrow_exception(pending.error);
+        }
+        data_ = std::move(pending.data);
+    }
+
+    if (i == known_) {
+        offsets_.push_back(offsets_.back() + data_.size());
+        known_++;
+    } else if (i < known_ && offsets_[i + 1] - offsets_[i] != data_.size()) {
+        throw file_error(
+            "invalid compressed block: expected {} bytes of uncompressed data, got {}",
+            offsets_[i + 1] - offsets_[i], data_.size()
+        );
+    }
+
+    current_ = i;
+    position_ = 0;
+}
+
+size_t BlockReader::read(char* data, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        if (position_ == data_.size()) {
+            auto next = current_ == count_ ? 0 : current_ + 1;
+            if (next >= count_) {
+                break;
+            }
+            load_block(next);
+            continue;
+        }
+
+        auto size = std::min(count - done, data_.size() - position_);
+        std::memcpy(data + done, data_.data() + position_, size);
+        position_ += size;
+        done += size;
+    }
+    return done;
+}
+
+void BlockReader::seek(uint64_t position) {
+    if (count_ == 0) {
+        return;
+    }
+
+    // start from the last block with a known offset before `position`
+    size_t i = 0;
+    if (known_ != 0) {
+        auto starts_end = offsets_.begin() + static_cast<std::ptrdiff_t>(known_);
+        auto it = std::upper_bound(offsets_.begin(), starts_end, position);
+        i = static_cast<size_t>(it - offsets_.begin()) - 1;
+        if (position >= offsets_[i + 1]) {
+            // after the end of the known blocks
+            i = std::min(known_, count_ - 1);
+        }
+    }
+
+    // decompress the next blocks until we find the one containing `position`
+    while (true) {
+        if (current_ != i) {
+            load_block(i);
+        }
+
+        if (position < offsets_[i + 1] || i + 1 == count_) {
+            auto offset = std::min(position - offsets_[i], static_cast<uint64_t>(data_.size()));
+            position_ = static_cast<size_t>(offset);
+            return;
+        }
+        i++;
+    }
+}
+
+uint64_t BlockReader::tell() const {
+    if (current_ == count_) {
+        return 0;
+    }
+    return offsets_[current_] + position_;
+}
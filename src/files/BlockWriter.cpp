@@ -0,0 +1,166 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <system_error>
+
+#include "chemfiles/files/BlockWriter.hpp"
+
+using namespace chemfiles;
+
+BlockWriter::BlockWriter(size_t block_size, Compress compress, Write write, size_t threads):
+    block_size_(block_size), compress_(std::move(compress)), write_(std::move(write)),
+    threads_(std::max(threads, size_t(1))), window_(2 * threads_)
+{
+    assert(block_size_ != 0);
+    buffer_.reserve(block_size_);
+}
+
+BlockWriter::~BlockWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread: pool_) {
+        thread.join();
+    }
+}
+
+void BlockWriter::write(const char* data, size_t count) {
+    check_failure();
+    try {
+        while (count != 0) {
+            auto size = std::min(count, block_size_ - buffer_.size());
+            buffer_.insert(buffer_.end(), data, data + size);
+            data += size;
+            count -= size;
+
+            if (buffer_.size() == block_size_) {
+                submit();
+            }
+        }
+    } catch (...) {
+        failure_ = std::current_exception();
+        throw;
+    }
+}
+
+void BlockWriter::finish() {
+    check_failure();
+    try {
+        if (!buffer_.empty()) {
+            submit();
+        }
+        write_until(0);
+    } catch (...) {
+        failure_ = std::current_exception();
+        throw;
+    }
+}
+
+void BlockWriter::check_failure() const {
+    if (failure_) {
+        std::rethrow_exception(failure_);
+    }
+}
+
+void BlockWriter::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        condition_.wait(lock, [this]() {
+            return stop_ || next_job_ < submitted_;
+        });
+        if (stop_) {
+            return;
+        }
+
+        auto i = next_job_++;
+        // references to map elements stay valid when inserting new elements,
+        // and jobs are only removed once they are done
+        auto& job = jobs_[i];
+        lock.unlock();
+
+        auto output = std::vector<char>();
+        auto error = std::exception_ptr();
+        try {
+            compress_(i, job.input, output);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        job.output = std::move(output);
+        job.error = error;
+        job.done = true;
+        condition_.notify_all();
+    }
+}
+
+void BlockWriter::submit() {
+    auto input = std::move(buffer_);
+    buffer_ = std::vector<char>();
+    buffer_.reserve(block_size_);
+
+    if (threads_ > 1 && pool_.empty()) {
+        for (size_t thread = 0; thread < threads_ - 1; thread++) {
+            try {
+                pool_.emplace_back([this]() { this->worker(); });
+            } catch (const std::system_error&) {
+                // could not create more threads, continue with the ones we have
+                break;
+            }
+        }
+
+        if (pool_.empty()) {
+            // no background thread, compress everything in this thread
+            threads_ = 1;
+        }
+    }
+
+    if (threads_ <= 1) {
+        auto output = std::vector<char>();
+        compress_(submitted_, input, output);
+        write_(submitted_, output);
+        submitted_++;
+        written_++;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_[submitted_].input = std::move(input);
+        submitted_++;
+    }
+    condition_.notify_all();
+    write_until(window_);
+}
+
+void BlockWriter::write_until(size_t pending) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (submitted_ - written_ > pending) {
+        auto i = written_;
+        auto& job = jobs_[i];
+        condition_.wait(lock, [&job]() { return job.done; });
+
+        auto output = std::move(job.output);
+        auto error = job.error;
+        jobs_.erase(i);
+        written_++;
+        lock.unlock();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        write_(i, output);
+
+        lock.lock();
+    }
+}
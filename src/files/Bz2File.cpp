@@ -1,20 +1,24 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
-#include <cstdio>
 #include <cstring>
 #include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <memory>
 #include <cassert>
 #include <limits>
 #include <string>
 #include <vector>
-#include <functional>
+#include <utility>
+#include <algorithm>
 
 #include <bzlib.h>
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/error_fmt.hpp"
 
+#include "chemfiles/files/RawFile.hpp"
 #include "chemfiles/files/MemoryBuffer.hpp"
 #include "chemfiles/files/Bz2File.hpp"
 
@@ -57,180 +61,436 @@ static void check(int status) {
     }
 }
 
-Bz2File::Bz2File(const std::string& path, File::Mode mode): TextFileImpl(path), mode_(mode), buffer_(8192) {
-    std::memset(&stream_, 0, sizeof(bz_stream));
+/// Magic number at the start of each bzip2 block (BCD encoding of pi)
+static constexpr uint64_t BZ2_BLOCK_MAGIC = 0x314159265359;
+/// Magic number at the end of each bzip2 stream (BCD encoding of sqrt(pi))
+static constexpr uint64_t BZ2_END_MAGIC = 0x177245385090;
+static constexpr uint64_t BZ2_MAGIC_MASK = (uint64_t(1) << 48) - 1;
+
+namespace {
+/// A magic number found when scanning a bzip2 file. The 48-bit magic numbers
+/// can also appear by chance inside the compressed data of a block.
+struct Bz2Marker {
+    /// Offset in bits of the start of the magic number
+    uint64_t position;
+    /// Is this a block magic number, or an end of stream one?
+    bool block;
+    /// CRC stored right after the magic number, for the block or the whole
+    /// stream respectively
+    uint32_t crc;
+};
+}
 
-    const char* openmode = nullptr;
-    if (mode == File::READ) {
-        openmode = "rb";
-        stream_end_ = BZ2_bzDecompressEnd;
-        check(BZ2_bzDecompressInit(&stream_, 0, 0));
-    } else if (mode == File::WRITE) {
-        openmode = "wb";
-        stream_end_ = BZ2_bzCompressEnd;
-        check(BZ2_bzCompressInit(&stream_, 6, 0, 0));
-
-        stream_.next_out = buffer_.data();
-        stream_.avail_out = checked_cast(buffer_.size());
-    } else if (mode == File::APPEND) {
-        throw file_error("appending (open mode 'a') is not supported with bzip2 files");
+/// Check that the combined CRC of the blocks in each stream matches the CRC
+/// stored at the end of the stream. This fails if some of the `markers` do
+/// not correspond to actual blocks or stream ends.
+static bool check_bz2_streams_crc(const std::vector<Bz2Marker>& markers) {
+    uint32_t combined = 0;
+    for (const auto& marker: markers) {
+        if (marker.block) {
+            combined = ((combined << 1) | (combined >> 31)) ^ marker.crc;
+        } else {
+            if (combined != marker.crc) {
+                return false;
+            }
+            combined = 0;
+        }
     }
+    // the last stream might be truncated, this will give an error when
+    // decompressing the corresponding block
+    return true;
+}
 
-    file_ = std::fopen(path.c_str(), openmode);
-    if (file_ == nullptr) {
-        stream_end_(&stream_);
-        throw file_error("could not open the file at '{}'", path);
+/// Maximal size in bits of a single compressed block. bzip2 blocks contain at
+/// most 900 kB of data, and the compressed data is never much larger.
+static constexpr uint64_t BZ2_MAX_BLOCK_BITS = 8 * 1024 * 1024 * 8;
+
+/// Check if the bits between `block.start` and `block.end` in `file` contain
+/// a single complete bzip2 block, by decompressing it
+static bool is_valid_bz2_block(RawFile& file, const Bz2Block& block, std::vector<char>& output) {
+    auto first = block.start / 8;
+    auto last = (block.end + 7) / 8;
+    auto data = std::vector<char>(static_cast<size_t>(last - first));
+
+    file.clear();
+    file.seek(first);
+    if (file.read(data.data(), data.size()) != data.size()) {
+        return false;
+    }
+
+    try {
+        decompress_bz2_block(data.data(), static_cast<unsigned>(block.start % 8), block, output);
+        return true;
+    } catch (const FileError&) {
+        return false;
     }
 }
 
-Bz2File::~Bz2File() {
-    if (mode_ == File::WRITE) {
-        try {
-            compress_and_write(BZ_FINISH);
-        } catch (...) {
-            // not much we can do here
+/// Find the actual blocks from the candidate `markers` by decompressing
+/// them. Each block ends at the first following marker for which the
+/// decompression succeeds; markers inside the block are skipped.
+static std::vector<Bz2Block> resolve_bz2_blocks(RawFile& file, const std::vector<Bz2Marker>& markers, uint64_t bits) {
+    auto blocks = std::vector<Bz2Block>();
+    auto output = std::vector<char>();
+
+    size_t i = 0;
+    while (i < markers.size()) {
+        if (!markers[i].block) {
+            i++;
+            continue;
         }
-    }
 
-    stream_end_(&stream_);
-    if (file_ != nullptr) {
-        std::fclose(file_);
+        auto start = markers[i].position;
+        auto marker_end = [&](size_t j) {
+            return j < markers.size() ? markers[j].position : bits;
+        };
+
+        // if no candidate decompresses, the block is corrupted: use the
+        // next marker as the end, to give an error when reading it
+        auto next = i + 1;
+        for (auto j = i + 1; j <= markers.size() && marker_end(j) - start <= BZ2_MAX_BLOCK_BITS; j++) {
+            if (is_valid_bz2_block(file, {start, marker_end(j)}, output)) {
+                next = j;
+                break;
+            }
+        }
+
+        blocks.push_back({start, marker_end(next)});
+        i = next;
     }
+
+    return blocks;
 }
 
-size_t Bz2File::read(char* data, size_t count) {
-    stream_.next_out = data;
-    stream_.avail_out = checked_cast(count);
+std::vector<Bz2Block> chemfiles::find_bz2_blocks(RawFile& file) {
+    file.seek(0);
+    auto blocks = std::vector<Bz2Block>();
 
-    while (stream_.avail_out != 0) {
-        // read more compressed data from the file
-        if (stream_.avail_in == 0 && (std::feof(file_) == 0)) {
-            stream_.next_in = buffer_.data();
-            stream_.avail_in = checked_cast(std::fread(buffer_.data(), 1, buffer_.size(), file_));
+    char header[4] = {0};
+    auto header_size = file.read(header, 4);
+    if (header_size == 0) {
+        // empty file
+        return blocks;
+    }
+    if (header_size != 4 || header[0] != 'B' || header[1] != 'Z' || header[2] != 'h' || header[3] < '1' || header[3] > '9') {
+        check(BZ_DATA_ERROR_MAGIC);
+    }
+
+    auto markers = std::vector<Bz2Marker>();
+    // number of bits of the CRC following the last marker still to be read
+    unsigned crc_bits = 0;
+
+    auto buffer = std::vector<unsigned char>(64 * 1024);
+    uint64_t window = 0;
+    uint64_t bits = 4 * 8;
+    while (true) {
+        auto count = file.read(buffer.data(), buffer.size());
+        if (count == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            auto byte = buffer[i];
+            for (int bit = 7; bit >= 0; bit--) {
+                auto value = static_cast<unsigned>((byte >> bit) & 1);
+                window = ((window << 1) | value) & BZ2_MAGIC_MASK;
+                bits++;
+
+                if (crc_bits != 0) {
+                    auto& crc = markers.back().crc;
+                    crc = (crc << 1) | value;
+                    crc_bits--;
+                }
+
+                if (window == BZ2_BLOCK_MAGIC) {
+                    markers.push_back({bits - 48, true, 0});
+                    crc_bits = 32;
+                } else if (window == BZ2_END_MAGIC) {
+                    markers.push_back({bits - 48, false, 0});
+                    crc_bits = 32;
+                }
+            }
+        }
+    }
 
-            if (std::ferror(file_) != 0) {
-                throw file_error("IO error while reading bzip2 file");
+    if (check_bz2_streams_crc(markers)) {
+        // the end of each block is the start of the next block, or the end
+        // of stream marker. For truncated files, this will give an error
+        // when decompressing the last block.
+        for (size_t i = 0; i < markers.size(); i++) {
+            if (markers[i].block) {
+                auto end = i + 1 < markers.size() ? markers[i + 1].position : bits;
+                blocks.push_back({markers[i].position, end});
             }
         }
+    } else {
+        // some of the magic numbers are part of the compressed data
+        blocks = resolve_bz2_blocks(file, markers, bits);
+    }
+
+    file.clear();
+    return blocks;
+}
+
+namespace {
+/// Simple helper to write a stream of bits, most significant bit first
+class BitWriter {
+public:
+    BitWriter(std::vector<char>& output): output_(output) {}
+
+    /// Write the lower `count` bits of `value`, with `count` <= 32
+    void write(uint64_t value, unsigned count) {
+        accumulator_ = (accumulator_ << count) | (value & ((uint64_t(1) << count) - 1));
+        used_ += count;
+        while (used_ >= 8) {
+            used_ -= 8;
+            output_.push_back(static_cast<char>((accumulator_ >> used_) & 0xFF));
+        }
+    }
+
+    /// Write the remaining bits, padding the last byte with zeros
+    void flush() {
+        if (used_ != 0) {
+            write(0, 8 - used_);
+        }
+    }
+
+private:
+    std::vector<char>& output_;
+    uint64_t accumulator_ = 0;
+    unsigned used_ = 0;
+};
+}
+
+/// Call `function(value, count)` for all the bits in `data`, from `start` to
+/// `end`, with at most 8 bits at once
+template <class Function>
+static void for_each_bits(const char* data, uint64_t start, uint64_t end, Function function) {
+    while (start < end) {
+        auto byte = static_cast<unsigned char>(data[start / 8]);
+        auto available = 8 - static_cast<unsigned>(start % 8);
+        auto count = static_cast<unsigned>(std::min<uint64_t>(available, end - start));
+        function((byte >> (available - count)) & ((1u << count) - 1), count);
+        start += count;
+    }
+}
+
+void chemfiles::decompress_bz2_block(const char* data, unsigned shift, const Bz2Block& block, std::vector<char>& output) {
+    // Create a standalone bzip2 stream containing only this block, using the
+    // largest block size in the header.
+    auto stream_data = std::vector<char>{'B', 'Z', 'h', '9'};
+    stream_data.reserve(static_cast<size_t>((block.end - block.start) / 8 + 16));
+    auto writer = BitWriter(stream_data);
+
+    for_each_bits(data, shift, shift + block.end - block.start, [&](unsigned value, unsigned count) {
+        writer.write(value, count);
+    });
+    writer.write(BZ2_END_MAGIC >> 24, 24);
+    writer.write(BZ2_END_MAGIC & 0xFFFFFF, 24);
+
+    // the CRC of a stream with a single block is the CRC of this block,
+    // stored right after the block magic
+    uint64_t crc = 0;
+    for_each_bits(data, shift + 48, shift + 48 + 32, [&](unsigned value, unsigned count) {
+        crc = (crc << count) | value;
+    });
+    writer.write(crc, 32);
+    writer.flush();
+
+    bz_stream stream;
+    std::memset(&stream, 0, sizeof(bz_stream));
+    stream.next_in = stream_data.data();
+    stream.avail_in = checked_cast(stream_data.size());
+    check(BZ2_bzDecompressInit(&stream, 0, 0));
+
+    // blocks contain at most 900 kB before run-length encoding
+    output.resize(1024 * 1024);
+    size_t total_out = 0;
+    while (true) {
+        if (total_out == output.size()) {
+            output.resize(2 * output.size());
+        }
 
-        auto status = BZ2_bzDecompress(&stream_);
+        stream.next_out = output.data() + total_out;
+        stream.avail_out = checked_cast(output.size() - total_out);
+
+        auto status = BZ2_bzDecompress(&stream);
+        total_out = output.size() - stream.avail_out;
 
         if (status == BZ_STREAM_END) {
-            return count - stream_.avail_out;
-        } else {
-            // Check for error
+            break;
+        } else if (status != BZ_OK) {
+            BZ2_bzDecompressEnd(&stream);
             check(status);
+        } else if (stream.avail_in == 0 && stream.avail_out != 0) {
+            // the decompressor wants more data, but this is the whole block
+            BZ2_bzDecompressEnd(&stream);
+            check(BZ_DATA_ERROR);
         }
     }
-    return count;
+
+    BZ2_bzDecompressEnd(&stream);
+    output.resize(total_out);
 }
 
-void Bz2File::clear() noexcept {
-    std::clearerr(file_);
+/// Compress `input` to a full bzip2 stream in `output`, using the given
+/// compression `level`
+static void compress_stream(const std::vector<char>& input, int level, std::vector<char>& output) {
+    // maximal size of the compressed data, as documented by bzip2
+    output.resize(input.size() + input.size() / 100 + 600);
+    auto size = checked_cast(output.size());
+    // bzip2 refuses NULL input, even for empty data
+    char empty = '\0';
+    auto* source = input.empty() ? &empty : const_cast<char*>(input.data());
+    check(BZ2_bzBuffToBuffCompress(
+        output.data(), &size, source, checked_cast(input.size()), level, 0, 0
+    ));
+    output.resize(size);
 }
 
-void Bz2File::seek(uint64_t position) {
-    assert(mode_ == File::READ);
-    // Reset stream state
-    stream_end_(&stream_);
-    std::memset(&stream_, 0, sizeof(bz_stream));
-    check(BZ2_bzDecompressInit(&stream_, 0, 0));
+Bz2File::Bz2File(const std::string& path, File::Mode mode):
+    Bz2File(nullptr, path, mode) {}
 
-    // Dumb implementation, re-decompressing the file from the begining
-    std::fseek(file_, 0, SEEK_SET);
-    constexpr size_t BUFFSIZE = 4096;
-    char buffer[BUFFSIZE];
+Bz2File::Bz2File(std::shared_ptr<MemoryBuffer> memory, File::Mode mode):
+    Bz2File(std::move(memory), "<in memory>", mode) {}
 
-    while (position > BUFFSIZE) {
-        auto count = this->read(buffer, BUFFSIZE);
-        assert(count == BUFFSIZE);
-        position -= count;
+Bz2File::Bz2File(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode):
+    TextFileImpl(path), mode_(mode)
+{
+    if (mode == File::APPEND) {
+        throw file_error("appending (open mode 'a') is not supported with bzip2 files");
     }
 
-    auto count = this->read(buffer, static_cast<size_t>(position));
-    assert(count == position);
-    // silent "unused variable" when compiling without assertions
-    (void)count;
-}
+    if (memory) {
+        file_ = std::make_unique<RawFile>(std::move(memory), mode);
+    } else {
+        file_ = std::make_unique<RawFile>(path, mode);
+    }
 
-void Bz2File::write(const char* data, size_t count) {
-    stream_.next_in = const_cast<char*>(data);
-    stream_.avail_in = checked_cast(count);
-    compress_and_write(BZ_RUN);
+    if (mode == File::WRITE) {
+        create_writer();
+    }
 
-    auto actual = count - stream_.avail_in;
-    if (actual != count) {
-        throw file_error("could not write data to the file at '{}'", this->path());
+    if (mode == File::READ) {
+        blocks_ = find_bz2_blocks(*file_);
+        create_reader();
     }
 }
 
-void Bz2File::compress_and_write(int action) {
-    int status = BZ_OK;
-    do {
-        status = BZ2_bzCompress(&stream_, action);
-
-        if (stream_.avail_out == 0 || status == BZ_STREAM_END) {
-            auto size = buffer_.size() - stream_.avail_out;
-            auto written = std::fwrite(buffer_.data(), sizeof(uint8_t), size, file_);
-            if (written != size) {
-                throw file_error("error while writting data to bzip2 file");
+Bz2File::~Bz2File() {
+    if (mode_ == File::WRITE) {
+        try {
+            writer_->finish();
+            if (!stream_written_) {
+                // write an empty stream, to get a valid bzip2 file
+                auto output = std::vector<char>();
+                compress_stream(std::vector<char>(), level_, output);
+                write_output(output.data(), output.size());
             }
-
-            stream_.next_out = buffer_.data();
-            stream_.avail_out = checked_cast(buffer_.size());
+        } catch (...) {
+            // not much we can do here
         }
+    }
 
-        check(status);
+    // stop the background threads before closing the file
+    reader_.reset();
+    writer_.reset();
+}
 
-    } while (stream_.avail_in != 0 || (action == BZ_FINISH && status != BZ_STREAM_END));
+void Bz2File::create_writer() {
+    auto level = level_;
+    writer_ = std::make_unique<BlockWriter>(
+        static_cast<size_t>(level) * 100000,
+        [level](size_t, const std::vector<char>& input, std::vector<char>& output) {
+            compress_stream(input, level, output);
+        },
+        [this](size_t, const std::vector<char>& output) {
+            this->write_output(output.data(), output.size());
+        },
+        threads_
+    );
 }
 
-// Get the full, potentially 64-bits large, value for total_out from the low and
-// high 32-bits parts.
-static uint64_t full_total_out(const bz_stream& stream) {
-    uint64_t total_out_hi32 = static_cast<uint64_t>(stream.total_out_hi32) << 32;
-    return total_out_hi32 + stream.total_out_lo32;
+void Bz2File::create_reader() {
+    reader_ = std::make_unique<BlockReader>(
+        blocks_.size(), std::vector<uint64_t>(),
+        [this](size_t i, std::vector<char>& output) {
+            this->decompress_block(i, output);
+        },
+        threads_
+    );
 }
 
-MemoryBuffer chemfiles::decompress_bz2(const char* src, size_t size) {
-    // assume a 10% compression ratio, which should be plenty enough
-    // (typical ratio is around 15-20%)
-    auto output = MemoryBuffer(10 * size);
+void Bz2File::set_compression_options(const CompressionOptions& options) {
+    if (options.extreme) {
+        throw file_error("the 'extreme' compression option is only supported for xz compression");
+    }
+    if (options.block_size != 0) {
+        throw file_error("the 'block_size' compression option is only supported for xz and zstd compression");
+    }
+    if (options.level != -1 && (options.level < 1 || options.level > 9)) {
+        throw file_error("invalid compression level {} for bzip2, expected a value between 1 and 9", options.level);
+    }
 
-    bz_stream stream;
-    stream.next_in = const_cast<char*>(src);
-    stream.avail_in = checked_cast(size);
-    stream.bzalloc = nullptr;
-    stream.bzfree = nullptr;
-    check(BZ2_bzDecompressInit(&stream, 0, 0));
+    level_ = options.level == -1 ? DEFAULT_LEVEL : options.level;
+    threads_ = options.threads == 0 ? parallel_threads() : options.threads;
 
-    bool done = false;
-    do {
-        // if we need more space, resize the vector
-        auto total_out = full_total_out(stream);
-        if (total_out >= output.capacity()) {
-            output.reserve_extra(output.capacity());
+    if (mode_ == File::WRITE) {
+        // write any data already given to the previous writer with the
+        // previous options
+        writer_->finish();
+        create_writer();
+    } else {
+        auto position = reader_->tell();
+        create_reader();
+        reader_->seek(position);
+    }
+}
+
+void Bz2File::decompress_block(size_t i, std::vector<char>& output) {
+    const auto& block = blocks_[i];
+    auto first = block.start / 8;
+    auto last = (block.end + 7) / 8;
+
+    auto data = std::vector<char>(static_cast<size_t>(last - first));
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_->seek(first);
+        if (file_->read(data.data(), data.size()) != data.size()) {
+            throw file_error("bzip2: compressed file is truncated");
         }
+    }
 
-	    stream.next_out = output.data_mut() + total_out;
-        stream.avail_out = checked_cast(output.capacity() - total_out);
+    decompress_bz2_block(data.data(), static_cast<unsigned>(block.start % 8), block, output);
+}
 
-        auto status = BZ2_bzDecompress(&stream);
-        if (status == BZ_STREAM_END) {
-		    done = true;
-        } else if (status != BZ_OK) {
-		    BZ2_bzDecompressEnd(&stream);
-            check(status);
-	    }
-    } while (!done);
+size_t Bz2File::read(char* data, size_t count) {
+    return reader_->read(data, count);
+}
 
-    check(BZ2_bzDecompressEnd(&stream));
+void Bz2File::clear() noexcept {
+    file_->clear();
+}
+
+void Bz2File::seek(uint64_t position) {
+    assert(mode_ == File::READ);
+    reader_->seek(position);
+}
+
+void Bz2File::write(const char* data, size_t count) {
+    if (writer_ == nullptr) {
+        throw file_error("can not write to the file at '{}': it was opened in read mode", this->path());
+    }
+    writer_->write(data, count);
+}
+
+void Bz2File::write_output(const char* data, size_t count) {
+    file_->write(data, count);
+    stream_written_ = true;
+}
 
-    auto total_out = full_total_out(stream);
-    if (total_out >= output.capacity()) {
-        // make sure the buffer always contains a terminal NULL
-        output.reserve_extra(1);
+void Bz2File::flush() {
+    if (writer_) {
+        writer_->finish();
     }
-    output.set_size(checked_cast(total_out));
-    return output;
 }
@@ -2,8 +2,15 @@
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <limits>
+#include <mutex>
+#include <memory>
 #include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <exception>
 
 #define ZLIB_CONST
 #include <zconf.h>
@@ -11,8 +18,10 @@
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/error_fmt.hpp"
-#include "chemfiles/unreachable.hpp"
+#include "chemfiles/parallel.hpp"
+#include "chemfiles/warnings.hpp"
 
+#include "chemfiles/files/RawFile.hpp"
 #include "chemfiles/files/MemoryBuffer.hpp"
 #include "chemfiles/files/GzFile.hpp"
 
@@ -26,123 +35,555 @@ static unsigned checked_cast(size_t value) {
     }
 }
 
-GzFile::GzFile(const std::string& path, File::Mode mode): TextFileImpl(path) {
-    const char* openmode;
-    switch (mode) {
-    case File::READ:
-        openmode = "rb";
-        break;
-    case File::WRITE:
-        openmode = "wb7";
-        break;
-    case File::APPEND:
-        openmode = "ab7";
-        break;
-    default:
-        unreachable();
-    }
+/// Size of the buffer used to read compressed data from the file
+static constexpr size_t GZ_INPUT_BUFFER_SIZE = 64 * 1024;
+/// Maximal size of a deflate window
+static constexpr size_t GZ_WINDOW_SIZE = 32 * 1024;
+/// Size of the gzip trailer: CRC-32 and size of the uncompressed data
+static constexpr unsigned GZ_TRAILER_SIZE = 8;
+
+/// Size of the header of BGZF members
+static constexpr size_t BGZF_HEADER_SIZE = 18;
+
+static bool is_gzip_header(const Bytef* data) {
+    return data[0] == 0x1f && data[1] == 0x8b;
+}
+
+static bool is_bgzf_header(const Bytef* data) {
+    // gzip header with deflate compression, FEXTRA flag set, and 'BC' as the
+    // first extra subfield, with 2 bytes of data
+    return is_gzip_header(data) && data[2] == 8 && (data[3] & 4) != 0 &&
+           (data[10] | (data[11] << 8)) >= 6 && data[12] == 'B' && data[13] == 'C' &&
+           data[14] == 2 && data[15] == 0;
+}
+
+/// Empty BGZF member, used to mark the end of BGZF files
+static constexpr unsigned char BGZF_EOF[28] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+    0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
 
-    file_ = gzopen64(path.c_str(), openmode);
-    if (file_ == nullptr) {
-        throw file_error("could not open the file at '{}'", path);
+static void write_le(unsigned char* output, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        output[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xff);
     }
 }
 
-GzFile::~GzFile() {
-    if (file_ != nullptr) {
-        gzclose(file_);
+/// Compress `input` to a sequence of BGZF members containing at most
+/// `GzFile::BGZF_MEMBER_SIZE` bytes of uncompressed data, using the given
+/// compression `level`.
+static void compress_bgzf(const std::vector<char>& input, int level, std::vector<char>& output) {
+    // the header of a member, with the size of the member in the last two bytes
+    constexpr unsigned char HEADER[BGZF_HEADER_SIZE] = {
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x00, 0x00,
+    };
+    constexpr size_t MAX_MEMBER_SIZE = 64 * 1024;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // raw deflate data, the gzip header and trailer are written manually
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw file_error("error creating gz stream: {}", stream.msg);
     }
+
+    output.clear();
+    for (size_t start = 0; start < input.size(); start += GzFile::BGZF_MEMBER_SIZE) {
+        auto size = std::min(input.size() - start, GzFile::BGZF_MEMBER_SIZE);
+        const auto* data = reinterpret_cast<const Bytef*>(input.data() + start);
+
+        auto member_start = output.size();
+        output.resize(member_start + MAX_MEMBER_SIZE);
+        auto* member = reinterpret_cast<unsigned char*>(output.data() + member_start);
+        std::memcpy(member, HEADER, BGZF_HEADER_SIZE);
+
+        deflateReset(&stream);
+        stream.next_in = data;
+        stream.avail_in = static_cast<uInt>(size);
+        stream.next_out = member + BGZF_HEADER_SIZE;
+        stream.avail_out = static_cast<uInt>(MAX_MEMBER_SIZE - BGZF_HEADER_SIZE - GZ_TRAILER_SIZE);
+        auto compressed_size = static_cast<size_t>(0);
+        if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+            compressed_size = static_cast<size_t>(stream.total_out);
+        } else {
+            // the data does not compress well enough to fit in a member,
+            // store it in a single uncompressed deflate block instead
+            auto* block = member + BGZF_HEADER_SIZE;
+            block[0] = 0x01;
+            write_le(block + 1, static_cast<uint32_t>(size), 2);
+            write_le(block + 3, static_cast<uint32_t>(~size & 0xffff), 2);
+            std::memcpy(block + 5, data, size);
+            compressed_size = size + 5;
+        }
+
+        auto member_size = BGZF_HEADER_SIZE + compressed_size + GZ_TRAILER_SIZE;
+        write_le(member + 16, static_cast<uint32_t>(member_size - 1), 2);
+
+        auto* trailer = member + BGZF_HEADER_SIZE + compressed_size;
+        auto crc = crc32(0, data, static_cast<uInt>(size));
+        write_le(trailer, static_cast<uint32_t>(crc), 4);
+        write_le(trailer + 4, static_cast<uint32_t>(size), 4);
+
+        output.resize(member_start + member_size);
+    }
+
+    deflateEnd(&stream);
 }
 
-size_t GzFile::read(char* data, size_t count) {
-    auto read = gzread(file_, data, checked_cast(count));
-    const auto* error = check_error();
-    if (read == -1 || error != nullptr) {
-        throw file_error("error while reading gziped file: {}", error);
+/// Find all the members in a BGZF file, grouping them until the uncompressed
+/// size of the group reaches `GzFile::BGZF_GROUP_SIZE`. This returns an empty
+/// vector if the file is not a valid BGZF file.
+static std::vector<GzFile::Block> find_bgzf_blocks(RawFile& file) {
+    auto blocks = std::vector<GzFile::Block>();
+    auto group = GzFile::Block{0, 0, 0};
+
+    // each iteration reads the trailer of the previous member, and the
+    // header of the next one
+    unsigned char buffer[4 + BGZF_HEADER_SIZE];
+    file.seek(0);
+    auto read = file.read(buffer + 4, BGZF_HEADER_SIZE) + 4;
+    uint64_t offset = 0;
+    while (true) {
+        if (read == 4) {
+            // end of file
+            break;
+        }
+
+        const auto* header = buffer + 4;
+        if (read != sizeof(buffer) || !is_bgzf_header(header)) {
+            file.clear();
+            return {};
+        }
+
+        auto member_size = static_cast<uint64_t>(header[16] | (header[17] << 8)) + 1;
+        file.seek(offset + member_size - 4);
+        read = file.read(buffer, sizeof(buffer));
+        if (read < 4) {
+            // truncated file
+            file.clear();
+            return {};
+        }
+
+        auto uncompressed_size = static_cast<uint64_t>(buffer[0]) |
+                                 static_cast<uint64_t>(buffer[1]) << 8 |
+                                 static_cast<uint64_t>(buffer[2]) << 16 |
+                                 static_cast<uint64_t>(buffer[3]) << 24;
+
+        if (group.uncompressed_size != 0 && group.uncompressed_size + uncompressed_size > GzFile::BGZF_GROUP_SIZE) {
+            blocks.push_back(group);
+            group = GzFile::Block{offset, offset, 0};
+        }
+        offset += member_size;
+        group.end = offset;
+        group.uncompressed_size += uncompressed_size;
     }
-    return static_cast<size_t>(read);
+
+    if (group.end != group.start) {
+        blocks.push_back(group);
+    }
+
+    file.clear();
+    return blocks;
 }
 
-void GzFile::write(const char* data, size_t count) {
-    auto actual = gzwrite(file_, data, checked_cast(count));
-    const auto* error = check_error();
-    if (actual == 0 || error != nullptr) {
-        throw file_error("error while writting to gziped file: {}", error);
+GzFile::GzFile(const std::string& path, File::Mode mode):
+    GzFile(std::make_unique<RawFile>(path, mode), path, mode, /* allow_transparent */ true) {}
+
+GzFile::GzFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode):
+    GzFile(std::make_unique<RawFile>(std::move(memory), mode), "<in memory>", mode, /* allow_transparent */ false) {}
+
+GzFile::GzFile(std::unique_ptr<RawFile> file, const std::string& path, File::Mode mode, bool allow_transparent): TextFileImpl(path) {
+    if (mode != File::READ) {
+        output_ = std::move(file);
+        create_writer();
+        return;
     }
-    if (static_cast<size_t>(actual) != count) {
-        throw file_error("could not write data to the file at '{}'", this->path());
+
+    input_ = std::move(file);
+    buffer_.resize(GZ_INPUT_BUFFER_SIZE);
+    stream_ = std::make_unique<z_stream>();
+    stream_->next_in = buffer_.data();
+    stream_->avail_in = 0;
+    stream_->zalloc = nullptr;
+    stream_->zfree = nullptr;
+    stream_->opaque = nullptr;
+
+    // 15 (use the largest window possible) + 16 (expect a gzip header)
+    auto status = inflateInit2(stream_.get(), 15 + 16);
+    if (status != Z_OK) {
+        throw file_error("error creating gz stream: {}", stream_->msg);
+    }
+
+    if (!fill_input(2)) {
+        // empty file
+        end_of_data_ = true;
+    } else if (!is_gzip_header(stream_->next_in)) {
+        if (!allow_transparent) {
+            inflateEnd(stream_.get());
+            stream_.reset();
+            throw file_error("error while reading gziped file: incorrect header check");
+        }
+        // like gzread, read files without gzip header directly
+        transparent_ = true;
+        this->seek(0);
+    } else if (fill_input(BGZF_HEADER_SIZE) && is_bgzf_header(stream_->next_in)) {
+        blocks_ = find_bgzf_blocks(*input_);
+        if (blocks_.size() > 1) {
+            create_reader();
+        } else {
+            blocks_.clear();
+            restart();
+        }
     }
 }
 
-const char* GzFile::check_error() const {
-    int status = Z_OK;
-    const auto* message = gzerror(file_, &status);
-    return status == Z_OK ? nullptr : message;
+GzFile::~GzFile() {
+    if (writer_) {
+        try {
+            writer_->finish();
+            write_output(reinterpret_cast<const char*>(BGZF_EOF), sizeof(BGZF_EOF));
+        } catch (const std::exception& e) {
+            warning("gzip writer", "failed to write data when closing the file: {}", e.what());
+        }
+    }
+
+    // stop the background threads before closing the file
+    reader_.reset();
+    writer_.reset();
+
+    if (stream_) {
+        inflateEnd(stream_.get());
+    }
 }
 
-void GzFile::clear() noexcept {
-    gzclearerr(file_);
+void GzFile::create_writer() {
+    auto level = level_;
+    writer_ = std::make_unique<BlockWriter>(
+        16 * BGZF_MEMBER_SIZE,
+        [level](size_t, const std::vector<char>& input, std::vector<char>& output) {
+            compress_bgzf(input, level, output);
+        },
+        [this](size_t, const std::vector<char>& output) {
+            this->write_output(output.data(), output.size());
+        },
+        threads_
+    );
 }
 
-void GzFile::seek(uint64_t position) {
-    static_assert(
-        sizeof(uint64_t) == sizeof(z_off64_t),
-        "uint64_t and z_off64_t do not have the same size"
+void GzFile::create_reader() {
+    auto sizes = std::vector<uint64_t>();
+    sizes.reserve(blocks_.size());
+    for (const auto& block: blocks_) {
+        sizes.push_back(block.uncompressed_size);
+    }
+    reader_ = std::make_unique<BlockReader>(
+        blocks_.size(), std::move(sizes),
+        [this](size_t i, std::vector<char>& output) {
+            this->decompress_block(i, output);
+        },
+        threads_
     );
-    auto status = gzseek64(file_, static_cast<z_off64_t>(position), SEEK_SET);
-    if (status == -1) {
-        const auto* message = check_error();
-        throw file_error("error while seeking gziped file: {}", message);
+}
+
+void GzFile::set_compression_options(const CompressionOptions& options) {
+    if (options.extreme) {
+        throw file_error("the 'extreme' compression option is only supported for xz compression");
+    }
+    if (options.block_size != 0) {
+        throw file_error("the 'block_size' compression option is only supported for xz and zstd compression");
     }
+    if (options.level != -1 && (options.level < 0 || options.level > 9)) {
+        throw file_error("invalid compression level {} for gzip, expected a value between 0 and 9", options.level);
+    }
+
+    level_ = options.level == -1 ? DEFAULT_LEVEL : options.level;
+    threads_ = options.threads == 0 ? parallel_threads() : options.threads;
+
+    if (writer_) {
+        // write any data already given to the previous writer with the
+        // previous options
+        writer_->finish();
+        create_writer();
+    } else if (reader_) {
+        auto position = reader_->tell();
+        create_reader();
+        reader_->seek(position);
+    }
+}
+
+size_t GzFile::read(char* data, size_t count) {
+    if (input_ == nullptr) {
+        throw file_error("can not read the file at '{}': it was opened in write mode", this->path());
+    }
+
+    if (reader_) {
+        return reader_->read(data, count);
+    }
+
+    if (transparent_) {
+        return input_->read(data, count);
+    }
+
+    return inflate_data(reinterpret_cast<unsigned char*>(data), count);
 }
 
-MemoryBuffer chemfiles::decompress_gz(const char* src, size_t size) {
-    // assume a 10% compression ratio, which should be plenty enough
-    // (typical ratio is around 15-20%)
-    auto output = MemoryBuffer(10 * size);
+void GzFile::decompress_block(size_t i, std::vector<char>& output) {
+    const auto& block = blocks_[i];
+    auto input = std::vector<unsigned char>(static_cast<size_t>(block.end - block.start));
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        input_->seek(block.start);
+        if (input_->read(input.data(), input.size()) != input.size()) {
+            throw file_error("error while reading gziped file: unexpected end of file");
+        }
+    }
+
+    output.resize(static_cast<size_t>(block.uncompressed_size));
 
     z_stream stream;
-    stream.next_in = reinterpret_cast<const Bytef*>(src);
-    stream.avail_in = checked_cast(size);
-    stream.total_out = 0;
-    stream.zalloc = nullptr;
-    stream.zfree = nullptr;
-
-    // the second parameter is set to 15 (use the largest window possible) + 32
-    // (detect header and check between gzip or zlib header)
-    auto status = inflateInit2(&stream, 15 + 32);
-    if (status != Z_OK) {
-	    throw file_error("error creating gz stream: {}", stream.msg);
+    std::memset(&stream, 0, sizeof(stream));
+    stream.next_in = input.data();
+    stream.avail_in = checked_cast(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = checked_cast(output.size());
+
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        throw file_error("error creating gz stream: {}", stream.msg);
     }
 
-    bool done = false;
-    do {
-        // if we need more space, resize the vector
-        if (stream.total_out >= output.capacity()) {
-            output.reserve_extra(output.capacity());
+    while (true) {
+        auto status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            if (stream.avail_in == 0) {
+                break;
+            }
+            // go to the next member
+            status = inflateReset(&stream);
         }
 
-	    stream.next_out = reinterpret_cast<Bytef*>(output.data_mut() + stream.total_out);
-        stream.avail_out = checked_cast(output.capacity() - stream.total_out);
+        if (status != Z_OK) {
+            auto message = std::string(stream.msg != nullptr ? stream.msg : "unexpected end of file");
+            inflateEnd(&stream);
+            throw file_error("error while reading gziped file: {}", message);
+        }
+    }
+    inflateEnd(&stream);
+
+    if (stream.avail_out != 0) {
+        throw file_error("error while reading gziped file: invalid uncompressed size");
+    }
+}
+
+size_t GzFile::inflate_data(unsigned char* data, size_t count) {
+    auto& stream = *stream_;
+    stream.next_out = data;
+    stream.avail_out = checked_cast(count);
+
+    while (stream.avail_out != 0 && !end_of_data_) {
+        if (stream.avail_in == 0 && !fill_input(1)) {
+            throw file_error("error while reading gziped file: unexpected end of file");
+        }
+
+        auto before = stream.avail_out;
+        auto status = inflate(&stream, Z_BLOCK);
+        output_position_ += before - stream.avail_out;
 
-        status = inflate(&stream, Z_SYNC_FLUSH);
         if (status == Z_STREAM_END) {
-		    done = true;
-        } else if (status != Z_OK) {
-		    inflateEnd(&stream);
-            throw file_error("error inflating gziped memory: {}", stream.msg);
-	    }
-    } while (!done);
-
-    status = inflateEnd(&stream);
+            next_member();
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            throw file_error("error while reading gziped file: {}",
+                stream.msg != nullptr ? stream.msg : "unknown error"
+            );
+        } else if ((stream.data_type & 128) != 0 && (stream.data_type & 64) == 0) {
+            // we are at the end of a deflate block (and not the last one),
+            // record an access point if the previous one is far enough
+            auto last = index_.empty() ? 0 : index_.back().output;
+            if (output_position_ >= last + ACCESS_POINT_SPAN) {
+                auto point = GzAccessPoint();
+                point.output = output_position_;
+                point.input = input_position_ - stream.avail_in;
+                point.bits = stream.data_type & 7;
+                point.window.resize(GZ_WINDOW_SIZE);
+
+                uInt size = 0;
+                inflateGetDictionary(&stream, point.window.data(), &size);
+                point.window.resize(size);
+
+                index_.emplace_back(std::move(point));
+            }
+        }
+    }
+
+    return count - stream.avail_out;
+}
+
+bool GzFile::fill_input(size_t count) {
+    auto& stream = *stream_;
+    if (stream.avail_in >= count) {
+        return true;
+    }
+
+    // move the remaining data to the start of the buffer
+    if (stream.avail_in != 0 && stream.next_in != buffer_.data()) {
+        std::memmove(buffer_.data(), stream.next_in, stream.avail_in);
+    }
+    stream.next_in = buffer_.data();
+
+    while (stream.avail_in < count) {
+        auto* start = buffer_.data() + stream.avail_in;
+        auto read = input_->read(start, buffer_.size() - stream.avail_in);
+        if (read == 0) {
+            return false;
+        }
+
+        stream.avail_in += static_cast<uInt>(read);
+        input_position_ += read;
+    }
+
+    return true;
+}
+
+void GzFile::next_member() {
+    auto& stream = *stream_;
+    if (raw_) {
+        // inflate does not process the trailer of raw deflate data
+        if (!fill_input(GZ_TRAILER_SIZE)) {
+            throw file_error("error while reading gziped file: unexpected end of file");
+        }
+        stream.next_in += GZ_TRAILER_SIZE;
+        stream.avail_in -= GZ_TRAILER_SIZE;
+    }
+
+    // files can contain multiple gzip members one after the other (for
+    // example when using append mode). Like gzread, ignore any trailing
+    // garbage after the last member.
+    if (!fill_input(2) || !is_gzip_header(stream.next_in)) {
+        end_of_data_ = true;
+        return;
+    }
+
+    if (inflateReset2(&stream, 15 + 16) != Z_OK) {
+        throw file_error("error while reading gziped file: could not reset the stream");
+    }
+    raw_ = false;
+}
+
+void GzFile::restart() {
+    auto& stream = *stream_;
+    input_->seek(0);
+    input_position_ = 0;
+    stream.next_in = buffer_.data();
+    stream.avail_in = 0;
+
+    if (inflateReset2(&stream, 15 + 16) != Z_OK) {
+        throw file_error("error while seeking gziped file: could not reset the stream");
+    }
+
+    raw_ = false;
+    end_of_data_ = false;
+    output_position_ = 0;
+}
+
+void GzFile::restart(const GzAccessPoint& point) {
+    auto& stream = *stream_;
+    auto offset = point.input - (point.bits != 0 ? 1 : 0);
+    input_->seek(offset);
+    input_position_ = offset;
+    stream.next_in = buffer_.data();
+    stream.avail_in = 0;
+
+    // data after an access point is raw deflate data, without gzip header
+    auto status = inflateReset2(&stream, -15);
+    if (status == Z_OK && point.bits != 0) {
+        if (!fill_input(1)) {
+            throw file_error("error while seeking gziped file: unexpected end of file");
+        }
+        auto byte = *stream.next_in;
+        stream.next_in += 1;
+        stream.avail_in -= 1;
+        status = inflatePrime(&stream, point.bits, byte >> (8 - point.bits));
+    }
+
+    if (status == Z_OK) {
+        status = inflateSetDictionary(&stream, point.window.data(), static_cast<uInt>(point.window.size()));
+    }
+
     if (status != Z_OK) {
-	    throw file_error("error finishing gz stream: {}", stream.msg);
+        throw file_error("error while seeking gziped file: could not restart from access point");
+    }
+
+    raw_ = true;
+    end_of_data_ = false;
+    output_position_ = point.output;
+}
+
+void GzFile::write(const char* data, size_t count) {
+    if (writer_ == nullptr) {
+        throw file_error("can not write to the file at '{}': it was opened in read mode", this->path());
+    }
+    writer_->write(data, count);
+}
+
+void GzFile::flush() {
+    if (writer_) {
+        writer_->finish();
+    }
+}
+
+void GzFile::write_output(const char* data, size_t count) {
+    output_->write(data, count);
+}
+
+void GzFile::clear() noexcept {
+    if (output_ != nullptr) {
+        output_->clear();
+    } else {
+        input_->clear();
+    }
+}
+
+void GzFile::seek(uint64_t position) {
+    if (output_ != nullptr) {
+        throw file_error("can not seek in the file at '{}': it was opened in write mode", this->path());
+    }
+
+    if (reader_) {
+        reader_->seek(position);
+        return;
+    }
+
+    if (transparent_) {
+        input_->seek(position);
+        return;
+    }
+
+    // find the last access point before `position`
+    auto it = std::upper_bound(index_.begin(), index_.end(), position,
+        [](uint64_t value, const GzAccessPoint& point) {
+            return value < point.output;
+        }
+    );
+    const GzAccessPoint* point = nullptr;
+    if (it != index_.begin()) {
+        point = &*(it - 1);
+    }
+
+    auto point_output = point != nullptr ? point->output : 0;
+    if (position < output_position_ || output_position_ < point_output) {
+        // we can not read forward from the current position, or the access
+        // point is closer than the current position
+        if (point != nullptr) {
+            restart(*point);
+        } else {
+            restart();
+        }
     }
 
-    if (stream.total_out >= output.capacity()) {
-        // make sure the buffer always contains a terminal NULL
-        output.reserve_extra(1);
+    // decompress and discard data up to the requested position
+    unsigned char discard[GZ_WINDOW_SIZE];
+    while (output_position_ < position && !end_of_data_) {
+        auto count = std::min(static_cast<uint64_t>(GZ_WINDOW_SIZE), position - output_position_);
+        inflate_data(discard, static_cast<size_t>(count));
     }
-    output.set_size(stream.total_out);
-    return output;
 }
@@ -0,0 +1,95 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/error_fmt.hpp"
+#include "chemfiles/files/MappedFile.hpp"
+
+#if CHEMFILES_TEXT_FILE_USE_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace chemfiles;
+
+MappedFile::MappedFile(const std::string& path): TextFileImpl(path) {
+    auto file_descriptor = open(path.c_str(), O_RDONLY);
+    if (file_descriptor == -1) {
+        throw file_error("could not open the file at '{}'", path);
+    }
+
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) != 0) {
+        auto* message = std::strerror(errno);
+        close(file_descriptor);
+        throw file_error("could not get the size of the file at '{}': {}", path, message);
+    }
+
+    if (!S_ISREG(file_stat.st_mode)) {
+        close(file_descriptor);
+        throw file_error("can not map '{}' in memory: this is not a regular file", path);
+    }
+
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ == 0) {
+        // mmap does not support empty mappings
+        close(file_descriptor);
+        data_ = "";
+        return;
+    }
+
+    auto* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    // the mapping stays valid after the file descriptor is closed
+    close(file_descriptor);
+    if (mapping == MAP_FAILED) {
+        throw file_error("mmap failed for '{}': {}", path, std::strerror(errno));
+    }
+    // text files are mostly read from the start to the end, tell the kernel
+    // to read ahead aggressively. This is only a hint, so errors are ignored.
+    posix_madvise(mapping, size_, POSIX_MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (size_ != 0) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+void MappedFile::seek(uint64_t position) {
+    position_ = static_cast<size_t>(std::min(position, static_cast<uint64_t>(size_)));
+}
+
+size_t MappedFile::read(char* data, size_t count) {
+    count = std::min(count, size_ - position_);
+    std::memcpy(data, data_ + position_, count);
+    position_ += count;
+    return count;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define IGNORING_SUGGEST_ATTRIBUTE_NORETURN
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=noreturn"
+#endif
+
+void MappedFile::write(const char* /*data*/, size_t /*count*/) {
+    throw file_error("can not write to the file at '{}': it was opened in read mode", this->path());
+}
+
+#if defined(IGNORING_SUGGEST_ATTRIBUTE_NORETURN)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
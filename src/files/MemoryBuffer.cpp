@@ -7,13 +7,6 @@
 #include <algorithm>
 
 #include "chemfiles/error_fmt.hpp"
-#include "chemfiles/unreachable.hpp"
-
-#include "chemfiles/File.hpp"
-#include "chemfiles/files/GzFile.hpp"
-#include "chemfiles/files/XzFile.hpp"
-#include "chemfiles/files/Bz2File.hpp"
-
 #include "chemfiles/files/MemoryBuffer.hpp"
 
 using namespace chemfiles;
@@ -94,34 +87,3 @@ void MemoryBuffer::reserve_extra(size_t extra) {
     std::memset(ptr_ + capacity_, 0, extra);
     capacity_ += extra;
 }
-
-void MemoryBuffer::set_size(size_t len) {
-    if (!this->is_owned()) {
-        throw file_error("can not set the size of a read-only MemoryBuffer");
-    }
-
-    if (len >= capacity_) {
-        throw file_error("can not set the size of a MemoryBuffer larger than the capacity");
-    }
-
-    len_ = len;
-}
-
-void MemoryBuffer::decompress(File::Compression compression) {
-    switch(compression) {
-    case File::GZIP:
-        *this = decompress_gz(this->data(), this->size());
-        break;
-    case File::LZMA:
-        *this = decompress_xz(this->data(), this->size());
-        break;
-    case File::BZIP2:
-        *this = decompress_bz2(this->data(), this->size());
-        break;
-    case File::DEFAULT:
-        // nothing to do
-        break;
-    default:
-        unreachable();
-    }
-}
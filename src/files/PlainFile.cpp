@@ -96,3 +96,9 @@ void PlainFile::write(const char* data, size_t count) {
         throw file_error("could not write data to the file at '{}'", this->path());
     }
 }
+
+void PlainFile::flush() {
+    if (std::fflush(file_) != 0) {
+        throw file_error("could not flush data to the file at '{}'", this->path());
+    }
+}
@@ -0,0 +1,142 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/error_fmt.hpp"
+#include "chemfiles/unreachable.hpp"
+
+#include "chemfiles/files/RawFile.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
+
+using namespace chemfiles;
+
+#ifdef __CYGWIN__
+    #include <sys/types.h>
+    #define fseek64 fseek
+    #define ftell64 ftell
+    #define off64_t off_t
+#elif defined(_MSC_VER)
+    #define fseek64 _fseeki64
+    #define ftell64 _ftelli64
+    #define off64_t __int64
+#else
+    // assume unix by default
+    #include <sys/types.h>
+    #define fseek64 fseeko
+    #define ftell64 ftello
+    #define off64_t off_t
+#endif
+
+RawFile::RawFile(const std::string& path, File::Mode mode) {
+    const char* openmode;
+    switch (mode) {
+    case File::READ:
+        openmode = "rb";
+        break;
+    case File::WRITE:
+        openmode = "wb";
+        break;
+    case File::APPEND:
+        openmode = "ab";
+        break;
+    default:
+        unreachable();
+    }
+
+    file_ = std::fopen(path.c_str(), openmode);
+    if (file_ == nullptr) {
+        throw file_error("could not open the file at '{}'", path);
+    }
+}
+
+RawFile::RawFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode): memory_(std::move(memory)) {
+    if (mode == File::APPEND) {
+        throw file_error("cannot append (mode 'a') to a memory file");
+    }
+}
+
+RawFile::~RawFile() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+}
+
+size_t RawFile::read(void* data, size_t count) {
+    if (file_ != nullptr) {
+        auto read = std::fread(data, 1, count, file_);
+        if (std::ferror(file_) != 0) {
+            throw file_error("error while reading file: {}", std::strerror(errno));
+        }
+        eof_ = std::feof(file_) != 0;
+        return read;
+    }
+
+    auto size = static_cast<uint64_t>(memory_->size());
+    auto start = std::min(position_, size);
+    auto read = static_cast<size_t>(std::min(static_cast<uint64_t>(count), size - start));
+    if (read != 0) {
+        std::memcpy(data, memory_->data() + start, read);
+    }
+    position_ = start + read;
+    eof_ = read < count;
+    return read;
+}
+
+void RawFile::write(const void* data, size_t count) {
+    if (file_ != nullptr) {
+        if (std::fwrite(data, 1, count, file_) != count) {
+            throw file_error("error while writing file: {}", std::strerror(errno));
+        }
+        return;
+    }
+
+    memory_->write(static_cast<const char*>(data), count);
+}
+
+void RawFile::seek(uint64_t position) {
+    eof_ = false;
+    if (file_ != nullptr) {
+        static_assert(
+            sizeof(uint64_t) == sizeof(off64_t),
+            "uint64_t and off64_t do not have the same size"
+        );
+        if (fseek64(file_, static_cast<off64_t>(position), SEEK_SET) != 0) {
+            throw file_error("error while seeking file: {}", std::strerror(errno));
+        }
+        return;
+    }
+
+    position_ = position;
+}
+
+uint64_t RawFile::size() {
+    if (file_ == nullptr) {
+        return static_cast<uint64_t>(memory_->size());
+    }
+
+    auto position = ftell64(file_);
+    if (position < 0 || fseek64(file_, 0, SEEK_END) != 0) {
+        throw file_error("error while seeking file: {}", std::strerror(errno));
+    }
+    auto size = ftell64(file_);
+    if (size < 0 || fseek64(file_, position, SEEK_SET) != 0) {
+        throw file_error("error while seeking file: {}", std::strerror(errno));
+    }
+    return static_cast<uint64_t>(size);
+}
+
+void RawFile::clear() noexcept {
+    eof_ = false;
+    if (file_ != nullptr) {
+        std::clearerr(file_);
+    }
+}
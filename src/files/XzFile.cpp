@@ -4,9 +4,14 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <memory>
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
 
 #include <lzma.h>
 
@@ -14,6 +19,7 @@
 #include "chemfiles/error_fmt.hpp"
 
 #include "chemfiles/files/XzFile.hpp"
+#include "chemfiles/files/RawFile.hpp"
 #include "chemfiles/files/MemoryBuffer.hpp"
 
 using namespace chemfiles;
@@ -60,44 +66,365 @@ static void open_stream_read(lzma_stream* stream) {
     check(lzma_stream_decoder(stream, memory_limit, flags));
 }
 
-XzFile::XzFile(const std::string& path, File::Mode mode): TextFileImpl(path), mode_(mode), buffer_(8192) {
-    const char* openmode = nullptr;
-    if (mode == File::READ) {
-        openmode = "rb";
-        open_stream_read(&stream_);
-    } else if (mode == File::WRITE) {
-        openmode = "wb";
-        check(lzma_easy_encoder(&stream_, 6, LZMA_CHECK_CRC64));
+/// Integrity check used when writing files
+static constexpr lzma_check XZ_CHECK = LZMA_CHECK_CRC64;
+
+/// Compress `input` in a single xz block in `output`, using the given
+/// compression `preset`
+static void compress_block(const std::vector<char>& input, uint32_t preset, std::vector<char>& output) {
+    lzma_options_lzma options;
+    if (lzma_lzma_preset(&options, preset)) {
+        check(LZMA_OPTIONS_ERROR);
+    }
+
+    lzma_filter filters[2];
+    filters[0].id = LZMA_FILTER_LZMA2;
+    filters[0].options = &options;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    filters[1].options = nullptr;
+
+    auto block = lzma_block();
+    block.version = 0;
+    block.check = XZ_CHECK;
+    block.filters = filters;
+
+    output.resize(checked_cast(lzma_block_buffer_bound(input.size())));
+    size_t position = 0;
+    check(lzma_block_buffer_encode(
+        &block, nullptr,
+        reinterpret_cast<const uint8_t*>(input.data()), input.size(),
+        reinterpret_cast<uint8_t*>(output.data()), &position, output.size()
+    ));
+    output.resize(position);
+}
+
+// Read the index of all the streams in the xz `file`, or return `nullptr` if
+// the index can not be read (for example if the file is truncated).
+static lzma_index* read_index(RawFile& file) {
+#if LZMA_VERSION >= 50040002
+    auto file_size = file.size();
+
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_index* index = nullptr;
+    auto memory_limit = std::numeric_limits<uint64_t>::max();
+    if (lzma_file_info_decoder(&stream, &index, memory_limit, file_size) != LZMA_OK) {
+        return nullptr;
+    }
+
+    auto buffer = std::vector<uint8_t>(8192);
+    auto status = LZMA_OK;
+    file.seek(0);
+    try {
+        while (true) {
+            if (stream.avail_in == 0) {
+                stream.next_in = buffer.data();
+                stream.avail_in = file.read(buffer.data(), buffer.size());
+            }
+
+            status = lzma_code(&stream, LZMA_RUN);
+            if (status == LZMA_SEEK_NEEDED) {
+                file.seek(stream.seek_pos);
+                stream.avail_in = 0;
+            } else if (status != LZMA_OK) {
+                break;
+            }
+        }
+    } catch (const FileError&) {
+        status = LZMA_BUF_ERROR;
+    }
+    lzma_end(&stream);
+
+    file.clear();
+    file.seek(0);
+    if (status != LZMA_STREAM_END) {
+        lzma_index_end(index, nullptr);
+        return nullptr;
+    }
+    return index;
+#else
+    // lzma_file_info_decoder is not available
+    (void)file;
+    return nullptr;
+#endif
+}
+
+XzFile::XzFile(const std::string& path, File::Mode mode, uint64_t block_size):
+    XzFile(nullptr, path, mode, block_size) {}
 
-        stream_.next_out = buffer_.data();
-        stream_.avail_out = buffer_.size();
+XzFile::XzFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, uint64_t block_size):
+    XzFile(std::move(memory), "<in memory>", mode, block_size) {}
+
+XzFile::XzFile(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode, uint64_t block_size):
+    TextFileImpl(path), mode_(mode), buffer_(8192), block_size_(block_size)
+{
+    if (mode == File::WRITE) {
+        if (block_size == 0) {
+            throw file_error("the block size for xz files can not be 0");
+        }
     } else if (mode == File::APPEND) {
         throw file_error("appending (open mode 'a') is not supported with xz files");
     }
 
-    file_ = std::fopen(path.c_str(), openmode);
-    if (file_ == nullptr) {
-        lzma_end(&stream_);
-        throw file_error("could not open the file at '{}'", path);
+    if (memory) {
+        file_ = std::make_unique<RawFile>(std::move(memory), mode);
+    } else {
+        file_ = std::make_unique<RawFile>(path, mode);
+    }
+
+    if (mode == File::READ) {
+        open_stream_read(&stream_);
+    }
+
+    if (mode == File::WRITE) {
+        // always write the header of the first stream, to get a valid xz
+        // file even if no data is written
+        write_header();
+        create_writer();
+    } else if (mode == File::READ) {
+        index_ = read_index(*file_);
+        if (index_ != nullptr) {
+            lzma_index_iter_init(&iter_, index_);
+            while (!lzma_index_iter_next(&iter_, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+                blocks_.push_back({
+                    iter_.block.compressed_file_offset,
+                    iter_.block.total_size,
+                    iter_.block.unpadded_size,
+                    iter_.block.uncompressed_size,
+                    iter_.stream.flags->check,
+                });
+            }
+            create_reader();
+
+            lzma_index_iter_rewind(&iter_);
+            if (lzma_index_iter_next(&iter_, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+                // no blocks, this file is empty
+                end_of_data_ = true;
+            } else {
+                start_block();
+            }
+        }
     }
 }
 
 XzFile::~XzFile() {
     if (mode_ == File::WRITE) {
         try {
-            compress_and_write(LZMA_FINISH);
+            writer_->finish();
+            if (index_ != nullptr) {
+                write_footer();
+            }
         } catch (...) {
             // not much we can do here ...
         }
     }
 
+    // stop the background threads before closing the file
+    reader_.reset();
+    writer_.reset();
     lzma_end(&stream_);
-    if (file_ != nullptr) {
-        std::fclose(file_);
+    if (index_ != nullptr) {
+        lzma_index_end(index_, nullptr);
     }
 }
 
+void XzFile::create_writer() {
+    auto preset = preset_;
+    writer_ = std::make_unique<BlockWriter>(
+        checked_cast(block_size_),
+        [preset](size_t, const std::vector<char>& input, std::vector<char>& output) {
+            compress_block(input, preset, output);
+        },
+        [this](size_t, const std::vector<char>& output) {
+            this->write_block(output);
+        },
+        threads_
+    );
+}
+
+void XzFile::create_reader() {
+    reader_.reset();
+
+    uint64_t max_block_size = 0;
+    for (const auto& block: blocks_) {
+        max_block_size = std::max(max_block_size, block.uncompressed_size);
+    }
+
+    // the block decoder is better for random access on a single thread,
+    // since it only decompresses the beginning of blocks
+    if (threads_ > 1 && blocks_.size() > 1 && max_block_size <= MAX_PARALLEL_BLOCK_SIZE) {
+        auto sizes = std::vector<uint64_t>();
+        sizes.reserve(blocks_.size());
+        for (const auto& block: blocks_) {
+            sizes.push_back(block.uncompressed_size);
+        }
+        reader_ = std::make_unique<BlockReader>(
+            blocks_.size(), std::move(sizes),
+            [this](size_t i, std::vector<char>& output) {
+                this->decompress_block(i, output);
+            },
+            threads_
+        );
+    }
+}
+
+void XzFile::set_compression_options(const CompressionOptions& options) {
+    if (options.level != -1 && (options.level < 0 || options.level > 9)) {
+        throw file_error("invalid compression level {} for xz, expected a value between 0 and 9", options.level);
+    }
+
+    threads_ = options.threads == 0 ? parallel_threads() : options.threads;
+    if (mode_ == File::READ) {
+        if (index_ != nullptr) {
+            auto position = position_;
+            if (reader_) {
+                position = reader_->tell();
+                // `reader_` moved the file around, the block decoder needs
+                // to restart from the block containing the position
+                end_of_data_ = true;
+            }
+            create_reader();
+            this->seek(position);
+        }
+        return;
+    }
+
+    preset_ = static_cast<uint32_t>(options.level == -1 ? DEFAULT_PRESET : options.level);
+    if (options.extreme) {
+        preset_ |= LZMA_PRESET_EXTREME;
+    }
+    if (options.block_size != 0) {
+        block_size_ = options.block_size;
+    }
+
+    // write any data already given to the previous writer with the previous
+    // options
+    writer_->finish();
+    create_writer();
+}
+
+void XzFile::start_block() {
+    file_->seek(iter_.block.compressed_file_offset);
+
+    uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+    if (file_->read(header, 1) != 1) {
+        throw file_error("lzma: compressed file is truncated");
+    }
+
+    block_ = lzma_block();
+    block_.version = 1;
+    block_.header_size = lzma_block_header_size_decode(header[0]);
+    block_.check = iter_.stream.flags->check;
+
+    auto remaining = block_.header_size - 1;
+    if (file_->read(header + 1, remaining) != remaining) {
+        throw file_error("lzma: compressed file is truncated");
+    }
+
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    block_.filters = filters;
+    check(lzma_block_header_decode(&block_, nullptr, header));
+
+    auto status = lzma_block_compressed_size(&block_, iter_.block.unpadded_size);
+    if (status == LZMA_OK) {
+        status = lzma_block_decoder(&stream_, &block_);
+    }
+
+    // the filters options are only used to initialize the decoder
+    for (size_t i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+        free(filters[i].options);
+    }
+    block_.filters = nullptr;
+    check(status);
+
+    stream_.avail_in = 0;
+    block_done_ = false;
+    position_ = iter_.block.uncompressed_file_offset;
+}
+
+void XzFile::decompress_block(size_t i, std::vector<char>& output) {
+    const auto& info = blocks_[i];
+    auto input = std::vector<uint8_t>(checked_cast(info.total_size));
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_->seek(info.compressed_offset);
+        if (file_->read(input.data(), input.size()) != input.size()) {
+            throw file_error("lzma: compressed file is truncated");
+        }
+    }
+
+    auto block = lzma_block();
+    block.version = 1;
+    block.header_size = lzma_block_header_size_decode(input[0]);
+    block.check = info.check;
+    if (block.header_size > input.size()) {
+        check(LZMA_DATA_ERROR);
+    }
+
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    block.filters = filters;
+    check(lzma_block_header_decode(&block, nullptr, input.data()));
+
+    output.resize(checked_cast(info.uncompressed_size));
+    size_t input_position = block.header_size;
+    size_t output_position = 0;
+    auto status = lzma_block_compressed_size(&block, info.unpadded_size);
+    if (status == LZMA_OK) {
+        status = lzma_block_buffer_decode(
+            &block, nullptr,
+            input.data(), &input_position, input.size(),
+            reinterpret_cast<uint8_t*>(output.data()), &output_position, output.size()
+        );
+    }
+
+    for (size_t j = 0; filters[j].id != LZMA_VLI_UNKNOWN; j++) {
+        free(filters[j].options);
+    }
+    check(status);
+
+    if (output_position != output.size()) {
+        check(LZMA_DATA_ERROR);
+    }
+}
+
+size_t XzFile::read_blocks(uint8_t* data, size_t count) {
+    stream_.next_out = data;
+    stream_.avail_out = count;
+
+    while (stream_.avail_out != 0 && !end_of_data_) {
+        if (block_done_) {
+            if (lzma_index_iter_next(&iter_, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+                end_of_data_ = true;
+                break;
+            }
+            start_block();
+        }
+
+        if (stream_.avail_in == 0) {
+            stream_.next_in = buffer_.data();
+            stream_.avail_in = file_->read(buffer_.data(), buffer_.size());
+        }
+
+        auto before = stream_.avail_out;
+        auto status = lzma_code(&stream_, LZMA_RUN);
+        position_ += before - stream_.avail_out;
+
+        if (status == LZMA_STREAM_END) {
+            block_done_ = true;
+        } else {
+            check(status);
+        }
+    }
+
+    return count - stream_.avail_out;
+}
+
 size_t XzFile::read(char* data, size_t count) {
+    if (reader_) {
+        return reader_->read(data, count);
+    } else if (index_ != nullptr) {
+        return read_blocks(reinterpret_cast<uint8_t*>(data), count);
+    }
+
     auto action = LZMA_RUN;
 
     stream_.next_out = reinterpret_cast<uint8_t*>(data);
@@ -105,16 +432,12 @@ size_t XzFile::read(char* data, size_t count) {
 
     while (stream_.avail_out != 0) {
         // read more compressed data from the file
-        if (stream_.avail_in == 0 && (std::feof(file_) == 0)) {
+        if (stream_.avail_in == 0 && !file_->eof()) {
             stream_.next_in = buffer_.data();
-            stream_.avail_in = std::fread(buffer_.data(), 1, buffer_.size(), file_);
-
-            if (std::ferror(file_) != 0) {
-                throw file_error("IO error while reading xz file");
-            }
+            stream_.avail_in = file_->read(buffer_.data(), buffer_.size());
         }
 
-        if (std::feof(file_) != 0) {
+        if (file_->eof()) {
             action = LZMA_FINISH;
         }
 
@@ -131,102 +454,127 @@ size_t XzFile::read(char* data, size_t count) {
 }
 
 void XzFile::clear() noexcept {
-    std::clearerr(file_);
+    file_->clear();
 }
 
 void XzFile::seek(uint64_t position) {
     assert(mode_ == File::READ);
+    constexpr size_t BUFFSIZE = 4096;
+    uint8_t buffer[BUFFSIZE];
+
+    if (reader_) {
+        reader_->seek(position);
+        return;
+    } else if (index_ != nullptr) {
+        auto block_end = iter_.block.uncompressed_file_offset + iter_.block.uncompressed_size;
+        auto in_current_block = !end_of_data_ && position >= position_ && position < block_end;
+        if (!in_current_block) {
+            lzma_index_iter_rewind(&iter_);
+            if (lzma_index_iter_locate(&iter_, position)) {
+                // position is past the end of the file
+                end_of_data_ = true;
+                position_ = lzma_index_uncompressed_size(index_);
+                return;
+            }
+            end_of_data_ = false;
+            start_block();
+        }
+
+        // decompress the beginning of the block up to the requested position
+        while (position_ < position && !end_of_data_) {
+            auto size = std::min(static_cast<uint64_t>(BUFFSIZE), position - position_);
+            read_blocks(buffer, static_cast<size_t>(size));
+        }
+        return;
+    }
+
     // Reset stream state
     lzma_end(&stream_);
     stream_ = LZMA_STREAM_INIT;
     open_stream_read(&stream_);
 
     // Dumb implementation, re-decompressing the file from the begining
-    std::fseek(file_, 0, SEEK_SET);
-    constexpr size_t BUFFSIZE = 4096;
-    char buffer[BUFFSIZE];
+    file_->seek(0);
 
     while (position > BUFFSIZE) {
-        auto count = this->read(buffer, BUFFSIZE);
+        auto count = this->read(reinterpret_cast<char*>(buffer), BUFFSIZE);
         assert(count == BUFFSIZE);
         position -= count;
     }
 
-    auto count = this->read(buffer, static_cast<size_t>(position));
+    auto count = this->read(reinterpret_cast<char*>(buffer), static_cast<size_t>(position));
     assert(count == position);
     // silent "unused variable" when compiling without assertions
     (void)count;
 }
 
 void XzFile::write(const char* data, size_t count) {
-    stream_.next_in = reinterpret_cast<const uint8_t*>(data);
-    stream_.avail_in = count;
-    compress_and_write(LZMA_RUN);
-
-    auto actual = count - stream_.avail_in;
-    if (actual != count) {
-        throw file_error("could not write data to the file at '{}'", this->path());
+    if (writer_ == nullptr) {
+        throw file_error("can not write to the file at '{}': it was opened in read mode", this->path());
+    }
+    if (index_ == nullptr) {
+        // the previous stream was finished by `flush`, start a new one
+        write_header();
     }
+    writer_->write(data, count);
 }
 
-void XzFile::compress_and_write(lzma_action action) {
-    lzma_ret status = LZMA_OK;
-    do {
-        status = lzma_code(&stream_, action);
-
-        if (stream_.avail_out == 0 || status == LZMA_STREAM_END) {
-            auto size = buffer_.size() - stream_.avail_out;
-            auto written = std::fwrite(buffer_.data(), sizeof(uint8_t), size, file_);
-            if (written != size) {
-                throw file_error("error while writting data to xz file");
-            }
-
-            stream_.next_out = buffer_.data();
-            stream_.avail_out = buffer_.size();
-        }
-
-        check(status);
-
-    } while (stream_.avail_in != 0 || (action == LZMA_FINISH && status != LZMA_STREAM_END));
+void XzFile::flush() {
+    if (writer_ == nullptr || index_ == nullptr) {
+        return;
+    }
+    writer_->finish();
+    write_footer();
 }
 
-MemoryBuffer chemfiles::decompress_xz(const char* src, size_t size) {
-    // assume a 10% compression ratio, which should be plenty enough
-    // (typical ratio is around 15-20%)
-    auto output = MemoryBuffer(10 * size);
-
-    lzma_stream stream = LZMA_STREAM_INIT;
-    stream.next_in = reinterpret_cast<const uint8_t*>(src);
-    stream.avail_in = size;
-    stream.total_out = 0;
+void XzFile::write_header() {
+    assert(index_ == nullptr);
+    auto flags = lzma_stream_flags();
+    flags.version = 0;
+    flags.check = XZ_CHECK;
+    uint8_t header[LZMA_STREAM_HEADER_SIZE];
+    check(lzma_stream_header_encode(&flags, header));
+    file_->write(header, sizeof(header));
+
+    index_ = lzma_index_init(nullptr);
+    if (index_ == nullptr) {
+        check(LZMA_MEM_ERROR);
+    }
+}
 
-    open_stream_read(&stream);
+void XzFile::write_block(const std::vector<char>& output) {
+    const auto* data = reinterpret_cast<const uint8_t*>(output.data());
+
+    // get the size of the block from its header, to add it to the index
+    auto block = lzma_block();
+    block.version = 1;
+    block.header_size = lzma_block_header_size_decode(data[0]);
+    block.check = XZ_CHECK;
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    block.filters = filters;
+    check(lzma_block_header_decode(&block, nullptr, data));
+    for (size_t i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+        free(filters[i].options);
+    }
+    check(lzma_index_append(index_, nullptr, lzma_block_unpadded_size(&block), block.uncompressed_size));
 
-    bool done = false;
-    do {
-	    // if we need more space, resize the vector
-	    if (stream.total_out >= output.capacity()) {
-		    output.reserve_extra(output.capacity());
-	    }
+    file_->write(output.data(), output.size());
+}
 
-	    stream.next_out = reinterpret_cast<uint8_t*>(output.data_mut() + stream.total_out);
-    	stream.avail_out = output.capacity() - checked_cast(stream.total_out);
+void XzFile::write_footer() {
+    auto index_size = static_cast<size_t>(lzma_index_size(index_));
+    auto footer = std::vector<uint8_t>(index_size + LZMA_STREAM_HEADER_SIZE);
+    size_t position = 0;
+    check(lzma_index_buffer_encode(index_, footer.data(), &position, index_size));
 
-        auto status = lzma_code(&stream, LZMA_FINISH);
-        if (status == LZMA_STREAM_END) {
-		    done = true;
-        } else if (status != LZMA_OK) {
-		    lzma_end(&stream);
-            check(status);
-	    }
-    } while (!done);
+    auto flags = lzma_stream_flags();
+    flags.version = 0;
+    flags.backward_size = lzma_index_size(index_);
+    flags.check = XZ_CHECK;
+    check(lzma_stream_footer_encode(&flags, footer.data() + index_size));
 
-    lzma_end(&stream);
+    file_->write(footer.data(), footer.size());
 
-    if (stream.total_out >= output.capacity()) {
-        // make sure the buffer always contains a terminal NULL
-        output.reserve_extra(1);
-    }
-    output.set_size(checked_cast(stream.total_out));
-    return output;
+    lzma_index_end(index_, nullptr);
+    index_ = nullptr;
 }
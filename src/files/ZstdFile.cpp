@@ -0,0 +1,413 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include <zstd.h>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/error_fmt.hpp"
+
+#include "chemfiles/files/ZstdFile.hpp"
+#include "chemfiles/files/RawFile.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
+
+using namespace chemfiles;
+
+static size_t check(size_t code) {
+    if (ZSTD_isError(code) != 0) {
+        throw file_error("zstd: {}", ZSTD_getErrorName(code));
+    }
+    return code;
+}
+
+/// Magic number of the skippable frame containing the seek table
+static constexpr uint32_t ZSTD_SEEK_TABLE_MAGIC = 0x184D2A5E;
+/// Magic number at the very end of the seek table
+static constexpr uint32_t ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;
+/// Size of the seek table footer: number of frames, descriptor and magic
+static constexpr uint64_t ZSTD_SEEK_TABLE_FOOTER_SIZE = 9;
+/// Maximal number of frames in a seek table
+static constexpr uint64_t ZSTD_SEEKABLE_MAX_FRAMES = 0x8000000;
+
+static uint32_t read_u32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0])
+        | (static_cast<uint32_t>(data[1]) << 8)
+        | (static_cast<uint32_t>(data[2]) << 16)
+        | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static void write_u32(std::vector<char>& output, uint32_t value) {
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        output.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+std::vector<ZstdFrame> chemfiles::read_zstd_seek_table(RawFile& file) {
+    auto frames = std::vector<ZstdFrame>();
+    auto file_size = file.size();
+    if (file_size < 8 + ZSTD_SEEK_TABLE_FOOTER_SIZE) {
+        return frames;
+    }
+
+    unsigned char footer[ZSTD_SEEK_TABLE_FOOTER_SIZE] = {0};
+    file.seek(file_size - ZSTD_SEEK_TABLE_FOOTER_SIZE);
+    if (file.read(footer, ZSTD_SEEK_TABLE_FOOTER_SIZE) != ZSTD_SEEK_TABLE_FOOTER_SIZE) {
+        file.clear();
+        return frames;
+    }
+
+    auto count = static_cast<uint64_t>(read_u32(footer));
+    auto descriptor = footer[4];
+    if (read_u32(footer + 5) != ZSTD_SEEKABLE_MAGIC || (descriptor & 0x7C) != 0 || count > ZSTD_SEEKABLE_MAX_FRAMES) {
+        return frames;
+    }
+
+    // entries contain the compressed size, the decompressed size, and an
+    // optional checksum
+    uint64_t entry_size = (descriptor & 0x80) != 0 ? 12 : 8;
+    auto table_size = 8 + count * entry_size + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+    if (table_size > file_size) {
+        return frames;
+    }
+
+    auto table = std::vector<unsigned char>(static_cast<size_t>(table_size));
+    file.seek(file_size - table_size);
+    if (file.read(table.data(), table.size()) != table.size()) {
+        file.clear();
+        return frames;
+    }
+
+    if (read_u32(table.data()) != ZSTD_SEEK_TABLE_MAGIC || read_u32(table.data() + 4) != table_size - 8) {
+        return frames;
+    }
+
+    frames.reserve(static_cast<size_t>(count));
+    uint64_t start = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        const auto* entry = table.data() + 8 + i * entry_size;
+        auto compressed_size = static_cast<uint64_t>(read_u32(entry));
+        auto size = static_cast<uint64_t>(read_u32(entry + 4));
+        frames.push_back({start, compressed_size, size});
+        start += compressed_size;
+    }
+
+    if (start != file_size - table_size) {
+        // the seek table does not describe all the frames in this file, for
+        // example because more data was appended to the file
+        frames.clear();
+    }
+
+    return frames;
+}
+
+/// Compress `input` to a single zstd frame in `output`, using the given
+/// compression `level`
+static void compress_frame(const std::vector<char>& input, int level, std::vector<char>& output) {
+    auto context = std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)>(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    if (!context) {
+        throw file_error("zstd: memory allocation failed");
+    }
+
+    check(ZSTD_CCtx_setParameter(context.get(), ZSTD_c_compressionLevel, level));
+    check(ZSTD_CCtx_setParameter(context.get(), ZSTD_c_checksumFlag, 1));
+
+    output.resize(ZSTD_compressBound(input.size()));
+    auto size = check(ZSTD_compress2(
+        context.get(), output.data(), output.size(), input.data(), input.size()
+    ));
+    output.resize(size);
+}
+
+ZstdFile::ZstdFile(const std::string& path, File::Mode mode):
+    ZstdFile(nullptr, path, mode) {}
+
+ZstdFile::ZstdFile(std::shared_ptr<MemoryBuffer> memory, File::Mode mode):
+    ZstdFile(std::move(memory), "<in memory>", mode) {}
+
+ZstdFile::ZstdFile(std::shared_ptr<MemoryBuffer> memory, const std::string& path, File::Mode mode):
+    TextFileImpl(path), mode_(mode), stream_(nullptr, ZSTD_freeDCtx)
+{
+    if (memory) {
+        file_ = std::make_unique<RawFile>(std::move(memory), mode);
+    } else {
+        file_ = std::make_unique<RawFile>(path, mode);
+    }
+
+    if (mode == File::READ) {
+        for (auto& frame: read_zstd_seek_table(*file_)) {
+            if (frame.size != 0) {
+                frames_.push_back(frame);
+            }
+        }
+        create_reader();
+
+        if (!reader_) {
+            stream_.reset(ZSTD_createDCtx());
+            if (!stream_) {
+                throw file_error("zstd: memory allocation failed");
+            }
+            buffer_.resize(ZSTD_DStreamInSize());
+            restart_points_.emplace_back(0, 0);
+            restart_stream(0, 0);
+        }
+    } else {
+        create_writer();
+    }
+}
+
+ZstdFile::~ZstdFile() {
+    if (writer_) {
+        try {
+            writer_->finish();
+            if (seek_table_.empty()) {
+                // write an empty frame, to get a valid zstd file even if no
+                // data was written
+                auto output = std::vector<char>();
+                compress_frame(std::vector<char>(), level_, output);
+                write_frame(output);
+            }
+            write_seek_table();
+        } catch (...) {
+            // not much we can do here
+        }
+    }
+
+    // stop the background threads before closing the file
+    reader_.reset();
+    writer_.reset();
+}
+
+void ZstdFile::create_writer() {
+    auto level = level_;
+    writer_ = std::make_unique<BlockWriter>(
+        static_cast<size_t>(block_size_),
+        [level](size_t, const std::vector<char>& input, std::vector<char>& output) {
+            compress_frame(input, level, output);
+        },
+        [this](size_t, const std::vector<char>& output) {
+            this->write_frame(output);
+        },
+        threads_
+    );
+}
+
+void ZstdFile::create_reader() {
+    if (frames_.empty()) {
+        return;
+    }
+
+    auto sizes = std::vector<uint64_t>();
+    sizes.reserve(frames_.size());
+    for (const auto& frame: frames_) {
+        if (frame.size > MAX_PARALLEL_BLOCK_SIZE) {
+            // decompressing such frames in advance would use too much memory
+            return;
+        }
+        sizes.push_back(frame.size);
+    }
+
+    reader_ = std::make_unique<BlockReader>(
+        frames_.size(), std::move(sizes),
+        [this](size_t i, std::vector<char>& output) {
+            this->decompress_frame(i, output);
+        },
+        threads_
+    );
+}
+
+void ZstdFile::set_compression_options(const CompressionOptions& options) {
+    if (options.extreme) {
+        throw file_error("the 'extreme' compression option is only supported for xz compression");
+    }
+    if (options.level != -1 && (options.level < 1 || options.level > ZSTD_maxCLevel())) {
+        throw file_error(
+            "invalid compression level {} for zstd, expected a value between 1 and {}",
+            options.level, ZSTD_maxCLevel()
+        );
+    }
+    if (options.block_size > MAX_BLOCK_SIZE) {
+        throw file_error(
+            "invalid block size {} for zstd, expected a value smaller than {}",
+            options.block_size, MAX_BLOCK_SIZE
+        );
+    }
+
+    level_ = options.level == -1 ? DEFAULT_LEVEL : options.level;
+    block_size_ = options.block_size == 0 ? DEFAULT_BLOCK_SIZE : options.block_size;
+    threads_ = options.threads == 0 ? parallel_threads() : options.threads;
+
+    if (mode_ == File::READ) {
+        if (reader_) {
+            auto position = reader_->tell();
+            create_reader();
+            reader_->seek(position);
+        }
+    } else {
+        // write any data already given to the previous writer with the
+        // previous options
+        writer_->finish();
+        create_writer();
+    }
+}
+
+void ZstdFile::decompress_frame(size_t i, std::vector<char>& output) {
+    const auto& frame = frames_[i];
+
+    auto data = std::vector<char>(static_cast<size_t>(frame.compressed_size));
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_->seek(frame.start);
+        if (file_->read(data.data(), data.size()) != data.size()) {
+            throw file_error("zstd: compressed file is truncated");
+        }
+    }
+
+    output.resize(static_cast<size_t>(frame.size));
+    auto size = check(ZSTD_decompress(output.data(), output.size(), data.data(), data.size()));
+    output.resize(size);
+}
+
+size_t ZstdFile::decompress_stream(char* data, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        if (buffer_position_ == buffer_size_) {
+            buffer_size_ = file_->read(buffer_.data(), buffer_.size());
+            buffer_position_ = 0;
+            input_position_ += buffer_size_;
+            if (buffer_size_ == 0) {
+                if (!frame_done_) {
+                    throw file_error("zstd: compressed file is truncated");
+                }
+                break;
+            }
+        }
+
+        if (frame_done_ && output_position_ > restart_points_.back().second) {
+            auto input = input_position_ - (buffer_size_ - buffer_position_);
+            restart_points_.emplace_back(input, output_position_);
+        }
+
+        ZSTD_inBuffer input = {buffer_.data(), buffer_size_, buffer_position_};
+        ZSTD_outBuffer output = {data + done, count - done, 0};
+        auto status = check(ZSTD_decompressStream(stream_.get(), &output, &input));
+
+        buffer_position_ = input.pos;
+        done += output.pos;
+        output_position_ += output.pos;
+        frame_done_ = (status == 0);
+    }
+    return done;
+}
+
+void ZstdFile::restart_stream(uint64_t input, uint64_t output) {
+    check(ZSTD_DCtx_reset(stream_.get(), ZSTD_reset_session_only));
+    file_->clear();
+    file_->seek(input);
+    buffer_position_ = 0;
+    buffer_size_ = 0;
+    input_position_ = input;
+    output_position_ = output;
+    frame_done_ = true;
+}
+
+size_t ZstdFile::read(char* data, size_t count) {
+    if (reader_) {
+        return reader_->read(data, count);
+    } else {
+        return decompress_stream(data, count);
+    }
+}
+
+void ZstdFile::clear() noexcept {
+    file_->clear();
+}
+
+void ZstdFile::seek(uint64_t position) {
+    assert(mode_ == File::READ);
+    if (reader_) {
+        reader_->seek(position);
+        return;
+    }
+
+    if (position < output_position_) {
+        // restart from the last known frame before `position`
+        auto it = std::upper_bound(
+            restart_points_.begin(), restart_points_.end(), position,
+            [](uint64_t value, const std::pair<uint64_t, uint64_t>& point) {
+                return value < point.second;
+            }
+        );
+        auto point = *std::prev(it);
+        restart_stream(point.first, point.second);
+    }
+
+    auto skip = std::vector<char>(64 * 1024);
+    while (output_position_ < position) {
+        auto count = static_cast<size_t>(std::min<uint64_t>(skip.size(), position - output_position_));
+        if (decompress_stream(skip.data(), count) == 0) {
+            break;
+        }
+    }
+}
+
+void ZstdFile::write(const char* data, size_t count) {
+    if (writer_ == nullptr) {
+        throw file_error("can not write to the file at '{}': it was opened in read mode", this->path());
+    }
+    writer_->write(data, count);
+}
+
+void ZstdFile::write_frame(const std::vector<char>& frame) {
+    auto size = ZSTD_getFrameContentSize(frame.data(), frame.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        throw file_error("zstd: missing content size in compressed frame, this is a bug in chemfiles");
+    }
+
+    file_->write(frame.data(), frame.size());
+    seek_table_.emplace_back(static_cast<uint32_t>(frame.size()), static_cast<uint32_t>(size));
+    seek_table_outdated_ = true;
+}
+
+void ZstdFile::write_seek_table() {
+    if (!seek_table_outdated_) {
+        return;
+    }
+
+    auto count = static_cast<uint32_t>(seek_table_.size());
+    auto table = std::vector<char>();
+    table.reserve(8 + 8 * seek_table_.size() + ZSTD_SEEK_TABLE_FOOTER_SIZE);
+    write_u32(table, ZSTD_SEEK_TABLE_MAGIC);
+    write_u32(table, static_cast<uint32_t>(8 * seek_table_.size() + ZSTD_SEEK_TABLE_FOOTER_SIZE));
+    for (const auto& entry: seek_table_) {
+        write_u32(table, entry.first);
+        write_u32(table, entry.second);
+    }
+    write_u32(table, count);
+    // seek table descriptor, without checksums
+    table.push_back(0);
+    write_u32(table, ZSTD_SEEKABLE_MAGIC);
+
+    file_->write(table.data(), table.size());
+
+    // if more frames are written after this one, this seek table is seen as
+    // a frame without uncompressed data by the next seek table
+    seek_table_.emplace_back(static_cast<uint32_t>(table.size()), 0);
+    seek_table_outdated_ = false;
+}
+
+void ZstdFile::flush() {
+    if (writer_) {
+        writer_->finish();
+        write_seek_table();
+    }
+}
@@ -9,6 +9,8 @@
 #include <map>
 #include <array>
 #include <string>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <string_view>
 
@@ -17,6 +19,7 @@
 #include "chemfiles/parse.hpp"
 #include "chemfiles/warnings.hpp"
 #include "chemfiles/error_fmt.hpp"
+#include "chemfiles/write_numbers.hpp"
 #include "chemfiles/external/optional.hpp"
 
 #include "chemfiles/File.hpp"
@@ -96,17 +99,17 @@ void GROFormat::read_next(Frame& frame) {
         auto name = std::string(trim(line.substr(10, 5)));
 
         // GRO files store atoms in nanometer, we need to convert to Angstroms
-        auto x = parse<double>(line.substr(20, 8)) * 10;
-        auto y = parse<double>(line.substr(28, 8)) * 10;
-        auto z = parse<double>(line.substr(36, 8)) * 10;
+        auto x = parse_fixed<double>(line.substr(20, 8)) * 10;
+        auto y = parse_fixed<double>(line.substr(28, 8)) * 10;
+        auto z = parse_fixed<double>(line.substr(36, 8)) * 10;
 
         double vx = 0;
         double vy = 0;
         double vz = 0;
         if (line.length() >= 68) {
-            vx = parse<double>(line.substr(44, 8)) * 10;
-            vy = parse<double>(line.substr(52, 8)) * 10;
-            vz = parse<double>(line.substr(60, 8)) * 10;
+            vx = parse_fixed<double>(line.substr(44, 8)) * 10;
+            vy = parse_fixed<double>(line.substr(52, 8)) * 10;
+            vz = parse_fixed<double>(line.substr(60, 8)) * 10;
         }
         frame.add_atom(Atom(name), {x, y, z}, {vx, vy, vz});
 
@@ -164,18 +167,6 @@ void GROFormat::read_next(Frame& frame) {
     }
 }
 
-static std::string to_gro_index(uint64_t i) {
-    if (i >= 99999) {
-        if (i == 99999) {
-            // Only warn once for this
-            warning("GRO writer", "too many atoms, removing atomic id bigger than 100000");
-        }
-        return "*****";
-    } else {
-        return std::to_string(i + 1);
-    }
-}
-
 void GROFormat::write_next(const Frame& frame) {
     file_.print("{}\n", frame.get<Property::STRING>("name").value_or("GRO File produced by chemfiles"));
     file_.print("{: >5d}\n", frame.size());
@@ -191,19 +182,23 @@ void GROFormat::write_next(const Frame& frame) {
         }
     }
 
+    // Find the residue and residue id of all atoms first, since generated
+    // residue ids depend on the previous atoms. This pass also checks the
+    // values and emits all the warnings, in the same order as they would be
+    // for a serial writer, before anything is formatted in parallel.
     const auto& positions = frame.positions();
+    const auto& velocities = frame.velocities();
+    auto residues = std::vector<const Residue*>(frame.size(), nullptr);
+    auto resids = std::vector<int64_t>(frame.size(), -1);
     for (size_t i = 0; i < frame.size(); i++) {
-        std::string resname = "XXXXX";
-        std::string resid = "-1";
         auto residue = frame.topology().residue_for_atom(i);
         if (residue) {
-            resname = residue->name();
-            if (resname.length() > 5) {
+            residues[i] = &(*residue);
+            if (residue->name().length() > 5) {
                 warning("GRO writer",
                     "residue '{}' name is too long, it will be truncated",
-                    resname
+                    residue->name()
                 );
-                resname = resname.substr(0, 5);
             }
         }
 
@@ -213,10 +208,10 @@ void GROFormat::write_next(const Frame& frame) {
                 warning("GRO writer", "the residue id '{}' should not be negative or zero, treating it as blank", value);
                 value = max_resid++;
                 if (value <= 99999) {
-                    resid = std::to_string(value);
+                    resids[i] = value;
                 }
             } else if (value <= 99999) {
-                resid = std::to_string(value);
+                resids[i] = value;
             } else {
                 warning("GRO writer", "too many residues, removing residue id");
             }
@@ -224,28 +219,50 @@ void GROFormat::write_next(const Frame& frame) {
             // We need to manually assign a residue ID
             auto value = max_resid++;
             if (value <= 99999) {
-                resid = std::to_string(value);
+                resids[i] = value;
             }
         }
 
-        assert(resname.length() <= 5);
+        check_values_size(positions[i] / 10, 8, "atomic position");
+        if (i == 99999) {
+            // Only warn once for this
+            warning("GRO writer", "too many atoms, removing atomic id bigger than 100000");
+        }
+        if (velocities) {
+            check_values_size((*velocities)[i] / 10, 8, "atomic velocity");
+        }
+    }
+
+    write_records(file_, frame.size(), [&](line_buffer& line, size_t i) {
+        auto resname = std::string_view("XXXXX");
+        if (residues[i] != nullptr) {
+            resname = std::string_view(residues[i]->name()).substr(0, 5);
+        }
+
         auto pos = positions[i] / 10;
-        check_values_size(pos, 8, "atomic position");
-
-        if (frame.velocities()) {
-            auto vel = (*frame.velocities())[i] / 10;
-            check_values_size(vel, 8, "atomic velocity");
-            file_.print(
-                "{: >5}{: <5}{: >5}{: >5}{:8.3f}{:8.3f}{:8.3f}{:8.4f}{:8.4f}{:8.4f}\n",
-                resid, resname, frame[i].name(), to_gro_index(i), pos[0], pos[1], pos[2], vel[0], vel[1], vel[2]
-            );
+
+        // "{: >5}{: <5}{: >5}{: >5}{:8.3f}{:8.3f}{:8.3f}", followed by
+        // "{:8.4f}{:8.4f}{:8.4f}" for velocities
+        write_integer(line, resids[i], 5);
+        write_left(line, resname, 5);
+        write_right(line, frame[i].name(), 5);
+        if (i < 99999) {
+            write_integer(line, static_cast<int64_t>(i + 1), 5);
         } else {
-            file_.print(
-                "{: >5}{: <5}{: >5}{: >5}{:8.3f}{:8.3f}{:8.3f}\n",
-                resid, resname, frame[i].name(), to_gro_index(i), pos[0], pos[1], pos[2]
-            );
+            write_string(line, "*****");
         }
-    }
+        for (auto coordinate: pos) {
+            write_fixed<3>(line, coordinate, 8);
+        }
+
+        if (velocities) {
+            auto vel = (*velocities)[i] / 10;
+            for (auto component: vel) {
+                write_fixed<4>(line, component, 8);
+            }
+        }
+        write_string(line, "\n");
+    });
 
     const auto& cell = frame.cell();
     // While this line is free form, we should try to print it in a pretty way that most gro parsers expect
@@ -301,14 +318,40 @@ optional<uint64_t> GROFormat::forward() {
         );
     }
 
-    for (size_t i=0; i<n_atoms+1; i++) {
-        if (file_.eof()) {
-            throw format_error(
-                "not enough lines in '{}' for GRO format", file_.path()
-            );
-        }
-        file_.readline();
+    if (file_.skiplines(n_atoms + 1) != n_atoms + 1) {
+        throw format_error(
+            "not enough lines in '{}' for GRO format", file_.path()
+        );
     }
 
     return position;
 }
+
+std::unique_ptr<TextFormat> GROFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<GROFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> GROFormat::find_next_step() {
+    // look for a line containing only the number of atoms, the step starts
+    // with the comment line just before it
+    auto previous = optional<uint64_t>();
+    while (!file_.eof()) {
+        auto position = file_.tellpos();
+        auto line = trim(file_.readline());
+
+        auto all_digits = !line.empty();
+        for (auto c: line) {
+            if (!is_ascii_digit(c)) {
+                all_digits = false;
+                break;
+            }
+        }
+
+        if (all_digits && previous) {
+            file_.seekpos(*previous);
+            return previous;
+        }
+        previous = position;
+    }
+    return nullopt;
+}
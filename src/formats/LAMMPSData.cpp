@@ -466,6 +466,8 @@ void LAMMPSDataFormat::read_bonds(Frame& frame) {
     if (nbonds_ == 0) {
         throw format_error("missing bonds count in header");
     }
+    auto bonds = std::vector<Bond>();
+    bonds.reserve(nbonds_);
     size_t n = 0;
     while (n < nbonds_ && !file_.eof()) {
         auto line = file_.readline();
@@ -481,13 +483,14 @@ void LAMMPSDataFormat::read_bonds(Frame& frame) {
         // LAMMPS use 1-based indexing
         auto i = parse<size_t>(splitted[2]) - 1;
         auto j = parse<size_t>(splitted[3]) - 1;
-        frame.add_bond(i, j);
+        bonds.emplace_back(i, j);
         n++;
     }
 
     if (file_.eof() && n < nbonds_) {
         throw format_error("end of file found before getting all bonds");
     }
+    frame.add_bonds(bonds);
 
     get_next_section();
 }
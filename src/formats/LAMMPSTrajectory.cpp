@@ -8,6 +8,7 @@
 
 #include <array>
 #include <string>
+#include <memory>
 #include <vector>
 #include <string_view>
 
@@ -385,9 +386,11 @@ void LAMMPSTrajectoryFormat::read_next(Frame& frame) {
     auto positions = frame.positions();
     auto velocities = frame.velocities();
 
+    auto splitted = std::vector<std::string_view>();
+    splitted.reserve(fields.size());
     for (size_t i = 0; i < natoms; ++i) {
         auto line = file_.readline();
-        auto splitted = split(line, ' ');
+        split_whitespace(line, splitted);
         if (splitted.size() != fields.size()) {
             throw format_error(
                 "LAMMPS atom line has wrong number of fields: expected {} got {}",
@@ -730,14 +733,37 @@ optional<uint64_t> LAMMPSTrajectoryFormat::forward() {
         );
     }
 
-    for (size_t i = 0; i < natoms; ++i) {
-        file_.readline();
-        if (file_.eof()) {
-            throw format_error(
-                "this file does not contain enough lines in ATOMS section for LAMMPS trajectory"
-            );
-        }
+    // all the atoms lines must be followed by a newline
+    file_.skiplines(natoms);
+    if (natoms != 0 && file_.eof()) {
+        throw format_error(
+            "this file does not contain enough lines in ATOMS section for LAMMPS trajectory"
+        );
     }
 
     return position;
 }
+
+std::unique_ptr<TextFormat> LAMMPSTrajectoryFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<LAMMPSTrajectoryFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> LAMMPSTrajectoryFormat::find_next_step() {
+    // Steps start right after the atoms of the previous step, i.e. on the
+    // first ITEM line after an 'ITEM: ATOMS' section.
+    auto in_atoms = false;
+    while (!file_.eof()) {
+        auto position = file_.tellpos();
+        auto item = get_item(file_.readline());
+        if (!item) {
+            continue;
+        }
+
+        if (in_atoms) {
+            file_.seekpos(position);
+            return position;
+        }
+        in_atoms = item->substr(0, 5) == "ATOMS";
+    }
+    return nullopt;
+}
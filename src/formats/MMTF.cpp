@@ -101,8 +101,13 @@ MMTFFormat::MMTFFormat(std::shared_ptr<MemoryBuffer> memory, File::Mode mode, Fi
         throw format_error("the MMTF format cannot write to memory");
     }
 
-    memory->decompress(compression);
-    decode(memory->data(), memory->size(), "memory");
+    if (compression == File::DEFAULT) {
+        decode(memory->data(), memory->size(), "memory");
+    } else {
+        auto file = TextFile(std::move(memory), mode, compression);
+        auto buffer = file.readall();
+        decode(buffer.data(), buffer.size(), "memory");
+    }
 }
 
 void MMTFFormat::decode(const char* data, size_t size, const std::string& source) {
@@ -224,6 +229,8 @@ void MMTFFormat::read_model(Frame& frame) {
 
     frame.resize(natoms);
     auto positions = frame.positions();
+    bonds_.clear();
+    bond_orders_.clear();
 
     // Read the structure iterating over the chains in the model, then the
     // residues/groups in the chain and finally the atoms in the residue/group
@@ -241,13 +248,15 @@ void MMTFFormat::read_model(Frame& frame) {
             read_group(frame, group_type, residue, positions);
             frame.add_residue(std::move(residue));
 
-            add_inter_residue_bonds(frame);
+            add_inter_residue_bonds();
 
             groupIndex_++;
         }
         chainIndex_++;
     }
     modelIndex_++;
+
+    frame.add_bonds(bonds_, bond_orders_);
 }
 
 std::string MMTFFormat::find_assembly() {
@@ -336,15 +345,12 @@ void MMTFFormat::read_group(Frame& frame, size_t group_type, Residue& residue, s
         auto atom1 = static_cast<size_t>(group.bondAtomList[l * 2]);
         auto atom2 = static_cast<size_t>(group.bondAtomList[l * 2 + 1]);
 
-        frame.add_bond(
-            global_indexes[atom1],
-            global_indexes[atom2],
-            bond_order_to_chemfiles(group.bondOrderList[l])
-        );
+        bonds_.emplace_back(global_indexes[atom1], global_indexes[atom2]);
+        bond_orders_.push_back(bond_order_to_chemfiles(group.bondOrderList[l]));
     }
 }
 
-void MMTFFormat::add_inter_residue_bonds(Frame& frame) {
+void MMTFFormat::add_inter_residue_bonds() {
     auto inter_residue_bond_count = structure_.bondAtomList.size() / 2;
 
     // Add additional global (not by group) bonds
@@ -357,7 +363,8 @@ void MMTFFormat::add_inter_residue_bonds(Frame& frame) {
             break;
         }
 
-        frame.add_bond(atom_id(atom1), atom_id(atom2));
+        bonds_.emplace_back(atom_id(atom1), atom_id(atom2));
+        bond_orders_.push_back(Bond::UNKNOWN);
         interBondIndex_++;
     }
 }
@@ -366,8 +373,8 @@ void MMTFFormat::apply_symmetry(Frame& frame) {
     const auto original_size = frame.size();
     const auto original_bond_size = frame.topology().bonds().size();
 
-    using bond_w_order = std::pair<Bond, Bond::BondOrder>;
-    std::vector<bond_w_order> bonds_to_add;
+    std::vector<Bond> bonds_to_add;
+    std::vector<Bond::BondOrder> bond_orders_to_add;
 
     for (const auto& assembly : structure_.bioAssemblyList) {
 
@@ -460,14 +467,13 @@ void MMTFFormat::apply_symmetry(Frame& frame) {
                     continue;
                 }
 
-                bonds_to_add.push_back({ {new_bond_0, new_bond_1}, frame.topology().bond_orders()[i] });
+                bonds_to_add.emplace_back(new_bond_0, new_bond_1);
+                bond_orders_to_add.push_back(frame.topology().bond_orders()[i]);
             }
         }
     }
 
-    for (auto& bond : bonds_to_add) {
-        frame.add_bond(bond.first[0], bond.first[1], bond.second);
-    }
+    frame.add_bonds(bonds_to_add, bond_orders_to_add);
 }
 
 void MMTFFormat::write(const Frame& frame) {
@@ -6,6 +6,7 @@
 
 #include <array>
 #include <string>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <string_view>
@@ -174,6 +175,11 @@ void MOL2Format::read_atoms(Frame& frame, size_t natoms, bool charges) {
 }
 
 void MOL2Format::read_bonds(Frame& frame, size_t nbonds) {
+    auto bonds = std::vector<Bond>();
+    auto bond_orders = std::vector<Bond::BondOrder>();
+    bonds.reserve(nbonds);
+    bond_orders.reserve(nbonds);
+
     for (size_t i=0; i<nbonds; i++) {
         auto line = file_.readline();
 
@@ -211,8 +217,11 @@ void MOL2Format::read_bonds(Frame& frame, size_t nbonds) {
             order = Bond::UNKNOWN;
         }
 
-        frame.add_bond(id_1, id_2, order);
+        bonds.emplace_back(id_1, id_2);
+        bond_orders.push_back(order);
     }
+
+    frame.add_bonds(bonds, bond_orders);
 }
 
 uint64_t read_until(TextFile& file, std::string_view tag) {
@@ -276,6 +285,20 @@ optional<uint64_t> MOL2Format::forward() {
     return position;
 }
 
+std::unique_ptr<TextFormat> MOL2Format::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<MOL2Format>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> MOL2Format::find_next_step() {
+    try {
+        auto position = read_until(file_, "@<TRIPOS>MOLECULE");
+        file_.seekpos(position);
+        return position;
+    } catch (const FormatError&) {
+        return nullopt;
+    }
+}
+
 void MOL2Format::write_next(const Frame& frame) {
     file_.print("@<TRIPOS>MOLECULE\n");
     file_.print("{}\n", frame.get<Property::STRING>("name").value_or(""));
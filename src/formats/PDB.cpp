@@ -7,9 +7,12 @@
 #include <cstdint>
 
 #include <map>
+#include <functional>
+#include <unordered_map>
 #include <array>
 #include <deque>
 #include <string>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -20,6 +23,7 @@
 #include "chemfiles/parse.hpp"
 #include "chemfiles/warnings.hpp"
 #include "chemfiles/error_fmt.hpp"
+#include "chemfiles/write_numbers.hpp"
 #include "chemfiles/external/optional.hpp"
 
 #include "chemfiles/File.hpp"
@@ -83,6 +87,18 @@ bool chemfiles::operator<(const FullResidueId& lhs, const FullResidueId& rhs) {
     }
 }
 
+size_t std::hash<FullResidueId>::operator()(const FullResidueId& id) const {
+    // the residue name is not used, since residues with the same chain, id
+    // and insertion code but a different name are very rare
+    auto value = static_cast<uint64_t>(id.resid) << 16;
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(id.chain)) << 8;
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(id.insertion_code));
+    // mix the bits with the finalizer from splitmix64
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    return static_cast<size_t>(value ^ (value >> 31));
+}
+
 /// Check the number of digits before the decimal separator to be sure than we
 /// can represent them. In case of error, use the given `context` in the error
 /// message
@@ -122,7 +138,10 @@ static Record get_record(std::string_view line);
 
 void PDBFormat::read_next(Frame& frame) {
     residues_.clear();
+    residues_indexes_.clear();
+    residues_sorted_ = true;
     atom_offsets_.clear();
+    conect_bonds_.clear();
 
     uint64_t position;
     bool got_end = false;
@@ -180,13 +199,22 @@ void PDBFormat::read_next(Frame& frame) {
             got_end = true;
             continue;
         case Record::HELIX:
-            read_HELIX(line);
-            continue;
         case Record::SHEET:
-            read_secondary(line, 17, 28, "SHEET");
-            continue;
         case Record::TURN:
-            read_secondary(line, 15, 26, "TURN");
+            if (parallel_) {
+                // these records change the secondary structure of all the
+                // following steps, which are read by other readers. Reading
+                // in parallel will fail, and the steps will be read again
+                // serially.
+                throw format_error("can not read secondary structure records in parallel");
+            }
+            if (record == Record::HELIX) {
+                read_HELIX(line);
+            } else if (record == Record::SHEET) {
+                read_secondary(line, 17, 28, "SHEET");
+            } else {
+                read_secondary(line, 15, 26, "TURN");
+            }
             continue;
         case Record::TER:
             if (line.size() >= 12) {
@@ -221,6 +249,7 @@ void PDBFormat::read_next(Frame& frame) {
     }
 
     chain_ended(frame);
+    frame.add_bonds(conect_bonds_);
     link_standard_residue_bonds(frame);
 }
 
@@ -231,14 +260,14 @@ void PDBFormat::read_CRYST1(Frame& frame, std::string_view line) {
     }
     try {
         auto lengths = Vector3D(
-            parse<double>(line.substr(6, 9)),
-            parse<double>(line.substr(15, 9)),
-            parse<double>(line.substr(24, 9))
+            parse_fixed<double>(line.substr(6, 9)),
+            parse_fixed<double>(line.substr(15, 9)),
+            parse_fixed<double>(line.substr(24, 9))
         );
         auto angles = Vector3D(
-            parse<double>(line.substr(33, 7)),
-            parse<double>(line.substr(40, 7)),
-            parse<double>(line.substr(47, 7))
+            parse_fixed<double>(line.substr(33, 7)),
+            parse_fixed<double>(line.substr(40, 7)),
+            parse_fixed<double>(line.substr(47, 7))
         );
 
         frame.set_cell({lengths, angles});
@@ -396,9 +425,9 @@ void PDBFormat::read_ATOM(Frame& frame, std::string_view line, bool is_hetatm) {
     }
 
     try {
-        auto x = parse<double>(line.substr(30, 8));
-        auto y = parse<double>(line.substr(38, 8));
-        auto z = parse<double>(line.substr(46, 8));
+        auto x = parse_fixed<double>(line.substr(30, 8));
+        auto y = parse_fixed<double>(line.substr(38, 8));
+        auto z = parse_fixed<double>(line.substr(46, 8));
 
         frame.add_atom(std::move(atom), Vector3D(x, y, z));
     } catch (const Error&) {
@@ -418,53 +447,67 @@ void PDBFormat::read_ATOM(Frame& frame, std::string_view line, bool is_hetatm) {
     auto chain = line[21];
     auto resname = std::string(trim(line.substr(17, 3)));
     auto full_residue_id = FullResidueId {chain, resid, resname, insertion_code};
-    if (residues_.count(full_residue_id) == 0) {
-        Residue residue(std::move(resname), resid);
-        residue.add_atom(atom_id);
-
-        if (insertion_code != ' ') {
-            residue.set("insertion_code", std::string(line.substr(26, 1)));
-        }
-
-        // Set whether or not the residue is standardized
-        residue.set("is_standard_pdb", !is_hetatm);
-        // This is saved as a string (instead of a number) on purpose
-        // to match MMTF format
-        residue.set("chainid", std::string(line.substr(21, 1)));
-        // PDB format makes no distinction between chainid and chainname
-        residue.set("chainname", std::string(line.substr(21, 1)));
-
-        // segment name is not part of the standard, but something added by
-        // CHARM/NAMD in the un-used character range 73-76
-        if (line.length() > 72) {
-            auto segname = trim(line.substr(72, 4));
-            if (segname != "") {
-                residue.set("segname", std::string(segname));
-            }
-        }
 
-        // Are we withing a secondary information sequence?
-        if (current_secinfo_) {
-            residue.set("secondary_structure", current_secinfo_->second);
+    // most atoms are in the same residue as the previous atom, check this
+    // first to skip the hash table lookup
+    if (!residues_.empty() && residues_.back().first == full_residue_id) {
+        residues_.back().second.add_atom(atom_id);
+        return;
+    }
 
-            // Are we the end of a secondary information sequence?
-            if (current_secinfo_->first == full_residue_id) {
-                current_secinfo_ = nullopt;
-            }
+    auto it = residues_indexes_.find(full_residue_id);
+    if (it != residues_indexes_.end()) {
+        // Just add this atom to the residue
+        residues_[it->second].second.add_atom(atom_id);
+        return;
+    }
+
+    Residue residue(std::move(resname), resid);
+    residue.add_atom(atom_id);
+
+    if (insertion_code != ' ') {
+        residue.set("insertion_code", std::string(line.substr(26, 1)));
+    }
+
+    // Set whether or not the residue is standardized
+    residue.set("is_standard_pdb", !is_hetatm);
+    // This is saved as a string (instead of a number) on purpose
+    // to match MMTF format
+    residue.set("chainid", std::string(line.substr(21, 1)));
+    // PDB format makes no distinction between chainid and chainname
+    residue.set("chainname", std::string(line.substr(21, 1)));
+
+    // segment name is not part of the standard, but something added by
+    // CHARM/NAMD in the un-used character range 73-76
+    if (line.length() > 72) {
+        auto segname = trim(line.substr(72, 4));
+        if (segname != "") {
+            residue.set("segname", std::string(segname));
         }
+    }
+
+    // Are we withing a secondary information sequence?
+    if (current_secinfo_) {
+        residue.set("secondary_structure", current_secinfo_->second);
 
-        // Are we the start of a secondary information sequence?
-        auto secinfo_for_residue = secinfo_.find(full_residue_id);
-        if (secinfo_for_residue != secinfo_.end()) {
-            current_secinfo_ = secinfo_for_residue->second;
-            residue.set("secondary_structure", secinfo_for_residue->second.second);
+        // Are we the end of a secondary information sequence?
+        if (current_secinfo_->first == full_residue_id) {
+            current_secinfo_ = nullopt;
         }
+    }
 
-        residues_.emplace(full_residue_id, residue);
-    } else {
-        // Just add this atom to the residue
-        residues_.at(full_residue_id).add_atom(atom_id);
+    // Are we the start of a secondary information sequence?
+    auto secinfo_for_residue = secinfo_.find(full_residue_id);
+    if (secinfo_for_residue != secinfo_.end()) {
+        current_secinfo_ = secinfo_for_residue->second;
+        residue.set("secondary_structure", secinfo_for_residue->second.second);
     }
+
+    if (!residues_.empty() && !(residues_.back().first < full_residue_id)) {
+        residues_sorted_ = false;
+    }
+    residues_indexes_.emplace(full_residue_id, residues_.size());
+    residues_.emplace_back(std::move(full_residue_id), std::move(residue));
 }
 
 void PDBFormat::read_CONECT(Frame& frame, std::string_view line) {
@@ -472,7 +515,7 @@ void PDBFormat::read_CONECT(Frame& frame, std::string_view line) {
     auto line_length = trim(line).length();
 
     // Helper lambdas
-    auto add_bond = [&frame, &line](size_t i, size_t j) {
+    auto add_bond = [&frame, &line, this](size_t i, size_t j) {
         if (i >= frame.size() || j >= frame.size()) {
             warning("PDB reader",
                 "ignoring CONECT ('{}') with atomic indexes bigger than frame size ({})",
@@ -480,7 +523,7 @@ void PDBFormat::read_CONECT(Frame& frame, std::string_view line) {
             );
             return;
         }
-        frame.add_bond(i, j);
+        conect_bonds_.emplace_back(i, j);
     };
 
     auto read_index = [&line,this](size_t initial) -> size_t {
@@ -527,8 +570,22 @@ void PDBFormat::read_CONECT(Frame& frame, std::string_view line) {
 }
 
 void PDBFormat::chain_ended(Frame& frame) {
-    for (const auto& residue: residues_) {
-        frame.add_residue(residue.second);
+    // residues are added to the frame sorted by their full id
+    if (residues_sorted_) {
+        for (auto& residue: residues_) {
+            frame.add_residue(std::move(residue.second));
+        }
+    } else {
+        auto order = std::vector<size_t>(residues_.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs) {
+            return residues_[lhs].first < residues_[rhs].first;
+        });
+        for (auto i: order) {
+            frame.add_residue(std::move(residues_[i].second));
+        }
     }
 
     // This is a 'hack' to allow for badly formatted PDB files which restart
@@ -536,101 +593,195 @@ void PDBFormat::chain_ended(Frame& frame) {
     // IE a metal Ion given the chain ID of A and residue ID of 1 even though
     // this residue already exists.
     residues_.clear();
+    residues_indexes_.clear();
+    residues_sorted_ = true;
+}
+
+/// Marker for atoms missing from a residue in `link_standard_residue_bonds`
+static constexpr size_t MISSING_ATOM = static_cast<size_t>(-1);
+
+namespace {
+/// Connectivity of a standard residue, compiled from the `PDBConnectivity`
+/// tables. Atoms in the template are identified by a local index, which is
+/// resolved once for each atom of a residue.
+struct ResidueTemplate {
+    /// Local index for all atom names used when linking this residue
+    std::unordered_map<std::string, size_t> indexes;
+    /// Names of the atoms, in the same order as the local indexes. The first
+    /// `standard_atoms` atoms are the atoms of the standard residue, and the
+    /// other ones are only used to link residues together.
+    std::vector<std::string> names;
+    size_t standard_atoms = 0;
+    /// Should we warn if the standard atom at a given local index is missing?
+    std::vector<bool> warn_if_missing;
+    /// Bonds between the standard atoms, with each bond only once
+    std::vector<std::pair<size_t, size_t>> bonds;
+
+    /// Local indexes of the atoms used to link consecutive residues, and of
+    /// the special-cased 5' terminal hydroxyl
+    size_t amide_nitrogen = 0;
+    size_t amide_carbon = 0;
+    size_t three_prime_oxygen = 0;
+    size_t five_prime_phosphorus = 0;
+    size_t five_prime_oxygen = 0;
+    size_t five_prime_hydrogen = 0;
+
+    /// Get the local index for the atom with the given `name`, adding it to
+    /// the template if needed
+    size_t index(const std::string& name) {
+        auto it = indexes.find(name);
+        if (it != indexes.end()) {
+            return it->second;
+        }
+        auto index = names.size();
+        indexes.emplace(name, index);
+        names.push_back(name);
+        return index;
+    }
+};
+}
+
+static ResidueTemplate compile_residue_template(const PDBConnectivity::ResidueConnectMap& table) {
+    auto result = ResidueTemplate();
+    for (const auto& link: table) {
+        auto i = result.index(link.first);
+        auto j = result.index(link.second);
+        // the table contains all bonds in both directions
+        if (i < j) {
+            result.bonds.emplace_back(i, j);
+        } else if (j < i) {
+            result.bonds.emplace_back(j, i);
+        }
+    }
+    std::sort(result.bonds.begin(), result.bonds.end());
+    result.bonds.erase(std::unique(result.bonds.begin(), result.bonds.end()), result.bonds.end());
+
+    result.standard_atoms = result.names.size();
+    for (const auto& name: result.names) {
+        result.warn_if_missing.push_back(
+            name[0] != 'H' && name != "OXT" && name[0] != 'P' && name.substr(0, 2) != "OP"
+        );
+    }
+
+    result.amide_nitrogen = result.index("N");
+    result.amide_carbon = result.index("C");
+    result.three_prime_oxygen = result.index("O3'");
+    result.five_prime_phosphorus = result.index("P");
+    result.five_prime_oxygen = result.index("O5'");
+    result.five_prime_hydrogen = result.index("HO5'");
+
+    return result;
+}
+
+/// Get the compiled templates for all standard residues, indexed by residue
+/// name. The templates are compiled once, the first time this is called.
+static const std::unordered_map<std::string, ResidueTemplate>& residue_templates() {
+    static const auto TEMPLATES = []() {
+        auto templates = std::unordered_map<std::string, ResidueTemplate>();
+        for (const auto& it: PDBConnectivity::all()) {
+            templates.emplace(it.first, compile_residue_template(it.second));
+        }
+        return templates;
+    }();
+    return TEMPLATES;
 }
 
 void PDBFormat::link_standard_residue_bonds(Frame& frame) {
+    const auto& templates = residue_templates();
+
     bool link_previous_peptide = false;
     bool link_previous_nucleic = false;
     int64_t previous_residue_id = 0;
     size_t previous_carboxylic_id = 0;
 
+    // all the bonds are collected first, and then added to the frame in
+    // sorted order
+    auto bonds = std::vector<Bond>();
+    // index of the atoms in the frame for each local index in the template
+    auto atoms = std::vector<size_t>();
     for (const auto& residue: frame.topology().residues()) {
-        auto residue_table = PDBConnectivity::find(residue.name());
-        if (!residue_table) {
+        auto it = templates.find(residue.name());
+        if (it == templates.end()) {
             continue;
         }
+        const auto& residue_template = it->second;
 
-        std::map<std::string, size_t> atom_name_to_index;
-        for (size_t atom : residue) {
-            atom_name_to_index[frame[atom].name()] =  atom;
+        atoms.assign(residue_template.names.size(), MISSING_ATOM);
+        for (auto atom: residue) {
+            auto local = residue_template.indexes.find(frame[atom].name());
+            if (local != residue_template.indexes.end()) {
+                atoms[local->second] = atom;
+            }
         }
 
-        const auto& amide_nitrogen = atom_name_to_index.find("N");
-        const auto& amide_carbon = atom_name_to_index.find("C");
-
         if (!residue.id()) {
             warning("PDB reader", "got a residues without id, this should not happen");
             continue;
         }
 
         auto resid = *residue.id();
+        auto amide_nitrogen = atoms[residue_template.amide_nitrogen];
         if (link_previous_peptide &&
-            amide_nitrogen != atom_name_to_index.end() &&
+            amide_nitrogen != MISSING_ATOM &&
             resid == previous_residue_id + 1 )
         {
             link_previous_peptide = false;
-            frame.add_bond(previous_carboxylic_id, amide_nitrogen->second);
+            bonds.emplace_back(previous_carboxylic_id, amide_nitrogen);
         }
 
-        if (amide_carbon != atom_name_to_index.end() ) {
+        auto amide_carbon = atoms[residue_template.amide_carbon];
+        if (amide_carbon != MISSING_ATOM) {
             link_previous_peptide = true;
-            previous_carboxylic_id = amide_carbon->second;
+            previous_carboxylic_id = amide_carbon;
             previous_residue_id = resid;
         }
 
-        const auto& three_prime_oxygen = atom_name_to_index.find("O3'");
-        const auto& five_prime_phosphorus = atom_name_to_index.find("P");
-
+        auto three_prime_oxygen = atoms[residue_template.three_prime_oxygen];
+        auto five_prime_phosphorus = atoms[residue_template.five_prime_phosphorus];
         if (link_previous_nucleic &&
-            five_prime_phosphorus != atom_name_to_index.end() &&
+            five_prime_phosphorus != MISSING_ATOM &&
             resid == previous_residue_id + 1 )
         {
+            // the phosphate links the O3' of the previous nucleotide to the
+            // O5' of this one
             link_previous_nucleic = false;
-            frame.add_bond(previous_carboxylic_id, three_prime_oxygen->second);
+            bonds.emplace_back(previous_carboxylic_id, five_prime_phosphorus);
         }
 
-        if (three_prime_oxygen != atom_name_to_index.end() ) {
+        if (three_prime_oxygen != MISSING_ATOM) {
             link_previous_nucleic = true;
-            previous_carboxylic_id = three_prime_oxygen->second;
+            previous_carboxylic_id = three_prime_oxygen;
             previous_residue_id = resid;
         }
 
         // A special case missed by the standards committee????
-        if (atom_name_to_index.count("HO5'") != 0) {
-            frame.add_bond(atom_name_to_index["HO5'"], atom_name_to_index["O5'"]);
-        }
-
-        for (const auto& link: *residue_table) {
-            const auto& first_atom = atom_name_to_index.find(link.first);
-            const auto& second_atom = atom_name_to_index.find(link.second);
-
-            if (first_atom == atom_name_to_index.end()) {
-                const auto& first_name = link.first.string();
-                if (first_name[0] != 'H' && first_name != "OXT" &&
-                    first_name[0] != 'P' && first_name.substr(0, 2) != "OP" ) {
-                    warning("PDB reader",
-                        "could not find standard atom '{}' in residue '{}' (resid {})",
-                        first_name, residue.name(), resid
-                    );
-                }
-                continue;
-            }
+        auto five_prime_hydrogen = atoms[residue_template.five_prime_hydrogen];
+        auto five_prime_oxygen = atoms[residue_template.five_prime_oxygen];
+        if (five_prime_hydrogen != MISSING_ATOM && five_prime_oxygen != MISSING_ATOM) {
+            bonds.emplace_back(five_prime_hydrogen, five_prime_oxygen);
+        }
 
-            if (second_atom == atom_name_to_index.end()) {
-                const auto& second_name = link.second.string();
-                if (second_name[0] != 'H' && second_name != "OXT" &&
-                    second_name[0] != 'P' && second_name.substr(0, 2) != "OP" ) {
-                        warning("PDB reader",
-                            "could not find standard atom '{}' in residue '{}' (resid {})",
-                            second_name, residue.name(), resid
-                        );
-                }
-                continue;
+        for (size_t i = 0; i < residue_template.standard_atoms; i++) {
+            if (atoms[i] == MISSING_ATOM && residue_template.warn_if_missing[i]) {
+                warning("PDB reader",
+                    "could not find standard atom '{}' in residue '{}' (resid {})",
+                    residue_template.names[i], residue.name(), resid
+                );
             }
+        }
 
-            frame.add_bond(first_atom->second, second_atom->second);
+        for (const auto& bond: residue_template.bonds) {
+            auto first = atoms[bond.first];
+            auto second = atoms[bond.second];
+            if (first != MISSING_ATOM && second != MISSING_ATOM) {
+                bonds.emplace_back(first, second);
+            }
         }
     }
+
+    std::sort(bonds.begin(), bonds.end());
+    bonds.erase(std::unique(bonds.begin(), bonds.end()), bonds.end());
+    frame.add_bonds(bonds);
 }
 
 Record get_record(std::string_view line) {
@@ -682,15 +833,36 @@ Record get_record(std::string_view line) {
     }
 }
 
+/// Warn if `value` is the first value too large to be written as a PDB index
+/// with `width` characters. Larger values are not reported again.
+static void check_pdb_index(int64_t value, size_t width) {
+    if (value == MAX_HYBRID36_W4_NUMBER || value == MAX_HYBRID36_W5_NUMBER) {
+        auto encoded = encode_hybrid36(width, value + 1);
+        if (encoded[0] == '*') {
+            const auto* type = width == 5 ? "atom" : "residue";
+            warning("PDB writer", "the value for a {} serial/id is too large, using '{}' instead", type, encoded);
+        }
+    }
+}
+
 static std::string to_pdb_index(int64_t value, size_t width) {
-    auto encoded = encode_hybrid36(width, value + 1);
+    check_pdb_index(value, width);
+    return encode_hybrid36(width, value + 1);
+}
 
-    if (encoded[0] == '*' && (value == MAX_HYBRID36_W4_NUMBER || value == MAX_HYBRID36_W5_NUMBER)) {
-        const auto* type = width == 5 ? "atom" : "residue";
-        warning("PDB writer", "the value for a {} serial/id is too large, using '{}' instead", type, encoded);
+/// Write the PDB index for `value` in `output`, right-aligned in a field of
+/// `width` characters. This is equivalent to `to_pdb_index`, but uses
+/// `write_integer` instead of hybrid-36 encoding for the common case of
+/// small values. This function does not emit warnings, and can be called from
+/// multiple threads: `check_pdb_index` should be called on the value first.
+static void write_pdb_index(line_buffer& output, int64_t value, size_t width) {
+    // values are written as `value + 1`, and hybrid-36 uses plain decimal
+    // numbers below 10^width
+    if (value >= 0 && static_cast<uint64_t>(value) + 1 < detail::POWERS_OF_TEN[width]) {
+        write_integer(output, value + 1, width);
+    } else {
+        write_right(output, encode_hybrid36(width, value + 1), width);
     }
-
-    return encoded;
 }
 
 struct ResidueInformation {
@@ -762,6 +934,23 @@ static ResidueInformation get_residue_information(optional<const Residue&> resid
     return info;
 }
 
+/// Marker for atoms without residue in `PDBFormat::write_next`
+static constexpr size_t NO_RESIDUE = static_cast<size_t>(-1);
+
+/// Information about a single atom, computed before formatting the ATOM or
+/// HETATM record for this atom
+struct AtomRecord {
+    /// Information about the residue containing this atom
+    const ResidueInformation* residue = nullptr;
+    /// Generated residue id, for atoms without residue
+    int64_t resid = 0;
+    /// Serial number of this atom, accounting for the TER records before it
+    int64_t serial = 0;
+    /// If not null, a TER record for this residue should be written before
+    /// this atom
+    const ResidueInformation* ter = nullptr;
+};
+
 static bool needs_ter_record(const ResidueInformation& residue) {
     return !(
         residue.composition_type.empty() ||
@@ -806,6 +995,17 @@ void PDBFormat::write_next(const Frame& frame) {
         }
     }
 
+    // Find the residue of all atoms, and the corresponding residue
+    // information. This information is computed once for each residue.
+    const auto& residues = frame.topology().residues();
+    auto residue_infos = std::vector<optional<ResidueInformation>>(residues.size());
+    auto atom_residues = std::vector<size_t>(frame.size(), NO_RESIDUE);
+    for (size_t r = 0; r < residues.size(); r++) {
+        for (auto atom: residues[r]) {
+            atom_residues[atom] = r;
+        }
+    }
+
     // Used to skip writing unnecessary connect record
     // use std::deque because std::vector<bool> have a surprising behavior due
     // to C++ standard requiring it to pack multiple bool in a byte
@@ -813,51 +1013,107 @@ void PDBFormat::write_next(const Frame& frame) {
 
     // Used for writing TER records.
     size_t ter_count = 0;
-    optional<ResidueInformation> last_residue = nullopt;
+    const ResidueInformation* last_residue = nullptr;
     std::vector<size_t> ter_serial_numbers;
 
+    // TER records, atom serial numbers and generated residue ids depend on the
+    // previous atoms, so they are computed in a first serial pass. This pass
+    // also checks the values and emits all the warnings, in the same order as
+    // a serial writer would. The records are then formatted in parallel.
     const auto& positions = frame.positions();
+    const auto no_residue = ResidueInformation();
+    auto records = std::vector<AtomRecord>(frame.size());
     for (size_t i = 0; i < frame.size(); i++) {
+        auto altloc = frame[i].get<Property::STRING>("altloc");
+        if (altloc && altloc->length() > 1) {
+            warning("PDB writer", "altloc '{}' is too long, it will be truncated", *altloc);
+        }
 
-        auto altloc = frame[i].get<Property::STRING>("altloc").value_or(" ");
-        if (altloc.length() > 1) {
-            warning("PDB writer", "altloc '{}' is too long, it will be truncated", altloc);
-            altloc = altloc[0];
+        auto& record = records[i];
+        auto residue = atom_residues[i];
+        if (residue == NO_RESIDUE) {
+            record.residue = &no_residue;
+            record.resid = max_resid++;
+            check_pdb_index(record.resid, 4);
+        } else {
+            auto& info = residue_infos[residue];
+            if (!info) {
+                info = get_residue_information(residues[residue], max_resid);
+            }
+            record.residue = &(*info);
         }
 
-        auto residue = frame.topology().residue_for_atom(i);
-        auto resinfo = get_residue_information(residue, max_resid);
-        if (resinfo.atom_hetatm == "ATOM  ") {
+        if (record.residue->atom_hetatm == "ATOM  ") {
             is_atom_record[i] = true;
         }
 
-        assert(resinfo.resname.length() <= 3);
+        assert(record.residue->resname.length() <= 3);
 
-        if (last_residue && last_residue->chainid != resinfo.chainid && needs_ter_record(*last_residue)) {
-            file_.print("TER   {: >5}      {:3} {:1}{: >4s}{:1}\n",
-                to_pdb_index(static_cast<int64_t>(i + ter_count), 5),
-                last_residue->resname, last_residue->chainid, last_residue->resid, last_residue->insertion_code);
+        if (last_residue && last_residue->chainid != record.residue->chainid && needs_ter_record(*last_residue)) {
+            record.ter = last_residue;
             ter_serial_numbers.push_back(i + ter_count);
             ++ter_count;
         }
+        record.serial = static_cast<int64_t>(i + ter_count);
 
-        const auto& pos = positions[i];
-        check_values_size(pos, 8, "atomic position");
-        file_.print(
-            "{: <6}{: >5} {: <4s}{:1}{:3} {:1}{: >4s}{:1}   {:8.3f}{:8.3f}{:8.3f}{:6.2f}{:6.2f}      {: <4s}{: >2s}\n",
-            resinfo.atom_hetatm, to_pdb_index(static_cast<int64_t>(i + ter_count), 5), frame[i].name(), altloc,
-            resinfo.resname, resinfo.chainid, resinfo.resid, resinfo.insertion_code,
-            pos[0], pos[1], pos[2], 1.0, 0.0, resinfo.segment, frame[i].type()
-        );
+        if (record.ter != nullptr) {
+            check_pdb_index(record.serial - 1, 5);
+        }
+        check_values_size(positions[i], 8, "atomic position");
+        check_pdb_index(record.serial, 5);
 
-        if (residue) {
-            last_residue = std::move(resinfo);
+        if (residue == NO_RESIDUE) {
+            last_residue = nullptr;
         } else {
-            last_residue = nullopt;
+            last_residue = record.residue;
         }
-
     }
 
+    write_records(file_, frame.size(), [&](line_buffer& line, size_t i) {
+        const auto& record = records[i];
+        const auto& resinfo = *record.residue;
+
+        if (record.ter != nullptr) {
+            // "TER   {: >5}      {:3} {:1}{: >4s}{:1}\n"
+            write_string(line, "TER   ");
+            write_pdb_index(line, record.serial - 1, 5);
+            write_string(line, "      ");
+            write_left(line, record.ter->resname, 3);
+            write_string(line, " ");
+            write_left(line, record.ter->chainid, 1);
+            write_right(line, record.ter->resid, 4);
+            write_left(line, record.ter->insertion_code, 1);
+            write_string(line, "\n");
+        }
+
+        const auto& pos = positions[i];
+        auto altloc = frame[i].get<Property::STRING>("altloc");
+        // "{: <6}{: >5} {: <4s}{:1}{:3} {:1}{: >4s}{:1}   {:8.3f}{:8.3f}{:8.3f}{:6.2f}{:6.2f}      {: <4s}{: >2s}\n"
+        // with occupancy = 1.0 and temperature factor = 0.0
+        write_left(line, resinfo.atom_hetatm, 6);
+        write_pdb_index(line, record.serial, 5);
+        write_string(line, " ");
+        write_left(line, frame[i].name(), 4);
+        write_left(line, altloc ? std::string_view(*altloc).substr(0, 1) : " ", 1);
+        write_left(line, resinfo.resname, 3);
+        write_string(line, " ");
+        write_left(line, resinfo.chainid, 1);
+        if (record.residue == &no_residue) {
+            write_pdb_index(line, record.resid, 4);
+        } else {
+            write_right(line, resinfo.resid, 4);
+        }
+        write_left(line, resinfo.insertion_code, 1);
+        write_string(line, "   ");
+        for (auto coordinate: pos) {
+            write_fixed<3>(line, coordinate, 8);
+        }
+        write_string(line, "  1.00  0.00      ");
+        write_left(line, resinfo.segment, 4);
+        write_right(line, frame[i].type(), 2);
+        write_string(line, "\n");
+    });
+
     auto connect = std::vector<std::vector<int64_t>>(frame.size());
     for (const auto& bond : frame.topology().bonds()) {
         if (is_atom_record[bond[0]] && is_atom_record[bond[1]]) { // both must be standard residue atoms
@@ -873,24 +1129,34 @@ void PDBFormat::write_next(const Frame& frame) {
     }
 
     for (size_t i = 0; i < frame.size(); i++) {
+        if (!connect[i].empty()) {
+            check_pdb_index(adjust_for_ter_residues(i, ter_serial_numbers), 5);
+            for (auto j: connect[i]) {
+                check_pdb_index(j, 5);
+            }
+        }
+    }
+
+    write_records(file_, frame.size(), [&](line_buffer& line, size_t i) {
         auto connections = connect[i].size();
         auto lines = connections / 4 + 1;
         if (connections == 0) {
-            continue;
+            return;
         }
 
         auto correction = adjust_for_ter_residues(i, ter_serial_numbers);
 
         for (size_t conect_line = 0; conect_line < lines; conect_line++) {
-            file_.print("CONECT{: >5}", to_pdb_index(correction, 5));
+            write_string(line, "CONECT");
+            write_pdb_index(line, correction, 5);
 
             auto last = std::min(connections, 4 * (conect_line + 1));
             for (size_t j = 4 * conect_line; j < last; j++) {
-                file_.print("{: >5}", to_pdb_index(connect[i][j], 5));
+                write_pdb_index(line, connect[i][j], 5);
             }
-            file_.print("\n");
+            write_string(line, "\n");
         }
-    }
+    });
 
     file_.print("ENDMDL\n");
 
@@ -950,3 +1216,35 @@ optional<uint64_t> PDBFormat::forward() {
         return nullopt;
     }
 }
+
+std::unique_ptr<TextFormat> PDBFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    auto reader = std::make_unique<PDBFormat>(std::move(memory), File::READ, File::DEFAULT);
+    // secondary structure records are usually in the header of the file,
+    // i.e. in the first step, and apply to all the following steps
+    reader->secinfo_ = secinfo_;
+    reader->current_secinfo_ = current_secinfo_;
+    reader->parallel_ = true;
+    return reader;
+}
+
+optional<uint64_t> PDBFormat::find_next_step() {
+    // steps start right after an END record, using the same rules as
+    // `forward` for ENDMDL followed by END
+    while (!file_.eof()) {
+        auto line = file_.readline();
+        if (line.substr(0, 6) == "ENDMDL") {
+            auto save = file_.tellpos();
+            auto next = file_.readline();
+            file_.seekpos(save);
+            if (next.substr(0, 3) == "END") {
+                continue;
+            }
+            return save;
+        }
+
+        if (line.substr(0, 3) == "END") {
+            return file_.tellpos();
+        }
+    }
+    return nullopt;
+}
@@ -8,6 +8,7 @@
 #include <cmath>
 #include <array>
 #include <string>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <string_view>
@@ -77,9 +78,9 @@ void SDFFormat::read_next(Frame& frame) {
             );
         }
 
-        auto x = parse<double>(line.substr(0, 10));
-        auto y = parse<double>(line.substr(10, 10));
-        auto z = parse<double>(line.substr(20, 10));
+        auto x = parse_fixed<double>(line.substr(0, 10));
+        auto y = parse_fixed<double>(line.substr(10, 10));
+        auto z = parse_fixed<double>(line.substr(20, 10));
         auto name = line.substr(31, 3);
         auto atom = Atom(std::string(trim(name)));
 
@@ -119,6 +120,11 @@ void SDFFormat::read_next(Frame& frame) {
         frame.add_atom(std::move(atom), Vector3D(x, y, z));
     }
 
+    auto bonds = std::vector<Bond>();
+    auto bond_orders = std::vector<Bond::BondOrder>();
+    bonds.reserve(nbonds);
+    bond_orders.reserve(nbonds);
+
     for (size_t i=0; i<nbonds; i++) {
         line = file_.readline();
         auto atom_1 = parse<size_t>(line.substr(0, 3));
@@ -145,8 +151,10 @@ void SDFFormat::read_next(Frame& frame) {
                 break;
         }
 
-        frame.add_bond(atom_1 - 1, atom_2 - 1, bond_order);
+        bonds.emplace_back(atom_1 - 1, atom_2 - 1);
+        bond_orders.push_back(bond_order);
     }
+    frame.add_bonds(bonds, bond_orders);
 
     // Parsing the file is more or less complete now, but atom properties can
     // still be read (until 'M  END' is reached).
@@ -373,3 +381,17 @@ optional<uint64_t> SDFFormat::forward() {
     // return the start of this step
     return position;
 }
+
+std::unique_ptr<TextFormat> SDFFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<SDFFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> SDFFormat::find_next_step() {
+    // steps start right after the "$$$$" separator
+    while (!file_.eof()) {
+        if (file_.readline() == "$$$$") {
+            return file_.tellpos();
+        }
+    }
+    return nullopt;
+}
@@ -11,6 +11,7 @@
 #include <tuple>
 #include <deque>
 #include <string>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <iterator>
@@ -849,6 +850,25 @@ optional<uint64_t> SMIFormat::forward() {
     return position;
 }
 
+std::unique_ptr<TextFormat> SMIFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<SMIFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> SMIFormat::find_next_step() {
+    // `forward` includes the empty lines before a SMILES string in the same
+    // step, so steps start right after a non-empty line
+    while (!file_.eof()) {
+        auto line = file_.readline();
+        if (!trim(line).empty()) {
+            if (file_.eof()) {
+                return nullopt;
+            }
+            return file_.tellpos();
+        }
+    }
+    return nullopt;
+}
+
 bool all(const std::deque<bool>& vec) {
     for (auto i : vec) {
         if (!i) {
@@ -7,6 +7,8 @@
 
 #include <array>
 #include <string>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <string_view>
 
@@ -172,18 +174,77 @@ optional<uint64_t> TinkerFormat::forward() {
         lines_to_skip += 1;
     }
 
-    for (size_t i=0; i<lines_to_skip; i++) {
-        if (file_.eof()) {
-            throw format_error(
-                "not enough lines in '{}' for Tinker XYZ format", file_.path()
-            );
-        }
-        file_.readline();
+    if (file_.skiplines(lines_to_skip) != lines_to_skip) {
+        throw format_error(
+            "not enough lines in '{}' for Tinker XYZ format", file_.path()
+        );
     }
 
     return position;
 }
 
+std::unique_ptr<TextFormat> TinkerFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<TinkerFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+/// Check if `line` contains the first atom of a step, i.e. an atom with
+/// index 1, followed by its name, position and type
+static bool is_first_atom_line(std::string_view line) {
+    try {
+        double x = 0;
+        double y = 0;
+        double z = 0;
+        int id = 0;
+        int atom_type = 0;
+        std::string name;
+        scan(line, id, name, x, y, z, atom_type);
+        return id == 1;
+    } catch (const Error&) {
+        return false;
+    }
+}
+
+/// Check if `line` contains the six unit cell parameters
+static bool is_full_unit_cell_line(std::string_view line) {
+    if (!is_unit_cell_line(line)) {
+        return false;
+    }
+    try {
+        Vector3D lengths;
+        Vector3D angles;
+        scan(line, lengths[0], lengths[1], lengths[2], angles[0], angles[1], angles[2]);
+        return true;
+    } catch (const Error&) {
+        return false;
+    }
+}
+
+optional<uint64_t> TinkerFormat::find_next_step() {
+    // look for the first atom of a step. The step starts with the line
+    // containing the number of atoms, just before the first atom or before
+    // the unit cell line.
+    auto previous = optional<uint64_t>();
+    auto before_previous = optional<uint64_t>();
+    auto previous_is_cell = false;
+    while (!file_.eof()) {
+        auto position = file_.tellpos();
+        auto line = file_.readline();
+
+        if (is_first_atom_line(line)) {
+            auto start = previous_is_cell ? before_previous : previous;
+            if (start) {
+                file_.seekpos(*start);
+                return start;
+            }
+        }
+
+        previous_is_cell = is_full_unit_cell_line(line);
+        before_previous = previous;
+        previous = position;
+    }
+    return nullopt;
+}
+
 // This is how tinker does it to check if there is unit cell information
 // in the file, so let's follow them here.
 bool is_unit_cell_line(std::string_view line) {
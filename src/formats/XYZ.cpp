@@ -10,6 +10,7 @@
 #include <set>
 #include <array>
 #include <string>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <string_view>
@@ -24,6 +25,7 @@
 #include "chemfiles/warnings.hpp"
 #include "chemfiles/error_fmt.hpp"
 #include "chemfiles/unreachable.hpp"
+#include "chemfiles/write_numbers.hpp"
 #include "chemfiles/external/optional.hpp"
 
 #include "chemfiles/File.hpp"
@@ -109,39 +111,45 @@ void XYZFormat::write_next(const Frame& frame) {
     file_.print("{}\n", frame.size());
     file_.print("{}\n", write_extended_comment_line(frame, properties));
 
-    for (size_t i = 0; i < frame.size(); i++) {
+    write_records(file_, frame.size(), [&](line_buffer& line, size_t i) {
         const auto& atom = frame[i];
 
-        auto name = atom.name();
-        if (name.empty()) {
-            name = "X";
+        if (atom.name().empty()) {
+            write_string(line, "X");
+        } else {
+            write_string(line, atom.name());
         }
 
-        file_.print("{} {:g} {:g} {:g}",
-            name, positions[i][0], positions[i][1], positions[i][2]
-        );
+        for (auto coordinate: positions[i]) {
+            write_string(line, " ");
+            write_general(line, coordinate);
+        }
 
         for (const auto& property: properties) {
             const auto& value = atom.get(property.name).value();
 
             if (property.type == Property::STRING) {
-                file_.print(" {}", value.as_string());
+                write_string(line, " ");
+                write_string(line, value.as_string());
             } else if (property.type == Property::BOOL) {
                 if (value.as_bool()) {
-                    file_.print(" T");
+                    write_string(line, " T");
                 } else {
-                    file_.print(" F");
+                    write_string(line, " F");
                 }
             } else if (property.type == Property::DOUBLE) {
-                file_.print(" {:g}", value.as_double());
+                write_string(line, " ");
+                write_general(line, value.as_double());
             } else if (property.type == Property::VECTOR3D) {
-                const auto& vector = value.as_vector3d();
-                file_.print(" {:g} {:g} {:g}", vector[0], vector[1], vector[2]);
+                for (auto component: value.as_vector3d()) {
+                    write_string(line, " ");
+                    write_general(line, component);
+                }
             }
         }
 
-        file_.print("\n");
-    }
+        write_string(line, "\n");
+    });
 }
 
 optional<uint64_t> XYZFormat::forward() {
@@ -163,15 +171,12 @@ optional<uint64_t> XYZFormat::forward() {
         );
     }
 
-    for (size_t i=0; i<n_atoms + 1; i++) {
-        if (file_.eof()) {
-            throw format_error(
-                "XYZ format: not enough lines at step {} (expected {}, got {})",
-                current_forward_step_, n_atoms + 2, i + 1
-            );
-        }
-
-        file_.readline();
+    auto skipped = file_.skiplines(n_atoms + 1);
+    if (skipped != n_atoms + 1) {
+        throw format_error(
+            "XYZ format: not enough lines at step {} (expected {}, got {})",
+            current_forward_step_, n_atoms + 2, skipped + 1
+        );
     }
 
     current_forward_step_++;
@@ -179,6 +184,35 @@ optional<uint64_t> XYZFormat::forward() {
     return position;
 }
 
+std::unique_ptr<TextFormat> XYZFormat::parallel_reader(std::shared_ptr<MemoryBuffer> memory) const {
+    return std::make_unique<XYZFormat>(std::move(memory), File::READ, File::DEFAULT);
+}
+
+optional<uint64_t> XYZFormat::find_next_step() {
+    // look for a line containing only the number of atoms
+    while (!file_.eof()) {
+        auto position = file_.tellpos();
+        auto line = trim(file_.readline());
+        if (line.empty()) {
+            continue;
+        }
+
+        auto all_digits = true;
+        for (auto c: line) {
+            if (!is_ascii_digit(c)) {
+                all_digits = false;
+                break;
+            }
+        }
+
+        if (all_digits) {
+            file_.seekpos(position);
+            return position;
+        }
+    }
+    return nullopt;
+}
+
 /*****************************************************************************/
 /* End of the main XYZ format implementation. The code below implements the  */
 /* extended XYZ format/convention. This format is 100% backward compatible   */
@@ -1,19 +1,54 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
 #include <string_view>
+#include <unordered_map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#include <lzma.h>
+#include <zstd.h>
 
 #include "chemfiles/FormatFactory.hpp"
 #include "chemfiles/FormatMetadata.hpp"
 #include "chemfiles/File.hpp"
+#include "chemfiles/Error.hpp"
 
 #include "chemfiles/misc.hpp"
+#include "chemfiles/mutex.hpp"
 #include "chemfiles/error_fmt.hpp"
 #include "chemfiles/external/optional.hpp"
 
+#include "chemfiles/files/RawFile.hpp"
+
 using namespace chemfiles;
 
+/// Information about a file guessed from its first bytes
+struct MagicBytes {
+    /// Compression method used for this file (`"GZ"`, `"BZ2"`, ...), or an
+    /// empty string for uncompressed files
+    std::string compression;
+    /// Formats matching the first bytes of the (decompressed) file, the
+    /// first one being the default when multiple formats share the same
+    /// magic number. This is empty for text formats.
+    std::vector<std::string> formats;
+};
+
+/// Read the first bytes of the file at `path` to guess its compression
+/// method and format. This returns `nullopt` if the file can not be read, or
+/// is too small to contain any magic number.
+static optional<MagicBytes> sniff_magic_bytes(const std::string& path);
+
 /// try to distinguish CIF and mmCIF files, since they share the same
 /// `.cif` extension
 static optional<std::string> distinguish_cif_variants(const std::string& path, const std::string& compression);
@@ -22,6 +57,10 @@ static bool contains(std::string_view haystack, std::string_view needle) {
     return haystack.find(needle) != std::string_view::npos;
 }
 
+std::string chemfiles::guess_format(std::string path) {
+    return guess_format(std::move(path), 'r');
+}
+
 std::string chemfiles::guess_format(std::string path, char mode) {
     std::string extension;
     std::string compression;
@@ -40,6 +79,9 @@ std::string chemfiles::guess_format(std::string path, char mode) {
         } else if (extension == ".xz") {
             new_extension = true;
             compression = "XZ";
+        } else if (extension == ".zst") {
+            new_extension = true;
+            compression = "ZST";
         }
 
         if (new_extension) {
@@ -51,6 +93,35 @@ std::string chemfiles::guess_format(std::string path, char mode) {
         }
     }
 
+    if (mode == 'r' || mode == 'a') {
+        // the content of the file takes precedence over its extension
+        auto magic = sniff_magic_bytes(path);
+        if (magic) {
+            compression = magic->compression;
+
+            if (!magic->formats.empty()) {
+                auto format = magic->formats[0];
+                if (!extension.empty()) {
+                    // use the extension to choose between formats sharing
+                    // the same magic number
+                    try {
+                        auto name = std::string(FormatFactory::get().by_extension(extension).metadata.name);
+                        if (std::find(magic->formats.begin(), magic->formats.end(), name) != magic->formats.end()) {
+                            format = name;
+                        }
+                    } catch (const FormatError&) {
+                        // unknown extension, use the default format
+                    }
+                }
+
+                if (!compression.empty()) {
+                    format += " / " + compression;
+                }
+                return format;
+            }
+        }
+    }
+
     if (extension.empty()) {
         throw file_error(
             "file at '{}' does not have an extension, provide a format name to read it",
@@ -84,6 +155,8 @@ static optional<std::string> distinguish_cif_variants(
         c = File::BZIP2;
     } else if (compression == "XZ") {
         c = File::LZMA;
+    } else if (compression == "ZST") {
+        c = File::ZSTD;
     }
 
     try {
@@ -117,3 +190,285 @@ static optional<std::string> distinguish_cif_variants(
         return nullopt;
     }
 }
+
+static uint32_t read_be_u32(const unsigned char* data) {
+    return (static_cast<uint32_t>(data[0]) << 24)
+        | (static_cast<uint32_t>(data[1]) << 16)
+        | (static_cast<uint32_t>(data[2]) << 8)
+        | static_cast<uint32_t>(data[3]);
+}
+
+static uint32_t read_le_u32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0])
+        | (static_cast<uint32_t>(data[1]) << 8)
+        | (static_cast<uint32_t>(data[2]) << 16)
+        | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static bool starts_with(const std::vector<unsigned char>& data, size_t offset, std::string_view magic) {
+    return data.size() >= offset + magic.size()
+        && std::memcmp(data.data() + offset, magic.data(), magic.size()) == 0;
+}
+
+/// Get the compression method matching the magic number at the start of
+/// `data`, or an empty string for uncompressed data
+static std::string sniff_compression(const std::vector<unsigned char>& data) {
+    if (starts_with(data, 0, "\x1f\x8b")) {
+        return "GZ";
+    } else if (starts_with(data, 0, "BZh") && data.size() > 3 && data[3] >= '1' && data[3] <= '9') {
+        return "BZ2";
+    } else if (starts_with(data, 0, std::string_view("\xfd" "7zXZ\x00", 6))) {
+        return "XZ";
+    } else if (data.size() >= 4 && (read_le_u32(data.data()) == 0xFD2FB528 || (read_le_u32(data.data()) & 0xFFFFFFF0) == 0x184D2A50)) {
+        // zstd frame, or skippable frame
+        return "ZST";
+    }
+    return "";
+}
+
+/// Check if `data` starts with the header of a GROMACS TPR file: the
+/// "VERSION ..." string, encoded as XDR (size with the NUL terminator, size
+/// without it, padded string), followed by the size of floating point
+/// values (4 or 8).
+static bool is_tpr_header(const std::vector<unsigned char>& data) {
+    if (data.size() < 8) {
+        return false;
+    }
+
+    auto size_with_nul = read_be_u32(data.data());
+    auto size = read_be_u32(data.data() + 4);
+    // the version string is "VERSION <GROMACS version>", which is short
+    if (size_with_nul != size + 1 || size < 8 || size > 256) {
+        return false;
+    }
+    if (!starts_with(data, 8, "VERSION ")) {
+        return false;
+    }
+
+    auto padded_size = static_cast<size_t>(size) + (4 - size % 4) % 4;
+    auto precision_offset = 8 + padded_size;
+    if (data.size() < precision_offset + 4) {
+        return false;
+    }
+    auto precision = read_be_u32(data.data() + precision_offset);
+    return precision == 4 || precision == 8;
+}
+
+/// Get the binary formats matching the magic number at the start of `data`
+static std::vector<std::string> sniff_formats(const std::vector<unsigned char>& data) {
+    if (data.size() < 8) {
+        return {};
+    }
+
+    // GROMACS files start with a magic number or a string, using XDR
+    // encoding (big-endian integers, strings prefixed by their length twice)
+    auto first = read_be_u32(data.data());
+    if (first == 1995) {
+        return {"XTC"};
+    } else if (first == 1993 && starts_with(data, 12, "GMX_trn_file")) {
+        return {"TRR"};
+    } else if (is_tpr_header(data)) {
+        return {"TPR"};
+    }
+
+    if (starts_with(data, 0, "CDF\x01") || starts_with(data, 0, "CDF\x02")) {
+        return {"Amber NetCDF", "Amber Restart"};
+    }
+
+    // Fortran record marker of 84 bytes (32 or 64-bit, in any endianness),
+    // followed by the CORD header
+    if ((first == 84 || read_le_u32(data.data()) == 84) && (starts_with(data, 4, "CORD") || starts_with(data, 8, "CORD"))) {
+        return {"DCD"};
+    }
+
+    // the first TNG block is named "GENERAL INFO", and its name comes after
+    // the header size, contents size, id (all 64-bit integers) and MD5 hash
+    if (starts_with(data, 40, "GENERAL INFO")) {
+        return {"TNG"};
+    }
+
+    // MMTF files are a MessagePack map
+    auto byte = data[0];
+    if ((byte & 0xF0) == 0x80 || byte == 0xDE || byte == 0xDF) {
+        auto view = std::string_view(reinterpret_cast<const char*>(data.data()), data.size());
+        if (contains(view, "mmtfVersion")) {
+            return {"MMTF"};
+        }
+    }
+
+    return {};
+}
+
+/// Size of the data read at the start of files to guess their format
+static constexpr size_t MAGIC_BYTES_SIZE = 4096;
+
+/// Size of the compressed data read at the start of compressed files, to get
+/// the first `MAGIC_BYTES_SIZE` bytes of decompressed data
+static constexpr size_t COMPRESSED_MAGIC_BYTES_SIZE = 64 * 1024;
+
+// The functions below decompress the start of a compressed file from `input`
+// into `output`, without going through the full (seekable) file classes which
+// can read much more data when opening the file. They return the number of
+// bytes written to `output`, which is smaller than `output.size()` if the input
+// is too short or invalid.
+
+static size_t decompress_start_gz(const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // 15 (use the largest window possible) + 16 (expect a gzip header)
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return 0;
+    }
+
+    stream.next_in = const_cast<Bytef*>(input.data());
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = output.data();
+    stream.avail_out = static_cast<uInt>(output.size());
+    while (stream.avail_out != 0 && stream.avail_in != 0) {
+        auto status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            // multiple gzip members, such as BGZF files
+            if (inflateReset(&stream) != Z_OK) {
+                break;
+            }
+        } else if (status != Z_OK) {
+            break;
+        }
+    }
+
+    auto size = output.size() - stream.avail_out;
+    inflateEnd(&stream);
+    return size;
+}
+
+static size_t decompress_start_xz(const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+        return 0;
+    }
+
+    stream.next_in = input.data();
+    stream.avail_in = input.size();
+    stream.next_out = output.data();
+    stream.avail_out = output.size();
+    while (stream.avail_out != 0 && stream.avail_in != 0) {
+        if (lzma_code(&stream, LZMA_RUN) != LZMA_OK) {
+            break;
+        }
+    }
+
+    auto size = output.size() - stream.avail_out;
+    lzma_end(&stream);
+    return size;
+}
+
+static size_t decompress_start_zstd(const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    auto* context = ZSTD_createDCtx();
+    if (context == nullptr) {
+        return 0;
+    }
+
+    auto zstd_input = ZSTD_inBuffer{input.data(), input.size(), 0};
+    auto zstd_output = ZSTD_outBuffer{output.data(), output.size(), 0};
+    while (zstd_output.pos < zstd_output.size && zstd_input.pos < zstd_input.size) {
+        auto previous = zstd_output.pos + zstd_input.pos;
+        auto status = ZSTD_decompressStream(context, &zstd_output, &zstd_input);
+        if (ZSTD_isError(status) || zstd_output.pos + zstd_input.pos == previous) {
+            break;
+        }
+    }
+
+    ZSTD_freeDCtx(context);
+    return zstd_output.pos;
+}
+
+static optional<MagicBytes> read_magic_bytes(const std::string& path) {
+    auto magic = MagicBytes();
+    auto data = std::vector<unsigned char>(MAGIC_BYTES_SIZE);
+    try {
+        auto file = RawFile(path, File::READ);
+        data.resize(file.read(data.data(), data.size()));
+        if (data.size() < 4) {
+            return nullopt;
+        }
+
+        magic.compression = sniff_compression(data);
+        if (magic.compression.empty()) {
+            magic.formats = sniff_formats(data);
+            return magic;
+        }
+
+        // read more compressed data to be able to decompress enough of it
+        auto size = data.size();
+        data.resize(COMPRESSED_MAGIC_BYTES_SIZE);
+        data.resize(size + file.read(data.data() + size, data.size() - size));
+    } catch (const FileError&) {
+        return nullopt;
+    }
+
+    // look at the start of the decompressed data. bzip2 files are skipped,
+    // since their blocks are usually larger than the data we read here.
+    auto decompressed = std::vector<unsigned char>(MAGIC_BYTES_SIZE);
+    size_t size = 0;
+    if (magic.compression == "GZ") {
+        size = decompress_start_gz(data, decompressed);
+    } else if (magic.compression == "XZ") {
+        size = decompress_start_xz(data, decompressed);
+    } else if (magic.compression == "ZST") {
+        size = decompress_start_zstd(data, decompressed);
+    } else {
+        return magic;
+    }
+
+    // invalid or truncated compressed files give empty data here, the user
+    // will get a proper error when trying to open them
+    decompressed.resize(size);
+    magic.formats = sniff_formats(decompressed);
+    return magic;
+}
+
+namespace {
+/// Cached result of `read_magic_bytes`, valid as long as the file is not
+/// modified
+struct CachedMagicBytes {
+    uint64_t size;
+    std::time_t modified;
+    optional<MagicBytes> magic;
+};
+}
+
+/// Maximal number of files in the magic bytes cache, the cache is cleared
+/// when it grows larger than this
+static constexpr size_t MAGIC_BYTES_CACHE_SIZE = 4096;
+
+static mutex<std::unordered_map<std::string, CachedMagicBytes>> MAGIC_BYTES_CACHE; // NOLINT
+
+static optional<MagicBytes> sniff_magic_bytes(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        // the file does not exist (yet), or we can not access it
+        return nullopt;
+    }
+    auto size = static_cast<uint64_t>(info.st_size);
+    auto modified = info.st_mtime;
+
+    {
+        auto cache = MAGIC_BYTES_CACHE.lock();
+        auto it = cache->find(path);
+        if (it != cache->end() && it->second.size == size && it->second.modified == modified) {
+            return it->second.magic;
+        }
+    }
+
+    auto magic = read_magic_bytes(path);
+
+    {
+        auto cache = MAGIC_BYTES_CACHE.lock();
+        if (cache->size() >= MAGIC_BYTES_CACHE_SIZE) {
+            cache->clear();
+        }
+        (*cache)[path] = CachedMagicBytes{size, modified, magic};
+    }
+
+    return magic;
+}
@@ -1,21 +1,46 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cfloat>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include <string>
 #include <limits>
+#include <vector>
 #include <algorithm>
 #include <string_view>
 
+#if __has_include(<charconv>)
+    #include <charconv>
+#endif
+
+#ifdef __cpp_lib_to_chars
+    #define CHEMFILES_HAS_FLOAT_FROM_CHARS
+    #include <system_error>
+#else
+    #include <locale>
+    #include <sstream>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHEMFILES_HAS_SSE2
+#endif
+
 #include "chemfiles/parse.hpp"
 #include "chemfiles/utils.hpp"
 #include "chemfiles/error_fmt.hpp"
+#include "chemfiles/powers_of_five.hpp"
 
 using namespace chemfiles;
 
+/// Integers below this value can be multiplied by 10 and added to a digit
+/// without overflowing a signed or unsigned 64-bit integer
+static constexpr uint64_t UNCHECKED_INTEGER_LIMIT = 100000000000000000;
+
 template <> int64_t chemfiles::parse(std::string_view input) {
     if (input.empty()) {
         throw error("can not parse an integer from an empty string");
@@ -29,34 +54,27 @@ template <> int64_t chemfiles::parse(std::string_view input) {
         it++;
     }
 
-    int sign = 1;
+    bool negative = false;
     // Parse sign, if any
     if (it != end && *it == '-') {
-        sign = -1;
+        negative = true;
         it++;
     } else if (it != end && *it == '+') {
         it++;
     }
 
-    int64_t result = 0;
+    // accumulate the absolute value of the number, which is at most 2^63 for
+    // negative numbers and 2^63 - 1 for positive numbers
+    auto limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1 : 0);
+    uint64_t result = 0;
     for (/*no initialization*/; it!=end; it++) {
         if (is_ascii_digit(*it)) {
-            auto digit = static_cast<int64_t>(*it - '0');
-            if (sign == -1) {
-                // Check for underflow
-                if (result >= ((std::numeric_limits<int64_t>::min() + digit) / 10)) {
-                    result = result * 10 - digit;
-                } else {
-                    throw error("{} is out of range for 64-bit integer", input);
-                }
-            } else {
-                // Check for overflow
-                if (result <= ((std::numeric_limits<int64_t>::max() - digit) / 10)) {
-                    result = result * 10 + digit;
-                } else {
-                    throw error("{} is out of range for 64-bit integer", input);
-                }
+            auto digit = static_cast<uint64_t>(*it - '0');
+            // Only check for overflow for numbers with more than 17 digits
+            if (result >= UNCHECKED_INTEGER_LIMIT && result > (limit - digit) / 10) {
+                throw error("{} is out of range for 64-bit integer", input);
             }
+            result = result * 10 + digit;
         } else {
             // we found the end of the number
             break;
@@ -72,7 +90,15 @@ template <> int64_t chemfiles::parse(std::string_view input) {
         throw error("can not parse '{}' as an integer", input);
     }
 
-    return result;
+    if (negative) {
+        if (result == 0) {
+            return 0;
+        }
+        // avoid overflow when result is 2^63
+        return -static_cast<int64_t>(result - 1) - 1;
+    } else {
+        return static_cast<int64_t>(result);
+    }
 }
 
 template <> uint64_t chemfiles::parse(std::string_view input) {
@@ -97,12 +123,11 @@ template <> uint64_t chemfiles::parse(std::string_view input) {
     for (/*no initialization*/; it!=end; it++) {
         if (is_ascii_digit(*it)) {
             auto digit = static_cast<uint64_t>(*it - '0');
-            // Check for overflow
-            if (result <= ((std::numeric_limits<uint64_t>::max() - digit) / 10)) {
-                result = result * 10 + digit;
-            } else {
+            // Only check for overflow for numbers with more than 17 digits
+            if (result >= UNCHECKED_INTEGER_LIMIT && result > ((std::numeric_limits<uint64_t>::max() - digit) / 10)) {
                 throw error("{} is out of range for 64-bit unsigned integer", input);
             }
+            result = result * 10 + digit;
         } else {
             // we found the end of the number
             break;
@@ -121,14 +146,294 @@ template <> uint64_t chemfiles::parse(std::string_view input) {
     return result;
 }
 
+/******************************************************************************/
+// Parsing doubles
+//
+// Numbers are first parsed into a decimal mantissa `w` of at most 19 digits
+// (which fits in a 64-bit integer) and a power of ten `q`. The value `w * 10^q`
+// is then converted to the closest double using one of three paths:
+//
+// - Clinger's fast path, if both `w` and `10^q` are exactly representable as
+//   doubles. A single IEEE multiplication or division is then correctly
+//   rounded;
+// - the Eisel-Lemire algorithm, which computes the result using a 128-bit
+//   approximation of `5^q` and is always correct for 19 digits mantissas. This
+//   is the same algorithm as the fast_float library (Lemire, "Number Parsing
+//   at a Gigabyte per Second", https://arxiv.org/abs/2101.11408);
+// - a slow path using the standard library, when the number has more than 19
+//   significant digits and the Eisel-Lemire algorithm can not decide between
+//   two candidates based on the first 19 digits only.
+/******************************************************************************/
+
+/// Maximal number of significant digits stored in the mantissa
+static constexpr int MAX_MANTISSA_DIGITS = 19;
+
+// When floating point operations are evaluated with a higher precision than
+// double (e.g. with x87 FPU), the result of a single operation is rounded
+// twice and might not be the closest double.
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+static constexpr bool CORRECTLY_ROUNDED_ARITHMETIC = false;
+#else
+static constexpr bool CORRECTLY_ROUNDED_ARITHMETIC = true;
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define CHEMFILES_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+    #define CHEMFILES_NOINLINE __declspec(noinline)
+#else
+    #define CHEMFILES_NOINLINE
+#endif
+
+/// Powers of ten exactly representable as double
+static constexpr double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/// Number of explicit bits in the mantissa of a double
+static constexpr int DOUBLE_MANTISSA_BITS = 52;
+/// Exponent bias of doubles
+static constexpr int DOUBLE_MINIMUM_EXPONENT = -1023;
+/// Biased exponent of infinity
+static constexpr int DOUBLE_INFINITE_POWER = 0x7FF;
+
+namespace {
+    struct uint128_parts {
+        uint64_t high;
+        uint64_t low;
+    };
+}
+
+/// Compute the full 128-bit product of `a` and `b`
+static uint128_parts full_multiplication(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128_t;
+    auto product = static_cast<uint128_t>(a) * b;
+    return {static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product)};
+#else
+    auto a_low = a & 0xFFFFFFFF;
+    auto a_high = a >> 32;
+    auto b_low = b & 0xFFFFFFFF;
+    auto b_high = b >> 32;
+
+    auto low_low = a_low * b_low;
+    auto high_low = a_high * b_low;
+    auto low_high = a_low * b_high;
+    auto high_high = a_high * b_high;
+
+    auto cross = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+    auto high = (high_low >> 32) + (cross >> 32) + high_high;
+    auto low = (cross << 32) | (low_low & 0xFFFFFFFF);
+    return {high, low};
+#endif
+}
+
+/// Count the leading zero bits in a non-zero `value`
+static int leading_zeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if ((value >> (64 - shift)) == 0) {
+            count += shift;
+            value <<= shift;
+        }
+    }
+    return count;
+#endif
+}
+
+/// Compute the bits of the double closest to `mantissa * 10^exponent` with the
+/// Eisel-Lemire algorithm. The sign bit is always unset in the result.
+static uint64_t eisel_lemire(int64_t exponent, uint64_t mantissa) {
+    if (mantissa == 0 || exponent < SMALLEST_POWER_OF_TEN) {
+        return 0;
+    }
+
+    if (exponent > LARGEST_POWER_OF_TEN) {
+        return static_cast<uint64_t>(DOUBLE_INFINITE_POWER) << DOUBLE_MANTISSA_BITS;
+    }
+
+    // normalize the mantissa so the most significant bit is set
+    auto lz = leading_zeros(mantissa);
+    mantissa <<= lz;
+
+    // compute the product of the mantissa and the truncated 5^q, with enough
+    // precision to get the 52 + 3 most significant bits right
+    auto index = static_cast<size_t>(2 * (exponent - SMALLEST_POWER_OF_TEN));
+    auto product = full_multiplication(mantissa, POWERS_OF_FIVE_128[index]);
+    constexpr uint64_t precision_mask = UINT64_C(0xFFFFFFFFFFFFFFFF) >> (DOUBLE_MANTISSA_BITS + 3);
+    if ((product.high & precision_mask) == precision_mask) {
+        // the lower bits might carry into the upper ones, use the second
+        // half of 5^q to get more precision
+        auto second = full_multiplication(mantissa, POWERS_OF_FIVE_128[index + 1]);
+        product.low += second.high;
+        if (second.high > product.low) {
+            product.high++;
+        }
+    }
+
+    auto upper_bit = static_cast<int>(product.high >> 63);
+    auto shift = upper_bit + 64 - DOUBLE_MANTISSA_BITS - 3;
+    auto result = product.high >> shift;
+
+    // binary exponent of the result, computed as floor(log2(10^q)) with the
+    // approximation log2(10) ~ 217706 / 2^16
+    auto q = static_cast<int32_t>(exponent);
+    auto power = (((152170 + 65536) * q) >> 16) + 63;
+    auto power2 = power + upper_bit - lz - DOUBLE_MINIMUM_EXPONENT;
+
+    if (power2 <= 0) {
+        // subnormal number
+        if (-power2 + 1 >= 64) {
+            return 0;
+        }
+        result >>= -power2 + 1;
+        // round to nearest
+        result += (result & 1);
+        result >>= 1;
+        // the rounding might have created a normal number
+        power2 = (result < (UINT64_C(1) << DOUBLE_MANTISSA_BITS)) ? 0 : 1;
+        result &= ~(UINT64_C(1) << DOUBLE_MANTISSA_BITS);
+        return result | (static_cast<uint64_t>(power2) << DOUBLE_MANTISSA_BITS);
+    }
+
+    // Handle ties (exactly between two doubles), which should round to even.
+    // They can only happen when 5^q fits in 64 bits (q <= 23), or when dividing
+    // by 5^-q gives a number with few enough bits (q >= -4).
+    if (product.low <= 1 && exponent >= -4 && exponent <= 23 && (result & 3) == 1) {
+        if ((result << shift) == product.high) {
+            result &= ~UINT64_C(1);
+        }
+    }
+
+    // round to nearest
+    result += (result & 1);
+    result >>= 1;
+    if (result >= (UINT64_C(2) << DOUBLE_MANTISSA_BITS)) {
+        // the rounding overflowed into the next power of two
+        result = UINT64_C(1) << DOUBLE_MANTISSA_BITS;
+        power2++;
+    }
+    result &= ~(UINT64_C(1) << DOUBLE_MANTISSA_BITS);
+
+    if (power2 >= DOUBLE_INFINITE_POWER) {
+        return static_cast<uint64_t>(DOUBLE_INFINITE_POWER) << DOUBLE_MANTISSA_BITS;
+    }
+
+    return result | (static_cast<uint64_t>(power2) << DOUBLE_MANTISSA_BITS);
+}
+
+/// Parse the unsigned decimal number in `input` using the standard library.
+/// This is only used for numbers with more than 19 significant digits where
+/// the Eisel-Lemire algorithm is not sufficient.
+static double parse_double_slow(std::string_view input) {
+    double value = 0;
+#ifdef CHEMFILES_HAS_FLOAT_FROM_CHARS
+    auto result = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (result.ec == std::errc::result_out_of_range) {
+        return std::numeric_limits<double>::infinity();
+    }
+#else
+    // use the "C" locale to always have '.' as the decimal separator
+    auto stream = std::istringstream(std::string(input));
+    stream.imbue(std::locale::classic());
+    stream >> value;
+    if (stream.fail()) {
+        return std::numeric_limits<double>::infinity();
+    }
+#endif
+    return value;
+}
+
+/// Convert `mantissa * 10^exponent` to the closest double, when Clinger's fast
+/// path can not be used. `number` should contain the full number without
+/// sign, `mantissa_size` the size of the digits and decimal point at the start
+/// of `number`, and `digit_count` the number of digits in it.
+///
+/// This function is kept out of line, to keep the fast path in
+/// `parse<double>` small.
+CHEMFILES_NOINLINE static double decimal_to_double(uint64_t mantissa, int64_t exponent, int64_t digit_count, std::string_view number, size_t mantissa_size) {
+    // If there are more than 19 digits, the mantissa might have overflowed.
+    // Only keep the first 19 significant digits in the mantissa, and set
+    // `truncated` if any of the remaining digits is not zero.
+    bool truncated = false;
+    if (digit_count > MAX_MANTISSA_DIGITS) {
+        mantissa = 0;
+        int64_t significant_digits = 0;
+        for (auto c: number.substr(0, mantissa_size)) {
+            if (c == '.') {
+                continue;
+            }
+
+            auto digit = static_cast<uint64_t>(c - '0');
+            if (significant_digits == 0 && digit == 0) {
+                // leading zeros are not significant
+                continue;
+            }
+
+            if (significant_digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + digit;
+            } else {
+                truncated = truncated || (digit != 0);
+            }
+            significant_digits++;
+        }
+
+        if (significant_digits > MAX_MANTISSA_DIGITS) {
+            exponent += significant_digits - MAX_MANTISSA_DIGITS;
+        }
+    }
+
+    auto bits = eisel_lemire(exponent, mantissa);
+    if (truncated && eisel_lemire(exponent, mantissa + 1) != bits) {
+        // the full value is between mantissa * 10^exponent and
+        // (mantissa + 1) * 10^exponent, which are rounded differently
+        return parse_double_slow(number);
+    }
+
+    double value = 0;
+    static_assert(sizeof(value) == sizeof(bits), "double should be 64-bit");
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// Load 8 characters starting at `input` in a 64-bit integer, the first
+/// character being in the least significant byte
+static uint64_t load_eight_chars(const char* input) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i])) << (8 * i);
+    }
+    return value;
+}
+
+/// Check if all 8 characters loaded with `load_eight_chars` are ASCII digits
+static bool is_eight_digits(uint64_t chars) {
+    return (((chars + 0x4646464646464646) | (chars - 0x3030303030303030)) & 0x8080808080808080) == 0;
+}
+
+/// Get the value of 8 ASCII digits loaded with `load_eight_chars`. This uses
+/// SIMD within a register to combine pairs of digits, then pairs of pairs, etc.
+static uint64_t parse_eight_digits(uint64_t chars) {
+    constexpr uint64_t mask = 0x000000FF000000FF;
+    constexpr uint64_t mul1 = 0x000F424000000064; // 100 + (1000000 << 32)
+    constexpr uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+    chars -= 0x3030303030303030;
+    chars = (chars * 10) + (chars >> 8);
+    chars = (((chars & mask) * mul1) + (((chars >> 16) & mask) * mul2)) >> 32;
+    return chars & 0xFFFFFFFF;
+}
 
 template <> double chemfiles::parse(std::string_view input) {
     if (input.empty()) {
         throw error("can not parse a double from an empty string");
     }
 
-    auto it = input.begin();  // NOLINT(readability-qualified-auto)
-    auto end = input.end();   // NOLINT(readability-qualified-auto)
+    const auto* it = input.data();
+    const auto* end = input.data() + input.size();
 
     // skip whitespaces before number
     while (it != end && is_ascii_whitespace(*it)) {
@@ -136,76 +441,77 @@ template <> double chemfiles::parse(std::string_view input) {
     }
 
     // Get sign, if any.
-    int sign = 1.0;
+    bool negative = false;
     if (it != end && *it == '-') {
-        sign = -1.0;
+        negative = true;
         it++;
     } else if (it != end && *it == '+') {
         it++;
     }
 
-    auto digit_start = it;  // NOLINT(readability-qualified-auto)
+    // The value of the number is `mantissa * 10^exponent`. All the digits are
+    // accumulated in the mantissa, which might overflow if there are more
+    // than 19 of them. This is handled in `decimal_to_double`.
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+
+    const auto* digit_start = it;
     // Get digits before decimal point or exponent, if any.
-    double value = 0.0;
     while (it != end && is_ascii_digit(*it)) {
-        value = value * 10.0 + static_cast<double>(*it - '0');
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*it - '0');
         it++;
     }
-    bool got_digits = (digit_start != it);
+    auto digit_count = static_cast<int64_t>(it - digit_start);
 
     // Get digits after decimal point, if any.
     if (it != end && *it == '.') {
         it++;
-        auto frac_start = it;  // NOLINT(readability-qualified-auto)
-        double pow10 = 10.0;
+        const auto* frac_start = it;
+        while (end - it >= 8 && is_eight_digits(load_eight_chars(it))) {
+            mantissa = mantissa * 100000000 + parse_eight_digits(load_eight_chars(it));
+            it += 8;
+        }
         while (it != end && is_ascii_digit(*it)) {
-            value += static_cast<double>(*it - '0') / pow10;
-            pow10 *= 10.0;
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*it - '0');
             it++;
         }
-
-        got_digits = got_digits || (frac_start != it);
+        exponent = -static_cast<int64_t>(it - frac_start);
+        digit_count -= exponent;
     }
+    const auto* mantissa_end = it;
+    bool got_digits = (digit_count != 0);
 
     // Handle exponent, if any.
-    bool frac = false;
-    double scale = 1.0;
     if (it != end && (*it == 'e' || *it == 'E')) {
         it++;
-        auto exponent_start = it;  // NOLINT(readability-qualified-auto)
+        const auto* exponent_start = it;
 
         // Get sign of exponent, if any.
+        bool negative_exponent = false;
         if (it != end && *it == '-') {
-            frac = true;
+            negative_exponent = true;
             it++;
         } else if (it != end && *it == '+') {
             it++;
         }
 
-        // Get digits of exponent, if any.
-        unsigned exponent = 0;
+        // Get digits of exponent, if any. Values larger than the limit are
+        // saturated, since they will overflow or underflow anyway.
+        int64_t explicit_exponent = 0;
         while (it != end && is_ascii_digit(*it)) {
-            auto digit = static_cast<unsigned>(*it - '0');
-            if (exponent <= ((std::numeric_limits<unsigned>::max() - digit) / 10)) {
-                exponent = exponent * 10 + digit;
-            } else {
-                throw error("float exponent in {} is out of range for unsigned integer", input);
+            if (explicit_exponent < 0x10000000) {
+                explicit_exponent = explicit_exponent * 10 + (*it - '0');
             }
-
             it++;
         }
 
         if (it == exponent_start) {
             throw error("missing exponent in '{}' to read a double", input);
-        } else if (exponent > 308) {
-            throw error("{} is out of range for double", input);
         }
 
-        // Calculate scaling factor.
-        while (exponent >= 50) { scale *= 1e50; exponent -= 50; }
-        while (exponent >=  8) { scale *= 1e8;  exponent -=  8; }
-        while (exponent >   0) { scale *= 1e1;  exponent -=  1; }
+        exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
     }
+    const auto* digits_end = it;
 
     // skip whitespaces after number if any
     while (it != end && is_ascii_whitespace(*it)) {
@@ -216,8 +522,171 @@ template <> double chemfiles::parse(std::string_view input) {
         throw error("can not parse '{}' as a double", input);
     }
 
-    // Return signed and scaled floating point result.
-    return sign * (frac ? (value / scale) : (value * scale));
+    double value = 0;
+    if (CORRECTLY_ROUNDED_ARITHMETIC && digit_count <= MAX_MANTISSA_DIGITS && exponent >= -22 && exponent <= 22 && mantissa <= (UINT64_C(1) << 53)) {
+        // Clinger's fast path. Converting from a signed integer is faster on
+        // some platforms.
+        value = static_cast<double>(static_cast<int64_t>(mantissa));
+        if (exponent < 0) {
+            value /= EXACT_POWERS_OF_TEN[-exponent];
+        } else {
+            value *= EXACT_POWERS_OF_TEN[exponent];
+        }
+    } else {
+        auto number = std::string_view(digit_start, static_cast<size_t>(digits_end - digit_start));
+        auto mantissa_size = static_cast<size_t>(mantissa_end - digit_start);
+        value = decimal_to_double(mantissa, exponent, digit_count, number, mantissa_size);
+        if (std::isinf(value)) {
+            throw error("{} is out of range for double", input);
+        }
+    }
+
+    return negative ? -value : value;
+}
+
+/// Maximal number of digits in fixed-width numbers using the fast path in
+/// `parse_fixed<double>`, such that the mantissa is exactly representable
+static constexpr int64_t MAX_FIXED_DIGITS = 15;
+
+template <> double chemfiles::parse_fixed(std::string_view input) {
+    // Fast path for numbers written with `%<width>.<precision>f`, i.e.
+    // `\s*-?\d*\.\d*\s*`. Both the mantissa and the power of ten are exactly
+    // representable, so a single division gives the correctly rounded result.
+    const auto* it = input.data();
+    const auto* end = input.data() + input.size();
+    while (it != end && *it == ' ') {
+        it++;
+    }
+
+    bool negative = false;
+    if (it != end && *it == '-') {
+        negative = true;
+        it++;
+    }
+
+    uint64_t mantissa = 0;
+    const auto* digit_start = it;
+    while (it != end && is_ascii_digit(*it)) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*it - '0');
+        it++;
+    }
+    auto digit_count = static_cast<int64_t>(it - digit_start);
+
+    int64_t decimals = 0;
+    if (it != end && *it == '.') {
+        it++;
+        const auto* frac_start = it;
+        while (it != end && is_ascii_digit(*it)) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*it - '0');
+            it++;
+        }
+        decimals = static_cast<int64_t>(it - frac_start);
+        digit_count += decimals;
+    }
+
+    while (it != end && *it == ' ') {
+        it++;
+    }
+
+    if (it != end || digit_count == 0 || digit_count > MAX_FIXED_DIGITS || !CORRECTLY_ROUNDED_ARITHMETIC) {
+        return parse<double>(input);
+    }
+
+    auto value = static_cast<double>(static_cast<int64_t>(mantissa)) / EXACT_POWERS_OF_TEN[decimals];
+    return negative ? -value : value;
+}
+
+#ifdef CHEMFILES_HAS_SSE2
+/// Get the whitespace mask of 16 characters at `input`
+static uint64_t whitespace_mask_16(const char* input) {
+    auto chars = _mm_loadu_si128(static_cast<const __m128i*>(static_cast<const void*>(input)));
+    auto spaces = _mm_cmpeq_epi8(chars, _mm_set1_epi8(' '));
+    // '\t', '\n', '\v', '\f' and '\r' are between 0x09 and 0x0D, but '\v' is
+    // not a whitespace for `is_ascii_whitespace`
+    auto controls = _mm_or_si128(
+        _mm_or_si128(
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')),
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n'))
+        ),
+        _mm_or_si128(
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8('\f')),
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))
+        )
+    );
+    auto mask = _mm_movemask_epi8(_mm_or_si128(spaces, controls));
+    return static_cast<uint64_t>(static_cast<uint16_t>(mask));
+}
+#else
+/// Get a value with the high bit of each byte set if the corresponding byte in
+/// `chars` is equal to `c`
+static uint64_t bytes_equal(uint64_t chars, char c) {
+    constexpr uint64_t high_bits = 0x8080808080808080;
+    auto x = chars ^ (0x0101010101010101 * static_cast<unsigned char>(c));
+    auto y = (x & ~high_bits) + ~high_bits;
+    return ~(y | x) & high_bits;
+}
+
+/// Get the whitespace mask of 8 characters loaded with `load_eight_chars`
+static uint64_t whitespace_mask_8(uint64_t chars) {
+    auto mask = bytes_equal(chars, ' ') | bytes_equal(chars, '\t') |
+                bytes_equal(chars, '\n') | bytes_equal(chars, '\f') |
+                bytes_equal(chars, '\r');
+    // gather the high bit of each byte in the lowest byte
+    return ((mask >> 7) * 0x0102040810204080) >> 56;
+}
+#endif
+
+uint64_t chemfiles::detail::whitespace_mask(const char* input, size_t size) {
+    // pad incomplete blocks with spaces
+    char buffer[64];
+    if (size < 64) {
+        std::memset(buffer, ' ', sizeof(buffer));
+        if (size != 0) {
+            std::memcpy(buffer, input, size);
+        }
+        input = buffer;
+    }
+
+    uint64_t mask = 0;
+#ifdef CHEMFILES_HAS_SSE2
+    for (size_t i = 0; i < 4; i++) {
+        mask |= whitespace_mask_16(input + 16 * i) << (16 * i);
+    }
+#else
+    for (size_t i = 0; i < 8; i++) {
+        mask |= whitespace_mask_8(load_eight_chars(input + 8 * i)) << (8 * i);
+    }
+#endif
+    return mask;
+}
+
+void chemfiles::split_whitespace(std::string_view input, std::vector<std::string_view>& tokens) {
+    tokens.clear();
+
+    size_t token_start = 0;
+    bool in_token = false;
+    for (size_t block = 0; block < input.size(); block += 64) {
+        auto size = std::min(input.size() - block, size_t(64));
+        auto mask = detail::whitespace_mask(input.data() + block, size);
+        // bits are set where a character is not of the same kind as the
+        // previous one, i.e. at the start and end of tokens
+        auto transitions = mask ^ ((mask << 1) | (in_token ? 0 : 1));
+        while (transitions != 0) {
+            auto position = block + static_cast<size_t>(detail::trailing_zeros(transitions));
+            if (in_token) {
+                tokens.emplace_back(input.substr(token_start, position - token_start));
+            } else {
+                token_start = position;
+            }
+            in_token = !in_token;
+            // clear the lowest set bit
+            transitions &= transitions - 1;
+        }
+    }
+
+    if (in_token) {
+        tokens.emplace_back(input.substr(token_start));
+    }
 }
 
 static const auto digits_upper = std::string("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ");
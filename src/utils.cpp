@@ -3,12 +3,20 @@
 
 #include <cerrno>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "chemfiles/config.h"  // IWYU pragma: keep
 #include "chemfiles/utils.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHEMFILES_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHEMFILES_USE_SSE2 0
+#endif
+
 #ifdef CHEMFILES_WINDOWS
 #include <windows.h>  // GetUserName & GetComputerNameEx
 #include <direct.h>  // _getcwd
@@ -80,3 +88,60 @@ std::string chemfiles::current_directory() {
         return std::string(buffer.data());
     }
 }
+
+#if CHEMFILES_USE_SSE2
+static unsigned popcount(unsigned value) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_popcount(value));
+#else
+    // newlines are sparse in text files, so this loop is short
+    unsigned count = 0;
+    while (value != 0) {
+        value &= value - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+#endif
+
+const char* chemfiles::skip_lines(const char* begin, const char* end, size_t& count) {
+    const char* current = begin;
+    if (count == 0) {
+        return current;
+    }
+
+#if CHEMFILES_USE_SSE2
+    // Count newlines 16 bytes at the time, until we reach the chunk containing
+    // the last newline we are looking for. The exact position inside this
+    // chunk is then found with memchr below.
+    const auto newline = _mm_set1_epi8('\n');
+    while (end - current >= 16) {
+        auto chunk = _mm_loadu_si128(static_cast<const __m128i*>(static_cast<const void*>(current)));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        auto found = static_cast<size_t>(popcount(mask));
+        if (found >= count) {
+            break;
+        }
+        count -= found;
+        current += 16;
+    }
+#endif
+
+    while (current != end) {
+        const auto* found = static_cast<const char*>(
+            std::memchr(current, '\n', static_cast<size_t>(end - current))
+        );
+        if (found == nullptr) {
+            return nullptr;
+        }
+
+        current = found + 1;
+        count -= 1;
+        if (count == 0) {
+            return current;
+        }
+    }
+
+    return nullptr;
+}
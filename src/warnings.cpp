@@ -2,6 +2,7 @@
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
 #include <string>
+#include <vector>
 #include <iostream>
 #include <exception>
 #include <functional>
@@ -22,8 +23,24 @@ void chemfiles::set_warning_callback(warning_callback_t callback) {
     *guard = std::move(callback);
 }
 
+/// Collector for warnings sent from the current thread, if any
+static thread_local WarningCollector* COLLECTOR = nullptr;
+
+WarningCollector::WarningCollector(): previous_(COLLECTOR) {
+    COLLECTOR = this;
+}
+
+WarningCollector::~WarningCollector() {
+    COLLECTOR = previous_;
+}
+
 void chemfiles::send_warning(const std::string& message) noexcept {
     try {
+        if (COLLECTOR != nullptr) {
+            COLLECTOR->messages_.push_back(message);
+            return;
+        }
+
         auto callback = CALLBACK.lock();
         (*callback)(message);
     } catch (const std::exception& e) {
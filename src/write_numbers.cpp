@@ -0,0 +1,136 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <fmt/format.h>
+
+#include "chemfiles/write_numbers.hpp"
+
+using namespace chemfiles;
+
+/// Number of significant digits used by `write_general`
+static constexpr int GENERAL_PRECISION = 6;
+
+/// Exact powers of ten, from 10^0 to 10^22
+static constexpr double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static constexpr int MAX_EXACT_POWER_OF_TEN = 22;
+
+void detail::write_fixed_fallback(line_buffer& output, double value, size_t width, size_t precision) {
+    fmt::format_to(fmt::appender(output), "{:{}.{}f}", value, width, precision);
+}
+
+static void write_general_fallback(line_buffer& output, double value) {
+    fmt::format_to(fmt::appender(output), "{:g}", value);
+}
+
+/// Get `value * 10^power` with a single correctly rounded operation, or a
+/// negative value if `10^power` is not exactly representable.
+static double scale_by_power_of_ten(double value, int power) {
+    if (power > MAX_EXACT_POWER_OF_TEN || power < -MAX_EXACT_POWER_OF_TEN) {
+        return -1;
+    } else if (power >= 0) {
+        return value * EXACT_POWERS_OF_TEN[power];
+    } else {
+        return value / EXACT_POWERS_OF_TEN[-power];
+    }
+}
+
+void chemfiles::write_general(line_buffer& output, double value) {
+    auto absolute = std::abs(value);
+    if (absolute == 0.0 || !std::isfinite(absolute)) {
+        write_general_fallback(output, value);
+        return;
+    }
+
+    // find the decimal exponent such that the scaled value has exactly six
+    // digits before the decimal point. log10 can be off by one around powers
+    // of ten, so check and correct the result.
+    constexpr auto lower = static_cast<double>(detail::POWERS_OF_TEN[GENERAL_PRECISION - 1]);
+    constexpr auto upper = static_cast<double>(detail::POWERS_OF_TEN[GENERAL_PRECISION]);
+    auto exponent = static_cast<int>(std::floor(std::log10(absolute)));
+    auto scaled = scale_by_power_of_ten(absolute, GENERAL_PRECISION - 1 - exponent);
+    if (scaled >= upper) {
+        exponent += 1;
+        scaled = scale_by_power_of_ten(absolute, GENERAL_PRECISION - 1 - exponent);
+    } else if (scaled >= 0 && scaled < lower) {
+        exponent -= 1;
+        scaled = scale_by_power_of_ten(absolute, GENERAL_PRECISION - 1 - exponent);
+    }
+
+    uint64_t digits = 0;
+    if (scaled < lower || scaled >= upper || !detail::round_scaled(scaled, digits)) {
+        write_general_fallback(output, value);
+        return;
+    }
+
+    if (digits == detail::POWERS_OF_TEN[GENERAL_PRECISION]) {
+        // rounding went up to the next power of ten
+        digits /= 10;
+        exponent += 1;
+    }
+
+    // remove trailing zeros
+    int significant = GENERAL_PRECISION;
+    while (digits % 10 == 0) {
+        digits /= 10;
+        significant -= 1;
+    }
+
+    // longest output is "-0.000123456" or "-1.23456e+100"
+    char buffer[16];
+    char* data = buffer;
+    if (std::signbit(value)) {
+        *data++ = '-';
+    }
+
+    if (exponent >= -4 && exponent < GENERAL_PRECISION) {
+        // fixed notation
+        if (exponent < 0) {
+            *data++ = '0';
+            *data++ = '.';
+            for (int i = 0; i < -exponent - 1; i++) {
+                *data++ = '0';
+            }
+            detail::write_digits(data, digits, static_cast<size_t>(significant));
+            data += significant;
+        } else if (significant <= exponent + 1) {
+            // integer value
+            auto integer_digits = static_cast<size_t>(exponent + 1);
+            detail::write_digits(data, digits * detail::POWERS_OF_TEN[integer_digits - static_cast<size_t>(significant)], integer_digits);
+            data += integer_digits;
+        } else {
+            auto integer_digits = static_cast<size_t>(exponent + 1);
+            auto fraction_digits = static_cast<size_t>(significant) - integer_digits;
+            auto divisor = detail::POWERS_OF_TEN[fraction_digits];
+            detail::write_digits(data, digits / divisor, integer_digits);
+            data += integer_digits;
+            *data++ = '.';
+            detail::write_digits(data, digits % divisor, fraction_digits);
+            data += fraction_digits;
+        }
+    } else {
+        // exponential notation
+        auto divisor = detail::POWERS_OF_TEN[significant - 1];
+        *data++ = static_cast<char>('0' + digits / divisor);
+        if (significant > 1) {
+            *data++ = '.';
+            detail::write_digits(data, digits % divisor, static_cast<size_t>(significant - 1));
+            data += significant - 1;
+        }
+        *data++ = 'e';
+        *data++ = exponent < 0 ? '-' : '+';
+        auto absolute_exponent = static_cast<uint64_t>(exponent < 0 ? -exponent : exponent);
+        size_t exponent_digits = absolute_exponent >= 100 ? 3 : 2;
+        detail::write_digits(data, absolute_exponent, exponent_digits);
+        data += exponent_digits;
+    }
+
+    output.append(buffer, data);
+}
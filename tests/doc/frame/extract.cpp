@@ -0,0 +1,33 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <catch.hpp>
+#include <chemfiles.hpp>
+using namespace chemfiles;
+
+#undef assert
+#define assert CHECK
+
+TEST_CASE() {
+    // [example]
+    auto frame = Frame();
+    frame.add_atom(Atom("H"), {1.0, 0.0, 0.0});
+    frame.add_atom(Atom("O"), {0.0, 0.0, 0.0});
+    frame.add_atom(Atom("H"), {0.0, 1.0, 0.0});
+    frame.add_atom(Atom("Zn"), {5.0, 5.0, 5.0});
+    frame.add_bond(0, 1);
+    frame.add_bond(1, 2);
+
+    // extract the atoms matching a selection
+    auto selected = Selection("type H or type O").list(frame);
+    auto water = frame.extract(selected);
+    assert(water.size() == 3);
+    assert(water.topology().bonds() == std::vector<Bond>({{0, 1}, {1, 2}}));
+
+    // atoms are added to the new frame in the given order
+    auto indexes = std::vector<size_t>{3, 1};
+    auto subset = frame.extract(indexes);
+    assert(subset.size() == 2);
+    assert(subset[0].type() == "Zn");
+    assert(subset.positions()[1] == Vector3D(0.0, 0.0, 0.0));
+    // [example]
+}
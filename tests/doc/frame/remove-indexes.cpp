@@ -0,0 +1,27 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <catch.hpp>
+#include <chemfiles.hpp>
+using namespace chemfiles;
+
+#undef assert
+#define assert CHECK
+
+TEST_CASE() {
+    // [example]
+    auto frame = Frame();
+    frame.add_atom(Atom("H"), {1.0, 0.0, 0.0});
+    frame.add_atom(Atom("O"), {0.0, 1.0, 0.0});
+    frame.add_atom(Atom("H"), {0.0, 0.0, 1.0});
+    frame.add_atom(Atom("Zn"), {1.0, 1.0, 1.0});
+    assert(frame.size() == 4);
+
+    auto indexes = std::vector<size_t>{0, 2};
+    frame.remove(indexes);
+    assert(frame.size() == 2);
+
+    // Removing atoms changes the indexes of atoms after the ones removed
+    assert(frame.topology()[1].name() == "Zn");
+    assert(frame.positions()[1] == Vector3D(1.0, 1.0, 1.0));
+    // [example]
+}
@@ -0,0 +1,26 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <catch.hpp>
+#include <chemfiles.hpp>
+using namespace chemfiles;
+
+#undef assert
+#define assert CHECK
+
+TEST_CASE() {
+    // [example]
+    auto topology = Topology();
+    topology.add_atom(Atom("H"));
+    topology.add_atom(Atom("O"));
+    topology.add_atom(Atom("H"));
+
+    auto bonds = std::vector<Bond>{{1, 2}, {0, 1}};
+    auto orders = std::vector<Bond::BondOrder>{Bond::SINGLE, Bond::DOUBLE};
+    topology.add_bonds(bonds, orders);
+
+    // bonds are sorted, and the bond orders follow the bonds
+    assert(topology.bonds() == std::vector<Bond>({{0, 1}, {1, 2}}));
+    assert(topology.bond_order(0, 1) == Bond::DOUBLE);
+    assert(topology.bond_order(1, 2) == Bond::SINGLE);
+    // [example]
+}
@@ -0,0 +1,29 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <catch.hpp>
+#include <chemfiles.hpp>
+using namespace chemfiles;
+
+#undef assert
+#define assert CHECK
+
+TEST_CASE() {
+    // [example]
+    auto topology = Topology();
+    topology.add_atom(Atom("Zn"));
+    topology.add_atom(Atom("Fe"));
+    topology.add_atom(Atom("Rd"));
+    topology.add_atom(Atom("Ni"));
+    topology.add_bond(1, 3);
+    assert(topology.size() == 4);
+
+    auto indexes = std::vector<size_t>{2, 0};
+    topology.remove(indexes);
+    assert(topology.size() == 2);
+
+    // atomic indexes are shifted by remove
+    assert(topology[0].name() == "Fe");
+    assert(topology[1].name() == "Ni");
+    assert(topology.bonds() == std::vector<Bond>{{0, 1}});
+    // [example]
+}
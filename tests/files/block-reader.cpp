@@ -0,0 +1,79 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "chemfiles/files/BlockReader.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+// block `i` contains `i + 1` times the letter 'a' + i
+static void decompress(size_t i, std::vector<char>& output) {
+    if (i == 7) {
+        throw FileError("corrupted block");
+    }
+    output.assign(i + 1, static_cast<char>('a' + i));
+}
+
+static std::string expected_data(size_t blocks) {
+    auto data = std::string();
+    for (size_t i = 0; i < blocks; i++) {
+        data += std::string(i + 1, static_cast<char>('a' + i));
+    }
+    return data;
+}
+
+static std::string read(BlockReader& reader, size_t count) {
+    auto data = std::string(count, '\0');
+    data.resize(reader.read(&data[0], count));
+    return data;
+}
+
+TEST_CASE("Block reader") {
+    auto expected = expected_data(7);
+    for (size_t threads: {size_t{1}, size_t{4}}) {
+        SECTION("Sequential reading with " + std::to_string(threads) + " threads") {
+            auto reader = BlockReader(7, {}, decompress, threads);
+            CHECK(read(reader, 5) == expected.substr(0, 5));
+            CHECK(read(reader, 100) == expected.substr(5));
+            CHECK(read(reader, 100) == "");
+        }
+
+        SECTION("Seeking with " + std::to_string(threads) + " threads") {
+            auto reader = BlockReader(7, {}, decompress, threads);
+            reader.seek(12);
+            CHECK(read(reader, 4) == expected.substr(12, 4));
+            reader.seek(2);
+            CHECK(read(reader, 4) == expected.substr(2, 4));
+            reader.seek(25);
+            CHECK(read(reader, 10) == expected.substr(25));
+
+            // past the end
+            reader.seek(1000);
+            CHECK(read(reader, 10) == "");
+            reader.seek(0);
+            CHECK(read(reader, 3) == "abb");
+        }
+
+        SECTION("Known sizes with " + std::to_string(threads) + " threads") {
+            auto reader = BlockReader(7, {1, 2, 3, 4, 5, 6, 7}, decompress, threads);
+            reader.seek(21);
+            CHECK(read(reader, 100) == "ggggggg");
+
+            auto wrong = BlockReader(3, {1, 2, 4}, decompress, threads);
+            CHECK_THROWS_WITH(
+                wrong.seek(3),
+                "invalid compressed block: expected 4 bytes of uncompressed data, got 3"
+            );
+        }
+
+        SECTION("Errors with " + std::to_string(threads) + " threads") {
+            auto reader = BlockReader(10, {}, decompress, threads);
+            auto data = std::string(28, '\0');
+            CHECK(reader.read(&data[0], 28) == 28);
+            CHECK_THROWS_WITH(read(reader, 10), "corrupted block");
+        }
+    }
+}
@@ -0,0 +1,72 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "chemfiles/files/BlockWriter.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+// "compress" a block by adding its index and size around the data
+static void compress(size_t i, const std::vector<char>& input, std::vector<char>& output) {
+    if (input.size() > 0 && input[0] == '!') {
+        throw FileError("invalid data");
+    }
+    auto header = "[" + std::to_string(i) + ":" + std::to_string(input.size()) + "]";
+    output.assign(header.begin(), header.end());
+    output.insert(output.end(), input.begin(), input.end());
+}
+
+TEST_CASE("Block writer") {
+    for (size_t threads: {size_t{1}, size_t{4}}) {
+        SECTION("Writing with " + std::to_string(threads) + " threads") {
+            auto output = std::string();
+            auto blocks = std::vector<size_t>();
+            auto write = [&](size_t i, const std::vector<char>& data) {
+                blocks.push_back(i);
+                output.append(data.begin(), data.end());
+            };
+
+            auto writer = BlockWriter(4, compress, write, threads);
+            writer.write("abc", 3);
+            CHECK(output.empty());
+            writer.write("defghijklmnopqrstuvwxyz0", 24);
+            writer.write("1", 1);
+            writer.write("", 0);
+            writer.finish();
+
+            CHECK(output == "[0:4]abcd[1:4]efgh[2:4]ijkl[3:4]mnop[4:4]qrst[5:4]uvwx[6:4]yz01");
+            CHECK(blocks == std::vector<size_t>{0, 1, 2, 3, 4, 5, 6});
+
+            // last, incomplete block
+            writer.write("23", 2);
+            writer.finish();
+            CHECK(output == "[0:4]abcd[1:4]efgh[2:4]ijkl[3:4]mnop[4:4]qrst[5:4]uvwx[6:4]yz01[7:2]23");
+
+            // nothing to write
+            writer.finish();
+            CHECK(blocks.size() == 8);
+        }
+
+        SECTION("Errors with " + std::to_string(threads) + " threads") {
+            auto output = std::string();
+            auto write = [&](size_t, const std::vector<char>& data) {
+                output.append(data.begin(), data.end());
+            };
+
+            auto writer = BlockWriter(2, compress, write, threads);
+            writer.write("ab", 2);
+            CHECK_THROWS_WITH([&]() {
+                writer.write("!c", 2);
+                writer.finish();
+            }(), "invalid data");
+
+            // the writer stays in a failed state
+            CHECK_THROWS_WITH(writer.write("de", 2), "invalid data");
+            CHECK_THROWS_WITH(writer.finish(), "invalid data");
+            CHECK(output == "[0:2]ab");
+        }
+    }
+}
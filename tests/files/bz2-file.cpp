@@ -5,6 +5,7 @@
 #include "helpers.hpp"
 #include "chemfiles/File.hpp"
 #include "chemfiles/files/Bz2File.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
 #include "chemfiles/Error.hpp"
 using namespace chemfiles;
 
@@ -107,18 +108,113 @@ TEST_CASE("In-memory decompression") {
         0x8b, 0x59, 0xd4
     };
 
-    auto decompressed = decompress_bz2(reinterpret_cast<const char*>(content.data()), content.size());
-    CHECK(std::string(decompressed.data(), decompressed.size()) == "Test\n5467\n");
+    auto read_memory = [&]() {
+        auto buffer = std::make_shared<MemoryBuffer>(reinterpret_cast<const char*>(content.data()), content.size());
+        auto file = TextFile(std::move(buffer), File::READ, File::BZIP2);
+        return file.readall();
+    };
+
+    CHECK(read_memory() == "Test\n5467\n");
 
     content[23] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_bz2(reinterpret_cast<const char*>(content.data()), content.size()),
-        "bzip2: corrupted file (code: -4)"
-    );
+    CHECK_THROWS_WITH(read_memory(), "bzip2: corrupted file (code: -4)");
 
     content[0] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_bz2(reinterpret_cast<const char*>(content.data()), content.size()),
-        "bzip2: this file do not seems to be a bz2 file (code: -5)"
-    );
+    CHECK_THROWS_WITH(read_memory(), "bzip2: this file do not seems to be a bz2 file (code: -5)");
+}
+
+TEST_CASE("Random access in a bzip2 file") {
+    auto filename = NamedTempPath(".bz2");
+    auto lines = std::vector<std::string>();
+    {
+        // enough data to create multiple blocks at compression level 6
+        TextFile file(filename, File::WRITE, File::BZIP2);
+        for (size_t i = 0; i < 100000; i++) {
+            auto line = "line " + std::to_string(i) + " " + std::to_string(i * i);
+            file.print("{}\n", line);
+            lines.emplace_back(std::move(line));
+        }
+    }
+
+    auto offsets = std::vector<uint64_t>();
+    uint64_t offset = 0;
+    for (const auto& line: lines) {
+        offsets.push_back(offset);
+        offset += line.size() + 1;
+    }
+
+    auto file = Bz2File(filename, File::READ);
+    CHECK(file.blocks().size() > 1);
+
+    auto text = TextFile(filename, File::READ, File::BZIP2);
+    for (auto i: {size_t(75000), size_t(10), size_t(99999), size_t(50000), size_t(0), size_t(42)}) {
+        text.seekpos(offsets[i]);
+        CHECK(text.readline() == lines[i]);
+    }
+
+    // Seeking past the end
+    text.seekpos(offset + 100);
+    CHECK(text.readline() == "");
+    CHECK(text.eof());
+
+    // Seeking inside a line
+    text.seekpos(offsets[60000] + 5);
+    CHECK(text.readline() == lines[60000].substr(5));
+}
+
+TEST_CASE("Finding blocks in a bzip2 file") {
+    auto buffer = std::make_shared<MemoryBuffer>(4096);
+    auto content = std::string();
+    {
+        TextFile file(buffer, File::WRITE, File::BZIP2);
+        for (size_t i = 0; i < 100000; i++) {
+            auto line = "line " + std::to_string(i) + " " + std::to_string(i * i) + "\n";
+            file.print("{}", line);
+            content += line;
+        }
+    }
+
+    auto data = std::vector<char>(buffer->data(), buffer->data() + buffer->size());
+    auto find_blocks = [&]() {
+        auto memory = std::make_shared<MemoryBuffer>(data.data(), data.size());
+        auto file = Bz2File(std::move(memory), File::READ);
+        return file.blocks();
+    };
+
+    auto read_all = [&]() {
+        auto memory = std::make_shared<MemoryBuffer>(data.data(), data.size());
+        auto file = TextFile(std::move(memory), File::READ, File::BZIP2);
+        return file.readall();
+    };
+
+    auto expected = find_blocks();
+    REQUIRE(expected.size() > 1);
+
+    auto read_bits = [&](uint64_t start, uint64_t count) {
+        uint64_t value = 0;
+        for (auto bit = start; bit < start + count; bit++) {
+            auto byte = static_cast<unsigned char>(data[bit / 8]);
+            value = (value << 1) | ((byte >> (7 - bit % 8)) & 1);
+        }
+        return value;
+    };
+
+    // Change the CRC of the first stream (right after the end of stream
+    // magic number), which then no longer matches the CRC of its blocks. The
+    // blocks are found by decompressing them, and should not change.
+    size_t last_block = 0;
+    while (read_bits(expected[last_block].end, 48) != 0x177245385090) {
+        last_block++;
+        REQUIRE(last_block < expected.size());
+    }
+    auto position = expected[last_block].end + 48;
+    data[position / 8] = static_cast<char>(data[position / 8] ^ (0x80 >> (position % 8)));
+
+    auto blocks = find_blocks();
+    REQUIRE(blocks.size() == expected.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        CHECK(blocks[i].start == expected[i].start);
+        CHECK(blocks[i].end == expected[i].end);
+    }
+    CHECK(read_all() == content);
 }
@@ -1,10 +1,16 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
 #include "catch.hpp"
 #include "helpers.hpp"
 #include "chemfiles/File.hpp"
 #include "chemfiles/files/GzFile.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
 #include "chemfiles/Error.hpp"
 using namespace chemfiles;
 
@@ -78,14 +84,15 @@ TEST_CASE("Write a gz file") {
     }
 
     auto content = read_binary_file(filename);
-    // Byte 9 identify the OS in gzip files.
-    // Override it so we can check for the full file output
-    content[9] = 0xff;
-
+    // The file contains a BGZF member, followed by the BGZF end of file marker
     auto expected = std::vector<uint8_t> {
-        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x0b, 0x49,
-        0x2d, 0x2e, 0xe1, 0x32, 0x35, 0x31, 0x33, 0xe7, 0x02, 0x00, 0x8a, 0x43,
-        0x5e, 0x98, 0x0a, 0x00, 0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x25, 0x00, 0x0b, 0x49, 0x2d, 0x2e, 0xe1, 0x32,
+        0x35, 0x31, 0x33, 0xe7, 0x02, 0x00, 0x8a, 0x43, 0x5e, 0x98, 0x0a, 0x00,
+        0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
     };
     CHECK(content == expected);
 
@@ -95,6 +102,117 @@ TEST_CASE("Write a gz file") {
     CHECK(file.readline() == "5467");
 }
 
+TEST_CASE("Skip lines in a gz file") {
+    auto filename = NamedTempPath(".gz");
+    {
+        // use more data than the TextFile buffer size
+        TextFile file(filename, File::WRITE, File::GZIP);
+        for (size_t i=0; i<5000; i++) {
+            file.print("line {}\n", i);
+        }
+        file.print("last line");
+    }
+
+    TextFile file(filename, File::READ, File::GZIP);
+    CHECK(file.skiplines(3) == 3);
+    CHECK(file.readline() == "line 3");
+    CHECK(file.skiplines(4000) == 4000);
+    CHECK(file.readline() == "line 4004");
+    auto position = file.tellpos();
+
+    CHECK(file.skiplines(1000) == 996);
+    CHECK(file.eof());
+    CHECK(file.readline() == "");
+
+    file.seekpos(position);
+    CHECK(file.skiplines(995) == 995);
+    CHECK_FALSE(file.eof());
+    CHECK(file.readline() == "last line");
+    CHECK(file.eof());
+}
+
+TEST_CASE("Random access in a gz file") {
+    auto filename = NamedTempPath(".gz");
+    auto content = std::string();
+    {
+        // use enough data to create multiple access points. This uses zlib
+        // directly to get a single gzip member instead of BGZF.
+        auto* file = gzopen(filename.path().c_str(), "wb");
+        REQUIRE(file != nullptr);
+        for (size_t i=0; i<300000; i++) {
+            auto line = "this is line " + std::to_string(i) + "\n";
+            gzwrite(file, line.data(), static_cast<unsigned>(line.size()));
+            content += line;
+        }
+        gzclose(file);
+    }
+
+    auto file = GzFile(filename, File::READ);
+    auto buffer = std::vector<char>(4096);
+    while (file.read(buffer.data(), buffer.size()) != 0) {}
+
+    const auto& points = file.access_points();
+    REQUIRE(points.size() >= 4);
+    for (size_t i=0; i<points.size(); i++) {
+        CHECK(points[i].window.size() == 32768);
+        CHECK(points[i].output >= (i + 1) * GzFile::ACCESS_POINT_SPAN);
+    }
+
+    auto offsets = std::vector<uint64_t>{
+        points[2].output + 1, 12, points[3].output, points[0].output - 1,
+        content.size() - 64, points[1].output - 1000, 0, points[1].output,
+    };
+    for (auto offset: offsets) {
+        file.seek(offset);
+        CHECK(file.read(buffer.data(), 64) == 64);
+        CHECK(std::string(buffer.data(), 64) == content.substr(offset, 64));
+    }
+
+    // the index is not modified by seeking
+    CHECK(file.access_points().size() == points.size());
+
+    // seeking past the end
+    file.seek(content.size() + 10);
+    CHECK(file.read(buffer.data(), 64) == 0);
+}
+
+TEST_CASE("Random access in a BGZF file") {
+    auto filename = NamedTempPath(".gz");
+    auto content = std::string();
+    for (size_t i=0; i<300000; i++) {
+        content += "this is line " + std::to_string(i) + "\n";
+    }
+
+    {
+        TextFile file(filename, File::WRITE, File::GZIP);
+        // write data crossing the boundaries between BGZF members
+        for (size_t i=0; i<content.size(); i += 3000) {
+            file.print("{}", content.substr(i, 3000));
+        }
+    }
+
+    auto compressed = read_binary_file(filename);
+    CHECK(compressed[12] == 'B');
+    CHECK(compressed[13] == 'C');
+
+    auto file = GzFile(filename, File::READ);
+    auto buffer = std::vector<char>(content.size() + 100);
+    CHECK(file.read(buffer.data(), buffer.size()) == content.size());
+    CHECK(std::string(buffer.data(), content.size()) == content);
+    // BGZF files do not need access points
+    CHECK(file.access_points().empty());
+
+    for (uint64_t offset: {3000000u, 3u, 65279u, 65280u, 1048575u, 0u, 4000000u, 1044480u}) {
+        file.seek(offset);
+        CHECK(file.read(buffer.data(), 64) == 64);
+        CHECK(std::string(buffer.data(), 64) == content.substr(offset, 64));
+    }
+
+    // seeking past the end
+    file.seek(content.size() + 10);
+    CHECK(file.read(buffer.data(), 64) == 0);
+}
+
 TEST_CASE("Append to a gz file") {
     auto filename = NamedTempPath(".gz");
 
@@ -111,21 +229,22 @@ TEST_CASE("Append to a gz file") {
     }
 
     auto content = read_binary_file(filename);
-    // Byte 9 identify the OS in gzip files.
-    // Override it so we can check for the full file output
-    content[9] = 0xff;
-    // A new header is written when appending
-    content[43] = 0xff;
-
+    // Each append adds new BGZF members and end of file marker
     auto expected = std::vector<uint8_t> {
-        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
-        0x73, 0x2c, 0x28, 0x48, 0xcd, 0x4b, 0x51, 0x30, 0xe4, 0x32,
-        0x37, 0x33, 0x31, 0xe5, 0x02, 0x00, 0xf8, 0x06, 0xaf, 0x8d,
-        0x0e, 0x00, 0x00, 0x00,
-        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
-        0x73, 0x2c, 0x28, 0x48, 0xcd, 0x4b, 0x51, 0x30, 0xe2, 0x32,
-        0x33, 0x37, 0x35, 0xe1, 0x02, 0x00, 0xc6, 0x09, 0x42, 0x21,
-        0x0e, 0x00, 0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x29, 0x00, 0x73, 0x2c, 0x28, 0x48, 0xcd, 0x4b,
+        0x51, 0x30, 0xe4, 0x32, 0x37, 0x33, 0x31, 0xe5, 0x02, 0x00, 0xf8, 0x06,
+        0xaf, 0x8d, 0x0e, 0x00, 0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x29, 0x00, 0x73, 0x2c, 0x28, 0x48, 0xcd, 0x4b,
+        0x51, 0x30, 0xe2, 0x32, 0x33, 0x37, 0x35, 0xe1, 0x02, 0x00, 0xc6, 0x09,
+        0x42, 0x21, 0x0e, 0x00, 0x00, 0x00,
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
     };
     CHECK(content == expected);
 
@@ -146,18 +265,21 @@ TEST_CASE("In-memory decompression") {
         0x5e, 0x98, 0x0a, 0x00, 0x00, 0x00,
     };
 
-    auto decompressed = decompress_gz(reinterpret_cast<const char*>(content.data()), content.size());
-    CHECK(std::string(decompressed.data(), decompressed.size()) == "Test\n5467\n");
+    auto read_memory = [&]() {
+        auto buffer = std::make_shared<MemoryBuffer>(reinterpret_cast<const char*>(content.data()), content.size());
+        auto file = TextFile(std::move(buffer), File::READ, File::GZIP);
+        return file.readall();
+    };
+
+    CHECK(read_memory() == "Test\n5467\n");
 
     content[23] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_gz(reinterpret_cast<const char*>(content.data()), content.size()),
-        "error inflating gziped memory: incorrect data check"
-    );
+    CHECK_THROWS_WITH(read_memory(), "error while reading gziped file: incorrect data check");
 
     content[0] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_gz(reinterpret_cast<const char*>(content.data()), content.size()),
-        "error inflating gziped memory: incorrect header check"
-    );
+    CHECK_THROWS_WITH(read_memory(), "error while reading gziped file: incorrect header check");
+
+    // data without gzip header is an error for in-memory data
+    content = std::vector<uint8_t>{'T', 'e', 's', 't', '\n'};
+    CHECK_THROWS_WITH(read_memory(), "error while reading gziped file: incorrect header check");
 }
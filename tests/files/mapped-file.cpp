@@ -0,0 +1,111 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <fstream>
+#include "catch.hpp"
+#include "helpers.hpp"
+#include "chemfiles/files/MappedFile.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+#if CHEMFILES_TEXT_FILE_USE_MMAP
+
+TEST_CASE("Memory mapped files") {
+    auto tmpfile = NamedTempPath(".dat");
+    {
+        std::ofstream file(tmpfile, std::ios_base::binary);
+        file << "first line\nsecond\r\n\nlast line";
+    }
+
+    SECTION("Reading lines") {
+        auto file = TextFile(tmpfile, File::READ, File::DEFAULT);
+        CHECK(file.readline() == "first line");
+        CHECK(file.tellpos() == 11);
+        CHECK(file.readline() == "second");
+        CHECK(file.readline() == "");
+        CHECK_FALSE(file.eof());
+        CHECK(file.readline() == "last line");
+        CHECK(file.eof());
+        CHECK(file.tellpos() == 29);
+
+        CHECK(file.readline() == "");
+        CHECK(file.eof());
+
+        file.rewind();
+        CHECK_FALSE(file.eof());
+        CHECK(file.readline() == "first line");
+
+        file.seekpos(14);
+        CHECK(file.readline() == "ond");
+
+        // Seeking past the end
+        file.seekpos(1000);
+        CHECK_FALSE(file.eof());
+        CHECK(file.readline() == "");
+        CHECK(file.eof());
+    }
+
+    SECTION("Skipping lines") {
+        auto file = TextFile(tmpfile, File::READ, File::DEFAULT);
+        CHECK(file.skiplines(2) == 2);
+        CHECK(file.tellpos() == 19);
+        CHECK(file.readline() == "");
+
+        CHECK(file.skiplines(0) == 0);
+        CHECK_FALSE(file.eof());
+
+        // going past the end of file
+        CHECK(file.skiplines(5) == 1);
+        CHECK(file.eof());
+        CHECK(file.tellpos() == 29);
+        CHECK(file.skiplines(5) == 0);
+
+        file.rewind();
+        CHECK(file.skiplines(4) == 4);
+        CHECK(file.eof());
+    }
+
+    SECTION("Read full file") {
+        auto file = TextFile(tmpfile, File::READ, File::DEFAULT);
+        CHECK(file.readall() == "first line\nsecond\r\n\nlast line");
+    }
+
+    SECTION("Direct usage") {
+        auto file = MappedFile(tmpfile);
+        REQUIRE(file.contiguous());
+        CHECK(file.contiguous()->size() == 29);
+
+        char buffer[6] = {0};
+        file.seek(11);
+        CHECK(file.read(buffer, 6) == 6);
+        CHECK(std::string(buffer, 6) == "second");
+        file.seek(27);
+        CHECK(file.read(buffer, 6) == 2);
+
+        CHECK_THROWS_WITH(
+            file.write("data", 4),
+            "can not write to the file at '" + tmpfile.path() + "': it was opened in read mode"
+        );
+    }
+
+    SECTION("Empty file") {
+        auto empty = NamedTempPath(".dat");
+        {
+            std::ofstream file(empty, std::ios_base::binary);
+        }
+
+        auto file = TextFile(empty, File::READ, File::DEFAULT);
+        CHECK(file.readline() == "");
+        CHECK(file.eof());
+        CHECK(file.tellpos() == 0);
+    }
+
+    SECTION("Constructor errors") {
+        CHECK_THROWS_WITH(
+            MappedFile("not existing"),
+            "could not open the file at 'not existing'"
+        );
+    }
+}
+
+#endif
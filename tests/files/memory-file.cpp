@@ -90,6 +90,9 @@ TEST_CASE("Write to files in memory") {
         CHECK(buffer->capacity() == 6);
 
         file.print("Test\n");
+        CHECK(buffer->size() == 0);
+        // data is only written to the buffer when flushing
+        file.flush();
         CHECK(std::string(buffer->data(), buffer->size()) == "Test\n");
         CHECK(std::strlen(buffer->data()) == buffer->size());
         CHECK(file.tellpos() == buffer->size());
@@ -98,6 +101,7 @@ TEST_CASE("Write to files in memory") {
 
         // Check reallocation (more than twice the previous size)
         file.print("JUNKJUNKJUNKJUNKJUNK");
+        file.flush();
         CHECK(std::string(buffer->data(), buffer->size()) == "Test\nJUNKJUNKJUNKJUNKJUNK");
         CHECK(std::strlen(buffer->data()) == buffer->size());
         CHECK(file.tellpos() == buffer->size());
@@ -116,22 +120,34 @@ TEST_CASE("Write to files in memory") {
     }
 
     SECTION("Writing to a compressed memory file") {
-        // This currently is not supported
-        auto buffer = std::make_shared<MemoryBuffer>(4096);
-        CHECK_THROWS_WITH(
-            TextFile(buffer, File::WRITE, File::GZIP),
-            "writing to a compressed memory file is not supported"
-        );
-
-        CHECK_THROWS_WITH(
-            TextFile(buffer, File::WRITE, File::LZMA),
-            "writing to a compressed memory file is not supported"
-        );
-
-        CHECK_THROWS_WITH(
-            TextFile(buffer, File::WRITE, File::BZIP2),
-            "writing to a compressed memory file is not supported"
-        );
+        for (auto compression: {File::GZIP, File::LZMA, File::BZIP2}) {
+            auto buffer = std::make_shared<MemoryBuffer>(4096);
+            auto file = TextFile(buffer, File::WRITE, compression);
+            file.print("{}", TEST_DATA);
+            // the compressed data is only written when flushing the file
+            CHECK(buffer->size() < TEST_DATA.size());
+
+            file.flush();
+            auto size = buffer->size();
+            auto reader = TextFile(
+                std::make_shared<MemoryBuffer>(buffer->data(), buffer->size()),
+                File::READ, compression
+            );
+            CHECK(reader.readall() == TEST_DATA);
+
+            // flushing again without new data does not change anything
+            file.flush();
+            CHECK(buffer->size() == size);
+
+            // more data can be written after flushing
+            file.print("more data\n");
+            file.flush();
+            reader = TextFile(
+                std::make_shared<MemoryBuffer>(buffer->data(), buffer->size()),
+                File::READ, compression
+            );
+            CHECK(reader.readall() == TEST_DATA + "more data\n");
+        }
     }
 
     SECTION("Appending to a memory file") {
@@ -142,4 +158,22 @@ TEST_CASE("Write to files in memory") {
             "cannot append (mode 'a') to a memory file"
         );
     }
+
+    SECTION("Move assignment") {
+        auto first = std::make_shared<MemoryBuffer>(4096);
+        auto second = std::make_shared<MemoryBuffer>(4096);
+
+        auto file = TextFile(first, File::WRITE, File::DEFAULT);
+        file.print("first\n");
+        CHECK(first->size() == 0);
+
+        // pending data is written before replacing the file
+        file = TextFile(second, File::WRITE, File::DEFAULT);
+        CHECK(std::string(first->data(), first->size()) == "first\n");
+
+        file.print("second\n");
+        file.flush();
+        CHECK(std::string(first->data(), first->size()) == "first\n");
+        CHECK(std::string(second->data(), second->size()) == "second\n");
+    }
 }
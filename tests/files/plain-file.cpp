@@ -1,6 +1,7 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cstring>
 #include <fstream>
 #include "catch.hpp"
 #include "helpers.hpp"
@@ -175,3 +176,51 @@ TEST_CASE("Write a text file") {
     std::getline(verification, line);
     CHECK(line == "5467");
 }
+
+TEST_CASE("Buffered writing") {
+    auto filename = NamedTempPath(".dat");
+
+    auto large = std::string(3 * 1024 * 1024, 'a');
+    {
+        TextFile file(filename, File::WRITE, File::DEFAULT);
+        file.print("{}\n", 42);
+        // larger than the output buffer
+        file.print("{}\n", large);
+
+        auto* output = file.reserve_output(16);
+        std::memcpy(output, "foo\nbar", 7);
+        file.commit_output(4);
+        CHECK(file.tellpos() == large.size() + 8);
+
+        for (size_t i = 0; i < 100000; i++) {
+            file.print("{:>8}\n", i);
+        }
+        CHECK(file.tellpos() == large.size() + 8 + 100000 * 9);
+
+        // data is written to the file when flushing
+        file.flush();
+        CHECK(read_text_file(filename).size() == large.size() + 8 + 100000 * 9);
+
+        file.print("end");
+    }
+
+    std::ifstream verification(filename);
+    REQUIRE(verification.is_open());
+
+    std::string line;
+    std::getline(verification, line);
+    CHECK(line == "42");
+    std::getline(verification, line);
+    CHECK(line == large);
+    std::getline(verification, line);
+    CHECK(line == "foo");
+    for (size_t i = 0; i < 100000; i++) {
+        std::getline(verification, line);
+        if (line != fmt::format("{:>8}", i)) {
+            CHECK(line == fmt::format("{:>8}", i));
+            break;
+        }
+    }
+    std::getline(verification, line);
+    CHECK(line == "end");
+}
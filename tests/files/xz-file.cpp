@@ -1,9 +1,14 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <string>
+#include <vector>
+#include <algorithm>
+
 #include "catch.hpp"
 #include "helpers.hpp"
 #include "chemfiles/files/XzFile.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
 #include "chemfiles/Error.hpp"
 using namespace chemfiles;
 
@@ -78,7 +83,7 @@ TEST_CASE("Write an xz file") {
     auto content = read_binary_file(filename);
     auto expected = std::vector<uint8_t> {
         0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00, 0x00, 0x04, 0xe6, 0xd6, 0xb4, 0x46,
-        0x02, 0x00, 0x21, 0x01, 0x16, 0x00, 0x00, 0x00, 0x74, 0x2f, 0xe5, 0xa3,
+        0x02, 0xc0, 0x0e, 0x0a, 0x21, 0x01, 0x16, 0x00, 0xf5, 0x29, 0x74, 0x9e,
         0x01, 0x00, 0x09, 0x54, 0x65, 0x73, 0x74, 0x0a, 0x35, 0x34, 0x36, 0x37,
         0x0a, 0x00, 0x00, 0x00, 0xbd, 0xb5, 0x7a, 0x14, 0x41, 0x54, 0x79, 0xbe,
         0x00, 0x01, 0x22, 0x0a, 0x15, 0x1a, 0xe1, 0x67, 0x1f, 0xb6, 0xf3, 0x7d,
@@ -87,6 +92,38 @@ TEST_CASE("Write an xz file") {
     CHECK(content == expected);
 }
 
+TEST_CASE("Random access in a multi-block xz file") {
+    auto filename = NamedTempPath(".xz");
+    auto content = std::string();
+    for (size_t i=0; i<20000; i++) {
+        content += "this is line " + std::to_string(i) + "\n";
+    }
+
+    {
+        // use small blocks, and write data crossing block boundaries
+        auto file = XzFile(filename, File::WRITE, 10000);
+        for (size_t i=0; i<content.size(); i += 3000) {
+            auto size = std::min(content.size() - i, size_t(3000));
+            file.write(content.data() + i, size);
+        }
+    }
+
+    auto file = XzFile(filename, File::READ);
+    auto buffer = std::vector<char>(content.size() + 100);
+    CHECK(file.read(buffer.data(), buffer.size()) == content.size());
+    CHECK(std::string(buffer.data(), content.size()) == content);
+
+    for (uint64_t offset: {150000u, 3u, 29999u, 30000u, 300000u, 0u, 9999u, 10000u, 10001u}) {
+        file.seek(offset);
+        CHECK(file.read(buffer.data(), 64) == 64);
+        CHECK(std::string(buffer.data(), 64) == content.substr(offset, 64));
+    }
+
+    // seeking past the end
+    file.seek(content.size() + 10);
+    CHECK(file.read(buffer.data(), 64) == 0);
+}
+
 TEST_CASE("In-memory decompression") {
     auto content = std::vector<uint8_t> {
         0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00, 0x00, 0x04, 0xe6, 0xd6, 0xb4, 0x46,
@@ -97,18 +134,17 @@ TEST_CASE("In-memory decompression") {
         0x01, 0x00, 0x00, 0x00, 0x00, 0x04, 0x59, 0x5a
     };
 
-    auto decompressed = decompress_xz(reinterpret_cast<const char*>(content.data()), content.size());
-    CHECK(std::string(decompressed.data(), decompressed.size()) == "Test\n5467\n");
+    auto read_memory = [&]() {
+        auto buffer = std::make_shared<MemoryBuffer>(reinterpret_cast<const char*>(content.data()), content.size());
+        auto file = TextFile(std::move(buffer), File::READ, File::LZMA);
+        return file.readall();
+    };
+
+    CHECK(read_memory() == "Test\n5467\n");
 
     content[23] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_xz(reinterpret_cast<const char*>(content.data()), content.size()),
-        "lzma: compressed file is corrupted (code: 9)"
-    );
+    CHECK_THROWS_WITH(read_memory(), "lzma: compressed file is corrupted (code: 9)");
 
     content[0] = 0x00;
-    CHECK_THROWS_WITH(
-        decompress_xz(reinterpret_cast<const char*>(content.data()), content.size()),
-        "lzma: input not in .xz format (code: 7)"
-    );
+    CHECK_THROWS_WITH(read_memory(), "lzma: input not in .xz format (code: 7)");
 }
@@ -0,0 +1,211 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <fstream>
+
+#include "catch.hpp"
+#include "helpers.hpp"
+#include "chemfiles/File.hpp"
+#include "chemfiles/files/ZstdFile.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+static std::vector<std::string> write_lines(const std::string& path, CompressionOptions options) {
+    auto lines = std::vector<std::string>();
+    TextFile file(path, File::WRITE, File::ZSTD);
+    file.set_compression_options(options);
+    for (size_t i = 0; i < 100000; i++) {
+        auto line = "line " + std::to_string(i) + " " + std::to_string(i * i);
+        file.print("{}\n", line);
+        lines.emplace_back(std::move(line));
+    }
+    return lines;
+}
+
+static void check_random_access(const std::string& path, const std::vector<std::string>& lines) {
+    auto offsets = std::vector<uint64_t>();
+    uint64_t offset = 0;
+    for (const auto& line: lines) {
+        offsets.push_back(offset);
+        offset += line.size() + 1;
+    }
+
+    auto text = TextFile(path, File::READ, File::ZSTD);
+    for (auto i: {size_t(75000), size_t(10), size_t(99999), size_t(50000), size_t(0), size_t(42)}) {
+        text.seekpos(offsets[i]);
+        CHECK(text.readline() == lines[i]);
+    }
+
+    // Seeking past the end
+    text.seekpos(offset + 100);
+    CHECK(text.readline() == "");
+    CHECK(text.eof());
+
+    // Seeking inside a line
+    text.seekpos(offsets[60000] + 5);
+    CHECK(text.readline() == lines[60000].substr(5));
+
+    // Reading everything
+    text.rewind();
+    size_t count = 0;
+    while (!text.eof()) {
+        auto line = text.readline();
+        if (count < lines.size()) {
+            CHECK(line == lines[count]);
+        }
+        count++;
+    }
+    CHECK(count == lines.size() + 1);
+}
+
+TEST_CASE("Read a text file") {
+    SECTION("Constructor errors") {
+        CHECK_THROWS_WITH(
+            ZstdFile("not existing", File::READ),
+            "could not open the file at 'not existing'"
+        );
+    }
+
+    SECTION("Compression options") {
+        auto filename = NamedTempPath(".zst");
+        TextFile file(filename, File::WRITE, File::ZSTD);
+
+        auto options = CompressionOptions();
+        options.level = 23;
+        CHECK_THROWS_WITH(
+            file.set_compression_options(options),
+            "invalid compression level 23 for zstd, expected a value between 1 and 22"
+        );
+
+        options = CompressionOptions();
+        options.extreme = true;
+        CHECK_THROWS_WITH(
+            file.set_compression_options(options),
+            "the 'extreme' compression option is only supported for xz compression"
+        );
+    }
+}
+
+TEST_CASE("Write a zstd file") {
+    auto filename = NamedTempPath(".zst");
+
+    {
+        TextFile file(filename, File::WRITE, File::ZSTD);
+        file.print("Test\n");
+        file.print("{}\n", 5467);
+        CHECK(file.tellpos() == 10);
+    }
+
+    auto content = read_binary_file(filename);
+    // zstd frame magic number
+    CHECK(content[0] == 0x28);
+    CHECK(content[1] == 0xb5);
+    CHECK(content[2] == 0x2f);
+    CHECK(content[3] == 0xfd);
+    // seekable format magic number
+    auto size = content.size();
+    CHECK(content[size - 4] == 0xb1);
+    CHECK(content[size - 3] == 0xea);
+    CHECK(content[size - 2] == 0x92);
+    CHECK(content[size - 1] == 0x8f);
+
+    auto zstd = ZstdFile(filename, File::READ);
+    REQUIRE(zstd.frames().size() == 1);
+    CHECK(zstd.frames()[0].start == 0);
+    CHECK(zstd.frames()[0].size == 10);
+
+    // Decompress and compare
+    TextFile file(filename, File::READ, File::ZSTD);
+    CHECK(file.readline() == "Test");
+    CHECK(file.readline() == "5467");
+    CHECK(file.readline() == "");
+    CHECK(file.eof());
+
+    SECTION("Empty file") {
+        {
+            TextFile empty(filename, File::WRITE, File::ZSTD);
+        }
+        TextFile empty(filename, File::READ, File::ZSTD);
+        CHECK(empty.readall() == "");
+    }
+}
+
+TEST_CASE("In-memory zstd data") {
+    auto buffer = std::make_shared<MemoryBuffer>(4096);
+    {
+        TextFile file(buffer, File::WRITE, File::ZSTD);
+        file.print("Test\n");
+        file.print("{}\n", 5467);
+    }
+    auto content = std::vector<char>(buffer->data(), buffer->data() + buffer->size());
+
+    auto read_memory = [&]() {
+        auto memory = std::make_shared<MemoryBuffer>(content.data(), content.size());
+        auto file = TextFile(std::move(memory), File::READ, File::ZSTD);
+        return file.readall();
+    };
+
+    CHECK(read_memory() == "Test\n5467\n");
+
+    // corrupt the checksum at the end of the frame
+    auto frame_size = ZstdFile(std::make_shared<MemoryBuffer>(content.data(), content.size()), File::READ).frames()[0].compressed_size;
+    content[frame_size - 1] ^= 0x55;
+    CHECK_THROWS_WITH(read_memory(), "zstd: Restored data doesn't match checksum");
+
+    content[0] = 0x00;
+    CHECK_THROWS_WITH(read_memory(), "zstd: Unknown frame descriptor");
+}
+
+TEST_CASE("Random access in a zstd file") {
+    auto filename = NamedTempPath(".zst");
+
+    SECTION("With a seek table") {
+        auto options = CompressionOptions();
+        options.block_size = 100000;
+        options.threads = 3;
+        auto lines = write_lines(filename, options);
+
+        auto file = ZstdFile(filename, File::READ);
+        CHECK(file.frames().size() > 1);
+
+        check_random_access(filename, lines);
+    }
+
+    SECTION("Without a seek table") {
+        auto options = CompressionOptions();
+        options.block_size = 100000;
+        auto lines = write_lines(filename, options);
+
+        // remove the seek table, to get the same files as produced by the
+        // standard zstd tools
+        auto frames = ZstdFile(filename, File::READ).frames();
+        auto content = read_binary_file(filename);
+        auto end = frames.back().start + frames.back().compressed_size;
+        content.resize(static_cast<size_t>(end));
+        {
+            std::ofstream file(filename, std::ios_base::binary);
+            file.write(reinterpret_cast<const char*>(content.data()), static_cast<std::streamsize>(content.size()));
+        }
+
+        auto file = ZstdFile(filename, File::READ);
+        CHECK(file.frames().empty());
+
+        check_random_access(filename, lines);
+    }
+}
+
+TEST_CASE("Append to a zstd file") {
+    auto filename = NamedTempPath(".zst");
+    {
+        TextFile file(filename, File::WRITE, File::ZSTD);
+        file.print("first\n");
+    }
+    {
+        TextFile file(filename, File::APPEND, File::ZSTD);
+        file.print("second\n");
+    }
+
+    TextFile file(filename, File::READ, File::ZSTD);
+    CHECK(file.readall() == "first\nsecond\n");
+}
@@ -1,5 +1,7 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <fmt/format.h>
+
 #include "catch.hpp"
 #include "helpers.hpp"
 #include "chemfiles.hpp"
@@ -293,6 +295,32 @@ TEST_CASE("Read and write files in memory") {
     }
 }
 
+TEST_CASE("Read large files in parallel") {
+    // generate a file large enough to be scanned with multiple threads
+    auto content = std::string();
+    auto natoms = std::vector<size_t>();
+    for (size_t step = 0; step < 2000; step++) {
+        auto n = 10 + (step * 37) % 100;
+        natoms.push_back(n);
+        content += fmt::format("generated step t= {}\n{:>5}\n", step, n);
+        for (size_t i = 0; i < n; i++) {
+            content += fmt::format(
+                "{:>5}{:<5}{:>5}{:>5}{:8.3f}{:8.3f}{:8.3f}\n",
+                i + 1, "RES", "C", i + 1, static_cast<double>(step % 100), 0.0, 0.0
+            );
+        }
+        content += "   1.00000   1.00000   1.00000\n";
+    }
+    REQUIRE(content.size() > 2 * 1024 * 1024);
+
+    auto file = Trajectory::memory_reader(content.data(), content.size(), "GRO");
+    REQUIRE(file.nsteps() == 2000);
+    for (size_t step = 0; step < 2000; step += 97) {
+        auto frame = file.read_step(step);
+        CHECK(frame.size() == natoms[step]);
+        CHECK(approx_eq(frame.positions()[0][0], 10.0 * static_cast<double>(step % 100), 1e-6));
+    }
+}
 
 TEST_CASE("Buggy files") {
     CHECK_THROWS_WITH(
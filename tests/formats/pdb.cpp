@@ -1,7 +1,15 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <cstdint>
 #include <cstdlib>
 
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fmt/format.h>
+
 #include "catch.hpp"
 #include "helpers.hpp"
 #include "chemfiles.hpp"
@@ -150,6 +158,46 @@ TEST_CASE("Read files in PDB format") {
         CHECK(residue.name() == "LIG");
     }
 
+    SECTION("Residues out of order") {
+        // residues are not sorted, and atoms from different residues are
+        // interleaved
+        auto content = std::string(
+            "ATOM      1  CA  RES A   3       0.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      2  CA  LIG A   1       1.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      3  CB  RES A   3       2.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      4  CA  LIG A   2       3.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      5  CA  RES B   1       4.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      6  CA  RES A   4       5.000   0.000   0.000  1.00  0.00           C\n"
+            "ATOM      7  CA  LIG A   1       6.000   0.000   0.000  1.00  0.00           C\n"
+            "END\n"
+        );
+        auto frame = Trajectory::memory_reader(content.data(), content.size(), "PDB").read();
+        REQUIRE(frame.size() == 7);
+
+        // residues are sorted by chain and residue id
+        const auto& residues = frame.topology().residues();
+        REQUIRE(residues.size() == 5);
+        auto expected = std::vector<std::tuple<std::string, int64_t, std::string, std::vector<size_t>>>{
+            {"A", 1, "LIG", {1, 6}},
+            {"A", 2, "LIG", {3}},
+            {"A", 3, "RES", {0, 2}},
+            {"A", 4, "RES", {5}},
+            {"B", 1, "RES", {4}},
+        };
+        for (size_t i = 0; i < residues.size(); i++) {
+            const auto& residue = residues[i];
+            CHECK(residue.get("chainid")->as_string() == std::get<0>(expected[i]));
+            CHECK(residue.id().value() == std::get<1>(expected[i]));
+            CHECK(residue.name() == std::get<2>(expected[i]));
+
+            auto atoms = std::vector<size_t>(residue.begin(), residue.end());
+            CHECK(atoms == std::get<3>(expected[i]));
+            for (auto atom: atoms) {
+                CHECK(&frame.topology().residue_for_atom(atom).value() == &residue);
+            }
+        }
+    }
+
     SECTION("Read ATOM/HETATM information") {
         auto file = Trajectory("data/pdb/hemo.pdb");
         auto frame = file.read();
@@ -247,6 +295,73 @@ TEST_CASE("Read files in PDB format") {
         CHECK(topology.bonds().size() == 815);
     }
 
+    SECTION("Standard residues with missing atoms") {
+        const auto names = std::vector<std::string>{
+            "HO5'", "P", "OP1", "OP2", "O5'", "C5'", "C4'", "O4'", "C3'", "O3'",
+            "C2'", "C1'", "N9", "C8", "N7", "C5", "C6", "N6", "N1", "C2", "N3", "C4",
+        };
+        // the first residue is missing N6, and the last one is missing O3'.
+        // Only the first residue has a 5' terminal hydroxyl, and only the
+        // other ones have a phosphate.
+        auto content = std::string();
+        size_t serial = 1;
+        for (int64_t resid = 1; resid <= 3; resid++) {
+            for (const auto& name: names) {
+                if ((resid == 1 && (name == "N6" || name == "P" || name == "OP1" || name == "OP2")) ||
+                    (resid != 1 && name == "HO5'") ||
+                    (resid == 3 && name == "O3'")) {
+                    continue;
+                }
+                content += fmt::format(
+                    "ATOM  {:>5} {:<4}  DA A{:>4}    {:8.3f}{:8.3f}{:8.3f}  1.00  0.00          {:>2}\n",
+                    serial, name, resid, static_cast<double>(serial), 0.0, 0.0, name.substr(0, 1)
+                );
+                serial++;
+            }
+        }
+        content += "END\n";
+
+        auto warnings = std::vector<std::string>();
+        set_warning_callback([&](const std::string& message) {
+            warnings.push_back(message);
+        });
+        auto frame = Trajectory::memory_reader(content.data(), content.size(), "PDB").read();
+        set_warning_callback([](const std::string& message) {
+            std::cerr << "[chemfiles] " << message << std::endl;
+        });
+
+        // missing atoms are reported once, even if they are part of multiple bonds
+        REQUIRE(warnings.size() == 2);
+        CHECK(warnings[0] == "PDB reader: could not find standard atom 'N6' in residue 'DA' (resid 1)");
+        CHECK(warnings[1] == "PDB reader: could not find standard atom 'O3'' in residue 'DA' (resid 3)");
+
+        const auto& topology = frame.topology();
+        REQUIRE(topology.residues().size() == 3);
+        auto atom = [&](size_t residue, const std::string& name) {
+            for (auto i: topology.residue(residue)) {
+                if (frame[i].name() == name) {
+                    return i;
+                }
+            }
+            FAIL("missing atom " << name << " in residue " << residue);
+            return SIZE_MAX;
+        };
+
+        const auto& bonds = topology.bonds();
+        CHECK(contains(bonds, Bond(atom(0, "HO5'"), atom(0, "O5'"))));
+        CHECK(contains(bonds, Bond(atom(0, "C6"), atom(0, "N1"))));
+        CHECK(contains(bonds, Bond(atom(1, "C6"), atom(1, "N6"))));
+
+        // nucleotides are linked through the phosphate, even if the O3' atom
+        // of the current residue is missing
+        CHECK(contains(bonds, Bond(atom(0, "O3'"), atom(1, "P"))));
+        CHECK(contains(bonds, Bond(atom(1, "O3'"), atom(2, "P"))));
+        CHECK_FALSE(contains(bonds, Bond(atom(0, "O3'"), atom(1, "O3'"))));
+
+        // bonds inside each residue, and two links between residues
+        CHECK(bonds.size() == 20 + 23 + 22 + 2);
+    }
+
     SECTION("Read atomic insertion codes") {
         auto frame = Trajectory("data/pdb/insertion-code.pdb").read();
         auto& topology = frame.topology();
@@ -542,6 +657,18 @@ TEST_CASE("PDB files with big values") {
         CHECK_THROWS_WITH(trajectory.write(frame), "value in atomic position is too big for representation in PDB format");
     }
 
+    SECTION("Coordinates in large frames") {
+        // the records of large frames are formatted in chunks of 16384 atoms
+        // by multiple threads, the error should still be reported by `write`
+        auto trajectory = Trajectory::memory_writer("PDB");
+        auto frame = Frame();
+        for (size_t i = 0; i < 50000; i++) {
+            frame.add_atom(Atom("A"), {0, 0, 0});
+        }
+        frame.positions()[40000] = Vector3D(123456789, 2, 3);
+        CHECK_THROWS_WITH(trajectory.write(frame), "value in atomic position is too big for representation in PDB format");
+    }
+
     SECTION("Default residues") {
         auto tmpfile = NamedTempPath(".pdb");
 
@@ -636,4 +763,118 @@ TEST_CASE("Read and write files in memory") {
         CHECK(approx_eq(positions[0], Vector3D(0.299, 8.310, 11.721), 1e-4));
         CHECK(approx_eq(positions[296], Vector3D(6.798, 11.509, 12.704), 1e-4));
     }
+
+    SECTION("Reading multiple steps in parallel") {
+        // multiple models, with a helix defined in the header and optionally
+        // a sheet defined inside one of the models
+        auto create_content = [](size_t sheet_model) {
+            auto content = std::string("HELIX    1   1 RES A    1  RES A    2  1\n");
+            for (size_t model = 0; model < 20; model++) {
+                content += fmt::format("MODEL     {:>4}\n", model + 1);
+                if (model == sheet_model) {
+                    content += "SHEET    1   A 1 RES A   3  RES A   3  0\n";
+                }
+                for (size_t residue = 1; residue <= 3; residue++) {
+                    content += fmt::format(
+                        "ATOM  {:>5}  CA  RES A{:>4}    {:8.3f}{:8.3f}{:8.3f}  1.00  0.00           C\n",
+                        residue, residue, static_cast<double>(model), static_cast<double>(residue), 0.0
+                    );
+                }
+                content += "ENDMDL\n";
+            }
+            content += "END\n";
+            return content;
+        };
+
+        auto check_read_steps = [](const std::string& content) {
+            auto file = Trajectory::memory_reader(content.data(), content.size(), "PDB");
+            REQUIRE(file.nsteps() == 20);
+            auto expected = std::vector<Frame>();
+            for (size_t step = 0; step < 20; step++) {
+                expected.push_back(file.read_step(step));
+            }
+
+            file = Trajectory::memory_reader(content.data(), content.size(), "PDB");
+            auto frames = file.read_steps(0, 20);
+            REQUIRE(frames.size() == 20);
+            for (size_t i = 0; i < frames.size(); i++) {
+                REQUIRE(frames[i].size() == 3);
+                CHECK(frames[i].positions()[0][0] == static_cast<double>(i));
+
+                const auto& residues = frames[i].topology().residues();
+                const auto& expected_residues = expected[i].topology().residues();
+                REQUIRE(residues.size() == 3);
+                REQUIRE(expected_residues.size() == 3);
+                for (size_t r = 0; r < 3; r++) {
+                    auto secondary = residues[r].get<Property::STRING>("secondary_structure").value_or("");
+                    auto expected_secondary = expected_residues[r].get<Property::STRING>("secondary_structure").value_or("");
+                    CHECK(secondary == expected_secondary);
+                }
+
+                CHECK(residues[0].get("secondary_structure")->as_string() == "right-handed alpha helix");
+                CHECK(residues[1].get("secondary_structure")->as_string() == "right-handed alpha helix");
+            }
+            return frames;
+        };
+
+        auto frames = check_read_steps(create_content(SIZE_MAX));
+        for (const auto& frame: frames) {
+            CHECK_FALSE(frame.topology().residues()[2].get("secondary_structure"));
+        }
+
+        // the sheet applies to all models after the one containing it
+        frames = check_read_steps(create_content(10));
+        CHECK_FALSE(frames[9].topology().residues()[2].get("secondary_structure"));
+        CHECK(frames[10].topology().residues()[2].get("secondary_structure")->as_string() == "extended");
+        CHECK(frames[19].topology().residues()[2].get("secondary_structure")->as_string() == "extended");
+    }
+
+    SECTION("Warnings when reading multiple steps in parallel") {
+        auto create_content = [](const std::string& invalid) {
+            auto content = std::string();
+            for (size_t model = 0; model < 20; model++) {
+                content += fmt::format("MODEL     {:>4}\n", model + 1);
+                content += fmt::format("FOOBAR {}\n", model);
+                if (model == 12) {
+                    content += invalid;
+                }
+                content += "ATOM      1  CA  RES A   1       0.000   0.000   0.000  1.00  0.00           C\n";
+                content += "ENDMDL\n";
+            }
+            content += "END\n";
+            return content;
+        };
+
+        auto read_warnings = [](const std::string& content) {
+            auto warnings = std::vector<std::string>();
+            set_warning_callback([&](const std::string& message) {
+                warnings.push_back(message);
+            });
+            auto file = Trajectory::memory_reader(content.data(), content.size(), "PDB");
+            try {
+                file.read_steps(0, 20);
+            } catch (const Error&) {
+                // only check the warnings
+            }
+            set_warning_callback([](const std::string& message) {
+                std::cerr << "[chemfiles] " << message << std::endl;
+            });
+            return warnings;
+        };
+
+        // warnings are sent once, in the same order as serial reading
+        auto warnings = read_warnings(create_content(""));
+        REQUIRE(warnings.size() == 20);
+        for (size_t model = 0; model < 20; model++) {
+            CHECK(warnings[model] == fmt::format("PDB reader: ignoring unknown record: FOOBAR {}", model));
+        }
+
+        // when reading fails, the warnings come from the serial reading only
+        auto invalid = "ATOM      2  CA  RES A   1       x.000   0.000   0.000  1.00  0.00           C\n";
+        warnings = read_warnings(create_content(invalid));
+        REQUIRE(warnings.size() == 13);
+        for (size_t model = 0; model < 13; model++) {
+            CHECK(warnings[model] == fmt::format("PDB reader: ignoring unknown record: FOOBAR {}", model));
+        }
+    }
 }
@@ -88,6 +88,29 @@ TEST_CASE("Read files in SMI format") {
     }
 }
 
+TEST_CASE("Read large files in parallel") {
+    // generate a file large enough to be scanned with multiple threads, with
+    // some empty lines between the molecules
+    auto content = std::string();
+    auto natoms = std::vector<size_t>();
+    for (size_t step = 0; step < 100000; step++) {
+        auto n = 10 + (step * 37) % 30;
+        natoms.push_back(n);
+        if (step % 7 == 0) {
+            content += "\n";
+        }
+        content += std::string(n, 'C') + "\n";
+    }
+    REQUIRE(content.size() > 2 * 1024 * 1024);
+
+    auto file = Trajectory::memory_reader(content.data(), content.size(), "SMI");
+    REQUIRE(file.nsteps() == 100000);
+    for (size_t step = 0; step < 100000; step += 997) {
+        auto frame = file.read_step(step);
+        CHECK(frame.size() == natoms[step]);
+    }
+}
+
 TEST_CASE("Check parsing results") {
     SECTION("Details") {
         auto file = Trajectory("data/smi/details.smi");
@@ -117,6 +117,33 @@ R"(4 written by the chemfiles library
 }
 
 
+TEST_CASE("Read large files in parallel") {
+    // generate a file large enough to be scanned with multiple threads, with
+    // a unit cell in some of the steps
+    auto content = std::string();
+    auto natoms = std::vector<size_t>();
+    for (size_t step = 0; step < 2000; step++) {
+        auto n = 10 + (step * 37) % 200;
+        natoms.push_back(n);
+        content += std::to_string(n) + " atoms in step " + std::to_string(step) + "\n";
+        if (step % 2 == 0) {
+            content += "10.0 10.0 10.0 90.0 90.0 90.0\n";
+        }
+        for (size_t i = 0; i < n; i++) {
+            content += std::to_string(i + 1) + " C " + std::to_string(step) + " " + std::to_string(i) + " 0 1\n";
+        }
+    }
+    REQUIRE(content.size() > 2 * 1024 * 1024);
+
+    auto file = Trajectory::memory_reader(content.data(), content.size(), "Tinker");
+    REQUIRE(file.nsteps() == 2000);
+    for (size_t step = 0; step < 2000; step += 97) {
+        auto frame = file.read_step(step);
+        CHECK(frame.size() == natoms[step]);
+        CHECK(frame.positions()[0][0] == static_cast<double>(step));
+    }
+}
+
 TEST_CASE("Read and write files in memory") {
     SECTION("Reading from memory") {
         auto content = read_text_file("data/tinker/nitrogen.arc");
@@ -2,6 +2,7 @@
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "catch.hpp"
 #include "helpers.hpp"
@@ -370,6 +371,47 @@ F 4 5 6
     }
 }
 
+TEST_CASE("Read large files in parallel") {
+    // generate a file large enough to be scanned with multiple threads, with
+    // comment lines looking like the start of a step
+    auto content = std::string();
+    auto natoms = std::vector<size_t>();
+    for (size_t step = 0; step < 2000; step++) {
+        auto n = 10 + (step * 37) % 200;
+        natoms.push_back(n);
+        content += std::to_string(n) + "\n" + std::to_string(step) + "\n";
+        for (size_t i = 0; i < n; i++) {
+            content += "C " + std::to_string(step) + " " + std::to_string(i) + " 0\n";
+        }
+    }
+    REQUIRE(content.size() > 2 * 1024 * 1024);
+
+    auto file = Trajectory::memory_reader(content.data(), content.size(), "XYZ");
+    REQUIRE(file.nsteps() == 2000);
+    for (size_t step = 0; step < 2000; step += 97) {
+        auto frame = file.read_step(step);
+        CHECK(frame.size() == natoms[step]);
+        CHECK(frame.positions()[0][0] == static_cast<double>(step));
+    }
+
+    auto frames = file.read_steps(500, 300);
+    for (size_t i = 0; i < frames.size(); i++) {
+        CHECK(frames[i].step() == 500 + i);
+        CHECK(frames[i].size() == natoms[500 + i]);
+        CHECK(frames[i].positions()[0][0] == static_cast<double>(500 + i));
+    }
+
+    // errors in the frames are reported as when reading a single step
+    auto invalid = content;
+    auto position = invalid.find("C 1000 2 0");
+    invalid[position + 7] = 'x';
+    file = Trajectory::memory_reader(invalid.data(), invalid.size(), "XYZ");
+    CHECK_THROWS_WITH(
+        file.read_steps(990, 20),
+        "error while reading 'C 1000 x 0': can not parse 'x' as a double"
+    );
+}
+
 TEST_CASE("Round-trip read/write") {
     std::string EXPECTED =
 R"(3
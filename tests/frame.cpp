@@ -52,6 +52,136 @@ TEST_CASE("Frame size") {
     CHECK_THROWS_AS(frame.remove(15), OutOfBounds);
 }
 
+TEST_CASE("Remove multiple atoms") {
+    auto frame = Frame();
+    frame.add_velocities();
+    for (size_t i = 0; i < 6; i++) {
+        auto value = static_cast<double>(i);
+        frame.add_atom(Atom(i % 3 == 0 ? "O" : "H"), {value, 0, 0}, {0, value, 0});
+    }
+    frame.add_bond(0, 1);
+    frame.add_bond(0, 2, Bond::DOUBLE);
+    frame.add_bond(3, 4);
+    frame.add_bond(3, 5, Bond::TRIPLE);
+
+    auto residue = Residue("first");
+    residue.add_atom(0);
+    residue.add_atom(1);
+    residue.add_atom(2);
+    frame.add_residue(residue);
+    residue = Residue("second");
+    residue.add_atom(3);
+    residue.add_atom(4);
+    residue.add_atom(5);
+    frame.add_residue(residue);
+
+    SECTION("Remove") {
+        // unordered, with duplicates
+        auto indexes = std::vector<size_t>{4, 1, 4};
+        frame.remove(indexes);
+
+        CHECK(frame.size() == 4);
+        CHECK(frame.positions()[0] == Vector3D(0, 0, 0));
+        CHECK(frame.positions()[1] == Vector3D(2, 0, 0));
+        CHECK(frame.positions()[2] == Vector3D(3, 0, 0));
+        CHECK(frame.positions()[3] == Vector3D(5, 0, 0));
+        CHECK((*frame.velocities())[3] == Vector3D(0, 5, 0));
+
+        const auto& topology = frame.topology();
+        CHECK(topology.bonds() == (std::vector<Bond>{{0, 1}, {2, 3}}));
+        CHECK(topology.bond_orders() == (std::vector<Bond::BondOrder>{Bond::DOUBLE, Bond::TRIPLE}));
+
+        CHECK(topology.residues()[0].size() == 2);
+        CHECK(topology.residues()[1].size() == 2);
+        CHECK(topology.residue_for_atom(1)->name() == "first");
+        CHECK(topology.residue_for_atom(2)->name() == "second");
+        CHECK(topology.residue_for_atom(3)->name() == "second");
+        CHECK_FALSE(topology.residue_for_atom(4));
+
+        indexes = std::vector<size_t>{0, 22};
+        CHECK_THROWS_AS(frame.remove(indexes), OutOfBounds);
+        CHECK(frame.size() == 4);
+    }
+
+    SECTION("Keep") {
+        frame.keep(Selection("name O or index 4"));
+        CHECK(frame.size() == 3);
+        CHECK(frame.positions()[2] == Vector3D(4, 0, 0));
+        CHECK(frame.topology().bonds() == (std::vector<Bond>{{1, 2}}));
+        CHECK(frame.topology().residues()[0].size() == 1);
+        CHECK(frame.topology().residues()[1].size() == 2);
+
+        CHECK_THROWS_AS(frame.keep(Selection("pairs: all")), SelectionError);
+        CHECK(frame.size() == 3);
+    }
+}
+
+TEST_CASE("Extract a subset of a frame") {
+    auto frame = Frame(UnitCell({10, 10, 10}));
+    frame.set_step(42);
+    frame.set("name", "water");
+    frame.add_velocities();
+    for (size_t i = 0; i < 6; i++) {
+        auto value = static_cast<double>(i);
+        frame.add_atom(Atom(i % 3 == 0 ? "O" : "H"), {value, 0, 0}, {0, value, 0});
+    }
+    frame.add_bond(0, 1);
+    frame.add_bond(0, 2, Bond::DOUBLE);
+    frame.add_bond(3, 4);
+    frame.add_bond(3, 5, Bond::TRIPLE);
+
+    auto residue = Residue("first", 1);
+    residue.add_atom(0);
+    residue.add_atom(1);
+    residue.add_atom(2);
+    residue.set("chainid", "A");
+    frame.add_residue(residue);
+    residue = Residue("second");
+    residue.add_atom(3);
+    residue.add_atom(4);
+    residue.add_atom(5);
+    frame.add_residue(residue);
+
+    auto indexes = std::vector<size_t>{5, 3, 0};
+    auto subset = frame.extract(indexes);
+    CHECK(subset.size() == 3);
+    CHECK(subset.step() == 42);
+    CHECK(subset.cell() == frame.cell());
+    CHECK(subset.get("name")->as_string() == "water");
+
+    CHECK(subset[0].type() == "H");
+    CHECK(subset[1].type() == "O");
+    CHECK(subset.positions()[0] == Vector3D(5, 0, 0));
+    CHECK(subset.positions()[2] == Vector3D(0, 0, 0));
+    CHECK((*subset.velocities())[1] == Vector3D(0, 3, 0));
+
+    const auto& topology = subset.topology();
+    CHECK(topology.bonds() == (std::vector<Bond>{{0, 1}}));
+    CHECK(topology.bond_order(0, 1) == Bond::TRIPLE);
+
+    REQUIRE(topology.residues().size() == 2);
+    CHECK(topology.residues()[0].name() == "first");
+    CHECK(topology.residues()[0].id().value() == 1);
+    CHECK(topology.residues()[0].get("chainid")->as_string() == "A");
+    CHECK(topology.residues()[0].contains(2));
+    CHECK(topology.residues()[1].name() == "second");
+    CHECK_FALSE(topology.residues()[1].id());
+    CHECK(topology.residues()[1].size() == 2);
+
+    // the initial frame is not modified
+    CHECK(frame.size() == 6);
+
+    // residues without any extracted atom are not copied
+    indexes = std::vector<size_t>{1};
+    CHECK(frame.extract(indexes).topology().residues().size() == 1);
+    CHECK(frame.extract({}).size() == 0);
+
+    indexes = std::vector<size_t>{0, 6};
+    CHECK_THROWS_AS(frame.extract(indexes), OutOfBounds);
+    indexes = std::vector<size_t>{0, 2, 0};
+    CHECK_THROWS_WITH(frame.extract(indexes), "atomic index 0 is present multiple times in `Frame::extract`");
+}
+
 TEST_CASE("Positions and velocities") {
     auto frame = Frame();
     frame.resize(15);
@@ -184,6 +314,69 @@ TEST_CASE("Guess topology") {
         frame.guess_bonds();
         CHECK(frame.topology().bonds() == (std::vector<Bond>{{0, 2}}));
     }
+
+    SECTION("Periodic boundary conditions") {
+        auto frame = Frame(UnitCell({20, 20, 20}));
+        frame.add_atom(Atom("C"), {0.5, 10, 10});
+        frame.add_atom(Atom("C"), {19.5, 10, 10});
+        frame.add_atom(Atom("C"), {10, 10, 10});
+        frame.add_atom(Atom("C"), {10, 10.5, 19.2});
+        frame.add_atom(Atom("C"), {10, 10, 0.3});
+
+        frame.guess_bonds();
+        CHECK(frame.topology().bonds() == (std::vector<Bond>{{0, 1}, {3, 4}}));
+
+        // a and b are at 60°
+        frame = Frame(UnitCell({10, 10, 10}, {90, 90, 60}));
+        frame.add_atom(Atom("C"), {1, 1, 5});
+        // image of (1, -0.4, 5) through the b vector
+        frame.add_atom(Atom("C"), {6, 8.26025403784, 5});
+        frame.add_atom(Atom("C"), {5, 5, 5});
+
+        frame.guess_bonds();
+        CHECK(frame.topology().bonds() == (std::vector<Bond>{{0, 1}}));
+
+        // cell smaller than three times the cutoff
+        frame = Frame(UnitCell({3, 3, 3}));
+        frame.add_atom(Atom("C"), {0, 0, 0});
+        frame.add_atom(Atom("C"), {2, 0, 0});
+
+        frame.guess_bonds();
+        CHECK(frame.topology().bonds() == (std::vector<Bond>{{0, 1}}));
+    }
+
+    SECTION("Larger systems") {
+        auto cells = std::vector<UnitCell>{
+            UnitCell(),
+            UnitCell({15, 17, 12}),
+            UnitCell({15, 17, 12}, {70, 95, 110}),
+        };
+
+        for (const auto& cell: cells) {
+            auto frame = Frame(cell);
+            for (size_t i = 0; i < 600; i++) {
+                // deterministic pseudo-random positions
+                auto x = static_cast<double>((i * 7919) % 1500) / 100.0;
+                auto y = static_cast<double>((i * 6563) % 1700) / 100.0;
+                auto z = static_cast<double>((i * 5171) % 1200) / 100.0;
+                frame.add_atom(Atom(i % 3 == 0 ? "O" : "C"), {x, y, z});
+            }
+            frame.guess_bonds();
+
+            auto expected = std::vector<Bond>();
+            for (size_t i = 0; i < frame.size(); i++) {
+                for (size_t j = i + 1; j < frame.size(); j++) {
+                    auto radii = (i % 3 == 0 ? 1.3 : 1.5) + (j % 3 == 0 ? 1.3 : 1.5);
+                    auto d = frame.distance(i, j);
+                    if (0.03 < d && d < 0.6 * radii) {
+                        expected.emplace_back(i, j);
+                    }
+                }
+            }
+            CHECK(!expected.empty());
+            CHECK(frame.topology().bonds() == expected);
+        }
+    }
 }
 
 TEST_CASE("PBC functions") {
@@ -1,14 +1,14 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <limits>
+#include <string>
+#include <vector>
+
 #include <catch.hpp>
 
 #include "chemfiles/parse.hpp"
 #include "chemfiles/Error.hpp"
 
-static bool relative_eq(double a, double b) {
-    return fabs((b - a) / a) < 1e-14;
-}
-
 TEST_CASE("String parsing") {
     SECTION("Double") {
         CHECK(chemfiles::parse<double>("12.5") == 12.5);
@@ -37,15 +37,29 @@ TEST_CASE("String parsing") {
         CHECK(chemfiles::parse<double>("+0.0") == 0.0);
         CHECK(chemfiles::parse<double>("-0.0") == 0.0);
 
-        // Some float are not parsed exactly, but up to a 1e-14 RELATIVE error
-        // which is good enough for our purposes
-        CHECK(relative_eq(chemfiles::parse<double>("1.97576e0"), 1.97576e0));
-        CHECK(relative_eq(chemfiles::parse<double>("2.27e-308"), 2.27e-308));
-        CHECK(relative_eq(chemfiles::parse<double>("1.15507e-173"), 1.15507e-173));
-        CHECK(relative_eq(
-            chemfiles::parse<double>("0.000000000000000000000000000000000000783475"),
+        // Doubles are correctly rounded
+        CHECK(chemfiles::parse<double>("1.97576e0") == 1.97576e0);
+        CHECK(chemfiles::parse<double>("2.27e-308") == 2.27e-308);
+        CHECK(chemfiles::parse<double>("1.15507e-173") == 1.15507e-173);
+        CHECK(
+            chemfiles::parse<double>("0.000000000000000000000000000000000000783475") ==
             0.000000000000000000000000000000000000783475
-        ));
+        );
+        CHECK(chemfiles::parse<double>("0.1") == 0.1);
+        CHECK(chemfiles::parse<double>("1.7976931348623157e308") == std::numeric_limits<double>::max());
+        CHECK(chemfiles::parse<double>("2.2250738585072014e-308") == std::numeric_limits<double>::min());
+        // subnormal numbers
+        CHECK(chemfiles::parse<double>("4.9406564584124654e-324") == std::numeric_limits<double>::denorm_min());
+        CHECK(chemfiles::parse<double>("2.2250738585072009e-308") == 2.2250738585072009e-308);
+        CHECK(chemfiles::parse<double>("1e-400") == 0.0);
+        // exactly halfway between two doubles, rounding to even
+        CHECK(chemfiles::parse<double>("9007199254740993") == 9007199254740992.0);
+        CHECK(chemfiles::parse<double>("9007199254740995") == 9007199254740996.0);
+        // more than 19 significant digits
+        CHECK(chemfiles::parse<double>("3.14159265358979323846264338327950288") == 3.14159265358979323846264338327950288);
+        CHECK(chemfiles::parse<double>("9007199254740993.0000000000000000001") == 9007199254740994.0);
+        CHECK(chemfiles::parse<double>("123456789012345678901234567890") == 123456789012345678901234567890.0);
+        CHECK(chemfiles::parse<double>("0.00000000000000000000000000000000000000000000000000001") == 1e-53);
 
         CHECK_THROWS_WITH(
             chemfiles::parse<double>(""),
@@ -81,6 +95,35 @@ TEST_CASE("String parsing") {
         }
     }
 
+    SECTION("Fixed-width double") {
+        CHECK(chemfiles::parse_fixed<double>("  12.345") == 12.345);
+        CHECK(chemfiles::parse_fixed<double>(" -12.345") == -12.345);
+        CHECK(chemfiles::parse_fixed<double>("   0.001") == 0.001);
+        CHECK(chemfiles::parse_fixed<double>("1234.567") == 1234.567);
+        CHECK(chemfiles::parse_fixed<double>("   -0.000") == 0.0);
+        CHECK(chemfiles::parse_fixed<double>("     42") == 42.0);
+        CHECK(chemfiles::parse_fixed<double>("    42.") == 42.0);
+        CHECK(chemfiles::parse_fixed<double>("   .5  ") == 0.5);
+
+        // other numbers are parsed with parse<double>
+        CHECK(chemfiles::parse_fixed<double>(" 1.2e3  ") == 1.2e3);
+        CHECK(chemfiles::parse_fixed<double>("\t+2.5") == 2.5);
+        CHECK(chemfiles::parse_fixed<double>("0.12345678901234567") == 0.12345678901234567);
+
+        CHECK_THROWS_WITH(
+            chemfiles::parse_fixed<double>("        "),
+            "can not parse '        ' as a double"
+        );
+        CHECK_THROWS_WITH(
+            chemfiles::parse_fixed<double>("  1.2.3"),
+            "can not parse '  1.2.3' as a double"
+        );
+        CHECK_THROWS_WITH(
+            chemfiles::parse_fixed<double>("   -"),
+            "can not parse '   -' as a double"
+        );
+    }
+
     SECTION("int64_t") {
         CHECK(chemfiles::parse<int64_t>("125") == 125);
         CHECK(chemfiles::parse<int64_t>("-32") == -32);
@@ -109,6 +152,14 @@ TEST_CASE("String parsing") {
             chemfiles::parse<int64_t>("9223372036854775808"),
             "9223372036854775808 is out of range for 64-bit integer"
         );
+        CHECK_THROWS_WITH(
+            chemfiles::parse<int64_t>("-9223372036854775809"),
+            "-9223372036854775809 is out of range for 64-bit integer"
+        );
+        CHECK_THROWS_WITH(
+            chemfiles::parse<int64_t>("123456789012345678901"),
+            "123456789012345678901 is out of range for 64-bit integer"
+        );
 
         auto BAD = {"foo", "5673bar", "5673  bar", "2.5"};
         for (auto bad: BAD) {
@@ -204,6 +255,64 @@ TEST_CASE("scan") {
         chemfiles::scan("4.2 4", i, d),
         "error while reading '4.2 4': can not parse '4.2' as an integer"
     );
+
+    SECTION("Long lines") {
+        // values crossing the 64 bytes blocks boundaries
+        auto line = std::string(60, ' ') + "12345678" + std::string(58, ' ') + "\t-3.5e2\r\n" + std::string(66, 'a');
+        count = chemfiles::scan(line, i, d, s);
+        CHECK((i == 12345678 && d == -350.0 && s == std::string(66, 'a')));
+        CHECK(count == line.size());
+
+        // input size is a multiple of the block size
+        line = std::string(63, ' ') + "1" + std::string(63, ' ') + "2";
+        int j = 0;
+        count = chemfiles::scan(line, i, j);
+        CHECK((i == 1 && j == 2));
+        CHECK(count == 128);
+
+        CHECK_THROWS_WITH(
+            chemfiles::scan(std::string(64, ' ') + "3", i, j),
+            "error while reading '" + std::string(64, ' ') + "3': expected 2 values, found 1"
+        );
+    }
+}
+
+TEST_CASE("split_whitespace") {
+    auto tokens = std::vector<std::string_view>();
+
+    chemfiles::split_whitespace("", tokens);
+    CHECK(tokens.empty());
+
+    chemfiles::split_whitespace(" \t\r\n\f  ", tokens);
+    CHECK(tokens.empty());
+
+    chemfiles::split_whitespace("a bc\tdef\r\n  g", tokens);
+    CHECK(tokens == std::vector<std::string_view>{"a", "bc", "def", "g"});
+
+    // previous content is removed
+    chemfiles::split_whitespace("  foo  ", tokens);
+    CHECK(tokens == std::vector<std::string_view>{"foo"});
+
+    // vertical tab is not a separator
+    chemfiles::split_whitespace("a\vb c", tokens);
+    CHECK(tokens == std::vector<std::string_view>{"a\vb", "c"});
+
+    // tokens crossing the 64 bytes blocks boundaries
+    auto line = std::string(63, 'a') + " " + std::string(70, 'b') + " " + std::string(63, 'c') + "d";
+    chemfiles::split_whitespace(line, tokens);
+    CHECK(tokens == std::vector<std::string_view>{
+        std::string_view(line).substr(0, 63),
+        std::string_view(line).substr(64, 70),
+        std::string_view(line).substr(135, 64),
+    });
+
+    line = std::string(64, ' ') + std::string(64, 'x');
+    chemfiles::split_whitespace(line, tokens);
+    CHECK(tokens == std::vector<std::string_view>{std::string(64, 'x')});
+
+    line = std::string(200, 'y');
+    chemfiles::split_whitespace(line, tokens);
+    CHECK(tokens == std::vector<std::string_view>{line});
 }
 
 static void recycle(size_t width, int64_t value, const std::string& hybrid) {
@@ -183,6 +183,38 @@ TEST_CASE("Connectivity detection") {
         impropers.push_back({12, 19, 16, 18});
         CHECK(topology.impropers() == impropers);
     }
+
+    SECTION("Incremental updates") {
+        auto topology = Topology();
+        for (size_t i=0; i<8; i++) {
+            topology.add_atom(Atom());
+        }
+        auto bonds = std::vector<Bond>{{0, 1}, {1, 2}, {2, 3}, {3, 4}, {2, 5}};
+        topology.add_bonds(bonds);
+
+        // compute everything before modifying the bonds
+        CHECK(topology.angles().size() == 5);
+        CHECK(topology.dihedrals().size() == 4);
+        CHECK(topology.impropers().size() == 1);
+
+        topology.add_bond(4, 6);
+        topology.add_bond(2, 7);
+        topology.remove_bond(1, 2);
+        topology.remove(0);
+
+        // compare with a topology computing everything from scratch
+        auto expected = Topology();
+        for (size_t i=0; i<7; i++) {
+            expected.add_atom(Atom());
+        }
+        bonds = std::vector<Bond>{{1, 2}, {2, 3}, {1, 4}, {3, 5}, {1, 6}};
+        expected.add_bonds(bonds);
+
+        CHECK(topology.bonds() == expected.bonds());
+        CHECK(topology.angles() == expected.angles());
+        CHECK(topology.dihedrals() == expected.dihedrals());
+        CHECK(topology.impropers() == expected.impropers());
+    }
 }
 
 TEST_CASE("Out of bounds errors") {
@@ -202,6 +234,49 @@ TEST_CASE("Out of bounds errors") {
     CHECK_THROWS_AS(topology.remove_bond(25, 0), OutOfBounds);
 
     CHECK_THROWS_AS(topology.remove(25), OutOfBounds);
+
+    auto bonds = std::vector<Bond>{{0, 1}, {0, 25}};
+    CHECK_THROWS_AS(topology.add_bonds(bonds), OutOfBounds);
+    CHECK(topology.bonds().empty());
+}
+
+TEST_CASE("Add multiple bonds at once") {
+    auto topology = Topology();
+    for (unsigned i=0; i<6; i++) {
+        topology.add_atom(Atom("C"));
+    }
+    topology.add_bond(2, 3, Bond::TRIPLE);
+
+    auto bonds = std::vector<Bond>{{4, 5}, {0, 1}, {3, 2}, {1, 2}, {1, 0}};
+    auto orders = std::vector<Bond::BondOrder>{
+        Bond::SINGLE, Bond::DOUBLE, Bond::SINGLE, Bond::AROMATIC, Bond::SINGLE
+    };
+    topology.add_bonds(bonds, orders);
+
+    CHECK(topology.bonds() == (std::vector<Bond>{{0, 1}, {1, 2}, {2, 3}, {4, 5}}));
+    // existing bonds and the first occurrence of duplicated bonds keep their
+    // bond order
+    CHECK(topology.bond_orders() == (std::vector<Bond::BondOrder>{
+        Bond::DOUBLE, Bond::AROMATIC, Bond::TRIPLE, Bond::SINGLE
+    }));
+    CHECK(topology.angles() == (std::vector<Angle>{{0, 1, 2}, {1, 2, 3}}));
+    CHECK(topology.dihedrals() == (std::vector<Dihedral>{{0, 1, 2, 3}}));
+
+    // without bond orders
+    bonds = std::vector<Bond>{{3, 4}};
+    topology.add_bonds(bonds);
+    CHECK(topology.bonds().size() == 5);
+    CHECK(topology.bond_order(3, 4) == Bond::UNKNOWN);
+
+    // empty list of bonds
+    topology.add_bonds({});
+    CHECK(topology.bonds().size() == 5);
+
+    // mismatched bond orders
+    CHECK_THROWS_WITH(topology.add_bonds(bonds, orders),
+        "invalid size for bond orders in `Topology::add_bonds`: "
+        "we have 1 bonds, but got 5 bond orders"
+    );
 }
 
 TEST_CASE("Add and remove items in the topology") {
@@ -330,4 +405,9 @@ TEST_CASE("Residues in topologies") {
     CHECK(all_residues[1].contains(8));
     CHECK(!all_residues[1].contains(9));
     CHECK(all_residues[2].size() == 2); // Totally removed
+
+    // atoms are associated with the right residues after being shifted
+    CHECK(topology.residue_for_atom(8)->size() == 3);
+    CHECK(topology.residue_for_atom(8)->contains(8));
+    CHECK_FALSE(topology.residue_for_atom(9));
 }
@@ -1,13 +1,20 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cstdint>
 #include <fstream>
 #include <thread>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <catch.hpp>
 
 #include "helpers.hpp"
 #include "chemfiles.hpp"
+#include "chemfiles/File.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
 using namespace chemfiles;
 
 // This file only perform basic testing of the trajectory class. All the
@@ -89,6 +96,23 @@ TEST_CASE("Setting frame step") {
 }
 
 
+TEST_CASE("Read multiple steps") {
+    auto file = Trajectory("data/xyz/helium.xyz");
+    auto frames = file.read_steps(3, 5);
+    REQUIRE(frames.size() == 5);
+
+    auto other = Trajectory("data/xyz/helium.xyz");
+    for (size_t i = 0; i < 5; i++) {
+        auto frame = other.read_step(3 + i);
+        CHECK(frames[i].step() == 3 + i);
+        CHECK(frames[i].size() == frame.size());
+        CHECK(frames[i].positions()[0] == frame.positions()[0]);
+    }
+
+    CHECK(file.read_steps(0, 0).empty());
+}
+
+
 TEST_CASE("Associate an unit cell and a trajectory") {
     SECTION("Reading") {
         auto file = Trajectory("data/xyz/trajectory.xyz");
@@ -183,6 +207,130 @@ TEST_CASE("Specify a format parameter") {
     CHECK(frame[0].name() == "Fe");
 }
 
+TEST_CASE("Compression options") {
+    auto frame = Frame();
+    frame.add_atom(Atom("Fe"), {0, 1, 2});
+    frame.add_atom(Atom("Zn"), {3, 4, 5});
+
+    auto formats = {
+        "XYZ / GZ(level=1, threads=2)",
+        "XYZ / GZ(level=0)",
+        "XYZ / BZ2(level=9, threads=1)",
+        "XYZ / XZ(level=9, extreme=true, block_size=16)",
+        "XYZ / XZ(level = 0, threads = 3, )",
+        "XYZ / XZ()",
+        "XYZ / ZST(level=19, block_size=64, threads=2)",
+        "XYZ / ZST",
+    };
+    for (auto format: formats) {
+        auto tmpfile = NamedTempPath(".xyz");
+        auto file = Trajectory(tmpfile, 'w', format);
+        for (size_t i = 0; i < 10; i++) {
+            file.write(frame);
+        }
+        file.close();
+
+        file = Trajectory(tmpfile, 'r', format);
+        CHECK(file.nsteps() == 10);
+        auto read = file.read_step(7);
+        CHECK(read.size() == 2);
+        CHECK(read[1].name() == "Zn");
+    }
+
+    auto tmpfile = NamedTempPath(".xyz");
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(level=23)"),
+        "invalid value '23' for compression option 'level': expected a value between 0 and 22"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(level=12)"),
+        "invalid compression level 12 for xz, expected a value between 0 and 9"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / GZ(threads=-1)"),
+        Catch::StartsWith("invalid value '-1' for compression option 'threads'")
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(extreme=yes)"),
+        "invalid value 'yes' for compression option 'extreme': expected 'true' or 'false'"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(block_size=0)"),
+        "invalid value '0' for compression option 'block_size': the block size can not be 0"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(speed=3)"),
+        "unknown compression option 'speed', expected one of 'level', 'extreme', 'block_size' or 'threads'"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(level)"),
+        "invalid compression option 'level': expected 'name=value'"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / XZ(level=3"),
+        "invalid compression options in 'XZ(level=3': missing closing parenthesis"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / BZ2(level=0)"),
+        "invalid compression level 0 for bzip2, expected a value between 1 and 9"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / GZ(extreme=true)"),
+        "the 'extreme' compression option is only supported for xz compression"
+    );
+    CHECK_THROWS_WITH(
+        Trajectory(tmpfile, 'w', "XYZ / BZ2(block_size=1000)"),
+        "the 'block_size' compression option is only supported for xz and zstd compression"
+    );
+}
+
+TEST_CASE("Compressed memory trajectories") {
+    auto frame = Frame();
+    frame.add_atom(Atom("Fe"), {0, 1, 2});
+
+    auto plain = Trajectory::memory_writer("XYZ");
+    plain.write(frame);
+    plain.write(frame);
+    plain.write(frame);
+    auto plain_buffer = plain.memory_buffer().value();
+    auto expected = std::string(plain_buffer.begin(), plain_buffer.end());
+
+    auto formats = std::vector<std::pair<std::string, File::Compression>>{
+        {"XYZ / GZ", File::GZIP},
+        {"XYZ / XZ(level=1)", File::LZMA},
+        {"XYZ / BZ2(threads=2)", File::BZIP2},
+        {"XYZ / ZST(block_size=10)", File::ZSTD},
+    };
+    for (const auto& format: formats) {
+        auto file = Trajectory::memory_writer(format.first);
+        file.write(frame);
+        file.write(frame);
+
+        auto buffer = file.memory_buffer().value();
+        auto data = std::vector<char>(buffer.begin(), buffer.end());
+        auto reader = Trajectory::memory_reader(data.data(), data.size(), format.first);
+        CHECK(reader.nsteps() == 2);
+        CHECK(reader.read_step(1)[0].name() == "Fe");
+
+        // getting the buffer again without writing does not change it
+        auto again = file.memory_buffer().value();
+        CHECK(std::vector<char>(again.begin(), again.end()) == data);
+
+        file.write(frame);
+        buffer = file.memory_buffer().value();
+        data = std::vector<char>(buffer.begin(), buffer.end());
+        reader = Trajectory::memory_reader(data.data(), data.size(), format.first);
+        CHECK(reader.nsteps() == 3);
+
+        again = file.memory_buffer().value();
+        CHECK(std::vector<char>(again.begin(), again.end()) == data);
+
+        // the data decompresses to the same content as an uncompressed file
+        auto memory = std::make_shared<MemoryBuffer>(data.data(), data.size());
+        CHECK(TextFile(memory, File::READ, format.second).readall() == expected);
+    }
+}
+
 TEST_CASE("Guessing format") {
     CHECK(guess_format("not-a-file.xyz") == "XYZ");
     CHECK(guess_format("not-a-file.pdb") == "PDB");
@@ -191,6 +339,7 @@ TEST_CASE("Guessing format") {
     CHECK(guess_format("not-a-file.xyz.gz") == "XYZ / GZ");
     CHECK(guess_format("not-a-file.xyz.bz2") == "XYZ / BZ2");
     CHECK(guess_format("not-a-file.xyz.xz") == "XYZ / XZ");
+    CHECK(guess_format("not-a-file.xyz.zst") == "XYZ / ZST");
 
     CHECK_THROWS_WITH(
         guess_format("not-a-file.unknown"),
@@ -202,6 +351,88 @@ TEST_CASE("Guessing format") {
     );
 }
 
+TEST_CASE("Guessing format from file content") {
+    auto frame = Frame();
+    frame.add_atom(Atom("Fe"), {0, 1, 2});
+
+    auto write = [&](const std::string& path, const std::string& format) {
+        auto file = Trajectory(path, 'w', format);
+        file.write(frame);
+    };
+
+    SECTION("Compressed files") {
+        // compressed file with a wrong extension
+        auto tmpfile = NamedTempPath(".xyz");
+        write(tmpfile, "XYZ / GZ");
+        CHECK(guess_format(tmpfile) == "XYZ / GZ");
+        CHECK(Trajectory(tmpfile).read()[0].name() == "Fe");
+        // no sniffing when writing
+        CHECK(guess_format(tmpfile, 'w') == "XYZ");
+
+        // the cache is invalidated when the file changes
+        write(tmpfile, "XYZ / ZST(level=10)");
+        CHECK(guess_format(tmpfile) == "XYZ / ZST");
+
+        write(tmpfile, "XYZ");
+        CHECK(guess_format(tmpfile) == "XYZ");
+
+        // uncompressed file with a compressed extension
+        auto uncompressed = NamedTempPath(".xyz.gz");
+        write(uncompressed, "XYZ");
+        CHECK(guess_format(uncompressed) == "XYZ");
+    }
+
+    SECTION("Binary formats") {
+        auto xtc = NamedTempPath("");
+        write(xtc, "XTC");
+        CHECK(guess_format(xtc) == "XTC");
+
+        auto trr = NamedTempPath(".pdb");
+        write(trr, "TRR");
+        CHECK(guess_format(trr) == "TRR");
+
+        auto dcd = NamedTempPath(".unknown");
+        write(dcd, "DCD");
+        CHECK(guess_format(dcd) == "DCD");
+
+        // formats sharing the same magic number use the extension
+        auto netcdf = NamedTempPath("");
+        write(netcdf, "Amber NetCDF");
+        CHECK(guess_format(netcdf) == "Amber NetCDF");
+
+        auto restart = NamedTempPath(".ncrst");
+        write(restart, "Amber Restart");
+        CHECK(guess_format(restart) == "Amber Restart");
+
+        // TPR header: XDR encoded version string and precision
+        auto write_bytes = [](const std::string& path, const std::string& bytes) {
+            std::ofstream file(path, std::ios::binary);
+            file << bytes;
+        };
+        auto tpr = NamedTempPath(".xyz");
+        write_bytes(tpr, std::string("\0\0\0\x0d\0\0\0\x0cVERSION 2021\0\0\0\x04", 24));
+        CHECK(guess_format(tpr) == "TPR");
+
+        // "VERSION" somewhere in a text file is not enough
+        auto not_tpr = NamedTempPath(".xyz");
+        write_bytes(not_tpr, "4\nfile with VERSION 2021\nH 0 0 0\n");
+        CHECK(guess_format(not_tpr) == "XYZ");
+
+        auto bad_precision = NamedTempPath(".xyz");
+        write_bytes(bad_precision, std::string("\0\0\0\x0d\0\0\0\x0cVERSION 2021\0\0\0\x03", 24));
+        CHECK(guess_format(bad_precision) == "XYZ");
+
+        // compressed binary files
+        auto content = read_binary_file(xtc);
+        auto compressed = NamedTempPath("");
+        {
+            auto file = TextFile(compressed, File::WRITE, File::GZIP);
+            file.print("{}", std::string(content.begin(), content.end()));
+        }
+        CHECK(guess_format(compressed) == "XTC / GZ");
+    }
+}
+
 static void read_from_multiple_threads(std::string filename, size_t n_atoms) {
     auto n_steps = Trajectory(filename).nsteps();
     size_t n_threads = 4;
@@ -293,6 +524,8 @@ TEST_CASE("Errors") {
     SECTION("Read file past end") {
         auto file = Trajectory("data/xyz/trajectory.xyz", 'r');
         CHECK_THROWS_AS(file.read_step(2), FileError);
+        CHECK_THROWS_AS(file.read_steps(1, 2), FileError);
+        CHECK_THROWS_AS(file.read_steps(1, SIZE_MAX), OutOfBounds);
 
         file.read();
         file.read();
@@ -305,6 +538,7 @@ TEST_CASE("Errors") {
 
         CHECK_THROWS_AS(file.read(), FileError);
         CHECK_THROWS_AS(file.read_step(0), FileError);
+        CHECK_THROWS_AS(file.read_steps(0, 1), FileError);
         CHECK_THROWS_AS(file.write(Frame()), FileError);
         CHECK_THROWS_AS(file.nsteps(), FileError);
         CHECK_THROWS_AS(file.done(), FileError);
@@ -312,4 +546,20 @@ TEST_CASE("Errors") {
         CHECK_THROWS_AS(file.set_topology(Topology()), FileError);
         CHECK_THROWS_AS(file.set_topology("topology"), FileError);
     }
+
+#ifdef __linux__
+    SECTION("Write error when closing the file") {
+        auto frame = Frame();
+        frame.add_atom(Atom("Fe"), {0, 1, 2});
+
+        // all writes to /dev/full fail, but the data is only written when
+        // flushing the buffers
+        auto file = Trajectory("/dev/full", 'w', "XYZ");
+        file.write(frame);
+        CHECK_THROWS_AS(file.close(), FileError);
+
+        // the file is closed even if writing failed
+        CHECK_THROWS_AS(file.write(frame), FileError);
+    }
+#endif
 }
@@ -129,3 +129,40 @@ TEST_CASE("split") {
     expected = std::vector<std::string_view>{"bla  bla", " jk:fiuks"};
     CHECK(chemfiles::split(",,bla  bla, jk:fiuks", ',') == expected);
 }
+
+TEST_CASE("skip_lines") {
+    auto input = std::string("a\nbb\n\nccc\n");
+    for (size_t i=0; i<20; i++) {
+        // make sure to test both short and long inputs
+        input += "0123456789abcdefghijklmnopqrstuvwxyz\n";
+    }
+    const auto* begin = input.data();
+    const auto* end = input.data() + input.size();
+
+    size_t count = 0;
+    CHECK(chemfiles::skip_lines(begin, end, count) == begin);
+
+    count = 1;
+    CHECK(chemfiles::skip_lines(begin, end, count) == begin + 2);
+    CHECK(count == 0);
+
+    count = 3;
+    CHECK(chemfiles::skip_lines(begin, end, count) == begin + 6);
+    CHECK(count == 0);
+
+    count = 10;
+    CHECK(chemfiles::skip_lines(begin, end, count) == begin + 10 + 6 * 37);
+    CHECK(count == 0);
+
+    count = 24;
+    CHECK(chemfiles::skip_lines(begin, end, count) == end);
+    CHECK(count == 0);
+
+    count = 30;
+    CHECK(chemfiles::skip_lines(begin, end, count) == nullptr);
+    CHECK(count == 6);
+
+    count = 3;
+    CHECK(chemfiles::skip_lines(begin, begin + 4, count) == nullptr);
+    CHECK(count == 2);
+}
@@ -0,0 +1,139 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <limits>
+#include <memory>
+
+#include <catch.hpp>
+#include <fmt/format.h>
+
+#include "chemfiles/write_numbers.hpp"
+#include "chemfiles/files/MemoryBuffer.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+template <size_t Precision>
+static std::string fixed(double value, size_t width) {
+    auto buffer = line_buffer();
+    write_fixed<Precision>(buffer, value, width);
+    return std::string(buffer.data(), buffer.size());
+}
+
+static std::string general(double value) {
+    auto buffer = line_buffer();
+    write_general(buffer, value);
+    return std::string(buffer.data(), buffer.size());
+}
+
+static std::string integer(int64_t value, size_t width) {
+    auto buffer = line_buffer();
+    write_integer(buffer, value, width);
+    return std::string(buffer.data(), buffer.size());
+}
+
+TEST_CASE("Fixed precision numbers") {
+    CHECK(fixed<3>(1.5, 8) == "   1.500");
+    CHECK(fixed<3>(-12.25, 8) == " -12.250");
+    CHECK(fixed<3>(123456.789, 8) == "123456.789");
+    CHECK(fixed<3>(-0.0, 8) == "  -0.000");
+    CHECK(fixed<3>(-0.0001, 8) == "  -0.000");
+    CHECK(fixed<0>(41.7, 4) == "  42");
+    CHECK(fixed<4>(0.00005, 0) == "0.0001");
+    CHECK(fixed<2>(0.125, 6) == "  0.12");
+    CHECK(fixed<2>(0.375, 6) == "  0.38");
+    CHECK(fixed<3>(1e20, 8) == "100000000000000000000.000");
+    // fmt aligns non-finite values on the left
+    CHECK(fixed<3>(std::nan(""), 8) == "nan     ");
+    CHECK(fixed<3>(-std::numeric_limits<double>::infinity(), 8) == "-inf    ");
+
+    auto rng = std::mt19937_64(12345);
+    auto distribution = std::uniform_real_distribution<double>(-1.0, 1.0);
+    for (size_t i = 0; i < 10000; i++) {
+        auto value = distribution(rng) * std::pow(10.0, static_cast<double>(i % 12));
+        CHECK(fixed<3>(value, 8) == fmt::format("{:8.3f}", value));
+        CHECK(fixed<5>(value, 10) == fmt::format("{:10.5f}", value));
+    }
+}
+
+TEST_CASE("General format numbers") {
+    CHECK(general(0.0) == "0");
+    CHECK(general(-0.0) == "-0");
+    CHECK(general(1.0) == "1");
+    CHECK(general(-2.5) == "-2.5");
+    CHECK(general(123456.0) == "123456");
+    CHECK(general(123456.5) == "123456");
+    CHECK(general(1234567.0) == "1.23457e+06");
+    CHECK(general(0.0001) == "0.0001");
+    CHECK(general(0.00001) == "1e-05");
+    CHECK(general(999999.5) == "1e+06");
+    CHECK(general(1e100) == "1e+100");
+    CHECK(general(-1.25e-300) == "-1.25e-300");
+    CHECK(general(std::nan("")) == "nan");
+
+    auto rng = std::mt19937_64(12345);
+    auto distribution = std::uniform_real_distribution<double>(-1.0, 1.0);
+    for (size_t i = 0; i < 10000; i++) {
+        auto value = distribution(rng) * std::pow(10.0, static_cast<double>(i % 40) - 20);
+        CHECK(general(value) == fmt::format("{:g}", value));
+    }
+}
+
+TEST_CASE("Integers and strings") {
+    CHECK(integer(0, 5) == "    0");
+    CHECK(integer(-42, 5) == "  -42");
+    CHECK(integer(123456, 5) == "123456");
+    CHECK(integer(std::numeric_limits<int64_t>::min(), 0) == "-9223372036854775808");
+
+    auto buffer = line_buffer();
+    write_left(buffer, "ab", 4);
+    write_right(buffer, "cd", 4);
+    write_string(buffer, "|");
+    write_left(buffer, "toolong", 2);
+    write_right(buffer, "toolong", 2);
+    CHECK(std::string(buffer.data(), buffer.size()) == "ab    cd|toolongtoolong");
+}
+
+TEST_CASE("Writing records") {
+    // records of different sizes, spanning multiple chunks and buffers
+    auto count = 10 * WRITE_RECORDS_CHUNK_SIZE + 17;
+    auto format = [](line_buffer& buffer, size_t i) {
+        write_integer(buffer, static_cast<int64_t>(i), 0);
+        write_string(buffer, std::string(i % 7, ' '));
+        write_string(buffer, "\n");
+    };
+
+    auto expected = line_buffer();
+    for (size_t i = 0; i < count; i++) {
+        format(expected, i);
+    }
+
+    for (size_t threads: {size_t{1}, size_t{4}}) {
+        auto buffer = std::make_shared<MemoryBuffer>(4096);
+        auto file = TextFile(buffer, File::WRITE, File::DEFAULT);
+        file.print("header\n");
+        write_records(file, count, threads, format);
+        file.print("footer\n");
+        file.flush();
+
+        auto content = std::string(buffer->data(), buffer->size());
+        CHECK(content == "header\n" + std::string(expected.data(), expected.size()) + "footer\n");
+    }
+
+    auto buffer = std::make_shared<MemoryBuffer>(4096);
+    auto file = TextFile(buffer, File::WRITE, File::DEFAULT);
+    write_records(file, 0, 4, format);
+    file.flush();
+    CHECK(buffer->size() == 0);
+
+    CHECK_THROWS_WITH(
+        write_records(file, count, 4, [](line_buffer&, size_t i) {
+            if (i == 3 * WRITE_RECORDS_CHUNK_SIZE + 5) {
+                throw chemfiles::Error("bad record");
+            }
+        }),
+        "bad record"
+    );
+}